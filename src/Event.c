@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Event.h"
+#include "MP4.h"
+#include "Utils.h"
+
+typedef struct {
+    char dir[128];
+    EventConfig config;
+
+    MediaFrame **ring;      // config.maxFrames references, starts with a key frame
+    int head;
+    int count;
+    int bytes;
+    int cut;                // the pre-roll was cut by the ring bounds, reported once
+
+    volatile int trigger;
+    int recording;          // between the trigger and the end of post-roll
+    uint64_t postEnd;       // pts
+    uint32_t events;
+
+    Sink mp4;               // driven from this sink's thread, not started
+    int fileOpen;
+}EventContext;
+
+static EventConfig gEventConfig = {5, 10, 8192, 192};
+
+void eventSetConfig(const EventConfig *config) {
+    gEventConfig = *config;
+}
+
+void eventTrigger(Sink *sink) {
+    EventContext *ctx = (EventContext *)sink->priv;
+
+    if (ctx)
+        __sync_lock_test_and_set(&ctx->trigger, 1);
+}
+
+static MediaFrame *eventRingAt(EventContext *ctx, int i) {
+    return ctx->ring[(ctx->head + i) % ctx->config.maxFrames];
+}
+
+static void eventRingPop(EventContext *ctx) {
+    MediaFrame *frame = ctx->ring[ctx->head];
+
+    ctx->bytes -= frame->size;
+    frameUnref(frame);
+    ctx->head = (ctx->head + 1) % ctx->config.maxFrames;
+    ctx->count--;
+}
+
+/* drop the oldest GOP, the ring always starts with a key frame */
+static void eventRingDropGop(EventContext *ctx) {
+    do {
+        eventRingPop(ctx);
+    } while (ctx->count > 0 && !eventRingAt(ctx, 0)->keyFrame);
+}
+
+/* index of the second key frame, 0 if there is only one GOP */
+static int eventRingNextGop(EventContext *ctx) {
+    int i;
+
+    for (i = 1; i < ctx->count; i++) {
+        if (eventRingAt(ctx, i)->keyFrame)
+            return i;
+    }
+    return 0;
+}
+
+/* the ring bounds drop a GOP still within preSeconds, events get less pre-roll than asked */
+static void eventRingCut(EventContext *ctx, uint64_t pts) {
+    if (ctx->cut || 0 == ctx->count)
+        return;
+    ctx->cut = 1;
+    printf("event pre-roll cut to %.1f s by the ring of %d frames, %d KB.\n",
+           (double)(pts - eventRingAt(ctx, 0)->pts) / 1000000, ctx->config.maxFrames, ctx->config.maxKB);
+}
+
+static void eventRingPush(EventContext *ctx, MediaFrame *frame) {
+    uint64_t pre = (uint64_t)ctx->config.preSeconds * 1000000;
+    int next;
+
+    if (ctx->count == 0 && !frame->keyFrame)
+        return;
+    if (ctx->count == ctx->config.maxFrames) {
+        eventRingDropGop(ctx);
+        eventRingCut(ctx, frame->pts);
+    }
+    if (ctx->count == 0 && !frame->keyFrame)
+        return;
+
+    ctx->ring[(ctx->head + ctx->count) % ctx->config.maxFrames] = frameRef(frame);
+    ctx->count++;
+    ctx->bytes += frame->size;
+
+    // keep whole GOPs, just enough to cover preSeconds
+    while ((next = eventRingNextGop(ctx)) > 0 && eventRingAt(ctx, next)->pts + pre <= frame->pts)
+        eventRingDropGop(ctx);
+    while (ctx->count > 0 && ctx->bytes > ctx->config.maxKB * 1024) {
+        eventRingDropGop(ctx);
+        eventRingCut(ctx, frame->pts);
+    }
+}
+
+static int eventFileOpen(EventContext *ctx, const Sink *sink) {
+    char path[256];
+    char *time = getCurrentTime();
+    int i;
+
+    snprintf(path, sizeof(path), "%s/event_%s_%u.mp4", ctx->dir, time, ctx->events);
+    free(time);
+
+    memset(&ctx->mp4, 0, sizeof(Sink));
+    ctx->mp4.ops = &mp4SinkOps;
+    ctx->mp4.info = sink->info;
+    if (mp4SinkOps.open(&ctx->mp4, path) < 0)
+        return -1;
+    ctx->fileOpen = 1;
+
+    printf("event %u record %s, %d frames %d KB before trigger\n", ctx->events, path, ctx->count, ctx->bytes >> 10);
+
+    // hand over the held frames, no copy until the mp4 writer
+    for (i = 0; i < ctx->count; i++) {
+        if (mp4SinkOps.writeFrame(&ctx->mp4, eventRingAt(ctx, i)) < 0)
+            printf("event write frame %u error.\n", eventRingAt(ctx, i)->seq);
+    }
+    while (ctx->count > 0)
+        eventRingPop(ctx);
+
+    return 0;
+}
+
+static void eventFileClose(EventContext *ctx) {
+    mp4SinkOps.close(&ctx->mp4);
+    ctx->fileOpen = 0;
+}
+
+static int eventSinkOpen(Sink *sink, const char *url) {
+    EventContext *ctx;
+
+    if (gEventConfig.maxFrames <= 0 || gEventConfig.maxKB <= 0) {
+        printf("eventSinkOpen ring of %d frames, %d KB is invalid.\n", gEventConfig.maxFrames, gEventConfig.maxKB);
+        return -1;
+    }
+
+    ctx = (EventContext *)calloc(1, sizeof(EventContext));
+    if (NULL == ctx)
+        return -1;
+    ctx->ring = (MediaFrame **)calloc((size_t)gEventConfig.maxFrames, sizeof(MediaFrame *));
+    if (NULL == ctx->ring) {
+        free(ctx);
+        return -1;
+    }
+
+    snprintf(ctx->dir, sizeof(ctx->dir), "%s", url);
+    ctx->config = gEventConfig;
+    sink->priv = ctx;
+    return 0;
+}
+
+static int eventSinkWriteFrame(Sink *sink, MediaFrame *frame) {
+    EventContext *ctx = (EventContext *)sink->priv;
+
+    if (__sync_lock_test_and_set(&ctx->trigger, 0)) {
+        if (!ctx->recording)
+            ctx->events++;
+        ctx->recording = 1;
+        ctx->postEnd = frame->pts + (uint64_t)ctx->config.postSeconds * 1000000;
+    }
+
+    if (ctx->recording) {
+        if (!ctx->fileOpen) {
+            if (ctx->count == 0 && !frame->keyFrame)
+                return 0;
+            if (eventFileOpen(ctx, sink) < 0) {
+                ctx->recording = 0;
+                return -1;
+            }
+        }
+
+        // stop at a GOP boundary, the ring takes over from this key frame
+        if (!(frame->keyFrame && frame->pts >= ctx->postEnd))
+            return mp4SinkOps.writeFrame(&ctx->mp4, frame);
+
+        printf("event %u post-roll done.\n", ctx->events);
+        eventFileClose(ctx);
+        ctx->recording = 0;
+    }
+
+    eventRingPush(ctx, frame);
+    return 0;
+}
+
+static void eventSinkClose(Sink *sink) {
+    EventContext *ctx = (EventContext *)sink->priv;
+
+    if (ctx->fileOpen)
+        eventFileClose(ctx);
+    while (ctx->count > 0)
+        eventRingPop(ctx);
+
+    free(ctx->ring);
+    free(ctx);
+    sink->priv = NULL;
+}
+
+const SinkOps eventSinkOps = {
+    "event",
+    SINK_CAP_STORAGE | SINK_CAP_KEYFRAME,
+    eventSinkOpen,
+    eventSinkWriteFrame,
+    NULL,       // the record writer flushes by itself
+    eventSinkClose
+};
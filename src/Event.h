@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_EVENT_H
+#define HISILIVE_EVENT_H
+
+#include "Sink.h"
+
+typedef struct {
+    int preSeconds;     // kept in RAM before the trigger, rounded up to a whole GOP
+    int postSeconds;    // recorded after the last trigger
+    int maxKB;          // RAM bound of the pre-event ring
+    int maxFrames;      // frames of the pre-event ring, taken from the venc frame pool
+}EventConfig;
+
+/*
+ * Event recorder, url is the directory:
+ * the last preSeconds of frames are held by reference in a GOP aligned ring,
+ * a trigger writes them to event_<time>.mp4 and records until postSeconds after the last trigger.
+ */
+extern const SinkOps eventSinkOps;
+
+/* config of event sinks opened afterwards */
+void eventSetConfig(const EventConfig *config);
+
+/* motion, occlusion or external trigger, safe from any thread */
+void eventTrigger(Sink *sink);
+
+#endif //HISILIVE_EVENT_H
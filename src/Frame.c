@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Frame.h"
+
+int framePoolInit(FramePool *pool, int count) {
+    int i;
+
+    if (NULL == pool || count <= 0) {
+        printf("framePoolInit param error.\n");
+        return -1;
+    }
+
+    memset(pool, 0, sizeof(FramePool));
+    pool->frames = (MediaFrame *)calloc((size_t)count, sizeof(MediaFrame));
+    pool->freeList = (MediaFrame **)calloc((size_t)count, sizeof(MediaFrame *));
+    if (NULL == pool->frames || NULL == pool->freeList) {
+        free(pool->frames);
+        free(pool->freeList);
+        return -1;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+
+    // frame buffers are allocated on first use, sized to the frame
+    for (i = 0; i < count; i++) {
+        pool->frames[i].pool = pool;
+        pool->freeList[i] = &pool->frames[i];
+    }
+    pool->count = count;
+    pool->freeNum = count;
+
+    return 0;
+}
+
+void framePoolDestroy(FramePool *pool) {
+    int i;
+
+    if (pool->freeNum != pool->count)
+        printf("framePoolDestroy %d frames still in use.\n", pool->count - pool->freeNum);
+
+    for (i = 0; i < pool->count; i++) {
+        free(pool->frames[i].data);
+        pool->frames[i].data = NULL;
+        pool->frames[i].capacity = 0;
+    }
+    free(pool->frames);
+    free(pool->freeList);
+    pool->frames = NULL;
+    pool->freeList = NULL;
+    pool->count = pool->freeNum = 0;
+    pthread_mutex_destroy(&pool->lock);
+}
+
+MediaFrame *frameGet(FramePool *pool, int size) {
+    MediaFrame *frame = NULL;
+    uint8_t *data;
+    int i, best = -1;
+
+    /* the smallest free buffer the frame fits in, else the largest one grows: once the buffers
+       were sized by the stream, I and P frames each find their own and nothing is allocated */
+    pthread_mutex_lock(&pool->lock);
+    for (i = pool->freeNum - 1; i >= 0; i--) {
+        if (best < 0 ||
+            (pool->freeList[i]->capacity >= size ?
+             pool->freeList[best]->capacity < size || pool->freeList[i]->capacity < pool->freeList[best]->capacity :
+             pool->freeList[i]->capacity > pool->freeList[best]->capacity))
+            best = i;
+    }
+    if (best >= 0) {
+        frame = pool->freeList[best];
+        pool->freeList[best] = pool->freeList[--pool->freeNum];
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (NULL == frame)
+        return NULL;
+
+    // with room for the next larger frames, the sizes of a stream vary around the rate
+    if (size > frame->capacity) {
+        data = (uint8_t *)realloc(frame->data, (size_t)size + (size_t)size / 4);
+        if (NULL == data) {
+            printf("frameGet realloc %d error.\n", size);
+            frame->refCount = 1;
+            frameUnref(frame);
+            return NULL;
+        }
+        frame->data = data;
+        frame->capacity = size + size / 4;
+    }
+
+    frame->size = 0;
+    frame->pts = 0;
+    frame->seq = 0;
+    frame->keyFrame = 0;
+    frame->temporalId = 0;
+    frame->stream = 0;
+    frame->slice = 0;
+    frame->frameEnd = 1;
+    frame->captureUs = 0;
+    frame->refCount = 1;
+
+    return frame;
+}
+
+MediaFrame *frameBorrow(FramePool *pool, uint8_t *data, int size, FrameRelease release, void *opaque) {
+    MediaFrame *frame = frameGet(pool, 0);
+
+    if (NULL == frame)
+        return NULL;
+
+    frame->own = frame->data;
+    frame->data = data;
+    frame->size = size;
+    frame->release = release;
+    frame->opaque = opaque;
+    return frame;
+}
+
+MediaFrame *frameClone(FramePool *pool, const MediaFrame *frame) {
+    MediaFrame *copy = frameGet(pool, frame->size);
+
+    if (NULL == copy)
+        return NULL;
+
+    memcpy(copy->data, frame->data, (size_t)frame->size);
+    copy->size = frame->size;
+    copy->pts = frame->pts;
+    copy->seq = frame->seq;
+    copy->codec = frame->codec;
+    copy->keyFrame = frame->keyFrame;
+    copy->temporalId = frame->temporalId;
+    copy->stream = frame->stream;
+    copy->slice = frame->slice;
+    copy->frameEnd = frame->frameEnd;
+    copy->captureUs = frame->captureUs;
+    return copy;
+}
+
+int frameAppend(MediaFrame *frame, const uint8_t *data, int size) {
+    uint8_t *buf;
+    int capacity = frame->capacity;
+
+    if (frame->size + size > capacity) {
+        while (capacity < frame->size + size)
+            capacity = capacity ? capacity * 2 : size;
+        buf = (uint8_t *)realloc(frame->data, (size_t)capacity);
+        if (NULL == buf) {
+            printf("frameAppend realloc %d error.\n", capacity);
+            return -1;
+        }
+        frame->data = buf;
+        frame->capacity = capacity;
+    }
+
+    memcpy(frame->data + frame->size, data, (size_t)size);
+    frame->size += size;
+    return 0;
+}
+
+MediaFrame *frameRef(MediaFrame *frame) {
+    __sync_fetch_and_add(&frame->refCount, 1);
+    return frame;
+}
+
+void frameUnref(MediaFrame *frame) {
+    FramePool *pool = frame->pool;
+
+    if (__sync_sub_and_fetch(&frame->refCount, 1) > 0)
+        return;
+
+    if (frame->release) {
+        frame->release(frame);
+        frame->release = NULL;
+        frame->data = frame->own;
+        frame->own = NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->freeList[pool->freeNum++] = frame;
+    pthread_mutex_unlock(&pool->lock);
+}
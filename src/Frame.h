@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_FRAME_H
+#define HISILIVE_FRAME_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+struct FramePool;
+struct MediaFrame;
+
+/* gives borrowed data back to its owner, called when the last reference is dropped */
+typedef void (*FrameRelease)(struct MediaFrame *frame);
+
+/* one encoded frame (all packs, Annex-B) or one slice of it, shared by sinks with a refcount */
+typedef struct MediaFrame {
+    uint8_t *data;
+    int size;
+    int capacity;       // of the own buffer, grows to the largest frame seen, never shrinks
+    uint64_t pts;       // us, from VENC_PACK_S.u64PTS
+    uint32_t seq;       // frame sequence number of venc
+    int codec;          // 0, H.264/AVC; 1, HEVC/H.265
+    int keyFrame;
+    int temporalId;     // svc-t layer, 0 the base layer, a frame references none of a higher one
+    int stream;         // simulcast, 0 the main stream, 1 the sub stream
+    int slice;          // only a part of the access unit, sent as soon as the encoder has it
+    int frameEnd;       // the last part of the access unit, always set on whole frames
+    uint64_t captureUs; // monotonic time the picture was captured, 0 unknown
+    FrameRelease release;   // data is borrowed, e.g. from the venc stream buffer, see frameBorrow()
+    void *opaque;       // for release
+    uint8_t *own;       // the own buffer while data is borrowed
+    volatile int refCount;
+    struct FramePool *pool;
+}MediaFrame;
+
+typedef struct FramePool {
+    MediaFrame *frames;     // count, allocated at init
+    MediaFrame **freeList;
+    int count;
+    int freeNum;
+    pthread_mutex_t lock;
+}FramePool;
+
+int framePoolInit(FramePool *pool, int count);
+
+void framePoolDestroy(FramePool *pool);
+
+/* get a free frame with at least size bytes, refCount = 1, NULL if pool is empty */
+MediaFrame *frameGet(FramePool *pool, int size);
+
+/* a frame pointing at data owned by someone else, release is called with the last reference.
+ * NULL if the pool is empty, the caller still owns the data then */
+MediaFrame *frameBorrow(FramePool *pool, uint8_t *data, int size, FrameRelease release, void *opaque);
+
+/* a frame with its own copy of the data and the same attributes, NULL if the pool is empty */
+MediaFrame *frameClone(FramePool *pool, const MediaFrame *frame);
+
+/* append data to a frame not shared yet and not borrowed, the buffer grows as needed. 0 or -1 */
+int frameAppend(MediaFrame *frame, const uint8_t *data, int size);
+
+MediaFrame *frameRef(MediaFrame *frame);
+
+/* return the frame to its pool when the last reference is dropped */
+void frameUnref(MediaFrame *frame);
+
+#endif //HISILIVE_FRAME_H
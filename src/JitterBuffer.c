@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "JitterBuffer.h"
+
+#define TS_DIFF(a, b)   ((int32_t)((uint32_t)(a) - (uint32_t)(b)))
+
+static int jbCompare(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* the target delay from the transit times in the window */
+static void jbAdapt(JitterBuffer *jb, int32_t transit) {
+    int32_t sorted[JB_WINDOW];
+    uint32_t target;
+
+    jb->transit[jb->transitPos] = transit;
+    jb->transitPos = (jb->transitPos + 1) % JB_WINDOW;
+    if (jb->transitNum < JB_WINDOW)
+        jb->transitNum++;
+
+    /* sorting the window per packet is the cost of the socket handler, take the percentile
+       only when this packet may move it up or a few packets have left the window */
+    if (++jb->adaptPackets < JB_ADAPT_PACKETS && jb->transitNum > 1 && transit >= jb->minTransit &&
+        ((uint32_t)(transit - jb->minTransit) + jb->frameSamples <= jb->target || jb->target >= jb->maxDelay))
+        return;
+    jb->adaptPackets = 0;
+
+    memcpy(sorted, jb->transit, sizeof(int32_t) * jb->transitNum);
+    qsort(sorted, (size_t)jb->transitNum, sizeof(int32_t), jbCompare);
+
+    jb->minTransit = sorted[0];
+    target = (uint32_t)(sorted[(jb->transitNum - 1) * 95 / 100] - sorted[0]) + jb->frameSamples;
+    if (target < jb->minDelay)
+        target = jb->minDelay;
+    if (target > jb->maxDelay)
+        target = jb->maxDelay;
+    jb->target = target;
+}
+
+static void jbFlush(JitterBuffer *jb) {
+    int i;
+
+    for (i = 0; i < JB_SLOTS; i++)
+        jb->slots[i].used = 0;
+    jb->count = 0;
+    jb->playing = 0;
+}
+
+static void jbRemoveHead(JitterBuffer *jb) {
+    jb->slots[jb->order[0]].used = 0;
+    jb->count--;
+    memmove(jb->order, jb->order + 1, sizeof(int) * jb->count);
+}
+
+void jbInit(JitterBuffer *jb, uint32_t rate, uint32_t frameSamples, uint32_t minDelayMs, uint32_t maxDelayMs) {
+    memset(jb, 0, sizeof(JitterBuffer));
+    jb->rate = rate;
+    jb->frameSamples = frameSamples;
+    jb->minDelay = minDelayMs * rate / 1000;
+    jb->maxDelay = maxDelayMs * rate / 1000;
+    jb->target = jb->minDelay;
+}
+
+int jbPut(JitterBuffer *jb, uint32_t ts, int marker, const uint8_t *data, int size, uint32_t samples, uint64_t arrivalUs) {
+    uint32_t arrival = (uint32_t)(arrivalUs * jb->rate / 1000000);
+    JBSlot *slot;
+    int i, empty;
+
+    if (size <= 0 || size > JB_PAYLOAD_MAX || 0 == samples) {
+        jb->stats.overflows++;
+        return -1;
+    }
+    jb->stats.received++;
+
+    if (!jb->started) {
+        jb->started = 1;
+        jb->firstArrival = arrival;
+        jb->firstTs = ts;
+    }
+    jbAdapt(jb, TS_DIFF(arrival - jb->firstArrival, ts - jb->firstTs));
+
+    if (jb->playing) {
+        if (marker && 0 == jb->count) {
+            /* a new talkspurt, play it out with the current target */
+            jb->playing = 0;
+            jb->stats.resyncs++;
+        } else if (TS_DIFF(ts + samples, jb->playTs) <= 0) {
+            jb->stats.late++;
+            return 1;
+        } else if (TS_DIFF(ts, jb->playTs) > (int32_t)(jb->maxDelay + JB_SLOTS * jb->frameSamples)) {
+            /* the sender restarted or skipped ahead */
+            jbFlush(jb);
+            jb->stats.resyncs++;
+        }
+    }
+    if (!jb->playing && 0 == jb->count)
+        jb->startUs = arrivalUs;
+
+    /* mostly in order, look from the newest */
+    for (i = jb->count; i > 0 && TS_DIFF(ts, jb->slots[jb->order[i - 1]].ts) < 0; i--);
+    if ((i > 0 && jb->slots[jb->order[i - 1]].ts == ts) ||
+        (i < jb->count && jb->slots[jb->order[i]].ts == ts)) {
+        jb->stats.duplicates++;
+        return 2;
+    }
+    if (JB_SLOTS == jb->count) {
+        jb->stats.overflows++;
+        return -1;
+    }
+
+    for (empty = 0; jb->slots[empty].used; empty++);
+    slot = &jb->slots[empty];
+    slot->used = 1;
+    slot->ts = ts;
+    slot->samples = samples;
+    slot->size = size;
+    memcpy(slot->data, data, (size_t)size);
+
+    memmove(jb->order + i + 1, jb->order + i, sizeof(int) * (jb->count - i));
+    jb->order[i] = empty;
+    jb->count++;
+    return 0;
+}
+
+/* repeat the last packet a few times, then silence */
+static JBKind jbConceal(JitterBuffer *jb, JBFrame *frame, uint32_t samples) {
+    if (jb->last.size > 0 && jb->repeats < JB_REPEAT_MAX) {
+        jb->repeats++;
+        frame->kind = JB_REPEAT;
+        frame->samples = jb->last.samples;
+        frame->data = jb->last.data;
+        frame->size = jb->last.size;
+    } else {
+        frame->kind = JB_SILENCE;
+        frame->samples = samples;
+        frame->data = NULL;
+        frame->size = 0;
+    }
+    frame->ts = jb->playTs;
+    return frame->kind;
+}
+
+JBKind jbGet(JitterBuffer *jb, uint64_t nowUs, JBFrame *frame) {
+    uint32_t now = (uint32_t)(nowUs * jb->rate / 1000000);
+    JBSlot *head;
+    int32_t gap, delay;
+
+    memset(frame, 0, sizeof(JBFrame));
+    if (!jb->playing) {
+        if (0 == jb->count || (nowUs - jb->startUs < (uint64_t)jb->target * 1000000 / jb->rate &&
+                               jbLevel(jb) < jb->target))
+            return JB_IDLE;
+        jb->playing = 1;
+        jb->playTs = jb->slots[jb->order[0]].ts;
+        jb->repeats = 0;
+        jb->starved = 0;
+    }
+
+    jb->getsSinceDrop++;
+    while (jb->count > 0) {
+        head = &jb->slots[jb->order[0]];
+        gap = TS_DIFF(head->ts, jb->playTs);
+        jb->starved = 0;
+
+        if (TS_DIFF(head->ts + head->samples, jb->playTs) <= 0) {
+            jbRemoveHead(jb);       // covered by concealment already
+            continue;
+        }
+
+        if (gap <= 0) {
+            if (jb->getsSinceDrop >= JB_SHRINK_GETS && jb->count > 1 &&
+                jbLevel(jb) > jb->target + head->samples + jb->frameSamples / 2) {
+                jb->playTs = head->ts + head->samples;
+                jbRemoveHead(jb);
+                jb->stats.dropped++;
+                jb->getsSinceDrop = 0;
+                continue;
+            }
+
+            memcpy(&jb->last, head, sizeof(JBSlot));
+            jbRemoveHead(jb);
+            jb->playTs = jb->last.ts + jb->last.samples;
+            jb->repeats = 0;
+            jb->stats.played++;
+
+            frame->kind = JB_PLAY;
+            frame->ts = jb->last.ts;
+            frame->samples = jb->last.samples;
+            frame->data = jb->last.data;
+            frame->size = jb->last.size;
+            return JB_PLAY;
+        }
+
+        if ((uint32_t)gap > jb->maxDelay) {
+            /* a pause without a marker, don't play it out as silence */
+            jb->playTs = head->ts;
+            jb->stats.resyncs++;
+            continue;
+        }
+
+        /* the packet at playTs is lost, or so late it will be */
+        jb->stats.lost++;
+        jbConceal(jb, frame, (uint32_t)gap < jb->frameSamples ? (uint32_t)gap : jb->frameSamples);
+        jb->playTs += frame->samples;
+        return frame->kind;
+    }
+
+    /* nothing buffered. played with less delay than the target the packet may still come in
+       time, stretch and the delay grows by what is concealed. about at the target delay already,
+       it is one of the few late or lost ones the target leaves out, play on without it */
+    jb->stats.underruns++;
+    jbConceal(jb, frame, jb->frameSamples);
+    delay = TS_DIFF(now - jb->firstArrival, jb->playTs - jb->firstTs) - jb->minTransit;
+    if (delay + (int32_t)jb->frameSamples / 2 >= (int32_t)jb->target)
+        jb->playTs += frame->samples;
+    jb->starved += frame->samples;
+    if (jb->starved > jb->maxDelay) {
+        jb->playing = 0;    // the stream stopped, prebuffer again when it comes back
+        jb->stats.resyncs++;
+    }
+    return frame->kind;
+}
+
+uint32_t jbLevel(const JitterBuffer *jb) {
+    const JBSlot *newest;
+    int32_t level;
+
+    if (0 == jb->count)
+        return 0;
+    newest = &jb->slots[jb->order[jb->count - 1]];
+    level = TS_DIFF(newest->ts + newest->samples, jb->playing ? jb->playTs : jb->slots[jb->order[0]].ts);
+    return level > 0 ? (uint32_t)level : 0;
+}
+
+uint32_t jbTargetMs(const JitterBuffer *jb) {
+    return jb->rate ? (uint32_t)((uint64_t)jb->target * 1000 / jb->rate) : 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_JITTERBUFFER_H
+#define HISILIVE_JITTERBUFFER_H
+
+#include <stdint.h>
+
+#define JB_SLOTS            64      // packets held, 1.28 s of 20 ms packets
+#define JB_PAYLOAD_MAX      1024
+#define JB_WINDOW           256     // transit times the target delay is taken from, ~5 s of 20 ms packets
+#define JB_ADAPT_PACKETS    16      // the percentile is taken again every so many packets
+#define JB_REPEAT_MAX       2       // a lost frame is repeated so often, then silence
+#define JB_SHRINK_GETS      10      // at most one frame dropped every so many gets to shrink the delay
+
+/*
+ * Adaptive jitter buffer for one audio stream, no I/O and no clock of its own,
+ * so arrival traces can be replayed through it on the host (recv/jbtrace).
+ *
+ * The target delay is the 95th percentile of the transit times of the last JB_WINDOW
+ * packets over the smallest one, plus a frame, within [minDelay, maxDelay]. It is taken at
+ * once for a packet beyond the target or below the smallest transit, so it grows with jitter
+ * and a late packet right away, otherwise every JB_ADAPT_PACKETS packets, and falls as the
+ * spikes leave the window.
+ * The player asks for one unit per frame time: a packet, or concealment when the packet
+ * is missing. An empty buffer below the target delay stretches the playout, which grows
+ * the delay; while more than the target is buffered a frame is dropped now and then,
+ * which shrinks it.
+ */
+
+typedef enum {
+    JB_IDLE = 0,        // nothing to play yet, prebuffering or no stream
+    JB_PLAY,            // data is the packet at ts
+    JB_REPEAT,          // data is the last packet played again, for a lost or late one
+    JB_SILENCE          // play samples of silence
+}JBKind;
+
+typedef struct {
+    JBKind kind;
+    uint32_t ts;
+    uint32_t samples;
+    const uint8_t *data;    // valid until the next jbGet()
+    int size;
+}JBFrame;
+
+typedef struct {
+    int used;
+    uint32_t ts;
+    uint32_t samples;
+    int size;
+    uint8_t data[JB_PAYLOAD_MAX];
+}JBSlot;
+
+typedef struct {
+    uint32_t received;
+    uint32_t late;          // arrived after its time was played
+    uint32_t duplicates;
+    uint32_t overflows;     // no slot left
+    uint32_t played;
+    uint32_t lost;          // concealed, a later packet was there
+    uint32_t underruns;     // concealed, the buffer ran empty
+    uint32_t dropped;       // dropped to shrink the delay
+    uint32_t resyncs;       // playout restarted at a new talkspurt or after a long gap
+}JBStats;
+
+typedef struct {
+    uint32_t rate;          // samples per second
+    uint32_t frameSamples;  // samples played per get when there is nothing to play
+    uint32_t minDelay;      // in samples
+    uint32_t maxDelay;
+    uint32_t target;        // current target delay, in samples
+
+    JBSlot slots[JB_SLOTS];
+    int order[JB_SLOTS];    // slot indices by timestamp
+    int count;
+
+    int32_t transit[JB_WINDOW];
+    int transitNum;
+    int transitPos;
+    int adaptPackets;       // since the percentile was taken
+    uint32_t firstArrival;  // rtp clock at the first arrival, the transit times are relative to it
+    uint32_t firstTs;
+    int32_t minTransit;     // smallest in the window
+
+    int started;            // a packet was put
+    int playing;
+    uint64_t startUs;       // first packet of the talkspurt arrived
+    uint32_t playTs;        // timestamp played next
+    int getsSinceDrop;
+    uint32_t starved;       // samples concealed in a row with nothing buffered
+
+    JBSlot last;            // repeated for concealment
+    int repeats;
+
+    JBStats stats;
+}JitterBuffer;
+
+void jbInit(JitterBuffer *jb, uint32_t rate, uint32_t frameSamples, uint32_t minDelayMs, uint32_t maxDelayMs);
+
+/* store a packet of samples at ts, arrived at arrivalUs (monotonic). a marker starts a talkspurt.
+ * 0 stored, 1 late, 2 duplicate, -1 no room or too big */
+int jbPut(JitterBuffer *jb, uint32_t ts, int marker, const uint8_t *data, int size, uint32_t samples, uint64_t arrivalUs);
+
+/* the unit to play at nowUs, returns its kind */
+JBKind jbGet(JitterBuffer *jb, uint64_t nowUs, JBFrame *frame);
+
+/* samples buffered ahead of the playout */
+uint32_t jbLevel(const JitterBuffer *jb);
+
+uint32_t jbTargetMs(const JitterBuffer *jb);
+
+#endif //HISILIVE_JITTERBUFFER_H
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "Loop.h"
+#include "Record.h"
+
+#define LOOP_COPY_SIZE  (64 * 1024)
+#define LOOP_PENDING    64          // GOPs written and not synced yet
+
+typedef struct {
+    char dir[128];
+    LoopConfig config;
+    int slot;
+    int opened;
+
+    RecordWriter rec;
+    int idxFd;
+    uint64_t offset;        // write position in the segment
+
+    LoopIndexEntry gop;     // GOP being written
+    int inGop;
+    uint32_t maxGop;        // room kept at the segment end for the next GOP
+
+    LoopIndexEntry pending[LOOP_PENDING];   // ended GOPs waiting for their data to be synced
+    int pendingNum;
+}LoopContext;
+
+static LoopConfig gLoopConfig = {16, 64};
+
+void loopSetConfig(const LoopConfig *config) {
+    gLoopConfig = *config;
+}
+
+void loopSegmentPath(char *buf, int size, const char *dir, int slot, int codec) {
+    snprintf(buf, (size_t)size, "%s/loop_%03d.%s", dir, slot, codec ? "h265" : "h264");
+}
+
+void loopIndexPath(char *buf, int size, const char *dir, int slot) {
+    snprintf(buf, (size_t)size, "%s/loop_%03d.idx", dir, slot);
+}
+
+/* continue after the newest segment: the first unused slot, or the oldest one */
+static int loopPickSlot(LoopContext *ctx) {
+    char path[256];
+    struct stat st;
+    time_t oldest = 0;
+    int i, slot = 0;
+
+    for (i = 0; i < ctx->config.segments; i++) {
+        loopIndexPath(path, sizeof(path), ctx->dir, i);
+        if (stat(path, &st) < 0)
+            return i;
+        if (0 == i || st.st_mtime < oldest) {
+            oldest = st.st_mtime;
+            slot = i;
+        }
+    }
+    return slot;
+}
+
+static int loopSegmentOpen(LoopContext *ctx, int codec, uint64_t pts) {
+    LoopIndexHeader header;
+    struct timeval tv;
+    char path[256];
+
+    // drop the old index first, so it never points into overwritten data
+    loopIndexPath(path, sizeof(path), ctx->dir, ctx->slot);
+    ctx->idxFd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (ctx->idxFd < 0) {
+        printf("loop open %s error %d.\n", path, errno);
+        return -1;
+    }
+
+    gettimeofday(&tv, NULL);
+    header.magic = LOOP_INDEX_MAGIC;
+    header.version = LOOP_INDEX_VERSION;
+    header.codec = (uint16_t)codec;
+    header.wallBase = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - (int64_t)pts;
+    if (write(ctx->idxFd, &header, sizeof(header)) != sizeof(header)) {
+        printf("loop write %s error %d.\n", path, errno);
+        close(ctx->idxFd);
+        return -1;
+    }
+
+    loopSegmentPath(path, sizeof(path), ctx->dir, ctx->slot, codec);
+    if (recordWriterOpenFixed(&ctx->rec, path, (uint64_t)ctx->config.segmentMB << 20) < 0) {
+        close(ctx->idxFd);
+        return -1;
+    }
+
+    printf("loop record segment %s\n", path);
+    ctx->offset = 0;
+    ctx->opened = 1;
+    return 0;
+}
+
+/* index the pending GOPs whose data is on the disk up to synced, so the index never gets ahead of the data */
+static int loopIndexFlush(LoopContext *ctx, uint64_t synced) {
+    int n = 0;
+
+    while (n < ctx->pendingNum && ctx->pending[n].offset + ctx->pending[n].size <= synced)
+        n++;
+    if (0 == n)
+        return 0;
+
+    if (write(ctx->idxFd, ctx->pending, n * sizeof(LoopIndexEntry)) != (ssize_t)(n * sizeof(LoopIndexEntry))) {
+        printf("loop write index error %d.\n", errno);
+        return -1;
+    }
+    ctx->pendingNum -= n;
+    memmove(ctx->pending, ctx->pending + n, ctx->pendingNum * sizeof(LoopIndexEntry));
+    return 0;
+}
+
+static void loopSegmentClose(LoopContext *ctx) {
+    recordWriterClose(&ctx->rec);
+    loopIndexFlush(ctx, ctx->offset);
+    ctx->pendingNum = 0;
+    fdatasync(ctx->idxFd);
+    close(ctx->idxFd);
+    ctx->opened = 0;
+}
+
+static void loopSegmentNext(LoopContext *ctx) {
+    loopSegmentClose(ctx);
+    ctx->slot = (ctx->slot + 1) % ctx->config.segments;
+}
+
+static int loopGopEnd(LoopContext *ctx) {
+    ctx->inGop = 0;
+    if (0 == ctx->gop.frames)
+        return 0;
+    if (ctx->gop.size > ctx->maxGop)
+        ctx->maxGop = ctx->gop.size;
+
+    // without syncs (syncGops 0) the data is durable only at close, and so is the index beyond this
+    if (LOOP_PENDING == ctx->pendingNum && loopIndexFlush(ctx, ctx->pending[0].offset + ctx->pending[0].size) < 0)
+        return -1;
+    ctx->pending[ctx->pendingNum++] = ctx->gop;
+    return loopIndexFlush(ctx, recordWriterSynced(&ctx->rec));
+}
+
+static int loopSinkOpen(Sink *sink, const char *url) {
+    LoopContext *ctx;
+
+    if (gLoopConfig.segments <= 0 || gLoopConfig.segments > LOOP_SEGMENT_MAX || gLoopConfig.segmentMB <= 0) {
+        printf("loopSinkOpen config %d x %d MB is invalid.\n", gLoopConfig.segments, gLoopConfig.segmentMB);
+        return -1;
+    }
+
+    ctx = (LoopContext *)calloc(1, sizeof(LoopContext));
+    if (NULL == ctx)
+        return -1;
+
+    snprintf(ctx->dir, sizeof(ctx->dir), "%s", url);
+    ctx->config = gLoopConfig;
+    ctx->slot = loopPickSlot(ctx);
+    ctx->idxFd = -1;
+
+    sink->priv = ctx;
+    return 0;
+}
+
+static int loopSinkWriteFrame(Sink *sink, MediaFrame *frame) {
+    LoopContext *ctx = (LoopContext *)sink->priv;
+    uint64_t segSize = (uint64_t)ctx->config.segmentMB << 20;
+
+    if (frame->keyFrame) {
+        if (ctx->inGop && loopGopEnd(ctx) < 0)
+            return -1;
+
+        // the next GOP may not fit, move on to the oldest segment
+        if (ctx->opened && ctx->offset + (ctx->maxGop > (uint32_t)frame->size ? ctx->maxGop : (uint32_t)frame->size) > segSize)
+            loopSegmentNext(ctx);
+        if (!ctx->opened && loopSegmentOpen(ctx, frame->codec, frame->pts) < 0)
+            return -1;
+
+        if (recordWriterMark(&ctx->rec) < 0)
+            return -1;
+        ctx->gop.offset = ctx->offset;
+        ctx->gop.pts = frame->pts;
+        ctx->gop.size = 0;
+        ctx->gop.frames = 0;
+        ctx->inGop = 1;
+    }
+
+    if (!ctx->inGop)
+        return 0;
+
+    // a GOP larger than the room left is cut, the segment is never written past its preallocated size
+    if (ctx->offset + frame->size > segSize) {
+        printf("loop GOP of %u bytes is cut at the end of segment %d.\n", ctx->gop.size, ctx->slot);
+        if (loopGopEnd(ctx) < 0)
+            return -1;
+        loopSegmentNext(ctx);
+        sinkRequestKey(sink);
+        return 0;
+    }
+
+    if (recordWriterWrite(&ctx->rec, frame->data, frame->size) < 0)
+        return -1;
+    ctx->offset += frame->size;
+    ctx->gop.size += frame->size;
+    ctx->gop.frames++;
+    return 0;
+}
+
+static void loopSinkClose(Sink *sink) {
+    LoopContext *ctx = (LoopContext *)sink->priv;
+
+    if (ctx->opened) {
+        if (ctx->inGop)
+            loopGopEnd(ctx);
+        loopSegmentClose(ctx);
+    }
+    free(ctx);
+    sink->priv = NULL;
+}
+
+const SinkOps loopSinkOps = {
+    "loop",
+    SINK_CAP_STORAGE | SINK_CAP_KEYFRAME,
+    loopSinkOpen,
+    loopSinkWriteFrame,
+    NULL,       // the record writer flushes by itself
+    loopSinkClose
+};
+
+int loopIndexLoad(const char *path, LoopIndex *index) {
+    FILE *fp;
+    long size;
+
+    memset(index, 0, sizeof(LoopIndex));
+    fp = fopen(path, "rb");
+    if (NULL == fp) {
+        printf("loop open index %s error.\n", path);
+        return -1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (fread(&index->header, sizeof(LoopIndexHeader), 1, fp) != 1
+        || index->header.magic != LOOP_INDEX_MAGIC || index->header.version != LOOP_INDEX_VERSION) {
+        printf("loop index %s is invalid.\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    // a partial entry left by a power loss is ignored
+    index->count = (int)((size - (long)sizeof(LoopIndexHeader)) / (long)sizeof(LoopIndexEntry));
+    if (index->count > 0) {
+        index->entries = (LoopIndexEntry *)malloc(index->count * sizeof(LoopIndexEntry));
+        if (NULL == index->entries
+            || fread(index->entries, sizeof(LoopIndexEntry), (size_t)index->count, fp) != (size_t)index->count) {
+            printf("loop read index %s error.\n", path);
+            free(index->entries);
+            index->entries = NULL;
+            index->count = 0;
+            fclose(fp);
+            return -1;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+void loopIndexFree(LoopIndex *index) {
+    free(index->entries);
+    index->entries = NULL;
+    index->count = 0;
+}
+
+int loopIndexSeek(const LoopIndex *index, uint64_t pts) {
+    int low = 0, high = index->count - 1, mid, found = -1;
+
+    while (low <= high) {
+        mid = low + (high - low) / 2;
+        if (index->entries[mid].pts <= pts) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return found;
+}
+
+int64_t loopIndexExport(const LoopIndex *index, const char *segment, uint64_t from, uint64_t to, int fd) {
+    uint8_t *buf;
+    uint64_t start, end;
+    int64_t copied = 0;
+    ssize_t n;
+    int first, last, in;
+
+    first = loopIndexSeek(index, from);
+    last = loopIndexSeek(index, to);
+    if (last < 0 || from > to)
+        return 0;
+    if (first < 0)
+        first = 0;
+
+    start = index->entries[first].offset;
+    end = index->entries[last].offset + index->entries[last].size;
+
+    in = open(segment, O_RDONLY);
+    if (in < 0) {
+        printf("loop open %s error %d.\n", segment, errno);
+        return -1;
+    }
+    buf = (uint8_t *)malloc(LOOP_COPY_SIZE);
+    if (NULL == buf) {
+        close(in);
+        return -1;
+    }
+
+    while (start < end) {
+        n = pread(in, buf, (size_t)(end - start < LOOP_COPY_SIZE ? end - start : LOOP_COPY_SIZE), (off_t)start);
+        if (n <= 0 || write(fd, buf, (size_t)n) != n) {
+            printf("loop export %s error %d.\n", segment, errno);
+            copied = -1;
+            break;
+        }
+        start += n;
+        copied += n;
+    }
+
+    free(buf);
+    close(in);
+    return copied;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_LOOP_H
+#define HISILIVE_LOOP_H
+
+#include <stdint.h>
+#include "Sink.h"
+
+#define LOOP_INDEX_MAGIC    0x58494C48      // "HLIX"
+#define LOOP_INDEX_VERSION  1
+#define LOOP_SEGMENT_MAX    256
+
+typedef struct {
+    int segments;       // files in the ring
+    int segmentMB;      // preallocated size of each file
+}LoopConfig;
+
+/* sidecar index: header + one entry per GOP, native byte order */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t codec;     // 0: H.264, 1: H.265
+    int64_t wallBase;   // wall clock (us) = wallBase + pts
+}LoopIndexHeader;
+
+typedef struct {
+    uint64_t offset;    // IDR position in the segment
+    uint64_t pts;       // us
+    uint32_t size;      // bytes until the next IDR
+    uint32_t frames;
+}LoopIndexEntry;
+
+typedef struct {
+    LoopIndexHeader header;
+    LoopIndexEntry *entries;    // sorted by offset and pts
+    int count;
+}LoopIndex;
+
+/*
+ * Loop recorder, url is the directory:
+ *   loop_NNN.h264/.h265 preallocated segments, the oldest is overwritten
+ *   loop_NNN.idx GOP index, truncated before its segment is reused
+ * A segment is only valid up to the end of its last indexed GOP.
+ */
+extern const SinkOps loopSinkOps;
+
+/* config of loop sinks opened afterwards */
+void loopSetConfig(const LoopConfig *config);
+
+void loopSegmentPath(char *buf, int size, const char *dir, int slot, int codec);
+void loopIndexPath(char *buf, int size, const char *dir, int slot);
+
+int loopIndexLoad(const char *path, LoopIndex *index);
+void loopIndexFree(LoopIndex *index);
+
+/* binary search, the GOP containing pts, -1 if it is before the first one */
+int loopIndexSeek(const LoopIndex *index, uint64_t pts);
+
+/* copy the GOPs covering [from, to] of a segment to fd, returns bytes copied */
+int64_t loopIndexExport(const LoopIndex *index, const char *segment, uint64_t from, uint64_t to, int fd);
+
+#endif //HISILIVE_LOOP_H
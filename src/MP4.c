@@ -0,0 +1,620 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "MP4.h"
+#include "Record.h"
+#include "Media.h"
+#include "Utils.h"
+
+#define MP4_SAMPLE_KEY      0x02000000  // sample_depends_on = 2
+#define MP4_SAMPLE_NONKEY   0x01010000  // sample_depends_on = 1, sample_is_non_sync_sample = 1
+
+typedef struct {
+    uint32_t size;
+    uint32_t duration;
+    uint32_t flags;
+}MP4Sample;
+
+typedef struct {
+    uint64_t time;          // MP4_TIMESCALE
+    uint64_t moofOffset;
+}MP4Fragment;
+
+typedef struct {
+    uint8_t data[MP4_PARAM_SET_MAX];
+    int len;
+}MP4ParamSet;
+
+typedef struct {
+    RecordWriter rec;
+    uint64_t offset;        // bytes written to file
+
+    MP4ParamSet vps;
+    MP4ParamSet sps;
+    MP4ParamSet pps;
+    int headerWritten;
+
+    // the GOP being buffered, mdat is already in length-prefixed (AVCC/HVCC) format
+    uint8_t *mdat;
+    int mdatSize;
+    int mdatCap;
+    MP4Sample *samples;
+    int sampleNum;
+    int sampleCap;
+    uint8_t *moof;
+
+    uint64_t firstPts;      // us, first frame of the file
+    uint64_t gopTime;       // MP4_TIMESCALE, first frame of the GOP
+    uint64_t lastTime;      // MP4_TIMESCALE, last frame
+    uint32_t lastDuration;
+    uint32_t fragSeq;
+
+    MP4Fragment *frags;
+    int fragNum;
+    int fragCap;
+}MP4Context;
+
+static uint8_t *putTag(uint8_t *p, const char *tag) {
+    memcpy(p, tag, 4);
+    return p + 4;
+}
+
+/* box size is patched by endBox() */
+static uint8_t *putBox(uint8_t *p, const char *type) {
+    p = Load32(p, 0);
+    return putTag(p, type);
+}
+
+static uint8_t *putFullBox(uint8_t *p, const char *type, uint8_t version, uint32_t flags) {
+    p = putBox(p, type);
+    return Load32(p, ((uint32_t)version << 24) | flags);
+}
+
+static void endBox(uint8_t *box, uint8_t *end) {
+    Load32(box, (uint32_t)(end - box));
+}
+
+static uint8_t *putZero(uint8_t *p, int n) {
+    memset(p, 0, (size_t)n);
+    return p + n;
+}
+
+static uint8_t *putMatrix(uint8_t *p) {
+    p = Load32(p, 0x00010000); p = Load32(p, 0); p = Load32(p, 0);
+    p = Load32(p, 0); p = Load32(p, 0x00010000); p = Load32(p, 0);
+    p = Load32(p, 0); p = Load32(p, 0); p = Load32(p, 0x40000000);
+    return p;
+}
+
+static uint64_t mp4Time(MP4Context *ctx, uint64_t pts) {
+    return (pts - ctx->firstPts) * 9 / 100;    // (μs / 10^6) * (90 * 10^3)
+}
+
+static int mp4Write(MP4Context *ctx, const uint8_t *buf, int len) {
+    if (recordWriterWrite(&ctx->rec, buf, len) < 0) {
+        printf("mp4Write %d bytes error.\n", len);
+        return -1;
+    }
+    ctx->offset += len;
+    return 0;
+}
+
+static int nalType(int codec, const uint8_t *nal) {
+    return codec ? (nal[0] >> 1) & 0x3f : nal[0] & 0x1f;
+}
+
+/* remove emulation prevention bytes, for reading the fields of a parameter set */
+static int nalUnescape(uint8_t *dst, const uint8_t *src, int len) {
+    int i, n = 0, zeros = 0;
+
+    for (i = 0; i < len; i++) {
+        if (zeros == 2 && src[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = (src[i] == 0) ? zeros + 1 : 0;
+        dst[n++] = src[i];
+    }
+    return n;
+}
+
+static uint8_t *putParamSet(uint8_t *p, const MP4ParamSet *ps) {
+    p = Load16(p, (uint16_t)ps->len);
+    memcpy(p, ps->data, (size_t)ps->len);
+    return p + ps->len;
+}
+
+static uint8_t *putAvcC(uint8_t *p, MP4Context *ctx) {
+    uint8_t *box = p;
+
+    p = putBox(p, "avcC");
+    p = Load8(p, 1);                    // configurationVersion
+    p = Load8(p, ctx->sps.data[1]);     // AVCProfileIndication
+    p = Load8(p, ctx->sps.data[2]);     // profile_compatibility
+    p = Load8(p, ctx->sps.data[3]);     // AVCLevelIndication
+    p = Load8(p, 0xFF);                 // lengthSizeMinusOne = 3
+    p = Load8(p, 0xE1);                 // numOfSequenceParameterSets = 1
+    p = putParamSet(p, &ctx->sps);
+    p = Load8(p, 1);                    // numOfPictureParameterSets
+    p = putParamSet(p, &ctx->pps);
+    endBox(box, p);
+    return p;
+}
+
+static uint8_t *putHvcC(uint8_t *p, MP4Context *ctx) {
+    uint8_t *box = p;
+    uint8_t sps[32];    // nal header + sub layer info + general_profile_tier_level
+    int maxSubLayers, nested;
+
+    memset(sps, 0, sizeof(sps));
+    nalUnescape(sps, ctx->sps.data, ctx->sps.len < 32 ? ctx->sps.len : 32);
+    maxSubLayers = ((sps[2] >> 1) & 0x07) + 1;
+    nested = sps[2] & 0x01;
+
+    p = putBox(p, "hvcC");
+    p = Load8(p, 1);                    // configurationVersion
+    memcpy(p, &sps[3], 12);             // profile_space ... general_level_idc
+    p += 12;
+    p = Load16(p, 0xF000);              // min_spatial_segmentation_idc
+    p = Load8(p, 0xFC);                 // parallelismType
+    p = Load8(p, 0xFD);                 // chromaFormat = 4:2:0
+    p = Load8(p, 0xF8);                 // bitDepthLumaMinus8
+    p = Load8(p, 0xF8);                 // bitDepthChromaMinus8
+    p = Load16(p, 0);                   // avgFrameRate
+    p = Load8(p, (uint8_t)((maxSubLayers << 3) | (nested << 2) | 0x03));   // lengthSizeMinusOne = 3
+    p = Load8(p, 3);                    // numOfArrays
+
+    p = Load8(p, 0x80 | 32);            // VPS
+    p = Load16(p, 1);
+    p = putParamSet(p, &ctx->vps);
+    p = Load8(p, 0x80 | 33);            // SPS
+    p = Load16(p, 1);
+    p = putParamSet(p, &ctx->sps);
+    p = Load8(p, 0x80 | 34);            // PPS
+    p = Load16(p, 1);
+    p = putParamSet(p, &ctx->pps);
+    endBox(box, p);
+    return p;
+}
+
+/* ftyp + moov with an empty sample table, samples go to the fragments */
+static int mp4WriteHeader(MP4Context *ctx, const SinkVideoInfo *info) {
+    uint8_t buf[2048];
+    uint8_t *p = buf;
+    uint8_t *moov, *trak, *mdia, *minf, *dinf, *dref, *stbl, *stsd, *entry, *mvex, *box;
+
+    box = p;
+    p = putBox(p, "ftyp");
+    p = putTag(p, "iso5");              // major_brand
+    p = Load32(p, 512);                 // minor_version
+    p = putTag(p, "iso5");
+    p = putTag(p, "iso6");
+    p = putTag(p, "mp41");
+    endBox(box, p);
+
+    moov = p;
+    p = putBox(p, "moov");
+
+    box = p;
+    p = putFullBox(p, "mvhd", 0, 0);
+    p = Load32(p, 0);                   // creation_time
+    p = Load32(p, 0);                   // modification_time
+    p = Load32(p, 1000);                // timescale
+    p = Load32(p, 0);                   // duration, unknown for fragments
+    p = Load32(p, 0x00010000);          // rate
+    p = Load16(p, 0x0100);              // volume
+    p = putZero(p, 10);                 // reserved
+    p = putMatrix(p);
+    p = putZero(p, 24);                 // pre_defined
+    p = Load32(p, 2);                   // next_track_ID
+    endBox(box, p);
+
+    trak = p;
+    p = putBox(p, "trak");
+
+    box = p;
+    p = putFullBox(p, "tkhd", 0, 0x03); // enabled, in movie
+    p = Load32(p, 0);                   // creation_time
+    p = Load32(p, 0);                   // modification_time
+    p = Load32(p, 1);                   // track_ID
+    p = Load32(p, 0);                   // reserved
+    p = Load32(p, 0);                   // duration
+    p = putZero(p, 8);                  // reserved
+    p = Load16(p, 0);                   // layer
+    p = Load16(p, 0);                   // alternate_group
+    p = Load16(p, 0);                   // volume
+    p = Load16(p, 0);                   // reserved
+    p = putMatrix(p);
+    p = Load32(p, (uint32_t)info->width << 16);
+    p = Load32(p, (uint32_t)info->height << 16);
+    endBox(box, p);
+
+    mdia = p;
+    p = putBox(p, "mdia");
+
+    box = p;
+    p = putFullBox(p, "mdhd", 0, 0);
+    p = Load32(p, 0);                   // creation_time
+    p = Load32(p, 0);                   // modification_time
+    p = Load32(p, MP4_TIMESCALE);
+    p = Load32(p, 0);                   // duration
+    p = Load16(p, 0x55C4);              // language "und"
+    p = Load16(p, 0);
+    endBox(box, p);
+
+    box = p;
+    p = putFullBox(p, "hdlr", 0, 0);
+    p = Load32(p, 0);                   // pre_defined
+    p = putTag(p, "vide");
+    p = putZero(p, 12);                 // reserved
+    memcpy(p, "VideoHandler", 13);
+    p += 13;
+    endBox(box, p);
+
+    minf = p;
+    p = putBox(p, "minf");
+
+    box = p;
+    p = putFullBox(p, "vmhd", 0, 1);
+    p = putZero(p, 8);                  // graphicsmode, opcolor
+    endBox(box, p);
+
+    dinf = p;
+    p = putBox(p, "dinf");
+    dref = p;
+    p = putFullBox(p, "dref", 0, 0);
+    p = Load32(p, 1);                   // entry_count
+    box = p;
+    p = putFullBox(p, "url ", 0, 1);    // media data is in this file
+    endBox(box, p);
+    endBox(dref, p);
+    endBox(dinf, p);
+
+    stbl = p;
+    p = putBox(p, "stbl");
+
+    stsd = p;
+    p = putFullBox(p, "stsd", 0, 0);
+    p = Load32(p, 1);                   // entry_count
+
+    // avc3/hev1: parameter sets may also be in-band, so a re-configured encoder is still playable
+    entry = p;
+    p = putBox(p, info->codec ? "hev1" : "avc3");
+    p = putZero(p, 6);                  // reserved
+    p = Load16(p, 1);                   // data_reference_index
+    p = putZero(p, 16);                 // pre_defined & reserved
+    p = Load16(p, (uint16_t)info->width);
+    p = Load16(p, (uint16_t)info->height);
+    p = Load32(p, 0x00480000);          // horizresolution 72 dpi
+    p = Load32(p, 0x00480000);          // vertresolution 72 dpi
+    p = Load32(p, 0);                   // reserved
+    p = Load16(p, 1);                   // frame_count
+    p = putZero(p, 32);                 // compressorname
+    p = Load16(p, 0x0018);              // depth
+    p = Load16(p, 0xFFFF);              // pre_defined = -1
+    p = info->codec ? putHvcC(p, ctx) : putAvcC(p, ctx);
+    endBox(entry, p);
+    endBox(stsd, p);
+
+    box = p;
+    p = putFullBox(p, "stts", 0, 0);
+    p = Load32(p, 0);
+    endBox(box, p);
+    box = p;
+    p = putFullBox(p, "stsc", 0, 0);
+    p = Load32(p, 0);
+    endBox(box, p);
+    box = p;
+    p = putFullBox(p, "stsz", 0, 0);
+    p = Load32(p, 0);                   // sample_size
+    p = Load32(p, 0);                   // sample_count
+    endBox(box, p);
+    box = p;
+    p = putFullBox(p, "stco", 0, 0);
+    p = Load32(p, 0);
+    endBox(box, p);
+
+    endBox(stbl, p);
+    endBox(minf, p);
+    endBox(mdia, p);
+    endBox(trak, p);
+
+    mvex = p;
+    p = putBox(p, "mvex");
+    box = p;
+    p = putFullBox(p, "trex", 0, 0);
+    p = Load32(p, 1);                   // track_ID
+    p = Load32(p, 1);                   // default_sample_description_index
+    p = Load32(p, 0);                   // default_sample_duration
+    p = Load32(p, 0);                   // default_sample_size
+    p = Load32(p, 0);                   // default_sample_flags
+    endBox(box, p);
+    endBox(mvex, p);
+
+    endBox(moov, p);
+
+    if (mp4Write(ctx, buf, (int)(p - buf)) < 0)
+        return -1;
+
+    ctx->headerWritten = 1;
+    return 0;
+}
+
+/* moof + mdat of the buffered GOP, the writer syncs here so a power loss can't take more than one GOP */
+static int mp4WriteFragment(MP4Context *ctx) {
+    uint8_t *p = ctx->moof;
+    uint8_t *moof, *traf, *box, *dataOffset;
+    uint64_t moofOffset = ctx->offset;
+    MP4Fragment *frags;
+    int i;
+
+    if (ctx->sampleNum == 0)
+        return 0;
+
+    moof = p;
+    p = putBox(p, "moof");
+
+    box = p;
+    p = putFullBox(p, "mfhd", 0, 0);
+    p = Load32(p, ++ctx->fragSeq);
+    endBox(box, p);
+
+    traf = p;
+    p = putBox(p, "traf");
+
+    box = p;
+    p = putFullBox(p, "tfhd", 0, 0x020000);    // default-base-is-moof
+    p = Load32(p, 1);                   // track_ID
+    endBox(box, p);
+
+    box = p;
+    p = putFullBox(p, "tfdt", 1, 0);
+    p = Load64(p, ctx->gopTime);        // baseMediaDecodeTime
+    endBox(box, p);
+
+    box = p;
+    p = putFullBox(p, "trun", 0, 0x000701);    // data-offset, duration, size, flags
+    p = Load32(p, (uint32_t)ctx->sampleNum);
+    dataOffset = p;
+    p = Load32(p, 0);
+    for (i = 0; i < ctx->sampleNum; i++) {
+        p = Load32(p, ctx->samples[i].duration);
+        p = Load32(p, ctx->samples[i].size);
+        p = Load32(p, ctx->samples[i].flags);
+    }
+    endBox(box, p);
+
+    endBox(traf, p);
+    endBox(moof, p);
+
+    Load32(dataOffset, (uint32_t)(p - moof) + 8);  // first sample right after mdat header
+    p = Load32(p, (uint32_t)ctx->mdatSize + 8);
+    p = putTag(p, "mdat");
+
+    if (mp4Write(ctx, ctx->moof, (int)(p - ctx->moof)) < 0 ||
+        mp4Write(ctx, ctx->mdat, ctx->mdatSize) < 0)
+        return -1;
+
+    recordWriterMark(&ctx->rec);
+
+    // keep the random access points for mfra
+    if (ctx->fragNum == ctx->fragCap) {
+        frags = (MP4Fragment *)realloc(ctx->frags, sizeof(MP4Fragment) * (ctx->fragCap + 256));
+        if (frags) {
+            ctx->frags = frags;
+            ctx->fragCap += 256;
+        }
+    }
+    if (ctx->fragNum < ctx->fragCap) {
+        ctx->frags[ctx->fragNum].time = ctx->gopTime;
+        ctx->frags[ctx->fragNum].moofOffset = moofOffset;
+        ctx->fragNum++;
+    }
+
+    ctx->sampleNum = 0;
+    ctx->mdatSize = 0;
+    return 0;
+}
+
+/* mfra/tfra/mfro, lets players seek without scanning all moofs */
+static int mp4WriteIndex(MP4Context *ctx) {
+    uint8_t *buf, *p, *mfra, *box;
+    int i, ret;
+
+    buf = (uint8_t *)malloc((size_t)(64 + 19 * ctx->fragNum));
+    if (NULL == buf)
+        return -1;
+
+    p = buf;
+    mfra = p;
+    p = putBox(p, "mfra");
+
+    box = p;
+    p = putFullBox(p, "tfra", 1, 0);
+    p = Load32(p, 1);                   // track_ID
+    p = Load32(p, 0);                   // length_size_of_traf/trun/sample_num = 1 byte
+    p = Load32(p, (uint32_t)ctx->fragNum);
+    for (i = 0; i < ctx->fragNum; i++) {
+        p = Load64(p, ctx->frags[i].time);
+        p = Load64(p, ctx->frags[i].moofOffset);
+        p = Load8(p, 1);                // traf_number
+        p = Load8(p, 1);                // trun_number
+        p = Load8(p, 1);                // sample_number, GOP starts with the key frame
+    }
+    endBox(box, p);
+
+    box = p;
+    p = putFullBox(p, "mfro", 0, 0);
+    p = Load32(p, (uint32_t)(p - mfra) + 4);   // size of mfra
+    endBox(box, p);
+    endBox(mfra, p);
+
+    ret = mp4Write(ctx, buf, (int)(p - buf));
+    free(buf);
+    return ret;
+}
+
+/* buffer grows to the largest GOP seen, no allocation in steady state */
+static int mp4Reserve(MP4Context *ctx, int size) {
+    uint8_t *mdat, *moof;
+    MP4Sample *samples;
+    int cap;
+
+    if (ctx->mdatSize + size > ctx->mdatCap) {
+        cap = (ctx->mdatSize + size) * 3 / 2;
+        mdat = (uint8_t *)realloc(ctx->mdat, (size_t)cap);
+        if (NULL == mdat)
+            return -1;
+        ctx->mdat = mdat;
+        ctx->mdatCap = cap;
+    }
+
+    if (ctx->sampleNum == ctx->sampleCap) {
+        cap = ctx->sampleCap + 64;
+        samples = (MP4Sample *)realloc(ctx->samples, sizeof(MP4Sample) * cap);
+        if (NULL == samples)
+            return -1;
+        ctx->samples = samples;
+
+        moof = (uint8_t *)realloc(ctx->moof, (size_t)(128 + 12 * cap));
+        if (NULL == moof)
+            return -1;
+        ctx->moof = moof;
+        ctx->sampleCap = cap;
+    }
+
+    return 0;
+}
+
+static void mp4SaveParamSet(MP4ParamSet *ps, const uint8_t *nal, int len) {
+    if (len > MP4_PARAM_SET_MAX) {
+        printf("mp4 parameter set %d bytes is too large.\n", len);
+        return;
+    }
+    memcpy(ps->data, nal, (size_t)len);
+    ps->len = len;
+}
+
+static int mp4SinkOpen(Sink *sink, const char *url) {
+    MP4Context *ctx = (MP4Context *)calloc(1, sizeof(MP4Context));
+    if (NULL == ctx)
+        return -1;
+
+    if (recordWriterOpen(&ctx->rec, url) < 0) {
+        printf("mp4SinkOpen open file[%s] failed.\n", url);
+        free(ctx);
+        return -1;
+    }
+
+    sink->priv = ctx;
+    return 0;
+}
+
+static int mp4SinkWriteFrame(Sink *sink, MediaFrame *frame) {
+    MP4Context *ctx = (MP4Context *)sink->priv;
+    const uint8_t *r, *r1, *end = frame->data + frame->size;
+    MP4Sample *sample;
+    uint64_t time;
+    int type, len;
+
+    if (0 == ctx->headerWritten && ctx->sampleNum == 0)
+        ctx->firstPts = frame->pts;
+
+    // the duration of the previous sample is known now
+    time = mp4Time(ctx, frame->pts);
+    if (ctx->sampleNum > 0) {
+        if (time > ctx->lastTime)
+            ctx->lastDuration = (uint32_t)(time - ctx->lastTime);
+        ctx->samples[ctx->sampleNum - 1].duration = ctx->lastDuration;
+    }
+
+    if (frame->keyFrame && mp4WriteFragment(ctx) < 0)
+        return -1;
+
+    // Annex-B to length prefixed NALUs while copying into mdat, 4 bytes start code & length
+    if (mp4Reserve(ctx, frame->size + 64) < 0) {
+        printf("mp4 reserve %d bytes error.\n", frame->size);
+        return -1;
+    }
+
+    sample = &ctx->samples[ctx->sampleNum];
+    sample->size = 0;
+    sample->duration = 0;
+    sample->flags = frame->keyFrame ? MP4_SAMPLE_KEY : MP4_SAMPLE_NONKEY;
+
+    r = ff_avc_find_startcode(frame->data, end);
+    while (r < end) {
+        while (!*(r++));    // skip current startcode
+        r1 = ff_avc_find_startcode(r, end);
+        len = (int)(r1 - r);
+
+        type = nalType(sink->info.codec, r);
+        if (sink->info.codec ? type == 32 : 0)
+            mp4SaveParamSet(&ctx->vps, r, len);
+        else if (sink->info.codec ? type == 33 : type == 7)
+            mp4SaveParamSet(&ctx->sps, r, len);
+        else if (sink->info.codec ? type == 34 : type == 8)
+            mp4SaveParamSet(&ctx->pps, r, len);
+
+        if (ctx->mdatSize + 4 + len > ctx->mdatCap && mp4Reserve(ctx, 4 + len) < 0)
+            return -1;
+        Load32(ctx->mdat + ctx->mdatSize, (uint32_t)len);
+        memcpy(ctx->mdat + ctx->mdatSize + 4, r, (size_t)len);
+        ctx->mdatSize += 4 + len;
+        sample->size += 4 + len;
+        r = r1;
+    }
+
+    if (0 == ctx->headerWritten) {
+        if (0 == ctx->sps.len || 0 == ctx->pps.len || (sink->info.codec && 0 == ctx->vps.len)) {
+            printf("mp4 no parameter sets in key frame, wait for next.\n");
+            ctx->mdatSize = 0;
+            return 0;
+        }
+        if (mp4WriteHeader(ctx, &sink->info) < 0)
+            return -1;
+        ctx->gopTime = time;
+    }
+
+    if (frame->keyFrame)
+        ctx->gopTime = time;
+    ctx->lastTime = time;
+    ctx->sampleNum++;
+
+    return 0;
+}
+
+static void mp4SinkClose(Sink *sink) {
+    MP4Context *ctx = (MP4Context *)sink->priv;
+
+    if (ctx->sampleNum > 0) {
+        if (0 == ctx->lastDuration && sink->info.frameRate > 0)
+            ctx->lastDuration = MP4_TIMESCALE / sink->info.frameRate;
+        ctx->samples[ctx->sampleNum - 1].duration = ctx->lastDuration;
+        mp4WriteFragment(ctx);
+    }
+    if (ctx->fragNum > 0)
+        mp4WriteIndex(ctx);
+
+    recordWriterClose(&ctx->rec);
+    free(ctx->mdat);
+    free(ctx->samples);
+    free(ctx->moof);
+    free(ctx->frags);
+    free(ctx);
+    sink->priv = NULL;
+}
+
+const SinkOps mp4SinkOps = {
+    "mp4",
+    SINK_CAP_STORAGE | SINK_CAP_KEYFRAME,
+    mp4SinkOpen,
+    mp4SinkWriteFrame,
+    NULL,       // the record writer flushes by itself
+    mp4SinkClose
+};
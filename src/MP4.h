@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_MP4_H
+#define HISILIVE_MP4_H
+
+#include "Sink.h"
+
+#define MP4_TIMESCALE       90000
+#define MP4_PARAM_SET_MAX   256     // max size of a VPS/SPS/PPS
+
+/*
+ * Fragmented MP4 (ISO BMFF) recorder:
+ *   ftyp + moov (written at the first key frame)
+ *   moof + mdat per GOP, written when the next GOP starts, synced by RecordConfig.syncGops
+ *   mfra at close for instant seeking
+ * A power loss loses at most the GOP being buffered.
+ */
+extern const SinkOps mp4SinkOps;
+
+#endif //HISILIVE_MP4_H
@@ -3,6 +3,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "Media.h"
 
 static const uint8_t *ff_avc_find_startcode_internal(const uint8_t *p, const uint8_t *end)
@@ -44,4 +45,78 @@ const uint8_t *ff_avc_find_startcode(const uint8_t *p, const uint8_t *end){
     const uint8_t *out= ff_avc_find_startcode_internal(p, end);
     if(p < out && out < end && !out[-1]) out--; // find 0001 in x001
     return out;
-}
\ No newline at end of file
+}
+
+int seiCaptureBuild(uint8_t *buf, uint64_t pts, uint64_t ntp){
+    int i;
+
+    memcpy(buf, SEI_CAPTURE_UUID, 16);
+    for (i = 0; i < 8; i++) {
+        buf[16 + i] = (uint8_t)(pts >> (56 - 8 * i));
+        buf[24 + i] = (uint8_t)(ntp >> (56 - 8 * i));
+    }
+    return SEI_CAPTURE_SIZE;
+}
+
+/* the SEI messages of one NALU, emulation prevention bytes removed */
+static int seiCaptureParse(const uint8_t *nal, const uint8_t *end, uint64_t *pts, uint64_t *ntp){
+    uint8_t rbsp[256];
+    int n = 0, zeros = 0, pos = 0, type, size, i;
+
+    for (; nal < end && n < (int)sizeof(rbsp); nal++) {
+        if (zeros >= 2 && *nal == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = *nal ? 0 : zeros + 1;
+        rbsp[n++] = *nal;
+    }
+
+    while (pos < n && rbsp[pos] != 0x80) {
+        for (type = 0; pos < n && rbsp[pos] == 0xff; pos++)
+            type += 255;
+        if (pos >= n)
+            break;
+        type += rbsp[pos++];
+        for (size = 0; pos < n && rbsp[pos] == 0xff; pos++)
+            size += 255;
+        if (pos >= n)
+            break;
+        size += rbsp[pos++];
+        if (pos + size > n)
+            break;
+
+        if (5 == type && size >= SEI_CAPTURE_SIZE && !memcmp(rbsp + pos, SEI_CAPTURE_UUID, 16)) {
+            *pts = *ntp = 0;
+            for (i = 0; i < 8; i++) {
+                *pts = *pts << 8 | rbsp[pos + 16 + i];
+                *ntp = *ntp << 8 | rbsp[pos + 24 + i];
+            }
+            return 0;
+        }
+        pos += size;
+    }
+    return -1;
+}
+
+int seiCaptureFind(const uint8_t *au, int size, int codec, uint64_t *pts, uint64_t *ntp){
+    const uint8_t *end = au + size, *r, *r1;
+
+    r = ff_avc_find_startcode(au, end);
+    while (r < end) {
+        while (r < end && !*r)
+            r++;
+        if (++r >= end)
+            break;
+        r1 = ff_avc_find_startcode(r, end);
+        if (codec) {
+            if (39 == ((r[0] >> 1) & 0x3f) && r + 2 < r1 && !seiCaptureParse(r + 2, r1, pts, ntp))
+                return 0;   // prefix SEI
+        } else {
+            if (6 == (r[0] & 0x1f) && !seiCaptureParse(r + 1, r1, pts, ntp))
+                return 0;
+        }
+        r = r1;
+    }
+    return -1;
+}
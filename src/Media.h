@@ -10,4 +10,18 @@
 /* copy from FFmpeg libavformat/acv.c */
 const uint8_t *ff_avc_find_startcode(const uint8_t *p, const uint8_t *end);
 
+/*
+ * capture time SEI, user_data_unregistered: the uuid, the pts (us) of a frame and the NTP time
+ * it was captured. The pts tells the frame it belongs to, with the RTP timestamp (pts * 0.09)
+ * the capture time of the frames without one follows from it too.
+ */
+#define SEI_CAPTURE_UUID    "HisiLive capture"
+#define SEI_CAPTURE_SIZE    32
+
+/* the user data as HI_MPI_VENC_InsertUserData takes it, returns SEI_CAPTURE_SIZE */
+int seiCaptureBuild(uint8_t *buf, uint64_t pts, uint64_t ntp);
+
+/* find the capture time SEI in an Annex-B access unit, 0 found or -1 */
+int seiCaptureFind(const uint8_t *au, int size, int codec, uint64_t *pts, uint64_t *ntp);
+
 #endif //HISILIVE_MEDIA_H
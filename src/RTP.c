@@ -14,9 +14,16 @@
 #include "Network.h"
 
 #define RTP_VERSION 2
-#define RTP_H264    96
+#define RTCP_SR     200
+#define RTCP_RR     201
+#define RTCP_SDES   202
 
-static UDPContext *gUdpContext;
+/* per packet trace, build with -DRTP_DEBUG */
+#ifdef RTP_DEBUG
+#define RTP_LOG(fmt...)     LOG(fmt)
+#else
+#define RTP_LOG(fmt...)
+#endif
 
 int initRTPMuxContext(RTPMuxContext *ctx){
     ctx->seq = 0;
@@ -25,14 +32,20 @@ int initRTPMuxContext(RTPMuxContext *ctx){
     ctx->aggregation = 1;   // use Aggregation Unit
     ctx->buf_ptr = ctx->buf;
     ctx->payload_type = 0;  // 0, H.264/AVC; 1, HEVC/H.265
+    ctx->pt = RTP_PT_H264;
+    ctx->packetCount = 0;
+    ctx->octetCount = 0;
+    ctx->captureExtId = 0;
+    ctx->captureNtp = 0;
+    ctx->paceBytes = 0;
+    ctx->paceDue = 0;
+    ctx->udp = NULL;
     return 0;
 }
 
 // enc RTP packet
 void rtpSendData(RTPMuxContext *ctx, const uint8_t *buf, int len, int mark)
 {
-    int res = 0, i;
-
     /* build the RTP header */
     /*
      *
@@ -52,32 +65,64 @@ void rtpSendData(RTPMuxContext *ctx, const uint8_t *buf, int len, int mark)
      **/
 
     uint8_t *pos = ctx->cache;
+    int header = 12;
+    uint64_t now;
     pos[0] = (RTP_VERSION << 6) & 0xff;      // V P X CC
-    pos[1] = (uint8_t)((RTP_H264 & 0x7f) | ((mark & 0x01) << 7)); // M PayloadType
+    pos[1] = (uint8_t)((ctx->pt & 0x7f) | ((mark & 0x01) << 7)); // M PayloadType
     Load16(&pos[2], (uint16_t)ctx->seq);    // Sequence number
     Load32(&pos[4], ctx->timestamp);
     Load32(&pos[8], ctx->ssrc);
 
+    /*
+     *   abs-capture-time, 64 bit NTP time of the capture, on the first packet of a frame
+     *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+     *   |       0xBE    |    0xDE       |           length=3            |
+     *   |  ID   | len=7 |     absolute capture timestamp (bit 0-23)     |
+     *   |             absolute capture timestamp (bit 24-55)            |
+     *   |  ... (56-63)  |                 padding                       |
+     *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+     */
+    if (ctx->captureExtId && ctx->captureNtp) {
+        pos[0] |= 0x10;
+        Load16(&pos[12], 0xBEDE);
+        Load16(&pos[14], 3);
+        pos[16] = (uint8_t)(ctx->captureExtId << 4 | 7);
+        Load64(&pos[17], ctx->captureNtp);
+        memset(&pos[25], 0, 3);
+        header += RTP_EXT_MAX;
+        ctx->captureNtp = 0;
+    }
+
     /* copy av data */
-    memcpy(&pos[12], buf, len);
+    memcpy(&pos[header], buf, len);
 
-    res = udpSend(gUdpContext, ctx->cache, (uint32_t)(len + 12));
-    printf("\nrtpSendData cache [%d]: ", res);
-    for (i = 0; i < 20; ++i) {
-        printf("%.2X ", ctx->cache[i]);
+    /* a large frame goes out spread over time instead of in one burst, no credit is saved up */
+    if (ctx->paceBytes) {
+        now = getMonotonicTime();
+        if (ctx->paceDue > now)
+            usleep((useconds_t)(ctx->paceDue - now));
+        else
+            ctx->paceDue = now;
+        ctx->paceDue += (uint64_t)(len + header + 28) * 1000000 / ctx->paceBytes;   // with the UDP/IP headers
     }
-    printf("\n");
+
+    udpSend(ctx->udp, ctx->cache, (uint32_t)(len + header));
+#ifdef RTP_DEBUG
+    dumpHex(ctx->cache, 20);
+#endif
 
     memset(ctx->cache, 0, RTP_PAYLOAD_MAX+10);
 
     ctx->buf_ptr = ctx->buf;  // restore buf_ptr
 
     ctx->seq = (ctx->seq + 1) & 0xffff;
+    ctx->packetCount++;
+    ctx->octetCount += (uint32_t)len;
 }
 
 // 拼接NAL头部 在 ctx->buff, 然后ff_rtp_send_data
 static void rtpSendNAL(RTPMuxContext *ctx, const uint8_t *nal, int size, int last){
-    printf("rtpSendNAL  len = %d M=%d\n", size, last);
+    RTP_LOG("len = %d M=%d\n", size, last);
 
     // Single NAL Packet or Aggregation Packets
     if (size <= RTP_PAYLOAD_MAX){
@@ -198,16 +243,20 @@ static void rtpSendNAL(RTPMuxContext *ctx, const uint8_t *nal, int size, int las
 
 // 从一段H264流中，查询完整的NAL发送，直到发送完此流中的所有NAL
 void rtpSendH264HEVC(RTPMuxContext *ctx, UDPContext *udp, const uint8_t *buf, int size){
+    rtpSendH264HEVCSlice(ctx, udp, buf, size, 1);
+}
+
+void rtpSendH264HEVCSlice(RTPMuxContext *ctx, UDPContext *udp, const uint8_t *buf, int size, int frameEnd){
     const uint8_t *r;
     const uint8_t *end = buf + size;
-    gUdpContext = udp;
 
-    LOG("rtpSendH264HEVC start\n");
+    RTP_LOG("start\n");
 
     if (NULL == ctx || NULL == udp || NULL == buf ||  size <= 0){
         printf("rtpSendH264HEVC param error.\n");
         return;
     }
+    ctx->udp = udp;     // each ctx keeps its own socket, sinks send from several threads
 
     r = ff_avc_find_startcode(buf, end);
     while (r < end){
@@ -217,7 +266,111 @@ void rtpSendH264HEVC(RTPMuxContext *ctx, UDPContext *udp, const uint8_t *buf, in
         r1 = ff_avc_find_startcode(r, end);  // find next startcode
 
         // send a NALU (except NALU startcode), r1==end indicates this is the last NALU
-        rtpSendNAL(ctx, r, (int)(r1-r), r1==end);
+        rtpSendNAL(ctx, r, (int)(r1-r), r1==end && frameEnd);
         r = r1;
     }
+
+    // more slices of this frame follow, don't keep the aggregated NALUs waiting for them
+    if (ctx->buf_ptr > ctx->buf){
+        rtpSendData(ctx, ctx->buf, (int)(ctx->buf_ptr - ctx->buf), 0);
+    }
+}
+
+void rtpSendAudio(RTPMuxContext *ctx, UDPContext *udp, const uint8_t *buf, int size, int mark){
+    if (NULL == ctx || NULL == udp || NULL == buf || size <= 0 || size > RTP_PAYLOAD_MAX){
+        printf("rtpSendAudio param error.\n");
+        return;
+    }
+    ctx->udp = udp;
+    rtpSendData(ctx, buf, size, mark);
+}
+
+void rtcpSendSR(RTPMuxContext *ctx, UDPContext *rtcp, uint64_t wallUs, uint32_t rtpTs){
+    uint8_t pkt[28 + 20];
+    uint8_t *pos = pkt;
+    uint64_t ntp = wallToNtp(wallUs);
+
+    /*
+     *   SR, RFC 3550 6.4.1, without report blocks
+     *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+     *   |V=2|P|   RC=0  |    PT=200     |          length=6             |
+     *   |                     SSRC of sender                            |
+     *   |             NTP timestamp, most significant word              |
+     *   |             NTP timestamp, least significant word             |
+     *   |                         RTP timestamp                         |
+     *   |                     sender's packet count                     |
+     *   |                      sender's octet count                     |
+     *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+     */
+    *pos++ = RTP_VERSION << 6;
+    *pos++ = RTCP_SR;
+    pos = Load16(pos, 6);
+    pos = Load32(pos, ctx->ssrc);
+    pos = Load64(pos, ntp);
+    pos = Load32(pos, rtpTs);
+    pos = Load32(pos, ctx->packetCount);
+    pos = Load32(pos, ctx->octetCount);
+
+    /* SDES with one chunk: SSRC, CNAME "hisilive", END, padded to 32 bits */
+    *pos++ = (RTP_VERSION << 6) | 1;
+    *pos++ = RTCP_SDES;
+    pos = Load16(pos, 4);
+    pos = Load32(pos, ctx->ssrc);
+    *pos++ = 1;     // CNAME
+    *pos++ = 8;
+    memcpy(pos, "hisilive", 8);
+    pos += 8;
+    *pos++ = 0;     // END
+    *pos++ = 0;
+
+    udpSend(rtcp, pkt, (uint32_t)(pos - pkt));
+}
+
+static uint32_t rtcpGet32(const uint8_t *p){
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+int rtcpParseRR(const uint8_t *buf, int len, uint32_t ssrc, RTCPReportBlock *rb){
+    const uint8_t *p, *block;
+    int size, count, i;
+
+    /*
+     *   RR, RFC 3550 6.4.2, an SR has the 20 bytes of sender info before the blocks
+     *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+     *   |V=2|P|    RC   |   PT=RR=201   |             length            |
+     *   |                     SSRC of packet sender                     |
+     *   +=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+     *   |                 SSRC_1 (SSRC of first source)                 |
+     *   | fraction lost |       cumulative number of packets lost       |
+     *   |           extended highest sequence number received           |
+     *   |                      interarrival jitter                      |
+     *   |                         last SR (LSR)                         |
+     *   |                   delay since last SR (DLSR)                  |
+     *   +=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+     */
+    for (p = buf; p + 4 <= buf + len; p += size) {
+        if ((p[0] >> 6) != RTP_VERSION)
+            return -1;
+        size = (p[2] << 8 | p[3]) * 4 + 4;
+        if (p + size > buf + len)
+            return -1;
+        if (RTCP_RR != p[1] && RTCP_SR != p[1])
+            continue;
+
+        count = p[0] & 0x1f;
+        block = p + 8 + (RTCP_SR == p[1] ? 20 : 0);
+        for (i = 0; i < count && block + 24 <= p + size; i++, block += 24) {
+            if (rtcpGet32(block) != ssrc)
+                continue;
+            rb->ssrc = ssrc;
+            rb->fractionLost = block[4];
+            rb->cumulativeLost = (int32_t)(rtcpGet32(block + 4) << 8) >> 8;
+            rb->highestSeq = rtcpGet32(block + 8);
+            rb->jitter = rtcpGet32(block + 12);
+            rb->lsr = rtcpGet32(block + 16);
+            rb->dlsr = rtcpGet32(block + 20);
+            return 0;
+        }
+    }
+    return -1;
 }
@@ -9,21 +9,69 @@
 
 #define RTP_PAYLOAD_MAX     1400
 
+/* static payload types of RFC 3551, the dynamic ones are the sender's choice */
+#define RTP_PT_PCMU         0
+#define RTP_PT_DVI4         5
+#define RTP_PT_PCMA         8
+#define RTP_PT_H264         96
+#define RTP_PT_G726         97
+
+#define RTCP_SR_INTERVAL    5000000     // us between sender reports
+
+/* header extension with the capture time of a frame, RFC 8285 one byte header */
+#define RTP_EXT_MAX         16
+#define RTP_EXT_ABS_CAPTURE_TIME    "http://www.webrtc.org/experiments/rtp-hdrext/abs-capture-time"
+
 typedef struct {
-    uint8_t cache[RTP_PAYLOAD_MAX+12];  //RTP packet = RTP header + buf
+    uint8_t cache[RTP_PAYLOAD_MAX+12+RTP_EXT_MAX];  //RTP packet = RTP header + buf
     uint8_t buf[RTP_PAYLOAD_MAX];       // NAL header + NAL
     uint8_t *buf_ptr;
 
     int aggregation;   // 0: Single Unit, 1: Aggregation Unit
     int payload_type;  // 0, H.264/AVC; 1, HEVC/H.265
+    int pt;            // RTP payload type in the header, RTP_PT_H264 by default
     uint32_t ssrc;
     uint32_t seq;
     uint32_t timestamp;
+    uint32_t packetCount;   // sent, for the sender report
+    uint32_t octetCount;    // payload bytes sent
+    int captureExtId;       // abs-capture-time extension id, 1-14, 0 none
+    uint64_t captureNtp;    // NTP time the frame was captured, sent with the next packet then cleared
+    uint32_t paceBytes;     // per second the packets are spread at, 0 no pacing
+    uint64_t paceDue;       // the next packet may go out, monotonic us
+    UDPContext *udp;
 }RTPMuxContext;
 
+/* a report block of a receiver report (or of a sender report of the other side), RFC 3550 6.4.1 */
+typedef struct {
+    uint32_t ssrc;          // of the stream reported on
+    uint8_t fractionLost;   // since the last report, in 1/256
+    int32_t cumulativeLost;
+    uint32_t highestSeq;    // extended
+    uint32_t jitter;        // in timestamp units
+    uint32_t lsr;           // middle 32 bits of the NTP time of the last SR received
+    uint32_t dlsr;          // since then, in 1/65536 s
+}RTCPReportBlock;
+
 int initRTPMuxContext(RTPMuxContext *ctx);
 
 /* send a H.264/HEVC video stream */
 void rtpSendH264HEVC(RTPMuxContext *ctx, UDPContext *udp, const uint8_t *buf, int size);
 
+/* send the NALUs of one slice at once, the marker bit is set only if frameEnd, nothing is held back */
+void rtpSendH264HEVCSlice(RTPMuxContext *ctx, UDPContext *udp, const uint8_t *buf, int size, int frameEnd);
+
+/* send one audio frame as it is in one packet, ctx->timestamp is its first sample */
+void rtpSendAudio(RTPMuxContext *ctx, UDPContext *udp, const uint8_t *buf, int size, int mark);
+
+/*
+ * send a RTCP sender report (with the SDES CNAME RFC 3550 wants next to it) over rtcp,
+ * telling receivers the stream was at rtpTs when the wallclock was wallUs.
+ * Streams sharing a clock for rtpTs play in sync this way.
+ */
+void rtcpSendSR(RTPMuxContext *ctx, UDPContext *rtcp, uint64_t wallUs, uint32_t rtpTs);
+
+/* find the report block on ssrc in a compound RTCP packet, 0 found, -1 not there or invalid */
+int rtcpParseRR(const uint8_t *buf, int len, uint32_t ssrc, RTCPReportBlock *rb);
+
 #endif //HISILIVE_RTP_H
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "RTPRecv.h"
+
+int rtpParse(RTPPacket *pkt, const uint8_t *buf, int len) {
+    int offset = 12, pad = 0;
+
+    if (len < 12 || (buf[0] >> 6) != 2)
+        return -1;
+
+    memset(pkt, 0, sizeof(RTPPacket));
+    pkt->marker = buf[1] >> 7;
+    pkt->payloadType = buf[1] & 0x7f;
+    pkt->seq = (uint16_t)(buf[2] << 8 | buf[3]);
+    pkt->timestamp = (uint32_t)buf[4] << 24 | (uint32_t)buf[5] << 16 | (uint32_t)buf[6] << 8 | buf[7];
+    pkt->ssrc = (uint32_t)buf[8] << 24 | (uint32_t)buf[9] << 16 | (uint32_t)buf[10] << 8 | buf[11];
+
+    offset += (buf[0] & 0x0f) * 4;      // CSRC list
+    if (buf[0] & 0x10) {                // X, header extension
+        if (offset + 4 > len)
+            return -1;
+        pkt->extProfile = (uint16_t)(buf[offset] << 8 | buf[offset + 1]);
+        pkt->extSize = (buf[offset + 2] << 8 | buf[offset + 3]) * 4;
+        pkt->ext = buf + offset + 4;
+        offset += 4 + pkt->extSize;
+    }
+    if (buf[0] & 0x20)                  // P, the last byte counts the padding
+        pad = buf[len - 1];
+    if (offset + pad > len)
+        return -1;
+
+    pkt->payload = buf + offset;
+    pkt->size = len - offset - pad;
+    return 0;
+}
+
+int rtpFindExt(const RTPPacket *pkt, int id, const uint8_t **data) {
+    int pos = 0, elemId, len;
+
+    if (NULL == pkt->ext || pkt->extProfile != 0xBEDE)
+        return -1;
+    while (pos < pkt->extSize) {
+        if (0 == pkt->ext[pos]) {       // padding
+            pos++;
+            continue;
+        }
+        elemId = pkt->ext[pos] >> 4;
+        len = (pkt->ext[pos] & 0x0f) + 1;
+        if (15 == elemId || pos + 1 + len > pkt->extSize)
+            return -1;
+        if (elemId == id) {
+            *data = pkt->ext + pos + 1;
+            return len;
+        }
+        pos += 1 + len;
+    }
+    return -1;
+}
+
+void rtpStatsInit(RTPRecvStats *st, uint32_t clockRate) {
+    memset(st, 0, sizeof(RTPRecvStats));
+    st->clockRate = clockRate;
+}
+
+uint32_t rtpStatsUpdate(RTPRecvStats *st, const RTPPacket *pkt, uint64_t arrivalUs, int *dup) {
+    uint32_t ext, bit;
+    int16_t delta;
+    int64_t transit, d;
+
+    *dup = 0;
+    if (!st->started || pkt->ssrc != st->ssrc) {
+        memset(st->seen, 0, sizeof(st->seen));
+        st->started = 1;
+        st->ssrc = pkt->ssrc;
+        st->baseSeq = st->maxSeq = 0x10000 + pkt->seq;  // one cycle up, so a reordered first packet stays positive
+        st->received = st->reordered = st->duplicates = 0;
+        st->jitter = 0;
+        st->transit = 0;
+        ext = st->maxSeq;
+    } else {
+        /* extend relative to the highest, the 16 bit difference handles the wrap */
+        delta = (int16_t)(pkt->seq - (uint16_t)st->maxSeq);
+        ext = st->maxSeq + delta;
+        if (delta > 0) {
+            for (bit = st->maxSeq + 1; bit != ext && bit - st->maxSeq < RTP_SEQ_WINDOW; bit++)
+                st->seen[(bit % RTP_SEQ_WINDOW) / 8] &= (uint8_t)~(1 << (bit % 8));
+            st->maxSeq = ext;
+        } else if (st->maxSeq - ext >= RTP_SEQ_WINDOW || (st->seen[(ext % RTP_SEQ_WINDOW) / 8] & (1 << (ext % 8)))) {
+            st->duplicates++;
+            *dup = 1;
+            return ext;
+        } else {
+            st->reordered++;
+        }
+        if (ext < st->baseSeq)
+            st->baseSeq = ext;
+    }
+    st->seen[(ext % RTP_SEQ_WINDOW) / 8] |= (uint8_t)(1 << (ext % 8));
+    st->received++;
+
+    /* J += (|D| - J) / 16, in timestamp units */
+    transit = (int64_t)(arrivalUs * st->clockRate / 1000000) - (int64_t)pkt->timestamp;
+    if (st->received > 1) {
+        d = transit - st->transit;
+        if (d < 0)
+            d = -d;
+        st->jitter += ((double)d - st->jitter) / 16;
+    }
+    st->transit = transit;
+    return ext;
+}
+
+uint32_t rtpStatsExpected(const RTPRecvStats *st) {
+    return st->started ? st->maxSeq - st->baseSeq + 1 : 0;
+}
+
+uint32_t rtpStatsLost(const RTPRecvStats *st) {
+    uint32_t expected = rtpStatsExpected(st);
+    return expected > st->received ? expected - st->received : 0;
+}
+
+double rtpStatsJitterUs(const RTPRecvStats *st) {
+    return st->clockRate ? st->jitter * 1000000 / st->clockRate : 0;
+}
+
+void rtpStatsSR(RTPRecvStats *st, const uint8_t *buf, int len, uint64_t arrivalUs) {
+    if (len < 28 || (buf[0] >> 6) != 2 || buf[1] != 200)
+        return;
+    st->lsr = (uint32_t)buf[10] << 24 | (uint32_t)buf[11] << 16 | (uint32_t)buf[12] << 8 | buf[13];
+    st->lsrUs = arrivalUs;
+}
+
+static uint8_t *rtcpPut32(uint8_t *p, uint32_t x) {
+    *p++ = (uint8_t)(x >> 24);
+    *p++ = (uint8_t)(x >> 16);
+    *p++ = (uint8_t)(x >> 8);
+    *p++ = (uint8_t)x;
+    return p;
+}
+
+int rtcpBuildRR(RTPRecvStats *st, uint32_t ssrc, uint64_t nowUs, uint8_t *buf) {
+    uint32_t expected = rtpStatsExpected(st), lost = rtpStatsLost(st);
+    uint32_t expectedInterval = expected - st->expectedPrior;
+    uint32_t receivedInterval = st->received - st->receivedPrior;
+    int32_t lostInterval = (int32_t)(expectedInterval - receivedInterval);
+    uint8_t fraction = 0, *p = buf;
+
+    /* RFC 3550 A.3 */
+    if (expectedInterval && lostInterval > 0)
+        fraction = (uint8_t)(((uint32_t)lostInterval << 8) / expectedInterval);
+    st->expectedPrior = expected;
+    st->receivedPrior = st->received;
+
+    *p++ = (2 << 6) | 1;
+    *p++ = 201;
+    *p++ = 0;
+    *p++ = 7;
+    p = rtcpPut32(p, ssrc);
+    p = rtcpPut32(p, st->ssrc);
+    p = rtcpPut32(p, (uint32_t)fraction << 24 | (lost & 0xffffff));
+    p = rtcpPut32(p, st->maxSeq - 0x10000);     // as the sender counts, without the cycle rtpStatsUpdate adds
+    p = rtcpPut32(p, (uint32_t)st->jitter);
+    p = rtcpPut32(p, st->lsr);
+    p = rtcpPut32(p, st->lsr ? (uint32_t)((nowUs - st->lsrUs) * 65536 / 1000000) : 0);
+    return (int)(p - buf);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_RTPRECV_H
+#define HISILIVE_RTPRECV_H
+
+#include <stdint.h>
+
+#define RTP_SEQ_WINDOW      1024    // packets remembered for duplicate detection
+
+typedef struct {
+    int marker;
+    int payloadType;
+    uint16_t seq;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    const uint8_t *ext;     // header extension after the 4 byte profile/length word, NULL if none
+    int extSize;
+    uint16_t extProfile;
+    const uint8_t *payload;
+    int size;
+}RTPPacket;
+
+/* parse an RTP packet, CSRCs, header extension and padding skipped, 0 or -1 */
+int rtpParse(RTPPacket *pkt, const uint8_t *buf, int len);
+
+/* the element id of a one byte header extension (RFC 8285), its size or -1 if it's not there */
+int rtpFindExt(const RTPPacket *pkt, int id, const uint8_t **data);
+
+/* receiver statistics as RFC 3550 A.1 and A.8 */
+typedef struct {
+    uint32_t clockRate;
+    int started;
+    uint32_t ssrc;
+    uint32_t baseSeq;       // extended
+    uint32_t maxSeq;        // extended, highest received
+    uint32_t received;
+    uint32_t reordered;     // older than the highest one
+    uint32_t duplicates;
+    int64_t transit;
+    double jitter;          // in timestamp units
+    uint8_t seen[RTP_SEQ_WINDOW / 8];
+    uint32_t expectedPrior; // at the last receiver report
+    uint32_t receivedPrior;
+    uint32_t lsr;           // middle 32 bits of the NTP time of the last sender report
+    uint64_t lsrUs;         // it arrived, monotonic
+}RTPRecvStats;
+
+void rtpStatsInit(RTPRecvStats *st, uint32_t clockRate);
+
+/* account one packet arrived at arrivalUs (monotonic), returns its extended sequence number,
+ * *dup is set for a packet received before */
+uint32_t rtpStatsUpdate(RTPRecvStats *st, const RTPPacket *pkt, uint64_t arrivalUs, int *dup);
+
+uint32_t rtpStatsExpected(const RTPRecvStats *st);
+
+uint32_t rtpStatsLost(const RTPRecvStats *st);
+
+/* interarrival jitter in us */
+double rtpStatsJitterUs(const RTPRecvStats *st);
+
+/* note the sender report of a compound RTCP packet for the LSR/DLSR of the next receiver report */
+void rtpStatsSR(RTPRecvStats *st, const uint8_t *buf, int len, uint64_t arrivalUs);
+
+/* a receiver report from ssrc with one block on the stream, loss since the last one, returns its size.
+ * buf holds RTCP_RR_SIZE */
+#define RTCP_RR_SIZE        32
+int rtcpBuildRR(RTPRecvStats *st, uint32_t ssrc, uint64_t nowUs, uint8_t *buf);
+
+#endif //HISILIVE_RTPRECV_H
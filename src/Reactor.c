@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "Reactor.h"
+
+static ReactorEntry *findEntry(ReactorContext *ctx, int fd) {
+    int i;
+    for (i = 0; i < REACTOR_MAX_HANDLERS; i++) {
+        if (ctx->entries[i].fd == fd)
+            return &ctx->entries[i];
+    }
+    return NULL;
+}
+
+int reactorInit(ReactorContext *ctx) {
+    int i;
+    struct epoll_event ev;
+    pthread_mutexattr_t attr;
+
+    memset(ctx, 0, sizeof(ReactorContext));
+    for (i = 0; i < REACTOR_MAX_HANDLERS; i++)
+        ctx->entries[i].fd = -1;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&ctx->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    ctx->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (ctx->epfd < 0) {
+        printf("reactorInit epoll_create1 error.\n");
+        return -1;
+    }
+
+    ctx->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ctx->wakeFd < 0) {
+        printf("reactorInit eventfd error.\n");
+        close(ctx->epfd);
+        return -1;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;     // NULL marks the wakeup fd
+    if (epoll_ctl(ctx->epfd, EPOLL_CTL_ADD, ctx->wakeFd, &ev) < 0) {
+        printf("reactorInit epoll_ctl error.\n");
+        close(ctx->wakeFd);
+        close(ctx->epfd);
+        return -1;
+    }
+
+    return 0;
+}
+
+int reactorAddFd(ReactorContext *ctx, int fd, uint32_t events, ReactorHandler handler, void *arg) {
+    struct epoll_event ev;
+    ReactorEntry *entry;
+
+    if (fd < 0 || NULL == handler) {
+        printf("reactorAddFd param error.\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    entry = findEntry(ctx, -1);
+    if (NULL == entry) {
+        pthread_mutex_unlock(&ctx->lock);
+        printf("reactorAddFd no free entry for fd %d.\n", fd);
+        return -1;
+    }
+
+    entry->fd = fd;
+    entry->owned = 0;
+    entry->handler = handler;
+    entry->arg = arg;
+
+    ev.events = events;
+    ev.data.ptr = entry;
+    if (epoll_ctl(ctx->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        printf("reactorAddFd epoll_ctl fd %d error %d.\n", fd, errno);
+        entry->fd = -1;
+        pthread_mutex_unlock(&ctx->lock);
+        return -1;
+    }
+
+    pthread_mutex_unlock(&ctx->lock);
+    return 0;
+}
+
+int reactorModFd(ReactorContext *ctx, int fd, uint32_t events) {
+    struct epoll_event ev;
+    ReactorEntry *entry;
+    int ret = -1;
+
+    if (fd < 0)
+        return -1;
+
+    pthread_mutex_lock(&ctx->lock);
+    entry = findEntry(ctx, fd);
+    if (entry) {
+        ev.events = events;
+        ev.data.ptr = entry;
+        ret = epoll_ctl(ctx->epfd, EPOLL_CTL_MOD, fd, &ev);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    return ret;
+}
+
+int reactorDelFd(ReactorContext *ctx, int fd) {
+    ReactorEntry *entry;
+
+    if (fd < 0)
+        return -1;
+
+    pthread_mutex_lock(&ctx->lock);
+    entry = findEntry(ctx, fd);
+    if (NULL == entry) {
+        pthread_mutex_unlock(&ctx->lock);
+        return -1;
+    }
+
+    epoll_ctl(ctx->epfd, EPOLL_CTL_DEL, fd, NULL);
+    if (entry->owned)
+        close(fd);
+
+    entry->fd = -1;
+    entry->handler = NULL;
+    entry->arg = NULL;
+    pthread_mutex_unlock(&ctx->lock);
+    return 0;
+}
+
+int reactorAddTimer(ReactorContext *ctx, int intervalMs, ReactorHandler handler, void *arg) {
+    int fd;
+    struct itimerspec its;
+
+    if (intervalMs <= 0)
+        return -1;
+
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        printf("reactorAddTimer timerfd_create error.\n");
+        return -1;
+    }
+
+    its.it_interval.tv_sec = intervalMs / 1000;
+    its.it_interval.tv_nsec = (intervalMs % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+    timerfd_settime(fd, 0, &its, NULL);
+
+    pthread_mutex_lock(&ctx->lock);
+    if (reactorAddFd(ctx, fd, EPOLLIN, handler, arg) < 0) {
+        pthread_mutex_unlock(&ctx->lock);
+        close(fd);
+        return -1;
+    }
+    findEntry(ctx, fd)->owned = 1;
+    pthread_mutex_unlock(&ctx->lock);
+
+    return fd;
+}
+
+int reactorRun(ReactorContext *ctx) {
+    struct epoll_event events[REACTOR_MAX_HANDLERS];
+    uint64_t val;
+    int i, n;
+
+    ctx->running = 1;
+    while (ctx->running) {
+        n = epoll_wait(ctx->epfd, events, REACTOR_MAX_HANDLERS, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            printf("reactorRun epoll_wait error %d.\n", errno);
+            return -1;
+        }
+
+        for (i = 0; i < n; i++) {
+            ReactorEntry *entry = (ReactorEntry *)events[i].data.ptr;
+
+            if (NULL == entry) {   // woken up by reactorStop()
+                read(ctx->wakeFd, &val, sizeof(val));
+                continue;
+            }
+
+            pthread_mutex_lock(&ctx->lock);
+
+            // handler may be removed by a previous handler in this round
+            if (entry->handler) {
+                if (entry->owned)   // timerfd, consume expirations
+                    read(entry->fd, &val, sizeof(val));
+
+                if (entry->handler(entry->fd, events[i].events, entry->arg) < 0)
+                    reactorDelFd(ctx, entry->fd);
+            }
+
+            pthread_mutex_unlock(&ctx->lock);
+        }
+    }
+
+    return 0;
+}
+
+void reactorStop(ReactorContext *ctx) {
+    uint64_t val = 1;
+    ctx->running = 0;
+    write(ctx->wakeFd, &val, sizeof(val));
+}
+
+void reactorDestroy(ReactorContext *ctx) {
+    int i;
+    for (i = 0; i < REACTOR_MAX_HANDLERS; i++) {
+        if (ctx->entries[i].fd >= 0)
+            reactorDelFd(ctx, ctx->entries[i].fd);
+    }
+    close(ctx->wakeFd);
+    close(ctx->epfd);
+    pthread_mutex_destroy(&ctx->lock);
+}
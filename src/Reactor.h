@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_REACTOR_H
+#define HISILIVE_REACTOR_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+
+#define REACTOR_MAX_HANDLERS    48      // the snapshot server takes up to SNAP_CONN_MAX + 2
+
+/* return < 0 to unregister the handler */
+typedef int (*ReactorHandler)(int fd, uint32_t events, void *arg);
+
+typedef struct {
+    int fd;         // -1: unused entry
+    int owned;      // fd is created by reactor (timerfd), close it on delete
+    ReactorHandler handler;
+    void *arg;
+}ReactorEntry;
+
+typedef struct {
+    int epfd;
+    int wakeFd;     // eventfd to break reactorRun()
+    volatile int running;
+    pthread_mutex_t lock;   // recursive, handlers run with it held
+    ReactorEntry entries[REACTOR_MAX_HANDLERS];
+}ReactorContext;
+
+int reactorInit(ReactorContext *ctx);
+
+/* register a fd (media fd, socket...), events: EPOLLIN/EPOLLOUT...
+ * add/mod/del are safe from handlers and from other threads */
+int reactorAddFd(ReactorContext *ctx, int fd, uint32_t events, ReactorHandler handler, void *arg);
+
+int reactorModFd(ReactorContext *ctx, int fd, uint32_t events);
+
+int reactorDelFd(ReactorContext *ctx, int fd);
+
+/* create a periodic timerfd, return the timerfd (used by reactorDelFd) */
+int reactorAddTimer(ReactorContext *ctx, int intervalMs, ReactorHandler handler, void *arg);
+
+/* dispatch events in the calling thread until reactorStop() */
+int reactorRun(ReactorContext *ctx);
+
+/* can be called from any thread */
+void reactorStop(ReactorContext *ctx);
+
+void reactorDestroy(ReactorContext *ctx);
+
+#endif //HISILIVE_REACTOR_H
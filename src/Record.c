@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "Record.h"
+#include "Utils.h"
+
+static RecordConfig gRecordConfig = {0, 1};
+
+void recordSetConfig(const RecordConfig *config) {
+    gRecordConfig = *config;
+}
+
+static void recordPrintStats(RecordWriter *w, uint64_t now) {
+    uint32_t secs = (uint32_t)((now - w->statTime) / 1000000);
+
+    printf("record %s: %u writes/s, %u syncs, %llu KB, worst write %u us, worst stall %u us\n",
+           w->path, secs ? w->stats.writes / secs : w->stats.writes, w->stats.syncs,
+           (unsigned long long)(w->stats.bytes >> 10), w->stats.maxWriteUs, w->stats.maxStallUs);
+
+    memset(&w->stats, 0, sizeof(RecordStats));
+    w->statTime = now;
+}
+
+/* preallocate ahead of the write position, the file size is kept */
+static void recordPrealloc(RecordWriter *w, int size) {
+    if (0 == w->allocated || w->written + size <= w->allocated)
+        return;
+
+    if (fallocate(w->fd, FALLOC_FL_KEEP_SIZE, (off_t)w->allocated, RECORD_PREALLOC_SIZE) < 0) {
+        printf("record %s fallocate error %d, disabled.\n", w->path, errno);
+        w->allocated = 0;
+        return;
+    }
+    w->allocated += RECORD_PREALLOC_SIZE;
+}
+
+static int recordWriteAll(RecordWriter *w, const uint8_t *data, int len) {
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(w->fd, data, (size_t)len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            printf("record %s write error %d.\n", w->path, errno);
+            return -1;
+        }
+        w->stats.writes++;
+        data += n;
+        len -= (int)n;
+    }
+    return 0;
+}
+
+static void *recordProc(void *arg) {
+    RecordWriter *w = (RecordWriter *)arg;
+    RecordBuffer *buf;
+    uint64_t start, now;
+    uint32_t us;
+
+    while (1) {
+        pthread_mutex_lock(&w->lock);
+        while (w->running && w->count == 0)
+            pthread_cond_wait(&w->cond, &w->lock);
+
+        if (w->count == 0) {    // stopped and drained
+            pthread_mutex_unlock(&w->lock);
+            break;
+        }
+        buf = &w->bufs[w->head];
+        pthread_mutex_unlock(&w->lock);
+
+        start = getMonotonicTime();
+        recordPrealloc(w, buf->size);
+        if (recordWriteAll(w, buf->data, buf->size) < 0)
+            w->error = 1;
+        w->written += buf->size;
+        w->stats.bytes += buf->size;
+        if (buf->sync) {
+            fdatasync(w->fd);
+            w->stats.syncs++;
+        }
+
+        now = getMonotonicTime();
+        us = (uint32_t)(now - start);
+
+        pthread_mutex_lock(&w->lock);
+        if (us > w->stats.maxWriteUs)
+            w->stats.maxWriteUs = us;
+        if (now - w->statTime >= RECORD_STAT_INTERVAL * 1000000ULL)
+            recordPrintStats(w, now);
+
+        if (buf->sync)
+            w->synced = w->written;
+        buf->size = 0;
+        buf->sync = 0;
+        w->head = (w->head + 1) % RECORD_BUF_NUM;
+        w->count--;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+
+    return NULL;
+}
+
+/* queue the current buffer to the writer thread and move to the next one */
+static int recordSubmit(RecordWriter *w, int sync) {
+    RecordBuffer *cur = &w->bufs[w->cur];
+    RecordBuffer *next = &w->bufs[(w->cur + 1) % RECORD_BUF_NUM];
+    uint64_t start;
+    uint32_t us;
+    int tail;
+
+    // O_DIRECT writes whole blocks only, the unaligned tail moves to the next buffer
+    tail = w->config.direct ? cur->size % RECORD_ALIGN : 0;
+    sync |= w->syncPending;
+    if (cur->size - tail == 0) {
+        w->syncPending = sync;      // nothing to write yet, the sync is not dropped
+        return w->error ? -1 : 0;
+    }
+    w->syncPending = 0;
+
+    pthread_mutex_lock(&w->lock);
+
+    // all other buffers are waiting for the disk
+    start = getMonotonicTime();
+    while (w->count >= RECORD_BUF_NUM - 1)
+        pthread_cond_wait(&w->cond, &w->lock);
+    us = (uint32_t)(getMonotonicTime() - start);
+    if (us > w->stats.maxStallUs)
+        w->stats.maxStallUs = us;
+
+    memcpy(next->data, cur->data + cur->size - tail, (size_t)tail);
+    next->size = tail;
+    cur->size -= tail;
+    cur->sync = sync;
+    w->cur = (w->cur + 1) % RECORD_BUF_NUM;
+    w->count++;
+    pthread_cond_broadcast(&w->cond);
+
+    pthread_mutex_unlock(&w->lock);
+    return w->error ? -1 : 0;
+}
+
+static int recordOpen(RecordWriter *w, const char *path, uint64_t fixedSize) {
+    int i, flags = O_WRONLY | O_CREAT | (fixedSize ? 0 : O_TRUNC);
+
+    memset(w, 0, sizeof(RecordWriter));
+    w->config = gRecordConfig;
+    snprintf(w->path, sizeof(w->path), "%s", path);
+
+    if (w->config.direct)
+        flags |= O_DIRECT;
+    w->fd = open(path, flags, 0644);
+    if (w->fd < 0 && w->config.direct) {
+        printf("record %s O_DIRECT not supported, use page cache.\n", path);
+        w->config.direct = 0;
+        w->fd = open(path, flags & ~O_DIRECT, 0644);
+    }
+    if (w->fd < 0) {
+        printf("record open %s error %d.\n", path, errno);
+        return -1;
+    }
+
+    for (i = 0; i < RECORD_BUF_NUM; i++) {
+        if (posix_memalign((void **)&w->bufs[i].data, RECORD_ALIGN, RECORD_BUF_SIZE)) {
+            printf("record alloc buffer error.\n");
+            goto ERR;
+        }
+    }
+
+    if (fixedSize) {
+        // no-op when the blocks are already there from the previous round
+        if (fallocate(w->fd, 0, 0, (off_t)fixedSize) < 0)
+            printf("record %s fallocate error %d.\n", path, errno);
+        w->allocated = fixedSize;
+        w->fixed = 1;
+    } else {
+        w->allocated = 0 == fallocate(w->fd, FALLOC_FL_KEEP_SIZE, 0, RECORD_PREALLOC_SIZE) ? RECORD_PREALLOC_SIZE : 0;
+    }
+    w->statTime = getMonotonicTime();
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->running = 1;
+    if (pthread_create(&w->tid, NULL, recordProc, w)) {
+        printf("record create thread error.\n");
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        goto ERR;
+    }
+
+    return 0;
+
+ERR:
+    for (i = 0; i < RECORD_BUF_NUM; i++) {
+        free(w->bufs[i].data);
+        w->bufs[i].data = NULL;
+    }
+    close(w->fd);
+    return -1;
+}
+
+int recordWriterOpen(RecordWriter *w, const char *path) {
+    return recordOpen(w, path, 0);
+}
+
+int recordWriterOpenFixed(RecordWriter *w, const char *path, uint64_t size) {
+    return recordOpen(w, path, size);
+}
+
+int recordWriterWrite(RecordWriter *w, const uint8_t *data, int len) {
+    RecordBuffer *cur;
+    int n;
+
+    while (len > 0) {
+        // only the producer touches the current buffer, no lock needed
+        cur = &w->bufs[w->cur];
+        n = RECORD_BUF_SIZE - cur->size;
+        if (n > len)
+            n = len;
+        memcpy(cur->data + cur->size, data, (size_t)n);
+        cur->size += n;
+        data += n;
+        len -= n;
+
+        if (cur->size == RECORD_BUF_SIZE && recordSubmit(w, 0) < 0)
+            return -1;
+    }
+
+    return w->error ? -1 : 0;
+}
+
+int recordWriterMark(RecordWriter *w) {
+    if (0 == w->config.syncGops || ++w->gops < w->config.syncGops)
+        return w->error ? -1 : 0;
+
+    w->gops = 0;
+    return recordSubmit(w, 1);
+}
+
+uint64_t recordWriterSynced(RecordWriter *w) {
+    uint64_t synced;
+
+    pthread_mutex_lock(&w->lock);
+    synced = w->synced;
+    pthread_mutex_unlock(&w->lock);
+    return synced;
+}
+
+int recordWriterClose(RecordWriter *w) {
+    RecordBuffer *cur;
+    int i, ret;
+
+    recordSubmit(w, 0);
+
+    pthread_mutex_lock(&w->lock);
+    w->running = 0;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->tid, NULL);
+
+    // unaligned tail left by O_DIRECT goes through the page cache
+    cur = &w->bufs[w->cur];
+    if (cur->size > 0) {
+        fcntl(w->fd, F_SETFL, fcntl(w->fd, F_GETFL) & ~O_DIRECT);
+        if (recordWriteAll(w, cur->data, cur->size) < 0)
+            w->error = 1;
+        w->written += cur->size;
+        w->stats.bytes += cur->size;
+    }
+
+    fdatasync(w->fd);
+    w->stats.syncs++;
+    w->synced = w->written;
+    if (w->allocated && !w->fixed)
+        ftruncate(w->fd, (off_t)w->written);   // release the preallocated tail
+    recordPrintStats(w, getMonotonicTime());
+
+    ret = close(w->fd);
+    for (i = 0; i < RECORD_BUF_NUM; i++) {
+        free(w->bufs[i].data);
+        w->bufs[i].data = NULL;
+    }
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+
+    return (w->error || ret < 0) ? -1 : 0;
+}
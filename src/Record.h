@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_RECORD_H
+#define HISILIVE_RECORD_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define RECORD_BUF_SIZE         (512 * 1024)        // one write syscall
+#define RECORD_BUF_NUM          4
+#define RECORD_ALIGN            4096                // page / O_DIRECT alignment
+#define RECORD_PREALLOC_SIZE    (32 * 1024 * 1024)  // fallocate step
+#define RECORD_STAT_INTERVAL    60                  // s
+
+typedef struct {
+    int direct;         // open with O_DIRECT, bypass page cache
+    int syncGops;       // durability: fdatasync every n GOPs, 0: only at close
+}RecordConfig;
+
+typedef struct {
+    uint32_t writes;        // write syscalls
+    uint32_t syncs;
+    uint64_t bytes;
+    uint32_t maxWriteUs;    // slowest write (+sync) of the writer thread
+    uint32_t maxStallUs;    // longest wait of the producer for a free buffer
+}RecordStats;
+
+typedef struct {
+    uint8_t *data;      // RECORD_ALIGN aligned
+    int size;
+    int sync;           // fdatasync after this buffer
+}RecordBuffer;
+
+/* frames are batched into large aligned buffers, written out by its own thread */
+typedef struct {
+    int fd;
+    char path[128];
+    RecordConfig config;
+    int gops;
+
+    RecordBuffer bufs[RECORD_BUF_NUM];
+    int head;           // first buffer queued for the writer
+    int count;          // buffers queued
+    int cur;            // buffer being filled, owned by the producer
+    int syncPending;    // a mark found less than a block to submit, the next buffer syncs
+    uint64_t written;   // bytes in file
+    uint64_t synced;    // bytes in file at the end of the last fdatasync
+    uint64_t allocated; // preallocated end of file, 0: fallocate not supported
+    int fixed;          // preallocated segment, file size is kept at close
+    int error;
+
+    RecordStats stats;
+    uint64_t statTime;
+
+    volatile int running;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t tid;
+}RecordWriter;
+
+/* default config of writers opened afterwards */
+void recordSetConfig(const RecordConfig *config);
+
+int recordWriterOpen(RecordWriter *w, const char *path);
+
+/* reuse a file of fixed size, allocated once so it never fragments, written from offset 0 */
+int recordWriterOpenFixed(RecordWriter *w, const char *path, uint64_t size);
+
+/* copy into the current buffer, blocks only if all buffers are waiting for the disk */
+int recordWriterWrite(RecordWriter *w, const uint8_t *data, int len);
+
+/* a GOP ends here, write out & sync according to the durability policy.
+ * with O_DIRECT only whole blocks are written, the unaligned end of the GOP goes
+ * with the next buffer and is durable only at the next sync */
+int recordWriterMark(RecordWriter *w);
+
+/* bytes from the file start that are on the disk, an index may point up to here */
+uint64_t recordWriterSynced(RecordWriter *w);
+
+/* write everything, sync and close the file */
+int recordWriterClose(RecordWriter *w);
+
+#endif //HISILIVE_RECORD_H
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Replay.h"
+#include "Media.h"
+#include "Utils.h"
+
+#define REPLAY_PACK_INIT    16
+
+int replayOpen(ReplayContext *ctx, const char *path, int codec, int frameRate, double speed, int loops) {
+    struct stat st;
+    int fd;
+
+    memset(ctx, 0, sizeof(ReplayContext));
+    if (frameRate <= 0 || speed < 0) {
+        printf("replayOpen param error.\n");
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("replay open %s error %d.\n", path, errno);
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        printf("replay %s is empty.\n", path);
+        close(fd);
+        return -1;
+    }
+
+    ctx->data = (uint8_t *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == ctx->data) {
+        printf("replay mmap %s error %d.\n", path, errno);
+        ctx->data = NULL;
+        return -1;
+    }
+    madvise(ctx->data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    ctx->packs = (VENC_PACK_S *)malloc(REPLAY_PACK_INIT * sizeof(VENC_PACK_S));
+    if (NULL == ctx->packs) {
+        munmap(ctx->data, (size_t)st.st_size);
+        return -1;
+    }
+
+    ctx->size = (size_t)st.st_size;
+    ctx->pos = ff_avc_find_startcode(ctx->data, ctx->data + ctx->size);
+    ctx->codec = codec;
+    ctx->frameRate = frameRate;
+    ctx->speed = speed;
+    ctx->loops = loops;
+    ctx->packCap = REPLAY_PACK_INIT;
+    ctx->pts = getMonotonicTime();
+    ctx->startPts = ctx->pts;
+    ctx->startTime = ctx->pts;
+
+    return 0;
+}
+
+void replayClose(ReplayContext *ctx) {
+    if (ctx->data)
+        munmap(ctx->data, ctx->size);
+    free(ctx->packs);
+    memset(ctx, 0, sizeof(ReplayContext));
+}
+
+/* the NALU opens a new access unit if one with a slice is pending */
+static int replayAuStart(int codec, const uint8_t *nal, const uint8_t *end, int *vcl) {
+    int type;
+
+    if (codec) {
+        type = (nal[0] >> 1) & 0x3f;
+        *vcl = type < 32;
+        if (*vcl)
+            return nal + 2 < end && (nal[2] & 0x80);    // first_slice_segment_in_pic_flag
+        // VPS, SPS, PPS, AUD, prefix SEI, reserved
+        return (type >= 32 && type <= 35) || type == 39 || (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+    }
+
+    type = nal[0] & 0x1f;
+    *vcl = type >= 1 && type <= 5;
+    if (*vcl)
+        return nal + 1 < end && (nal[1] & 0x80);        // first_mb_in_slice == 0
+    // SEI, SPS, PPS, AUD, reserved
+    return (type >= 6 && type <= 9) || (type >= 14 && type <= 18);
+}
+
+static void replaySetType(ReplayContext *ctx, VENC_PACK_S *pack, const uint8_t *nal, int *key) {
+    int type;
+
+    if (ctx->codec) {
+        type = (nal[0] >> 1) & 0x3f;
+        if (type >= 16 && type <= 21) {     // IRAP reported like an encoder I slice
+            type = H265E_NALU_ISLICE;
+            *key = 1;
+        } else if (type < 32) {
+            type = H265E_NALU_PSLICE;
+        }
+        pack->DataType.enH265EType = (H265E_NALU_TYPE_E)type;
+    } else {
+        type = nal[0] & 0x1f;
+        if (type == H264E_NALU_ISLICE)
+            *key = 1;
+        else if (type >= 1 && type < 5)
+            type = H264E_NALU_PSLICE;
+        pack->DataType.enH264EType = (H264E_NALU_TYPE_E)type;
+    }
+}
+
+static void replayWait(ReplayContext *ctx) {
+    struct timespec ts;
+    uint64_t due;
+
+    if (ctx->speed <= 0)
+        return;
+
+    due = ctx->startTime + (uint64_t)((double)(ctx->pts - ctx->startPts) / ctx->speed);
+    ts.tv_sec = (time_t)(due / 1000000);
+    ts.tv_nsec = (long)(due % 1000000) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+int replayNext(ReplayContext *ctx, VENC_STREAM_S *stream) {
+    const uint8_t *end = ctx->data + ctx->size;
+    const uint8_t *r, *next;
+    VENC_PACK_S *pack;
+    int n = 0, vcl, hasVcl = 0, key = 0;
+
+    if (ctx->pos >= end) {
+        if (ctx->loops && ++ctx->played >= ctx->loops)
+            return 0;
+        ctx->pos = ff_avc_find_startcode(ctx->data, end);
+        if (ctx->pos >= end)
+            return 0;
+    }
+
+    while (ctx->pos < end) {
+        r = ctx->pos;
+        while (r < end && !*r)      // skip start code
+            r++;
+        if (++r >= end)
+            break;
+
+        if (replayAuStart(ctx->codec, r, end, &vcl) && hasVcl)
+            break;
+        hasVcl |= vcl;
+
+        next = ff_avc_find_startcode(r, end);
+        if (n == ctx->packCap) {
+            pack = (VENC_PACK_S *)realloc(ctx->packs, ctx->packCap * 2 * sizeof(VENC_PACK_S));
+            if (NULL == pack)
+                return -1;
+            ctx->packs = pack;
+            ctx->packCap *= 2;
+        }
+
+        pack = &ctx->packs[n++];
+        memset(pack, 0, sizeof(VENC_PACK_S));
+        pack->pu8Addr = (HI_U8 *)ctx->pos;
+        pack->u32Len = (HI_U32)(next - ctx->pos);
+        pack->u64PTS = ctx->pts;
+        replaySetType(ctx, pack, r, &key);
+        ctx->pos = next;
+    }
+
+    if (n == 0)
+        return 0;
+    ctx->packs[n - 1].bFrameEnd = HI_TRUE;
+
+    replayWait(ctx);
+
+    memset(stream, 0, sizeof(VENC_STREAM_S));
+    stream->pstPack = ctx->packs;
+    stream->u32PackCount = (HI_U32)n;
+    stream->u32Seq = ctx->seq++;
+    if (ctx->codec)
+        stream->stH265Info.enRefType = key ? BASE_IDRSLICE : BASE_PSLICE_REFBYBASE;
+    else
+        stream->stH264Info.enRefType = key ? BASE_IDRSLICE : BASE_PSLICE_REFBYBASE;
+
+    ctx->pts += 1000000 / ctx->frameRate;
+    return n;
+}
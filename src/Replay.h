@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_REPLAY_H
+#define HISILIVE_REPLAY_H
+
+#include <stdint.h>
+#include "hi_comm_venc.h"
+
+/*
+ * Replay source: an Annex-B .h264/.h265 file is mapped and split into access units,
+ * each one returned as a VENC_STREAM_S with one pack per NALU (start code included),
+ * as HI_MPI_VENC_GetStream does, so the pipeline after the encoder runs unchanged.
+ */
+typedef struct {
+    uint8_t *data;          // mmap of the whole file
+    size_t size;
+    const uint8_t *pos;     // start code of the next access unit
+    int codec;              // 0, H.264/AVC; 1, HEVC/H.265
+
+    double speed;           // 1.0 real time, >1 accelerated, 0 as fast as possible
+    int frameRate;
+    int loops;              // times to play the file, 0 forever
+    int played;
+
+    VENC_PACK_S *packs;     // reused for every access unit
+    int packCap;
+    uint32_t seq;
+    uint64_t pts;           // us, advances by 1/frameRate
+    uint64_t startPts;
+    uint64_t startTime;     // monotonic us of startPts
+}ReplayContext;
+
+int replayOpen(ReplayContext *ctx, const char *path, int codec, int frameRate, double speed, int loops);
+
+/* wait until the next access unit is due, returns its pack count, 0 at the end, -1 on error */
+int replayNext(ReplayContext *ctx, VENC_STREAM_S *stream);
+
+void replayClose(ReplayContext *ctx);
+
+#endif //HISILIVE_REPLAY_H
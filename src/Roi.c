@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <string.h>
+#include "Roi.h"
+
+#define ROI_FLOOR(v)    ((v) / ROI_ALIGN * ROI_ALIGN)
+#define ROI_CEIL(v)     (((v) + ROI_ALIGN - 1) / ROI_ALIGN * ROI_ALIGN)
+
+static uint32_t roiArea(const RoiRect *r) {
+    return (uint32_t)(r->right - r->left) * (uint32_t)(r->bottom - r->top);
+}
+
+static void roiUnion(RoiRect *u, const RoiRect *a, const RoiRect *b) {
+    u->left = a->left < b->left ? a->left : b->left;
+    u->top = a->top < b->top ? a->top : b->top;
+    u->right = a->right > b->right ? a->right : b->right;
+    u->bottom = a->bottom > b->bottom ? a->bottom : b->bottom;
+}
+
+static uint32_t roiIntersect(const RoiRect *a, const RoiRect *b) {
+    int w = (a->right < b->right ? a->right : b->right) - (a->left > b->left ? a->left : b->left);
+    int h = (a->bottom < b->bottom ? a->bottom : b->bottom) - (a->top > b->top ? a->top : b->top);
+    return (w > 0 && h > 0) ? (uint32_t)w * (uint32_t)h : 0;
+}
+
+/* area of r the plan doesn't cover */
+static uint32_t roiOutside(const RoiRect *r, const RoiPlan *plan) {
+    uint32_t area = roiArea(r), in = 0;
+    int i;
+
+    for (i = 0; i < plan->num; i++)
+        in += roiIntersect(r, &plan->rects[i]);
+    return in < area ? area - in : 0;
+}
+
+/* from detector coordinates to the encoded picture, without the margin */
+static void roiScale(const RoiConfig *cfg, const RoiRect *in, RoiRect *out) {
+    out->left = in->left * cfg->width / cfg->srcWidth;
+    out->top = in->top * cfg->height / cfg->srcHeight;
+    out->right = in->right * cfg->width / cfg->srcWidth;
+    out->bottom = in->bottom * cfg->height / cfg->srcHeight;
+}
+
+/* merge until no two overlap and at most max are left, returns how many */
+static int roiMerge(RoiRect *r, int num, int max) {
+    uint32_t cost, best;
+    int i, j, bi = 0, bj = 0, merged;
+    RoiRect u;
+
+    do {
+        merged = 0;
+        for (i = 0; i < num; i++) {
+            for (j = i + 1; j < num; j++) {
+                if (roiIntersect(&r[i], &r[j])) {
+                    roiUnion(&r[i], &r[i], &r[j]);
+                    r[j--] = r[--num];
+                    merged = 1;
+                }
+            }
+        }
+        if (merged || num <= max)
+            continue;
+
+        /* the union of a pair that adds the least area, it may overlap others now */
+        best = UINT32_MAX;
+        for (i = 0; i < num; i++) {
+            for (j = i + 1; j < num; j++) {
+                roiUnion(&u, &r[i], &r[j]);
+                cost = roiArea(&u) - roiArea(&r[i]) - roiArea(&r[j]);
+                if (cost < best) {
+                    best = cost;
+                    bi = i;
+                    bj = j;
+                }
+            }
+        }
+        roiUnion(&r[bi], &r[bi], &r[bj]);
+        r[bj] = r[--num];
+        merged = 1;
+    } while (merged);
+    return num;
+}
+
+static void roiBuild(const RoiConfig *cfg, const RoiRect *regions, int num, int margin, RoiPlan *plan) {
+    RoiRect rects[ROI_INPUT_MAX], *r;
+    int maxW = ROI_FLOOR(cfg->width), maxH = ROI_FLOOR(cfg->height), n = 0, i;
+
+    for (i = 0; i < num && n < ROI_INPUT_MAX; i++) {
+        r = &rects[n];
+        roiScale(cfg, &regions[i], r);
+        r->left = r->left > margin ? ROI_FLOOR(r->left - margin) : 0;
+        r->top = r->top > margin ? ROI_FLOOR(r->top - margin) : 0;
+        r->right = ROI_CEIL(r->right + margin);
+        r->bottom = ROI_CEIL(r->bottom + margin);
+        /* the last partial macroblock row of 1080 lines is left out, regions stay in the picture */
+        r->right = r->right < maxW ? r->right : maxW;
+        r->bottom = r->bottom < maxH ? r->bottom : maxH;
+        if (r->right > r->left && r->bottom > r->top)
+            n++;
+    }
+
+    plan->num = roiMerge(rects, n, ROI_MAX);
+    memcpy(plan->rects, rects, sizeof(RoiRect) * (size_t)plan->num);
+}
+
+void roiInit(RoiPlanner *p, const RoiConfig *cfg) {
+    memset(p, 0, sizeof(RoiPlanner));
+    p->cfg = *cfg;
+}
+
+int roiUpdate(RoiPlanner *p, const RoiRect *regions, int num, uint64_t nowUs) {
+    RoiPlan plan;
+    RoiRect r;
+    uint32_t outside = 0;
+    int i, apply = 1;
+
+    roiBuild(&p->cfg, regions, num, p->cfg.margin, &plan);
+    for (i = 0; i < plan.num; i++)
+        outside += roiOutside(&plan.rects[i], &p->applied);
+
+    if (0 == outside) {
+        /* covered, smaller regions are taken once they were enough for the hold time */
+        if (roiPlanArea(&plan) * 100ull >= roiPlanArea(&p->applied) * (uint64_t)ROI_SHRINK_PCT) {
+            p->shrinkSinceUs = 0;
+            apply = 0;
+        } else if (0 == p->shrinkSinceUs) {
+            p->shrinkSinceUs = nowUs;
+            apply = 0;
+        } else if (nowUs - p->shrinkSinceUs < p->cfg.holdUs) {
+            apply = 0;
+        }
+    } else {
+        p->shrinkSinceUs = 0;
+    }
+
+    if (apply && p->stats.updates && nowUs - p->lastApplyUs < p->cfg.intervalUs) {
+        p->stats.deferred++;
+        apply = 0;
+    }
+    if (apply) {
+        /* something moved out of the regions, give it room to move on before the next update */
+        if (outside)
+            roiBuild(&p->cfg, regions, num, p->cfg.margin * ROI_GROW_MARGIN, &plan);
+        p->applied = plan;
+        p->lastApplyUs = nowUs;
+        p->shrinkSinceUs = 0;
+        p->stats.updates++;
+    }
+
+    p->stats.results++;
+    p->stats.planArea += roiPlanArea(&p->applied);
+    for (i = 0; i < num; i++) {
+        roiScale(&p->cfg, &regions[i], &r);
+        if (r.right > r.left && r.bottom > r.top) {
+            p->stats.regionArea += roiArea(&r);
+            p->stats.missArea += roiOutside(&r, &p->applied);
+        }
+    }
+    return apply;
+}
+
+uint32_t roiPlanArea(const RoiPlan *plan) {
+    uint32_t area = 0;
+    int i;
+
+    for (i = 0; i < plan->num; i++)
+        area += roiArea(&plan->rects[i]);
+    return area;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_ROI_H
+#define HISILIVE_ROI_H
+
+#include <stdint.h>
+
+#define ROI_MAX             8       // venc regions, HI_MPI_VENC_SetRoiCfg index 0-7
+#define ROI_INPUT_MAX       128     // regions of one detector result, VDA MD reports up to u32ObjNumMax
+#define ROI_ALIGN           16      // macroblock, the venc takes regions on the grid
+#define ROI_SHRINK_PCT      70      // a plan under this share of the applied area is worth a smaller one
+#define ROI_GROW_MARGIN     4       // regions grown for motion outside them get this many margins
+
+/*
+ * Encoder ROI planning from detected regions, no MPI and no clock of its own,
+ * so region traces can be replayed through it on the host (bench/roibench).
+ *
+ * Each detector result is scaled to the encoded picture, widened by a margin, put on the
+ * macroblock grid and merged until at most ROI_MAX regions are left, overlapping ones
+ * first, then the pair whose bounding box adds the least area. The encoder is told only
+ * when it matters and at most every intervalUs: at once (within the interval) when something
+ * is detected outside the applied regions, which then get ROI_GROW_MARGIN margins of room to
+ * move on, and only after holdUs when the applied regions are much larger than needed, so a
+ * subject stopping for a moment keeps its quality.
+ */
+
+typedef struct {
+    int left;
+    int top;
+    int right;              // exclusive
+    int bottom;
+}RoiRect;
+
+typedef struct {
+    RoiRect rects[ROI_MAX];
+    int num;
+}RoiPlan;
+
+typedef struct {
+    int width;              // encoded picture
+    int height;
+    int srcWidth;           // detector picture, the regions come in its coordinates
+    int srcHeight;
+    int margin;             // pixels of the encoded picture around each region
+    uint32_t intervalUs;    // the encoder is reconfigured at most so often
+    uint32_t holdUs;        // a smaller plan is taken after it was enough for so long
+}RoiConfig;
+
+typedef struct {
+    uint32_t results;       // detector results taken
+    uint32_t updates;       // plans applied
+    uint32_t deferred;      // results that wanted a change within the interval
+    uint64_t planArea;      // applied area, summed per result
+    uint64_t regionArea;    // detected area, summed per result
+    uint64_t missArea;      // detected area outside the applied regions, summed per result
+}RoiStats;
+
+typedef struct {
+    RoiConfig cfg;
+    RoiPlan applied;
+    uint64_t lastApplyUs;
+    uint64_t shrinkSinceUs; // the applied regions are larger than needed since, 0 not
+    RoiStats stats;
+}RoiPlanner;
+
+void roiInit(RoiPlanner *p, const RoiConfig *cfg);
+
+/* take the regions of one detector result at nowUs (monotonic).
+ * 1 if the applied plan changed and goes to the encoder */
+int roiUpdate(RoiPlanner *p, const RoiRect *regions, int num, uint64_t nowUs);
+
+/* pixels covered, the regions of a plan don't overlap */
+uint32_t roiPlanArea(const RoiPlan *plan);
+
+#endif //HISILIVE_ROI_H
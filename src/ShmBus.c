@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include "ShmBus.h"
+#include "Media.h"
+
+#define SHM_BUS_ALIGN   64      // frames start on a cache line
+
+/* abstract unix socket, nothing to clean up after a crash */
+static socklen_t shmBusAddr(struct sockaddr_un *addr, const char *name) {
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "hisilive.%s", name);
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + strlen(addr->sun_path + 1));
+}
+
+/************ writer ************/
+
+int shmBusCreate(ShmBusWriter *w, const char *name, const SinkVideoInfo *info, int dataMB) {
+    struct sockaddr_un addr;
+    socklen_t len;
+    ShmBusHeader *h;
+    uint32_t dataOffset = (sizeof(ShmBusHeader) + 4095) & ~4095u;
+    int i;
+
+    memset(w, 0, sizeof(ShmBusWriter));
+    w->fd = w->listenFd = -1;
+    if (dataMB <= 0 || (dataMB & (dataMB - 1)) || dataMB > 1024) {
+        printf("shm bus size %d MB is not a power of 2.\n", dataMB);
+        return -1;
+    }
+
+    // memfd_create needs linux 3.17, the camera runs 3.4
+    snprintf(w->path, sizeof(w->path), "/dev/shm/hisilive.%s", name);
+    w->fd = open(w->path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (w->fd < 0) {
+        printf("shm bus open %s error %d.\n", w->path, errno);
+        return -1;
+    }
+
+    w->mapSize = dataOffset + ((size_t)dataMB << 20);
+    if (ftruncate(w->fd, (off_t)w->mapSize) < 0) {
+        printf("shm bus truncate %s error %d.\n", w->path, errno);
+        goto ERR;
+    }
+    h = (ShmBusHeader *)mmap(NULL, w->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+    if (MAP_FAILED == h) {
+        printf("shm bus mmap error %d.\n", errno);
+        goto ERR;
+    }
+    w->header = h;
+    w->data = (uint8_t *)h + dataOffset;
+    memset(w->data, 0, (size_t)dataMB << 20);     // fault the pages in now, not in the first lap
+
+    h->version = SHM_BUS_VERSION;
+    h->codec = (uint16_t)info->codec;
+    h->width = (uint32_t)info->width;
+    h->height = (uint32_t)info->height;
+    h->frameRate = (uint32_t)info->frameRate;
+    h->slotCount = SHM_BUS_SLOTS;
+    h->dataSize = (uint32_t)dataMB << 20;
+    h->dataOffset = dataOffset;
+    __sync_synchronize();
+    h->magic = SHM_BUS_MAGIC;
+
+    w->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    len = shmBusAddr(&addr, name);
+    if (w->listenFd < 0 || bind(w->listenFd, (struct sockaddr *)&addr, len) < 0 ||
+        listen(w->listenFd, SHM_BUS_READER_MAX) < 0) {
+        printf("shm bus listen on %s error %d.\n", addr.sun_path + 1, errno);
+        goto ERR;
+    }
+
+    for (i = 0; i < SHM_BUS_READER_MAX; i++)
+        w->peers[i].sock = w->peers[i].efd = -1;
+    return 0;
+
+ERR:
+    shmBusDestroy(w);
+    return -1;
+}
+
+/* hand the ring and a fresh eventfd to a new reader */
+static int shmBusHello(ShmBusWriter *w, ShmBusPeer *peer) {
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char ctrl[CMSG_SPACE(2 * sizeof(int))];
+    uint32_t magic = SHM_BUS_MAGIC;
+    int fds[2];
+
+    peer->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (peer->efd < 0)
+        return -1;
+
+    fds[0] = w->fd;
+    fds[1] = peer->efd;
+    iov.iov_base = &magic;
+    iov.iov_len = sizeof(magic);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(peer->sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) != sizeof(magic)) {
+        close(peer->efd);
+        peer->efd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void shmBusAccept(ShmBusWriter *w) {
+    ShmBusPeer *peer;
+    char c;
+    int sock, i, n;
+
+    // a reader never sends anything, readable means it is gone
+    for (i = 0; i < w->peerNum; ) {
+        peer = &w->peers[i];
+        n = (int)recv(peer->sock, &c, 1, MSG_DONTWAIT | MSG_PEEK);
+        if (0 == n || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close(peer->sock);
+            close(peer->efd);
+            *peer = w->peers[--w->peerNum];
+            continue;
+        }
+        i++;
+    }
+
+    while ((sock = accept(w->listenFd, NULL, NULL)) >= 0) {
+        if (w->peerNum == SHM_BUS_READER_MAX) {
+            close(sock);
+            continue;
+        }
+        peer = &w->peers[w->peerNum];
+        peer->sock = sock;
+        if (shmBusHello(w, peer) < 0) {
+            close(sock);
+            continue;
+        }
+        w->peerNum++;
+    }
+}
+
+int shmBusPublish(ShmBusWriter *w, const uint8_t *data, int size, const ShmBusSlot *meta) {
+    ShmBusHeader *h = w->header;
+    ShmBusSlot *slot;
+    uint32_t pos = w->writePos, off, n = h->writeSeq;
+    uint64_t one = 1;
+    int i;
+
+    if (size <= 0 || (uint32_t)size > h->dataSize / 2)
+        return -1;
+
+    // a frame never wraps, the tail of the ring is skipped instead
+    off = pos & (h->dataSize - 1);
+    if (off + (uint32_t)size > h->dataSize)
+        pos += h->dataSize - off;
+
+    // readers of the frame in this slot and of the bytes below writeEnd see it before the copy
+    slot = &h->slots[n & (h->slotCount - 1)];
+    slot->seq = 0;
+    __sync_synchronize();
+    h->writeEnd = pos + (uint32_t)size;
+    __sync_synchronize();
+
+    memcpy(w->data + (pos & (h->dataSize - 1)), data, (size_t)size);
+    slot->pos = pos;
+    slot->size = (uint32_t)size;
+    slot->frameSeq = meta->frameSeq;
+    slot->pts = meta->pts;
+    slot->nalMask = meta->nalMask;
+    slot->keyFrame = meta->keyFrame;
+    slot->temporalId = meta->temporalId;
+    __sync_synchronize();
+    slot->seq = n + 1;
+    h->writeSeq = n + 1;
+
+    w->writePos = (pos + (uint32_t)size + SHM_BUS_ALIGN - 1) & ~(uint32_t)(SHM_BUS_ALIGN - 1);
+
+    for (i = 0; i < w->peerNum; i++) {
+        if (write(w->peers[i].efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            printf("shm bus notify error %d.\n", errno);
+    }
+    return 0;
+}
+
+void shmBusDestroy(ShmBusWriter *w) {
+    int i;
+
+    for (i = 0; i < w->peerNum; i++) {
+        close(w->peers[i].sock);
+        close(w->peers[i].efd);
+    }
+    w->peerNum = 0;
+    if (w->listenFd >= 0)
+        close(w->listenFd);
+    if (w->header)
+        munmap(w->header, w->mapSize);
+    if (w->fd >= 0) {
+        close(w->fd);
+        unlink(w->path);
+    }
+    w->listenFd = w->fd = -1;
+    w->header = NULL;
+}
+
+/************ Shm Sink ************/
+
+static int shmSinkOpen(Sink *sink, const char *url) {
+    ShmBusWriter *w = (ShmBusWriter *)malloc(sizeof(ShmBusWriter));
+
+    if (NULL == w)
+        return -1;
+    if (shmBusCreate(w, url, &sink->info, SHM_BUS_DATA_MB) < 0) {
+        free(w);
+        return -1;
+    }
+    sink->priv = w;
+    return 0;
+}
+
+static int shmSinkWriteFrame(Sink *sink, MediaFrame *frame) {
+    ShmBusWriter *w = (ShmBusWriter *)sink->priv;
+    const uint8_t *end = frame->data + frame->size;
+    const uint8_t *r = ff_avc_find_startcode(frame->data, end);
+    ShmBusSlot meta;
+    int readers = w->peerNum;
+
+    memset(&meta, 0, sizeof(meta));
+    while (r < end) {
+        while (r < end && !*r)
+            r++;
+        if (++r >= end)
+            break;
+        meta.nalMask |= 1ull << (frame->codec ? (*r >> 1) & 0x3f : *r & 0x1f);
+        r = ff_avc_find_startcode(r, end);
+    }
+    meta.frameSeq = frame->seq;
+    meta.pts = frame->pts;
+    meta.keyFrame = (uint32_t)frame->keyFrame;
+    meta.temporalId = (uint32_t)frame->temporalId;
+
+    shmBusAccept(w);
+    if (w->peerNum != readers)
+        printf("shm bus %s has %d readers.\n", w->path, w->peerNum);
+    if (w->peerNum > readers)
+        sink->wantKey = 1;      // the new reader starts at a key frame, see sinkRequestKey()
+    return shmBusPublish(w, frame->data, frame->size, &meta);
+}
+
+static void shmSinkClose(Sink *sink) {
+    shmBusDestroy((ShmBusWriter *)sink->priv);
+    free(sink->priv);
+    sink->priv = NULL;
+}
+
+const SinkOps shmSinkOps = {
+    "shm",
+    SINK_CAP_KEYFRAME,      // after a queue drop the readers get the next key frame, not a gap
+    shmSinkOpen,
+    shmSinkWriteFrame,
+    NULL,
+    shmSinkClose
+};
+
+/************ reader ************/
+
+int shmBusOpen(ShmBusReader *r, const char *name) {
+    struct sockaddr_un addr;
+    socklen_t len = shmBusAddr(&addr, name);
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    struct stat st;
+    char ctrl[CMSG_SPACE(2 * sizeof(int))];
+    uint32_t magic = 0, n;
+    const ShmBusSlot *slot;
+    int fds[2];
+
+    memset(r, 0, sizeof(ShmBusReader));
+    r->fd = r->efd = -1;
+    r->sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (r->sock < 0 || connect(r->sock, (struct sockaddr *)&addr, len) < 0) {
+        printf("shm bus %s connect error %d.\n", name, errno);
+        goto ERR;
+    }
+
+    iov.iov_base = &magic;
+    iov.iov_len = sizeof(magic);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    if (recvmsg(r->sock, &msg, MSG_CMSG_CLOEXEC) != sizeof(magic) || magic != SHM_BUS_MAGIC ||
+        NULL == (cmsg = CMSG_FIRSTHDR(&msg)) || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        printf("shm bus %s handshake error.\n", name);
+        goto ERR;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    r->fd = fds[0];
+    r->efd = fds[1];
+
+    if (fstat(r->fd, &st) < 0) {
+        goto ERR;
+    }
+    r->mapSize = (size_t)st.st_size;
+    r->header = (const ShmBusHeader *)mmap(NULL, r->mapSize, PROT_READ, MAP_SHARED, r->fd, 0);
+    if (MAP_FAILED == r->header) {
+        r->header = NULL;
+        goto ERR;
+    }
+    if (r->header->magic != SHM_BUS_MAGIC || r->header->version != SHM_BUS_VERSION ||
+        r->header->dataOffset + (size_t)r->header->dataSize > r->mapSize) {
+        printf("shm bus %s version mismatch.\n", name);
+        goto ERR;
+    }
+    r->data = (const uint8_t *)r->header + r->header->dataOffset;
+
+    // start with the newest key frame still in the ring, else wait for the next one
+    r->next = r->header->writeSeq;
+    r->waitKey = 1;
+    __sync_synchronize();
+    for (n = r->next; n-- != r->next - r->header->slotCount; ) {
+        slot = &r->header->slots[n & (r->header->slotCount - 1)];
+        if (slot->seq != n + 1)
+            break;
+        if (slot->keyFrame) {
+            r->next = n;
+            break;
+        }
+    }
+    return 0;
+
+ERR:
+    shmBusClose(r);
+    return -1;
+}
+
+int shmBusWait(ShmBusReader *r, int timeoutMs) {
+    struct pollfd pfd[2];
+    uint64_t val;
+
+    if (r->next != r->header->writeSeq)
+        return 1;
+
+    pfd[0].fd = r->efd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = r->sock;
+    pfd[1].events = POLLIN;
+    if (poll(pfd, 2, timeoutMs) < 0)
+        return errno == EINTR ? 0 : -1;
+    if (pfd[1].revents)
+        return -1;
+    if (pfd[0].revents & POLLIN) {
+        while (read(r->efd, &val, sizeof(val)) < 0 && errno == EINTR);
+        return 1;
+    }
+    return 0;
+}
+
+int shmBusRead(ShmBusReader *r, ShmBusFrame *frame, uint8_t *buf, int cap) {
+    const ShmBusHeader *h = r->header;
+    const ShmBusSlot *slot;
+    uint32_t writeSeq, seq, pos;
+
+    while (1) {
+        writeSeq = h->writeSeq;
+        __sync_synchronize();
+        if (r->next == writeSeq)
+            return 0;
+
+        slot = &h->slots[r->next & (h->slotCount - 1)];
+        seq = slot->seq;
+        __sync_synchronize();
+        if (writeSeq - r->next > h->slotCount || seq != r->next + 1)
+            goto RESYNC;
+
+        pos = slot->pos;
+        frame->pts = slot->pts;
+        frame->nalMask = slot->nalMask;
+        frame->frameSeq = slot->frameSeq;
+        frame->size = (int)slot->size;
+        frame->keyFrame = (int)slot->keyFrame;
+        frame->temporalId = (int)slot->temporalId;
+        if ((r->waitKey && !frame->keyFrame) || frame->size > cap) {
+            r->waitKey = 1;
+            r->skipped++;
+            r->next++;
+            continue;
+        }
+        memcpy(buf, r->data + (pos & (h->dataSize - 1)), (size_t)frame->size);
+
+        // the writer may have lapped us during the copy
+        __sync_synchronize();
+        if (slot->seq != seq || h->writeEnd - pos > h->dataSize)
+            goto RESYNC;
+
+        r->waitKey = 0;
+        r->next++;
+        r->frames++;
+        return frame->size;
+
+RESYNC:
+        r->resyncs++;
+        r->skipped += writeSeq - r->next;
+        r->next = writeSeq;
+        r->waitKey = 1;
+    }
+}
+
+void shmBusClose(ShmBusReader *r) {
+    if (r->header)
+        munmap((void *)r->header, r->mapSize);
+    if (r->efd >= 0)
+        close(r->efd);
+    if (r->fd >= 0)
+        close(r->fd);
+    if (r->sock >= 0)
+        close(r->sock);
+    r->header = NULL;
+    r->efd = r->fd = r->sock = -1;
+}
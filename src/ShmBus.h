@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_SHMBUS_H
+#define HISILIVE_SHMBUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Sink.h"
+
+#define SHM_BUS_MAGIC       0x42534C48      // "HLSB"
+#define SHM_BUS_VERSION     1
+#define SHM_BUS_SLOTS       256             // frames indexed, power of 2
+#define SHM_BUS_DATA_MB     4               // data ring, power of 2
+#define SHM_BUS_READER_MAX  8
+
+/*
+ * Stream bus for local processes, one writer and up to SHM_BUS_READER_MAX readers.
+ *
+ * The ring lives in /dev/shm/hisilive.<name>, the writer listens on the abstract unix socket
+ * "hisilive.<name>" and hands every reader the ring fd and an eventfd it signals per frame.
+ * Nothing a reader does can block the writer: frames are overwritten in place and each
+ * reader checks after its copy that the slot and the bytes were not reused meanwhile.
+ * A reader too slow for the ring skips to the next key frame.
+ *
+ * All shared counters are 32 bit, so loads and stores are atomic on the ARM too.
+ * Byte positions run modulo 2^32, a multiple of the data ring size.
+ */
+
+typedef struct {
+    volatile uint32_t seq;      // frame number + 1 when published, 0 while being rewritten
+    uint32_t pos;               // byte position of the frame, contiguous in the data ring
+    uint32_t size;
+    uint32_t frameSeq;          // venc sequence number
+    uint64_t pts;               // us
+    uint64_t nalMask;           // bit n: a NALU of type n is in the frame
+    uint32_t keyFrame;
+    uint32_t temporalId;        // svc-t layer, a reader may skip the frames above the one it keeps up with
+}ShmBusSlot;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t codec;             // 0: H.264, 1: H.265
+    uint32_t width;
+    uint32_t height;
+    uint32_t frameRate;
+    uint32_t slotCount;
+    uint32_t dataSize;
+    uint32_t dataOffset;        // from the start of the mapping
+    volatile uint32_t writeSeq; // frames published
+    volatile uint32_t writeEnd; // the writer may have written the bytes before this position
+    ShmBusSlot slots[SHM_BUS_SLOTS];
+}ShmBusHeader;
+
+/************ writer ************/
+
+typedef struct {
+    int sock;
+    int efd;
+}ShmBusPeer;
+
+typedef struct {
+    int fd;
+    int listenFd;
+    ShmBusHeader *header;
+    uint8_t *data;
+    size_t mapSize;
+    uint32_t writePos;
+    ShmBusPeer peers[SHM_BUS_READER_MAX];
+    int peerNum;
+    char path[64];
+}ShmBusWriter;
+
+int shmBusCreate(ShmBusWriter *w, const char *name, const SinkVideoInfo *info, int dataMB);
+
+/* take new readers and forget the gone ones, never blocks. see peerNum */
+void shmBusAccept(ShmBusWriter *w);
+
+/* copy one access unit into the ring and wake the readers. 0 or -1 if it doesn't fit */
+int shmBusPublish(ShmBusWriter *w, const uint8_t *data, int size, const ShmBusSlot *meta);
+
+void shmBusDestroy(ShmBusWriter *w);
+
+/* url is the bus name */
+extern const SinkOps shmSinkOps;
+
+/************ reader ************/
+
+typedef struct {
+    uint64_t pts;
+    uint64_t nalMask;
+    uint32_t frameSeq;
+    int size;
+    int keyFrame;
+    int temporalId;
+}ShmBusFrame;
+
+typedef struct {
+    int sock;
+    int fd;
+    int efd;                    // readable when frames were published, see shmBusWait()
+    const ShmBusHeader *header;
+    const uint8_t *data;
+    size_t mapSize;
+    uint32_t next;              // frame number read next
+    int waitKey;
+    uint32_t frames;
+    uint32_t resyncs;           // fell behind the writer and skipped to a key frame
+    uint32_t skipped;           // frames not read, waiting for the key frame
+}ShmBusReader;
+
+/* connect to the bus, reading starts at the newest key frame in the ring */
+int shmBusOpen(ShmBusReader *r, const char *name);
+
+/* wait for frames, 1 ready, 0 timeout, -1 the writer is gone */
+int shmBusWait(ShmBusReader *r, int timeoutMs);
+
+/* copy the next frame into buf, returns its size, 0 if there is none yet.
+ * a frame larger than cap is skipped like a lost one */
+int shmBusRead(ShmBusReader *r, ShmBusFrame *frame, uint8_t *buf, int cap);
+
+void shmBusClose(ShmBusReader *r);
+
+#endif //HISILIVE_SHMBUS_H
@@ -0,0 +1,492 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Sink.h"
+#include "Record.h"
+#include "RTP.h"
+#include "Network.h"
+#include "Utils.h"
+
+static void *sinkProc(void *arg) {
+    Sink *sink = (Sink *)arg;
+    MediaFrame *frame;
+    uint64_t queued, start, now;
+    int empty;
+    uint32_t latency, delay;
+
+    while (1) {
+        pthread_mutex_lock(&sink->lock);
+        while (sink->running && sink->count == 0)
+            pthread_cond_wait(&sink->cond, &sink->lock);
+
+        if (sink->count == 0) {     // stopped and drained
+            pthread_mutex_unlock(&sink->lock);
+            break;
+        }
+
+        frame = sink->queue[sink->head];
+        queued = sink->queuedUs[sink->head];
+        sink->head = (sink->head + 1) % SINK_QUEUE_SIZE;
+        sink->count--;
+        empty = (sink->count == 0);
+        pthread_mutex_unlock(&sink->lock);
+
+        start = getMonotonicTime();
+        if (sink->ops->writeFrame(sink, frame) < 0)
+            printf("sink %s write frame %u error.\n", sink->ops->name, frame->seq);
+
+        // the frame is out when its last slice is
+        now = getMonotonicTime();
+        delay = (uint32_t)(now - queued);
+        pthread_mutex_lock(&sink->lock);
+        sink->writeUs += (uint32_t)(now - start);
+        if (frame->frameEnd || !frame->slice) {
+            if (sink->writeUs > sink->writeMax)
+                sink->writeMax = sink->writeUs;
+            sink->writeUs = 0;
+        }
+        sink->delayBins[delay / SINK_DELAY_STEP < SINK_DELAY_BINS ? delay / SINK_DELAY_STEP : SINK_DELAY_BINS - 1]++;
+        sink->delayNum++;
+        if (delay > sink->delayMax)
+            sink->delayMax = delay;
+        pthread_mutex_unlock(&sink->lock);
+
+        if (frame->captureUs) {
+            latency = (uint32_t)(now - frame->captureUs);
+            pthread_mutex_lock(&sink->lock);
+            sink->partLatencySum += latency;
+            sink->partNum++;
+            if (frame->frameEnd) {
+                sink->latencySum += latency;
+                sink->latencyNum++;
+                if (latency > sink->latencyMax)
+                    sink->latencyMax = latency;
+            }
+            pthread_mutex_unlock(&sink->lock);
+        }
+        frameUnref(frame);
+
+        // batch the small writes, flush only when catching up
+        if (empty && sink->ops->flush)
+            sink->ops->flush(sink);
+    }
+
+    return NULL;
+}
+
+int sinkOpen(Sink *sink, const SinkOps *ops, const char *url, const SinkVideoInfo *info) {
+    if (NULL == sink || NULL == ops || NULL == url || NULL == info) {
+        printf("sinkOpen param error.\n");
+        return -1;
+    }
+
+    memset(sink, 0, sizeof(Sink));
+    sink->ops = ops;
+    sink->info = *info;
+    sink->waitKey = (ops->caps & SINK_CAP_KEYFRAME) ? 1 : 0;
+
+    if (ops->open(sink, url) < 0) {
+        printf("sink %s open %s error.\n", ops->name, url);
+        return -1;
+    }
+
+    pthread_mutex_init(&sink->lock, NULL);
+    pthread_cond_init(&sink->cond, NULL);
+    sink->running = 1;
+    if (pthread_create(&sink->tid, NULL, sinkProc, sink)) {
+        printf("sink %s create thread error.\n", ops->name);
+        sink->running = 0;
+        ops->close(sink);
+        return -1;
+    }
+
+    return 0;
+}
+
+int sinkPush(Sink *sink, MediaFrame *frame) {
+    pthread_mutex_lock(&sink->lock);
+
+    /* simulcast, the other stream is taken over at one of its key frames */
+    sink->streamBytes[frame->stream % SINK_STREAMS] += (uint64_t)frame->size;
+    if (frame->stream != sink->stream) {
+        if (frame->stream != sink->wantStream || !frame->keyFrame) {
+            pthread_mutex_unlock(&sink->lock);
+            return 1;
+        }
+        sink->stream = frame->stream;
+    }
+
+    if (sink->waitKey && !frame->keyFrame) {
+        sink->dropped++;
+        sink->wantKey = 1;
+        pthread_mutex_unlock(&sink->lock);
+        return -1;
+    }
+
+    // the sink can't keep up, drop instead of stalling the other sinks
+    if (sink->count == SINK_QUEUE_SIZE) {
+        sink->dropped++;
+        if (sink->ops->caps & SINK_CAP_KEYFRAME)
+            sink->waitKey = sink->wantKey = 1;
+        pthread_mutex_unlock(&sink->lock);
+        printf("sink %s queue full, %u frames dropped.\n", sink->ops->name, sink->dropped);
+        return -1;
+    }
+
+    sink->waitKey = 0;
+    sink->queue[(sink->head + sink->count) % SINK_QUEUE_SIZE] = frameRef(frame);
+    sink->queuedUs[(sink->head + sink->count) % SINK_QUEUE_SIZE] = getMonotonicTime();
+    sink->count++;
+    pthread_cond_signal(&sink->cond);
+    pthread_mutex_unlock(&sink->lock);
+
+    return 0;
+}
+
+uint32_t sinkLatency(Sink *sink, SinkLatency *lat) {
+    uint32_t i, n = 0;
+
+    pthread_mutex_lock(&sink->lock);
+    for (i = 0; i < SINK_DELAY_BINS && n <= sink->delayNum - sink->delayNum / 100; i++)
+        n += sink->delayBins[i];
+    lat->queueP99Us = (i * SINK_DELAY_STEP < sink->delayMax) ? i * SINK_DELAY_STEP : sink->delayMax;
+    lat->queueMaxUs = sink->delayMax;
+    lat->writeMaxUs = sink->writeMax;
+    sink->writeMax = 0;
+    memset(sink->delayBins, 0, sizeof(sink->delayBins));
+    sink->delayNum = 0;
+    sink->delayMax = 0;
+    lat->frames = sink->latencyNum;
+    lat->meanUs = sink->latencyNum ? (uint32_t)(sink->latencySum / sink->latencyNum) : 0;
+    lat->maxUs = sink->latencyMax;
+    lat->partMeanUs = sink->partNum ? (uint32_t)(sink->partLatencySum / sink->partNum) : 0;
+    sink->latencySum = 0;
+    sink->latencyNum = 0;
+    sink->latencyMax = 0;
+    sink->partLatencySum = 0;
+    sink->partNum = 0;
+    pthread_mutex_unlock(&sink->lock);
+
+    return lat->frames;
+}
+
+void sinkRequestKey(Sink *sink) {
+    sink->wantKey = 1;
+}
+
+int sinkTakeKeyRequest(Sink *sink) {
+    return __sync_lock_test_and_set(&sink->wantKey, 0);
+}
+
+void sinkClose(Sink *sink) {
+    if (NULL == sink->ops || !sink->running)
+        return;
+
+    pthread_mutex_lock(&sink->lock);
+    sink->running = 0;
+    pthread_cond_signal(&sink->cond);
+    pthread_mutex_unlock(&sink->lock);
+    pthread_join(sink->tid, NULL);
+
+    if (sink->ops->flush)
+        sink->ops->flush(sink);
+    sink->ops->close(sink);
+
+    pthread_cond_destroy(&sink->cond);
+    pthread_mutex_destroy(&sink->lock);
+    sink->ops = NULL;
+}
+
+/************ File Sink ************/
+
+static int fileSinkOpen(Sink *sink, const char *url) {
+    RecordWriter *w = (RecordWriter *)malloc(sizeof(RecordWriter));
+    if (NULL == w)
+        return -1;
+
+    if (recordWriterOpen(w, url) < 0) {
+        printf("fileSinkOpen open file[%s] failed.\n", url);
+        free(w);
+        return -1;
+    }
+    sink->priv = w;
+    return 0;
+}
+
+static int fileSinkWriteFrame(Sink *sink, MediaFrame *frame) {
+    RecordWriter *w = (RecordWriter *)sink->priv;
+
+    if (frame->keyFrame && recordWriterMark(w) < 0)     // previous GOP ends
+        return -1;
+    return recordWriterWrite(w, frame->data, frame->size);
+}
+
+static void fileSinkClose(Sink *sink) {
+    recordWriterClose((RecordWriter *)sink->priv);
+    free(sink->priv);
+    sink->priv = NULL;
+}
+
+const SinkOps fileSinkOps = {
+    "file",
+    SINK_CAP_STORAGE | SINK_CAP_KEYFRAME,
+    fileSinkOpen,
+    fileSinkWriteFrame,
+    NULL,       // the record writer flushes by itself
+    fileSinkClose
+};
+
+/************ RTP Sink ************/
+
+/* temporal layer or simulcast stream of a viewer from its receiver reports, fraction lost in 1/256 */
+#define RTP_ADAPT_LOSS_DOWN     13          // 5%, one layer down or to the sub stream at once
+#define RTP_ADAPT_LOSS_CLEAN    3           // under 1%
+#define RTP_ADAPT_UP_REPORTS    3           // clean reports in a row for one step up
+#define RTP_ADAPT_UP_MAX        32
+#define RTP_ADAPT_HOLD_US       10000000    // down again so soon after up: wait twice as long next time
+#define RTP_ADAPT_FIT_PCT       80          // the main stream fits in so much of the throughput measured
+
+typedef struct {
+    RTPMuxContext rtp;
+    UDPContext udp;
+    UDPContext rtcp;        // port + 1
+    uint64_t lastSrUs;
+    int frameStart;         // the next write begins an access unit
+
+    int layer;              // highest temporalId sent
+    int raise;              // one layer up at the next base layer frame
+    int cleanReports;
+    int upReports;          // clean reports needed to go up
+    uint64_t raisedUs;
+    int skip;               // the access unit being written is above the layer
+    uint32_t skipped;       // frames
+
+    /* simulcast, one ssrc and sequence for both streams, the timestamps go on across a switch */
+    int stream;             // of the frames written, -1 none yet
+    uint32_t tsOffset;
+    uint32_t lastTs;
+    uint32_t switches;
+    uint64_t rrUs;          // the last receiver report came in
+    uint32_t rrHighest;
+    int32_t rrLost;
+    uint32_t rrPackets;     // sent then
+    uint32_t rrOctets;
+    uint64_t rrBytes[SINK_STREAMS];     // pushed then
+    uint32_t fitKbps;       // throughput when the main stream was given up
+}RTPSinkContext;
+
+/*
+ * A frame above the layer is never referenced by one below, so going down is at once.
+ * Going up waits for the next base layer frame, the layer above may reference frames
+ * of it sent before.
+ */
+static void rtpSinkLayerReport(RTPSinkContext *ctx, int layers, const RTCPReportBlock *rb) {
+    if (rb->fractionLost >= RTP_ADAPT_LOSS_DOWN) {
+        ctx->cleanReports = 0;
+        ctx->raise = 0;
+        if (ctx->layer > 0) {
+            ctx->layer--;
+            if (getMonotonicTime() - ctx->raisedUs < RTP_ADAPT_HOLD_US && ctx->upReports < RTP_ADAPT_UP_MAX)
+                ctx->upReports *= 2;
+            printf("sink rtp %s lost %u%%, temporal layer down to %d, %u frames skipped.\n", ctx->udp.dstIp,
+                   rb->fractionLost * 100 / 256, ctx->layer, ctx->skipped);
+        }
+    } else if (rb->fractionLost < RTP_ADAPT_LOSS_CLEAN) {
+        if (++ctx->cleanReports >= ctx->upReports && ctx->layer < layers - 1) {
+            ctx->raise = 1;
+            ctx->cleanReports = 0;
+        }
+    } else {
+        ctx->cleanReports = 0;
+    }
+}
+
+/*
+ * The throughput is what the receiver got between two reports, in the mean packet size
+ * sent meanwhile. Loss gives up the main stream at once, the throughput then is kept:
+ * once the main stream fits in it again, a few clean reports bring it back, without
+ * that only after upReports of them. The switch itself waits for a key frame of the
+ * stream wanted, see sinkPush().
+ */
+static void rtpSinkStreamReport(Sink *sink, RTPSinkContext *ctx, const RTCPReportBlock *rb) {
+    uint64_t now = getMonotonicTime(), bytes[SINK_STREAMS];
+    uint32_t packets = rb->highestSeq - ctx->rrHighest - (uint32_t)(rb->cumulativeLost - ctx->rrLost);
+    uint32_t sent = ctx->rtp.packetCount - ctx->rrPackets, octets = ctx->rtp.octetCount - ctx->rrOctets;
+    uint32_t kbps = 0, mainKbps = 0, want = (uint32_t)sink->wantStream;
+
+    pthread_mutex_lock(&sink->lock);
+    memcpy(bytes, sink->streamBytes, sizeof(bytes));
+    pthread_mutex_unlock(&sink->lock);
+
+    if (ctx->rrUs && now > ctx->rrUs) {
+        if (sent && packets <= sent * 2)
+            kbps = (uint32_t)((uint64_t)packets * (octets / sent) * 8000 / (now - ctx->rrUs));
+        mainKbps = (uint32_t)((bytes[0] - ctx->rrBytes[0]) * 8000 / (now - ctx->rrUs));
+    }
+    ctx->rrUs = now;
+    ctx->rrHighest = rb->highestSeq;
+    ctx->rrLost = rb->cumulativeLost;
+    ctx->rrPackets = ctx->rtp.packetCount;
+    ctx->rrOctets = ctx->rtp.octetCount;
+    memcpy(ctx->rrBytes, bytes, sizeof(bytes));
+
+    if (rb->fractionLost >= RTP_ADAPT_LOSS_DOWN) {
+        ctx->cleanReports = 0;
+        if (0 == want) {
+            sink->wantStream = 1;
+            ctx->fitKbps = kbps;
+            if (now - ctx->raisedUs < RTP_ADAPT_HOLD_US && ctx->upReports < RTP_ADAPT_UP_MAX)
+                ctx->upReports *= 2;
+            printf("sink rtp %s lost %u%% at %u kbps, to the sub stream.\n", ctx->udp.dstIp,
+                   rb->fractionLost * 100 / 256, kbps);
+        }
+    } else if (rb->fractionLost < RTP_ADAPT_LOSS_CLEAN) {
+        ctx->cleanReports++;
+        if (1 == want && (ctx->cleanReports >= ctx->upReports ||
+                          (ctx->cleanReports >= RTP_ADAPT_UP_REPORTS &&
+                           mainKbps * 100 < (uint64_t)ctx->fitKbps * RTP_ADAPT_FIT_PCT))) {
+            sink->wantStream = 0;
+            ctx->cleanReports = 0;
+            ctx->raisedUs = now;
+            printf("sink rtp %s clean at %u kbps, main stream %u kbps, back to it.\n", ctx->udp.dstIp, kbps, mainKbps);
+        }
+    } else {
+        ctx->cleanReports = 0;
+    }
+}
+
+/* the receiver reports coming back to the RTCP socket steer the layer or the stream */
+static void rtpSinkFeedback(Sink *sink, RTPSinkContext *ctx) {
+    RTCPReportBlock rb;
+    uint8_t buf[512];
+    ssize_t len;
+
+    while ((len = recv(ctx->rtcp.socket, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        if (rtcpParseRR(buf, (int)len, ctx->rtp.ssrc, &rb) < 0)
+            continue;
+        if (sink->info.layers > 1)
+            rtpSinkLayerReport(ctx, sink->info.layers, &rb);
+        if (sink->info.simulcast)
+            rtpSinkStreamReport(sink, ctx, &rb);
+    }
+}
+
+static int rtpSinkOpen(Sink *sink, const char *url) {
+    RTPSinkContext *ctx;
+    const char *port = strchr(url, ':');
+
+    if (NULL == port || port - url >= sizeof(ctx->udp.dstIp)) {
+        printf("rtpSinkOpen url %s is invalid, use ip:port.\n", url);
+        return -1;
+    }
+
+    ctx = (RTPSinkContext *)calloc(1, sizeof(RTPSinkContext));
+    if (NULL == ctx)
+        return -1;
+
+    memcpy(ctx->udp.dstIp, url, (size_t)(port - url));
+    ctx->udp.dstPort = atoi(port + 1);
+    if (udpInit(&ctx->udp)) {
+        free(ctx);
+        return -1;
+    }
+    ctx->rtcp = ctx->udp;
+    ctx->rtcp.dstPort++;
+    if (udpInit(&ctx->rtcp)) {
+        close(ctx->udp.socket);
+        free(ctx);
+        return -1;
+    }
+
+    initRTPMuxContext(&ctx->rtp);
+    ctx->rtp.aggregation = 1;   // 1 use Aggregation Unit, 0 Single NALU Unit
+    ctx->rtp.payload_type = sink->info.codec;
+    ctx->rtp.captureExtId = sink->info.captureExtId;
+    ctx->rtp.paceBytes = (uint32_t)((uint64_t)sink->info.paceKbps * 1000 / 8);
+    ctx->frameStart = 1;
+    ctx->layer = sink->info.layers > 1 ? sink->info.layers - 1 : 0;
+    ctx->upReports = RTP_ADAPT_UP_REPORTS;
+    ctx->stream = -1;
+
+    sink->priv = ctx;
+    return 0;
+}
+
+static int rtpSinkWriteFrame(Sink *sink, MediaFrame *frame) {
+    RTPSinkContext *ctx = (RTPSinkContext *)sink->priv;
+    uint64_t now;
+    uint32_t ts;
+
+    if (ctx->frameStart && sink->info.simulcast)
+        rtpSinkFeedback(sink, ctx);
+    if (frame->stream != ctx->stream) {
+        /* a key frame of the other stream, its first packet follows the last one sent */
+        ts = (uint32_t)(frame->pts * 9 / 100);
+        if (ctx->stream >= 0) {
+            ctx->tsOffset = ((int32_t)(ts - ctx->lastTs) > 0) ? 0 : ctx->lastTs + 90000 / sink->info.frameRate - ts;
+            ctx->switches++;
+            printf("sink rtp %s switched to the %s stream, %u switches.\n", ctx->udp.dstIp,
+                   frame->stream ? "sub" : "main", ctx->switches);
+        }
+        ctx->stream = frame->stream;
+        ctx->frameStart = 1;
+    }
+
+    if (ctx->frameStart && sink->info.layers > 1) {
+        rtpSinkFeedback(sink, ctx);
+        if (ctx->raise && 0 == frame->temporalId) {
+            ctx->layer++;
+            ctx->raise = 0;
+            ctx->raisedUs = getMonotonicTime();
+            printf("sink rtp %s temporal layer up to %d, %u frames skipped.\n", ctx->udp.dstIp, ctx->layer, ctx->skipped);
+        }
+        ctx->skip = frame->temporalId > ctx->layer;
+        ctx->skipped += (uint32_t)ctx->skip;
+    }
+    if (ctx->skip) {
+        ctx->frameStart = frame->frameEnd;
+        return 0;
+    }
+
+    // all NALUs of a frame or slice in one call, marker bit is set on the last one of the frame only
+    ctx->rtp.timestamp = (uint32_t)(frame->pts * 9 / 100) + ctx->tsOffset;   // (μs / 10^6) * (90 * 10^3)
+    ctx->lastTs = ctx->rtp.timestamp;
+
+    /* the capture time goes with the first packet of the frame, on the wallclock for other hosts */
+    if (ctx->rtp.captureExtId && ctx->frameStart && frame->captureUs)
+        ctx->rtp.captureNtp = wallToNtp(getWallClockTime() - (getMonotonicTime() - frame->captureUs));
+    ctx->frameStart = frame->frameEnd;
+    rtpSendH264HEVCSlice(&ctx->rtp, &ctx->udp, frame->data, frame->size, frame->frameEnd);
+
+    /* the pts clock is shared with the audio, a report maps it to the wallclock for lip sync */
+    now = getMonotonicTime();
+    if (frame->captureUs && now - ctx->lastSrUs >= RTCP_SR_INTERVAL) {
+        ctx->lastSrUs = now;
+        rtcpSendSR(&ctx->rtp, &ctx->rtcp, getWallClockTime(),
+                   (uint32_t)((frame->pts + now - frame->captureUs) * 9 / 100) + ctx->tsOffset);
+    }
+    return 0;
+}
+
+static void rtpSinkClose(Sink *sink) {
+    RTPSinkContext *ctx = (RTPSinkContext *)sink->priv;
+
+    close(ctx->udp.socket);
+    close(ctx->rtcp.socket);
+    free(ctx);
+    sink->priv = NULL;
+}
+
+const SinkOps rtpSinkOps = {
+    "rtp",
+    SINK_CAP_NETWORK | SINK_CAP_KEYFRAME | SINK_CAP_SLICE,
+    rtpSinkOpen,
+    rtpSinkWriteFrame,
+    NULL,
+    rtpSinkClose
+};
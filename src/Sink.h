@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_SINK_H
+#define HISILIVE_SINK_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "Frame.h"
+
+#define SINK_QUEUE_SIZE     32
+#define SINK_DELAY_STEP     250     // us per bin of the queue delay histogram
+#define SINK_DELAY_BINS     800     // up to 200 ms, the last bin takes the rest
+#define SINK_STREAMS        2       // simulcast, MediaFrame.stream
+
+/* capability flags of a sink */
+#define SINK_CAP_STORAGE    0x01    // writes to local storage, may block for a long time
+#define SINK_CAP_NETWORK    0x02    // sends to network
+#define SINK_CAP_KEYFRAME   0x04    // must start (and restart after a drop) with a key frame
+#define SINK_CAP_SLICE      0x08    // takes the slices of a frame one by one, see MediaFrame.slice
+
+typedef struct {
+    uint32_t frames;
+    uint32_t meanUs;        // capture to the whole frame written
+    uint32_t maxUs;
+    uint32_t partMeanUs;    // capture to each slice written, meanUs for a sink without slices
+    uint32_t queueP99Us;    // queued to written, 99th percentile
+    uint32_t queueMaxUs;
+    uint32_t writeMaxUs;    // the longest a frame took to write (send), all of its slices
+}SinkLatency;
+
+typedef struct {
+    int codec;          // 0, H.264/AVC; 1, HEVC/H.265
+    int width;
+    int height;
+    int frameRate;
+    int captureExtId;   // rtp: abs-capture-time header extension id, 0 none
+    uint32_t paceKbps;  // rtp: packets spread at this rate, 0 sent as fast as they come
+    int layers;         // svc-t temporal layers, MediaFrame.temporalId below it, 1 none
+    int simulcast;      // rtp: the frames of the sub stream are pushed too, the sink picks one, see wantStream
+}SinkVideoInfo;
+
+struct Sink;
+
+typedef struct {
+    const char *name;
+    int caps;
+    int (*open)(struct Sink *sink, const char *url);     // url: file path, ip:port...
+    int (*writeFrame)(struct Sink *sink, MediaFrame *frame);
+    int (*flush)(struct Sink *sink);                     // called when the queue runs empty
+    void (*close)(struct Sink *sink);
+}SinkOps;
+
+/* every sink runs in its own thread, fed by its own frame queue */
+typedef struct Sink {
+    const SinkOps *ops;
+    void *priv;
+    SinkVideoInfo info;
+
+    MediaFrame *queue[SINK_QUEUE_SIZE];
+    uint64_t queuedUs[SINK_QUEUE_SIZE];
+    int head;
+    int count;
+    int waitKey;        // drop frames until next key frame
+    uint32_t dropped;
+    volatile int wantKey;   // a key frame is waited for, see sinkTakeKeyRequest()
+    int stream;             // simulcast, the frames of this stream are taken
+    volatile int wantStream;    // switched to at its next key frame
+    uint64_t streamBytes[SINK_STREAMS];     // pushed, taken or not
+
+    /* capture to written (sent) time, see sinkLatency() */
+    uint64_t latencySum;
+    uint32_t latencyNum;
+    uint32_t latencyMax;
+    uint64_t partLatencySum;
+    uint32_t partNum;
+    uint32_t delayBins[SINK_DELAY_BINS];
+    uint32_t delayNum;
+    uint32_t delayMax;
+    uint32_t writeUs;   // of the frame being written
+    uint32_t writeMax;
+
+    volatile int running;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t tid;
+}Sink;
+
+extern const SinkOps fileSinkOps;   // Annex-B elementary stream
+extern const SinkOps rtpSinkOps;    // RTP over UDP, url "ip:port"
+
+int sinkOpen(Sink *sink, const SinkOps *ops, const char *url, const SinkVideoInfo *info);
+
+/* queue a frame to the sink, never blocks. return -1 if the frame is dropped,
+ * 1 if it is of the other simulcast stream */
+int sinkPush(Sink *sink, MediaFrame *frame);
+
+/* capture to written latency since the last call, returns the number of frames */
+uint32_t sinkLatency(Sink *sink, SinkLatency *lat);
+
+/* a new reader or a lost frame, the sink would like a key frame soon */
+void sinkRequestKey(Sink *sink);
+
+/* 1 if a key frame was requested since the last call */
+int sinkTakeKeyRequest(Sink *sink);
+
+/* write out the queued frames and close */
+void sinkClose(Sink *sink);
+
+#endif //HISILIVE_SINK_H
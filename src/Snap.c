@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include "Snap.h"
+#include "Utils.h"
+
+static SnapBuffer *snapBack(SnapServer *s) {
+    return &s->bufs[s->front < 0 ? 0 : 1 - s->front];
+}
+
+static int snapTag(const SnapServer *s, const SnapBuffer *b, char *tag, int len) {
+    return snprintf(tag, (size_t)len, "\"%x-%u\"", s->boot, b->seq);
+}
+
+static void snapConnClose(SnapConn *c) {
+    SnapServer *s = c->server;
+
+    reactorDelFd(s->reactor, c->fd);
+    close(c->fd);
+    c->fd = -1;
+    if (c->body)
+        c->body->refs--;
+    c->body = NULL;
+    s->connNum--;
+
+    if (!s->accepting) {
+        reactorModFd(s->reactor, s->listenFd, EPOLLIN);
+        s->accepting = 1;
+    }
+}
+
+/* 1 the response is sent, 0 the socket is full, -1 error */
+static int snapWrite(SnapConn *c) {
+    struct msghdr msg;
+    struct iovec iov[2];
+    ssize_t n;
+    int num, part;
+
+    for (;;) {
+        num = 0;
+        if (c->headSent < c->headLen) {
+            iov[num].iov_base = c->head + c->headSent;
+            iov[num++].iov_len = (size_t)(c->headLen - c->headSent);
+        }
+        if (c->body && c->bodySent < c->body->size) {
+            iov[num].iov_base = c->body->data + c->bodySent;
+            iov[num++].iov_len = (size_t)(c->body->size - c->bodySent);
+        }
+        if (0 == num)
+            return 1;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = (size_t)num;
+        n = sendmsg(c->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+            return (EAGAIN == errno || EWOULDBLOCK == errno) ? 0 : -1;
+        }
+
+        part = (int)n < c->headLen - c->headSent ? (int)n : c->headLen - c->headSent;
+        c->headSent += part;
+        c->bodySent += (int)n - part;
+        c->server->stats.bytes += (uint64_t)((int)n - part);
+        c->lastUs = getMonotonicTime();
+    }
+}
+
+/* go on with the response, 1 done and ready for the next request, 0 on the way, -1 closed */
+static int snapFlush(SnapConn *c) {
+    int ret = snapWrite(c);
+
+    if (ret < 0) {
+        snapConnClose(c);
+        return -1;
+    }
+    if (0 == ret) {
+        reactorModFd(c->server->reactor, c->fd, EPOLLOUT);
+        return 0;
+    }
+
+    if (c->body)
+        c->body->refs--;
+    c->body = NULL;
+    c->headLen = c->headSent = c->bodySent = 0;
+    if (!c->keepAlive) {
+        snapConnClose(c);
+        return -1;
+    }
+    reactorModFd(c->server->reactor, c->fd, EPOLLIN);
+    return 1;
+}
+
+static int snapError(SnapConn *c, int code, const char *reason) {
+    c->server->stats.errors += code < 500;
+    c->server->stats.unavailable += 503 == code;
+    if (400 == code || 431 == code)
+        c->keepAlive = 0;       // the rest of the stream can't be parsed
+    c->headLen = snprintf(c->head, sizeof(c->head),
+                          "HTTP/1.1 %d %s\r\nContent-Length: 0\r\n%sConnection: %s\r\n\r\n", code, reason,
+                          405 == code ? "Allow: GET, HEAD\r\n" : 503 == code ? "Retry-After: 1\r\n" : "",
+                          c->keepAlive ? "keep-alive" : "close");
+    return snapFlush(c);
+}
+
+/* answer with the snapshot b, NULL none */
+static int snapRespond(SnapConn *c, SnapBuffer *b) {
+    SnapServer *s = c->server;
+    char tag[32];
+
+    c->waiting = 0;
+    if (NULL == b)
+        return snapError(c, 503, "Service Unavailable");
+
+    snapTag(s, b, tag, sizeof(tag));
+    if (c->etag[0] && (strstr(c->etag, tag) || !strcmp(c->etag, "*"))) {
+        s->stats.notModified++;
+        c->headLen = snprintf(c->head, sizeof(c->head),
+                              "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nCache-Control: no-cache\r\n"
+                              "Connection: %s\r\n\r\n", tag, c->keepAlive ? "keep-alive" : "close");
+        return snapFlush(c);
+    }
+
+    s->stats.sent++;
+    c->headLen = snprintf(c->head, sizeof(c->head),
+                          "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: %d\r\nETag: %s\r\n"
+                          "Cache-Control: no-cache\r\nConnection: %s\r\n\r\n",
+                          b->size, tag, c->keepAlive ? "keep-alive" : "close");
+    if (!c->headOnly) {
+        c->body = b;
+        b->refs++;
+    }
+    return snapFlush(c);
+}
+
+/* the latest snapshot if it is fresh enough, else wait for one */
+static int snapServe(SnapConn *c) {
+    SnapServer *s = c->server;
+    SnapBuffer *b = s->front < 0 ? NULL : &s->bufs[s->front];
+    uint64_t now = getMonotonicTime();
+
+    if (b && (0 == s->maxAgeMs || now - b->timeUs <= (uint64_t)s->maxAgeMs * 1000))
+        return snapRespond(c, b);
+
+    c->waiting = 1;
+    c->lastUs = now;
+    reactorModFd(s->reactor, c->fd, 0);
+    if (s->wanted && !s->pending) {
+        s->pending = 1;
+        s->pendingUs = now;
+        s->stats.wanted++;
+        s->wanted(s, s->arg);
+    }
+    return 0;
+}
+
+/* the value of header name in the lines from p to end, NULL if it is not there */
+static const char *snapHeader(const char *p, const char *end, const char *name, int *len) {
+    size_t n = strlen(name);
+    const char *eol;
+
+    for (; p < end; p = eol + 2) {
+        eol = strstr(p, "\r\n");
+        if (NULL == eol || eol > end)
+            break;
+        if (!strncasecmp(p, name, n) && ':' == p[n]) {
+            for (p += n + 1; ' ' == *p || '\t' == *p; p++);
+            *len = (int)(eol - p);
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/* take one request if it was read completely, 1 answered, 0 incomplete or waiting, -1 closed */
+static int snapRequest(SnapConn *c) {
+    char method[8], path[256], *end, *query;
+    const char *value;
+    int major, minor, len, headLen, ret;
+
+    end = strstr(c->req, "\r\n\r\n");
+    if (NULL == end) {
+        if (c->reqLen < SNAP_REQUEST_MAX - 1)
+            return 0;
+        c->server->stats.requests++;
+        return snapError(c, 431, "Request Header Fields Too Large");
+    }
+    headLen = (int)(end - c->req) + 4;
+    c->server->stats.requests++;
+
+    if (sscanf(c->req, "%7s %255s HTTP/%d.%d", method, path, &major, &minor) != 4)
+        return snapError(c, 400, "Bad Request");
+    c->keepAlive = major > 1 || (1 == major && minor >= 1);
+    value = snapHeader(strstr(c->req, "\r\n") + 2, end + 2, "Connection", &len);
+    if (value && !strncasecmp(value, "close", 5))
+        c->keepAlive = 0;
+    else if (value && !strncasecmp(value, "keep-alive", 10))
+        c->keepAlive = 1;
+    c->etag[0] = '\0';
+    value = snapHeader(strstr(c->req, "\r\n") + 2, end + 2, "If-None-Match", &len);
+    if (value)
+        snprintf(c->etag, sizeof(c->etag), "%.*s", len, value);
+
+    /* the request is taken, what follows is the next one */
+    c->reqLen -= headLen;
+    memmove(c->req, c->req + headLen, (size_t)c->reqLen + 1);
+
+    query = strchr(path, '?');     // pollers add ?t=... against caches
+    if (query)
+        *query = '\0';
+    c->headOnly = !strcmp(method, "HEAD");
+    if (strcmp(method, "GET") && !c->headOnly)
+        ret = snapError(c, 405, "Method Not Allowed");
+    else if (strcmp(path, SNAP_PATH))
+        ret = snapError(c, 404, "Not Found");
+    else
+        ret = snapServe(c);
+    return ret;
+}
+
+/* requests read and not answered, one after another until one has to wait or send */
+static void snapProcess(SnapConn *c) {
+    while (!c->waiting && 0 == c->headLen && snapRequest(c) > 0);
+}
+
+static int snapConnHandler(int fd, uint32_t events, void *arg) {
+    SnapConn *c = (SnapConn *)arg;
+    ssize_t n;
+
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        snapConnClose(c);
+        return 0;
+    }
+    if (c->headLen) {
+        if ((events & EPOLLOUT) && snapFlush(c) > 0)
+            snapProcess(c);
+        return 0;
+    }
+    if (!(events & EPOLLIN) || c->waiting)
+        return 0;
+
+    n = recv(fd, c->req + c->reqLen, (size_t)(SNAP_REQUEST_MAX - 1 - c->reqLen), MSG_DONTWAIT);
+    if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno))
+        return 0;
+    if (n <= 0) {
+        snapConnClose(c);
+        return 0;
+    }
+    c->reqLen += (int)n;
+    c->req[c->reqLen] = '\0';
+    c->lastUs = getMonotonicTime();
+    snapProcess(c);
+    return 0;
+}
+
+static int snapAcceptHandler(int fd, uint32_t events, void *arg) {
+    SnapServer *s = (SnapServer *)arg;
+    SnapConn *c;
+    int sock, i;
+
+    while (s->connNum < SNAP_CONN_MAX) {
+        sock = accept(fd, NULL, NULL);
+        if (sock < 0)
+            return 0;
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+        fcntl(sock, F_SETFD, FD_CLOEXEC);
+
+        for (i = 0; s->conns[i].fd >= 0; i++);
+        c = &s->conns[i];
+        memset(c, 0, sizeof(SnapConn));
+        c->server = s;
+        c->fd = sock;
+        c->lastUs = getMonotonicTime();
+        if (reactorAddFd(s->reactor, sock, EPOLLIN, snapConnHandler, c) < 0) {
+            close(sock);
+            c->fd = -1;
+            return 0;
+        }
+        s->connNum++;
+    }
+
+    /* all taken, new ones wait in the backlog until one closes */
+    reactorModFd(s->reactor, fd, 0);
+    s->accepting = 0;
+    s->stats.full++;
+    return 0;
+}
+
+/* requests waiting too long, stalled responses and idle connections */
+static int snapTickHandler(int fd, uint32_t events, void *arg) {
+    SnapServer *s = (SnapServer *)arg;
+    uint64_t now = getMonotonicTime();
+    SnapConn *c;
+    int i;
+
+    if (s->pending && now - s->pendingUs > SNAP_WAIT_MS * 1000ull)
+        s->pending = 0;     // lost, the next request asks again
+
+    for (i = 0; i < SNAP_CONN_MAX; i++) {
+        c = &s->conns[i];
+        if (c->fd < 0)
+            continue;
+        if (c->waiting) {
+            if (now - c->lastUs > SNAP_WAIT_MS * 1000ull && snapRespond(c, s->front < 0 ? NULL : &s->bufs[s->front]) > 0)
+                snapProcess(c);
+        } else if (now - c->lastUs > (c->headLen ? SNAP_SEND_MS : SNAP_IDLE_MS) * 1000ull) {
+            snapConnClose(c);
+        }
+    }
+    return 0;
+}
+
+int snapServerInit(SnapServer *s, ReactorContext *reactor, int port, uint32_t maxAgeMs,
+                   SnapWanted wanted, void *arg) {
+    struct sockaddr_in addr;
+    int i, on = 1;
+
+    memset(s, 0, sizeof(SnapServer));
+    s->reactor = reactor;
+    s->listenFd = s->timerFd = -1;
+    s->front = -1;
+    s->boot = (uint32_t)(getWallClockTime() / 1000000);
+    s->maxAgeMs = maxAgeMs;
+    s->wanted = wanted;
+    s->arg = arg;
+    for (i = 0; i < SNAP_CONN_MAX; i++)
+        s->conns[i].fd = -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    s->listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s->listenFd < 0 || setsockopt(s->listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+        bind(s->listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(s->listenFd, SNAP_CONN_MAX) < 0 ||
+        reactorAddFd(reactor, s->listenFd, EPOLLIN, snapAcceptHandler, s) < 0) {
+        printf("snapshot server on tcp %d error %d.\n", port, errno);
+        goto ERR;
+    }
+    s->accepting = 1;
+
+    s->timerFd = reactorAddTimer(reactor, SNAP_TICK_MS, snapTickHandler, s);
+    if (s->timerFd < 0) {
+        reactorDelFd(reactor, s->listenFd);
+        goto ERR;
+    }
+    return 0;
+
+ERR:
+    if (s->listenFd >= 0)
+        close(s->listenFd);
+    s->listenFd = -1;
+    return -1;
+}
+
+uint8_t *snapBuffer(SnapServer *s, int size) {
+    SnapBuffer *b = snapBack(s);
+    uint8_t *data;
+
+    if (b->refs) {
+        s->stats.held++;
+        return NULL;
+    }
+    if (size > b->cap) {
+        data = (uint8_t *)realloc(b->data, (size_t)size + (size_t)size / 4);
+        if (NULL == data)
+            return NULL;
+        b->data = data;
+        b->cap = size + size / 4;
+    }
+    return b->data;
+}
+
+void snapCommit(SnapServer *s, int size) {
+    SnapBuffer *b = snapBack(s);
+    SnapConn *c;
+    int i;
+
+    if (size > 0) {
+        b->size = size;
+        b->seq = ++s->seq;
+        b->timeUs = getMonotonicTime();
+        s->front = (int)(b - s->bufs);
+        s->stats.snapshots++;
+    }
+    s->pending = 0;
+
+    for (i = 0; i < SNAP_CONN_MAX; i++) {
+        c = &s->conns[i];
+        if (c->fd >= 0 && c->waiting && snapRespond(c, s->front < 0 ? NULL : &s->bufs[s->front]) > 0)
+            snapProcess(c);
+    }
+}
+
+void snapServerDestroy(SnapServer *s) {
+    int i;
+
+    for (i = 0; i < SNAP_CONN_MAX; i++) {
+        if (s->conns[i].fd >= 0)
+            snapConnClose(&s->conns[i]);
+    }
+    if (s->timerFd >= 0)
+        reactorDelFd(s->reactor, s->timerFd);
+    if (s->listenFd >= 0) {
+        reactorDelFd(s->reactor, s->listenFd);
+        close(s->listenFd);
+    }
+    free(s->bufs[0].data);
+    free(s->bufs[1].data);
+    s->listenFd = s->timerFd = -1;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_SNAP_H
+#define HISILIVE_SNAP_H
+
+#include <stdint.h>
+#include "Reactor.h"
+
+#define SNAP_CONN_MAX       16      // http connections at once, each takes a reactor entry
+#define SNAP_REQUEST_MAX    2048    // request head, longer ones are answered 431
+#define SNAP_RESPONSE_MAX   320     // response head
+#define SNAP_IDLE_MS        15000   // keep-alive connections closed after so long without a request
+#define SNAP_WAIT_MS        2000    // a request waits for a snapshot at most so long
+#define SNAP_SEND_MS        3000    // a response not taken so long is cut, it holds a buffer
+#define SNAP_TICK_MS        500
+#define SNAP_PATH           "/snapshot.jpg"
+
+/*
+ * The latest JPEG snapshot served over HTTP/1.1 from the reactor, no MPI.
+ *
+ * Snapshots go into one of two buffers, the other one is the latest and is what every
+ * request gets, so any number of pollers cost one encode and no file. A buffer is not
+ * written while a connection still sends it: a new snapshot finding the back buffer held
+ * by a slow client is dropped and the latest stays. Each snapshot has an ETag, a request
+ * with a matching If-None-Match gets 304 without the body.
+ *
+ * With maxAgeMs a request finding the latest snapshot older than that waits for a new one
+ * and asks for it through wanted(), one encode for all the requests waiting meanwhile.
+ * Without, snapshots are taken on the caller's own schedule. Either way a request coming
+ * before the first snapshot waits for it, up to SNAP_WAIT_MS.
+ */
+
+typedef struct SnapServer SnapServer;
+
+/* a fresh snapshot is wanted, snapCommit() it when it is there */
+typedef void (*SnapWanted)(SnapServer *s, void *arg);
+
+typedef struct {
+    uint8_t *data;
+    int size;
+    int cap;
+    uint32_t seq;           // snapshot number, 0 none yet
+    uint64_t timeUs;        // monotonic, stored
+    int refs;               // connections sending it
+}SnapBuffer;
+
+typedef struct {
+    SnapServer *server;
+    int fd;                 // -1 unused
+    char req[SNAP_REQUEST_MAX];
+    int reqLen;
+    char head[SNAP_RESPONSE_MAX];
+    int headLen;
+    int headSent;
+    SnapBuffer *body;       // held until sent
+    int bodySent;
+    int keepAlive;
+    int headOnly;           // HEAD
+    int waiting;            // for a snapshot since lastUs
+    char etag[48];          // If-None-Match of the waiting request
+    uint64_t lastUs;
+}SnapConn;
+
+typedef struct {
+    uint32_t snapshots;     // stored
+    uint32_t held;          // dropped, the back buffer was still sent
+    uint32_t wanted;        // wanted() calls
+    uint32_t requests;
+    uint32_t sent;          // 200
+    uint32_t notModified;   // 304
+    uint32_t unavailable;   // 503, no snapshot in SNAP_WAIT_MS
+    uint32_t errors;        // 4xx
+    uint32_t full;          // all connections were taken, new ones waited in the backlog
+    uint64_t bytes;         // body bytes sent
+}SnapStats;
+
+struct SnapServer {
+    ReactorContext *reactor;
+    int listenFd;
+    int timerFd;
+    int accepting;
+    SnapBuffer bufs[2];
+    int front;              // the latest, -1 none yet
+    uint32_t seq;
+    uint32_t boot;          // in the ETag, numbers of an earlier run don't match
+    uint32_t maxAgeMs;
+    SnapWanted wanted;
+    void *arg;
+    int pending;            // wanted() and no snapshot since
+    uint64_t pendingUs;
+    SnapConn conns[SNAP_CONN_MAX];
+    int connNum;
+    SnapStats stats;
+};
+
+/* listen on the tcp port and serve SNAP_PATH from the reactor.
+ * maxAgeMs 0 and wanted NULL: snapshots come on their own */
+int snapServerInit(SnapServer *s, ReactorContext *reactor, int port, uint32_t maxAgeMs,
+                   SnapWanted wanted, void *arg);
+
+/* room for a snapshot of size bytes, NULL if the back buffer is still sent or can't grow */
+uint8_t *snapBuffer(SnapServer *s, int size);
+
+/* size bytes written to snapBuffer() are the latest snapshot now, the waiting requests
+ * get it. 0: the wanted snapshot failed, they get the one there is */
+void snapCommit(SnapServer *s, int size);
+
+/* after the reactor stopped */
+void snapServerDestroy(SnapServer *s);
+
+#endif //HISILIVE_SNAP_H
@@ -26,6 +26,12 @@ uint8_t* Load32(uint8_t *p, uint32_t x) {
     return p;
 }
 
+uint8_t* Load64(uint8_t *p, uint64_t x) {
+    p = Load32(p, (uint32_t)(x >> 32));
+    p = Load32(p, (uint32_t)x);
+    return p;
+}
+
 int readFile(uint8_t **stream, int *len, const char *file) {
     FILE *fp = NULL;
     long size = 0;
@@ -80,4 +86,26 @@ char* getCurrentTime() {
         strftime(res, 20, "%Y.%m.%d-%H:%M:%S", localtime(&currentTime));
     }
     return res;
-}
\ No newline at end of file
+}
+
+uint64_t getMonotonicTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t getWallClockTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#define NTP_OFFSET  2208988800ULL   // seconds from 1900 to 1970
+
+uint64_t wallToNtp(uint64_t wallUs) {
+    return (wallUs / 1000000 + NTP_OFFSET) << 32 | (wallUs % 1000000) * (1ULL << 32) / 1000000;
+}
+
+uint64_t ntpToWall(uint64_t ntp) {
+    return ((ntp >> 32) - NTP_OFFSET) * 1000000 + (((ntp & 0xffffffff) * 1000000 + (1ULL << 31)) >> 32);
+}
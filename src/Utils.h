@@ -49,6 +49,8 @@ uint8_t* Load16(uint8_t *p, uint16_t x);
 
 uint8_t* Load32(uint8_t *p, uint32_t x);
 
+uint8_t* Load64(uint8_t *p, uint64_t x);
+
 /* read a complete file */
 int readFile(uint8_t **stream, int *len, const char *file);
 
@@ -56,4 +58,15 @@ void dumpHex(const uint8_t *ptr, int len);
 
 char* getCurrentTime();
 
+/* monotonic clock in us, for measuring */
+uint64_t getMonotonicTime();
+
+/* wall clock in us since 1970, for RTCP */
+uint64_t getWallClockTime();
+
+/* wall clock us since 1970 to a 64 bit NTP timestamp (32.32 seconds since 1900) and back */
+uint64_t wallToNtp(uint64_t wallUs);
+
+uint64_t ntpToWall(uint64_t ntp);
+
 #endif //HISILIVE_UTILS_H
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+/*
+ * Replays motion region scenarios through the ROI planner, built on the host with `make bench`.
+ *
+ * A scenario is a trace file, one vda result per line, "ms left,top,right,bottom ..." in the
+ * detector picture (CIF like HisiLive -q), or one of the built-in ones:
+ *   walk   one subject crossing the picture, 2 s pause between crossings
+ *   stop   a subject walking in, standing still for 4 s, walking out
+ *   crowd  12 small subjects wandering, more regions than the venc takes
+ *
+ * The bitrate is a model of the P frames, not an encoder: a static pixel costs 1, a moving
+ * one -k times that, 6 qp more halve the cost. With roi the rc runs at the lower bitrate
+ * that puts the whole frame |qp| higher, the regions get it back, so the subject keeps its
+ * quality and what is saved is the rest; the rest is skipped in frames above the background
+ * frame rate. Motion outside the regions is the quality lost, the planner's lag.
+ *
+ *   bench/roibench -q -6,10 walk stop crowd
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "Roi.h"
+
+#define BENCH_PERIOD_US     133333  // vda results at 7.5 fps, u32VdaIntvl 4 at 30 fps
+#define BENCH_CROWD         12
+
+typedef struct {
+    uint64_t us;
+    int num;
+    RoiRect regions[ROI_INPUT_MAX];
+}BenchResult;
+
+typedef struct {
+    int srcWidth;
+    int srcHeight;
+    int width;              // encoded picture
+    int height;
+    int fps;
+    int qp;
+    int bgFrameRate;
+    double moveCost;
+    double seconds;
+    RoiConfig cfg;
+}BenchConfig;
+
+static uint32_t gRand = 0x1234567;
+
+static uint32_t benchRand() {
+    gRand ^= gRand << 13;
+    gRand ^= gRand >> 17;
+    gRand ^= gRand << 5;
+    return gRand;
+}
+
+static void benchBox(RoiRect *r, int cx, int cy, int w, int h) {
+    r->left = cx - w / 2;
+    r->top = cy - h / 2;
+    r->right = cx + w / 2;
+    r->bottom = cy + h / 2;
+}
+
+static int benchBuiltIn(const char *name) {
+    return !strcmp(name, "walk") || !strcmp(name, "stop") || !strcmp(name, "crowd");
+}
+
+/* the regions of a built-in scenario at us */
+static void benchScenario(const char *name, const BenchConfig *bc, uint64_t us, BenchResult *res) {
+    static int x[BENCH_CROWD], y[BENCH_CROWD];
+    double t = (double)us / 1000000, cross = 8, pos;
+    int w = bc->srcWidth, h = bc->srcHeight, i;
+
+    res->us = us;
+    res->num = 0;
+    if (!strcmp(name, "walk")) {
+        pos = fmod(t, cross + 2);
+        if (pos < cross) {
+            /* a person, the legs and the body found apart now and then */
+            benchBox(&res->regions[res->num++], (int)(pos / cross * w), h / 2, w / 10, h / 3);
+            if (benchRand() % 3 == 0)
+                benchBox(&res->regions[res->num++], (int)(pos / cross * w), h / 2 + h / 5, w / 12, h / 8);
+        }
+    } else if (!strcmp(name, "stop")) {
+        pos = fmod(t, 12);
+        if (pos < 4)
+            benchBox(&res->regions[res->num++], (int)(pos / 8 * w), h / 2, w / 10, h / 3);
+        else if (pos >= 8)
+            benchBox(&res->regions[res->num++], (int)((pos - 4) / 8 * w), h / 2, w / 10, h / 3);
+        else if (benchRand() % 4 == 0)
+            benchBox(&res->regions[res->num++], w / 2, h / 2 - h / 8, w / 20, h / 12);   // a hand
+    } else if (!strcmp(name, "crowd")) {
+        for (i = 0; i < BENCH_CROWD; i++) {
+            if (0 == us) {
+                x[i] = (int)(benchRand() % (uint32_t)w);
+                y[i] = (int)(benchRand() % (uint32_t)h);
+            }
+            x[i] += (int)(benchRand() % 7) - 3;
+            y[i] += (int)(benchRand() % 5) - 2;
+            x[i] = x[i] < 0 ? 0 : x[i] >= w ? w - 1 : x[i];
+            y[i] = y[i] < 0 ? 0 : y[i] >= h ? h - 1 : y[i];
+            benchBox(&res->regions[res->num++], x[i], y[i], w / 16, h / 8);
+        }
+    }
+}
+
+static int benchLoad(const char *path, BenchResult **out) {
+    FILE *fp = fopen(path, "r");
+    BenchResult *res = NULL, *p;
+    char line[4096], *str;
+    unsigned long long ms;
+    RoiRect *r;
+    int num = 0, cap = 0, n;
+
+    if (NULL == fp) {
+        printf("open %s failed.\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%llu%n", &ms, &n) != 1)
+            continue;
+        if (num == cap) {
+            cap = cap ? cap * 2 : 1024;
+            p = (BenchResult *)realloc(res, sizeof(BenchResult) * (size_t)cap);
+            if (NULL == p) {
+                free(res);
+                fclose(fp);
+                return -1;
+            }
+            res = p;
+        }
+        p = &res[num++];
+        p->us = ms * 1000;
+        p->num = 0;
+        for (str = line + n; p->num < ROI_INPUT_MAX; str += n) {
+            r = &p->regions[p->num];
+            if (sscanf(str, " %d,%d,%d,%d%n", &r->left, &r->top, &r->right, &r->bottom, &n) != 4)
+                break;
+            p->num++;
+        }
+    }
+    fclose(fp);
+    *out = res;
+    return num;
+}
+
+/* the model cost of one frame, the roi one and the one without */
+static void benchCost(const BenchConfig *bc, double motion, double plan, double miss, double *roi, double *full) {
+    double area = (double)bc->width * bc->height, in;
+    double rest = pow(2, bc->qp / 6.0), bg;
+
+    miss = miss < motion ? miss : motion;
+    in = motion - miss;
+
+    *full = (area - motion) + bc->moveCost * motion;
+    if (0 == plan) {
+        *roi = rest * *full;       // no regions, the whole frame at the raised qp, full rate
+        return;
+    }
+    bg = bc->bgFrameRate ? (double)bc->bgFrameRate / bc->fps : 1.0;
+    *roi = (plan - in) + bc->moveCost * in + bg * rest * ((area - plan - miss) + bc->moveCost * miss);
+}
+
+static void benchRun(const char *name, const BenchConfig *bc, const BenchResult *trace, int num, int json) {
+    static BenchResult one;
+    RoiPlanner planner;
+    const BenchResult *res;
+    RoiStats last;
+    uint64_t us;
+    double roi = 0, full = 0, r, f, motion, frames, area = (double)bc->width * bc->height;
+    int i;
+
+    roiInit(&planner, &bc->cfg);
+    gRand = 0x1234567;
+    for (i = 0, us = 0; trace ? i < num : us < (uint64_t)(bc->seconds * 1000000); i++, us += BENCH_PERIOD_US) {
+        if (trace) {
+            res = &trace[i];
+        } else {
+            benchScenario(name, bc, us, &one);
+            res = &one;
+        }
+        last = planner.stats;
+        roiUpdate(&planner, res->regions, res->num, res->us);
+
+        /* the frames till the next result are encoded with the plan of this one */
+        motion = (double)(planner.stats.regionArea - last.regionArea);
+        motion = motion < area ? motion : area;
+        frames = (trace && i + 1 < num) ? (double)(trace[i + 1].us - res->us) * bc->fps / 1000000 :
+                 (double)BENCH_PERIOD_US * bc->fps / 1000000;
+        benchCost(bc, motion, (double)(planner.stats.planArea - last.planArea),
+                  (double)(planner.stats.missArea - last.missArea), &r, &f);
+        roi += r * frames;
+        full += f * frames;
+    }
+    us = trace ? (num > 1 ? trace[num - 1].us - trace[0].us : 0) : us;
+
+    if (json) {
+        printf("{\"scenario\":\"%s\",\"results\":%u,\"seconds\":%.1f,\"qp\":%d,\"bg_fps\":%d,\"updates\":%u,"
+               "\"deferred\":%u,\"updates_per_min\":%.1f,\"roi_area_pct\":%.1f,\"motion_missed_pct\":%.1f,"
+               "\"bitrate_saved_pct\":%.1f}\n",
+               name, planner.stats.results, (double)us / 1000000, bc->qp, bc->bgFrameRate,
+               planner.stats.updates, planner.stats.deferred,
+               us ? planner.stats.updates * 60e6 / (double)us : 0.0,
+               planner.stats.results ? (double)planner.stats.planArea * 100 / area / planner.stats.results : 0.0,
+               planner.stats.regionArea ? (double)planner.stats.missArea * 100 / planner.stats.regionArea : 0.0,
+               full > 0 ? (1 - roi / full) * 100 : 0.0);
+    } else {
+        printf("%s: %u results in %.1f s, %u updates (%.1f/min), %u put off\n", name, planner.stats.results,
+               (double)us / 1000000, planner.stats.updates, us ? planner.stats.updates * 60e6 / (double)us : 0.0,
+               planner.stats.deferred);
+        printf("  regions %.1f%% of the picture, %.1f%% of the motion outside them\n",
+               planner.stats.results ? (double)planner.stats.planArea * 100 / area / planner.stats.results : 0.0,
+               planner.stats.regionArea ? (double)planner.stats.missArea * 100 / planner.stats.regionArea : 0.0);
+        printf("  qp %d, background %d fps: %.1f%% less bitrate at the same subject qp\n", bc->qp,
+               bc->bgFrameRate ? bc->bgFrameRate : bc->fps, full > 0 ? (1 - roi / full) * 100 : 0.0);
+    }
+}
+
+static void benchUsage(const char *prg) {
+    printf("Usage : %s [-q qp[,fps]] [-f fps] [-k cost] [-t seconds] [-i ms] [-H ms] [-m px] [-j] scenario...\n", prg);
+    printf("\t scenario: walk, stop, crowd or a trace file of \"ms left,top,right,bottom ...\" lines.\n");
+    printf("\t -q: relative qp of the regions[,background frame rate], like HisiLive -q, default -6,0 (full rate).\n");
+    printf("\t -f: frame rate, default 30.\n");
+    printf("\t -k: cost of a moving pixel against a static one, default 10.\n");
+    printf("\t -t: seconds of a built-in scenario, default 60.\n");
+    printf("\t -i: regions reconfigured at most every so many ms, default 500.\n");
+    printf("\t -H: regions made smaller after they were too large so long, default 2000 ms.\n");
+    printf("\t -m: margin around a region, default 16 pixels.\n");
+    printf("\t -j: one JSON object per scenario.\n");
+    printf("\t The detector picture is CIF, the encoded one 1080p, like HisiLive -q.\n");
+}
+
+int main(int argc, char **argv) {
+    BenchConfig bc;
+    BenchResult *trace;
+    int json = 0, opt, num, i;
+
+    memset(&bc, 0, sizeof(bc));
+    bc.srcWidth = 352;
+    bc.srcHeight = 288;
+    bc.width = 1920;
+    bc.height = 1080;
+    bc.fps = 30;
+    bc.qp = -6;
+    bc.moveCost = 10;
+    bc.seconds = 60;
+    bc.cfg.margin = 16;
+    bc.cfg.intervalUs = 500000;
+    bc.cfg.holdUs = 2000000;
+
+    while ((opt = getopt(argc, argv, "q:f:k:t:i:H:m:jh")) != -1) {
+        switch (opt) {
+            case 'q': sscanf(optarg, "%d,%d", &bc.qp, &bc.bgFrameRate); break;
+            case 'f': bc.fps = atoi(optarg); break;
+            case 'k': bc.moveCost = atof(optarg); break;
+            case 't': bc.seconds = atof(optarg); break;
+            case 'i': bc.cfg.intervalUs = (uint32_t)atoi(optarg) * 1000; break;
+            case 'H': bc.cfg.holdUs = (uint32_t)atoi(optarg) * 1000; break;
+            case 'm': bc.cfg.margin = atoi(optarg); break;
+            case 'j': json = 1; break;
+            default:
+                benchUsage(argv[0]);
+                return -1;
+        }
+    }
+    if (optind >= argc || bc.fps <= 0 || bc.bgFrameRate < 0 || bc.bgFrameRate > bc.fps || bc.moveCost < 1 ||
+        bc.seconds <= 0 || bc.cfg.margin < 0) {
+        benchUsage(argv[0]);
+        return -1;
+    }
+    bc.cfg.width = bc.width;
+    bc.cfg.height = bc.height;
+    bc.cfg.srcWidth = bc.srcWidth;
+    bc.cfg.srcHeight = bc.srcHeight;
+
+    for (i = optind; i < argc; i++) {
+        if (benchBuiltIn(argv[i])) {
+            benchRun(argv[i], &bc, NULL, 0, json);
+            continue;
+        }
+        num = benchLoad(argv[i], &trace);
+        if (num <= 0) {
+            printf("%s: no results.\n", argv[i]);
+            continue;
+        }
+        benchRun(argv[i], &bc, trace, num, json);
+        free(trace);
+    }
+    return 0;
+}
@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+/*
+ * Packetizer benchmark, built on the host with `make bench`.
+ *
+ * Every stream of the corpus is split into access units once, then the packetizer runs
+ * over it repeatedly for at least -t seconds. udpSend and the allocator are wrapped at
+ * link time (ld --wrap), so packets and allocations are counted without touching RTP.c,
+ * and the null sink measures the packetizer alone. The slice case sends each slice on its
+ * own, as the venc hands them out in slice mode. Cache misses and instructions come
+ * from perf_event_open when the kernel allows it, -1 otherwise.
+ *
+ * One JSON object per stream and packetizer is written to stdout or -o file.
+ *
+ *   bench/rtpbench                     built-in synthetic corpus
+ *   bench/rtpbench -l a.h264 b.h265    recorded streams, loopback udp sink
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "RTP.h"
+#include "Media.h"
+#include "Replay.h"
+#include "Utils.h"
+
+#ifndef BENCH_VERSION
+#define BENCH_VERSION   "unknown"
+#endif
+
+#define BENCH_PORT      32704
+#define BENCH_FPS       30
+#define BENCH_GOP       30
+
+typedef struct {
+    const char *name;
+    int codec;              // 0, H.264/AVC; 1, HEVC/H.265
+    uint8_t *data;
+    size_t size;
+    uint32_t *auOffset;     // frames + 1 offsets into data
+    int frames;
+    uint32_t *sliceEnd;     // end offsets of the slices, a slice goes with the NALUs before it
+    uint32_t *auSlice;      // frames + 1 indexes into sliceEnd
+}BenchStream;
+
+/* built-in corpus: bitrate and I-frame weight per resolution, all 30 fps */
+typedef struct {
+    const char *name;
+    int codec;
+    int kbps;
+    int iWeight;            // I-frame size in P-frames
+    int slices;             // per frame
+}BenchProfile;
+
+static const BenchProfile gProfiles[] = {
+    {"1080p_4M_h264",   0, 4096, 8,  1},
+    {"1080p_2M_h264",   0, 2048, 8,  1},
+    {"1080p_2M_h265",   1, 2048, 8,  1},
+    {"720p_2M_h264",    0, 2048, 8,  1},
+    {"720p_1M_h264",    0, 1024, 8,  1},
+    {"D1_1M_h264",      0, 1024, 8,  1},
+    {"D1_512k_h264",    0, 512,  8,  1},
+    {"1080p_bigI_h264", 0, 4096, 40, 1},    // I-frames of several hundred KB
+    {"1080p_4M_4slice_h264", 0, 4096, 8, 4},
+    {"1080p_2M_4slice_h265", 1, 2048, 8, 4},
+};
+
+typedef void (*PacketizeFunc)(RTPMuxContext *ctx, UDPContext *udp, const uint8_t *buf, int size);
+typedef void (*PacketizeSliceFunc)(RTPMuxContext *ctx, UDPContext *udp, const uint8_t *buf, int size, int frameEnd);
+
+typedef struct {
+    const char *name;
+    PacketizeFunc fn;
+    PacketizeSliceFunc sliceFn;     // called per slice instead of fn
+}BenchCase;
+
+static const BenchCase gCases[] = {
+    {"rtpSendH264HEVC", rtpSendH264HEVC, NULL},
+    {"rtpSendH264HEVCSlice", NULL, rtpSendH264HEVCSlice},
+};
+
+/************ link time wraps ************/
+
+static int gSinkLoopback = 0;
+static volatile int gCount = 0;
+static uint64_t gPackets, gPacketBytes, gAllocs;
+
+int __real_udpSend(const UDPContext *udp, const uint8_t *data, uint32_t len);
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+int __wrap_udpSend(const UDPContext *udp, const uint8_t *data, uint32_t len) {
+    gPackets++;
+    gPacketBytes += len;
+    return gSinkLoopback ? __real_udpSend(udp, data, len) : (int)len;
+}
+
+void *__wrap_malloc(size_t size) {
+    if (gCount)
+        gAllocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    if (gCount)
+        gAllocs++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    if (gCount)
+        gAllocs++;
+    return __real_realloc(ptr, size);
+}
+
+/************ perf counters ************/
+
+typedef struct {
+    int fd[2];              // cache misses, instructions
+}BenchPerf;
+
+static int benchPerfOpen1(uint64_t config, int group) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static void benchPerfOpen(BenchPerf *perf) {
+    perf->fd[0] = benchPerfOpen1(PERF_COUNT_HW_CACHE_MISSES, -1);
+    perf->fd[1] = perf->fd[0] < 0 ? -1 : benchPerfOpen1(PERF_COUNT_HW_INSTRUCTIONS, perf->fd[0]);
+}
+
+static void benchPerfStart(BenchPerf *perf) {
+    if (perf->fd[0] < 0)
+        return;
+    ioctl(perf->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static void benchPerfStop(BenchPerf *perf, int64_t value[2]) {
+    int i;
+    uint64_t v;
+
+    if (perf->fd[0] >= 0)
+        ioctl(perf->fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (i = 0; i < 2; i++) {
+        value[i] = -1;
+        if (perf->fd[i] >= 0 && read(perf->fd[i], &v, sizeof(v)) == sizeof(v))
+            value[i] = (int64_t)v;
+    }
+}
+
+static void benchPerfClose(BenchPerf *perf) {
+    if (perf->fd[1] >= 0)
+        close(perf->fd[1]);
+    if (perf->fd[0] >= 0)
+        close(perf->fd[0]);
+}
+
+/************ corpus ************/
+
+static uint32_t gRand = 0x1234567;
+
+static uint32_t benchRand() {
+    gRand ^= gRand << 13;
+    gRand ^= gRand >> 17;
+    gRand ^= gRand << 5;
+    return gRand;
+}
+
+/* a NALU of random non-zero bytes, so no start code is emulated */
+static uint8_t *benchPutNal(uint8_t *p, int codec, int type, int size, int first) {
+    int i;
+
+    *p++ = 0; *p++ = 0; *p++ = 0; *p++ = 1;
+    if (codec) {
+        *p++ = (uint8_t)(type << 1);
+        *p++ = 1;
+        *p++ = first ? 0x80 : 0x40;     // first_slice_segment_in_pic_flag
+        size -= 3;
+    } else {
+        *p++ = (uint8_t)(0x60 | type);
+        *p++ = first ? 0x80 : 0x40;     // first_mb_in_slice 0 or 1
+        size -= 2;
+    }
+    for (i = 0; i < size; i++)
+        *p++ = (uint8_t)(benchRand() % 255 + 1);
+    return p;
+}
+
+static int benchSynth(BenchStream *s, const BenchProfile *prof, int seconds) {
+    int frames = seconds * BENCH_FPS, i, j, size;
+    int avg = prof->kbps * 1000 / 8 / BENCH_FPS;
+    int pSize = avg * BENCH_GOP / (prof->iWeight + BENCH_GOP - 1);
+    size_t cap = (size_t)avg * frames * 2 + (size_t)frames * 128;
+    uint8_t *p;
+
+    memset(s, 0, sizeof(BenchStream));
+    s->data = (uint8_t *)malloc(cap);
+    s->auOffset = (uint32_t *)malloc((frames + 1) * sizeof(uint32_t));
+    if (NULL == s->data || NULL == s->auOffset)
+        return -1;
+
+    p = s->data;
+    for (i = 0; i < frames; i++) {
+        s->auOffset[i] = (uint32_t)(p - s->data);
+        size = pSize * (80 + (int)(benchRand() % 41)) / 100;   // +-20%
+        if (i % BENCH_GOP == 0) {
+            size *= prof->iWeight;
+            if (prof->codec) {
+                p = benchPutNal(p, 1, 32, 24, 1);   // VPS
+                p = benchPutNal(p, 1, 33, 40, 1);   // SPS
+                p = benchPutNal(p, 1, 34, 8, 1);    // PPS
+                p = benchPutNal(p, 1, 39, 12, 1);   // SEI
+                for (j = 0; j < prof->slices; j++)
+                    p = benchPutNal(p, 1, 19, size / prof->slices, 0 == j);    // IDR_W_RADL
+            } else {
+                p = benchPutNal(p, 0, 7, 16, 1);    // SPS
+                p = benchPutNal(p, 0, 8, 5, 1);     // PPS
+                p = benchPutNal(p, 0, 6, 12, 1);    // SEI
+                for (j = 0; j < prof->slices; j++)
+                    p = benchPutNal(p, 0, 5, size / prof->slices, 0 == j);     // IDR
+            }
+        } else {
+            for (j = 0; j < prof->slices; j++)
+                p = benchPutNal(p, prof->codec, 1, size / prof->slices, 0 == j);
+        }
+    }
+    s->auOffset[frames] = (uint32_t)(p - s->data);
+
+    s->name = prof->name;
+    s->codec = prof->codec;
+    s->size = (size_t)(p - s->data);
+    s->frames = frames;
+    return 0;
+}
+
+/* split a recorded stream into access units */
+static int benchLoad(BenchStream *s, const char *path) {
+    ReplayContext replay;
+    VENC_STREAM_S stream;
+    const char *ext = strrchr(path, '.');
+    int codec = ext && (!strcmp(ext, ".h265") || !strcmp(ext, ".hevc"));
+    int cap = 1024, n = 0;
+    uint32_t *au;
+
+    memset(s, 0, sizeof(BenchStream));
+    if (replayOpen(&replay, path, codec, BENCH_FPS, 0, 1) < 0)
+        return -1;
+
+    s->data = (uint8_t *)malloc(replay.size);
+    s->auOffset = (uint32_t *)malloc(cap * sizeof(uint32_t));
+    if (NULL == s->data || NULL == s->auOffset) {
+        replayClose(&replay);
+        return -1;
+    }
+    memcpy(s->data, replay.data, replay.size);
+
+    while (replayNext(&replay, &stream) > 0) {
+        if (n + 2 > cap) {
+            au = (uint32_t *)realloc(s->auOffset, cap * 2 * sizeof(uint32_t));
+            if (NULL == au)
+                break;
+            s->auOffset = au;
+            cap *= 2;
+        }
+        s->auOffset[n++] = (uint32_t)(stream.pstPack[0].pu8Addr - replay.data);
+    }
+    s->auOffset[n] = (uint32_t)replay.size;
+    replayClose(&replay);
+
+    s->name = path;
+    s->codec = codec;
+    s->size = s->auOffset[n] - (n ? s->auOffset[0] : 0);
+    s->frames = n;
+    return n > 0 ? 0 : -1;
+}
+
+static int benchPutSlice(BenchStream *s, int *cap, int n, uint32_t end) {
+    uint32_t *slices;
+
+    if (n == *cap) {
+        slices = (uint32_t *)realloc(s->sliceEnd, *cap * 2 * sizeof(uint32_t));
+        if (NULL == slices)
+            return -1;
+        s->sliceEnd = slices;
+        *cap *= 2;
+    }
+    s->sliceEnd[n] = end;
+    return 0;
+}
+
+/* the end of each slice NALU, found once so the slice case doesn't pay for the search */
+static int benchSplitSlices(BenchStream *s) {
+    const uint8_t *r, *r1, *end;
+    int cap = s->frames * 2, i, n = 0, type;
+
+    s->auSlice = (uint32_t *)malloc((s->frames + 1) * sizeof(uint32_t));
+    s->sliceEnd = (uint32_t *)malloc(cap * sizeof(uint32_t));
+    if (NULL == s->auSlice || NULL == s->sliceEnd)
+        return -1;
+
+    for (i = 0; i < s->frames; i++) {
+        s->auSlice[i] = (uint32_t)n;
+        end = s->data + s->auOffset[i + 1];
+        r = ff_avc_find_startcode(s->data + s->auOffset[i], end);
+        while (r < end) {
+            while (!*(r++));
+            r1 = ff_avc_find_startcode(r, end);
+            type = s->codec ? (r[0] >> 1) & 0x3f : r[0] & 0x1f;
+            if (s->codec ? type < 32 : type >= 1 && type <= 5) {
+                if (benchPutSlice(s, &cap, n++, (uint32_t)(r1 - s->data)) < 0)
+                    return -1;
+            }
+            r = r1;
+        }
+        // a frame without a slice is sent as one, NALUs after the last slice go with it
+        if (n == (int)s->auSlice[i] && benchPutSlice(s, &cap, n++, s->auOffset[i + 1]) < 0)
+            return -1;
+        s->sliceEnd[n - 1] = s->auOffset[i + 1];
+    }
+    s->auSlice[s->frames] = (uint32_t)n;
+    return 0;
+}
+
+/************ run ************/
+
+static uint64_t benchNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int benchPass(const BenchCase *bc, const BenchStream *s, RTPMuxContext *rtp, UDPContext *udp, uint32_t *ts) {
+    uint32_t start;
+    int i, j;
+
+    for (i = 0; i < s->frames; i++) {
+        rtp->timestamp = *ts;
+        if (bc->sliceFn) {
+            start = s->auOffset[i];
+            for (j = (int)s->auSlice[i]; j < (int)s->auSlice[i + 1]; j++) {
+                bc->sliceFn(rtp, udp, s->data + start, (int)(s->sliceEnd[j] - start), j + 1 == (int)s->auSlice[i + 1]);
+                start = s->sliceEnd[j];
+            }
+        } else {
+            bc->fn(rtp, udp, s->data + s->auOffset[i], (int)(s->auOffset[i + 1] - s->auOffset[i]));
+        }
+        *ts += 90000 / BENCH_FPS;
+    }
+    return s->frames;
+}
+
+static void benchRun(FILE *out, const BenchCase *bc, const BenchStream *s, UDPContext *udp, double minSeconds) {
+    RTPMuxContext rtp;
+    BenchPerf perf;
+    uint64_t start, elapsed, frames = 0, bytes = 0;
+    int64_t counter[2];
+    uint32_t ts = 0;
+    int passes = 0;
+
+    initRTPMuxContext(&rtp);
+    rtp.payload_type = s->codec;
+    benchPass(bc, s, &rtp, udp, &ts);      // warm up caches and the socket
+
+    benchPerfOpen(&perf);
+    gPackets = gPacketBytes = gAllocs = 0;
+    gCount = 1;
+    benchPerfStart(&perf);
+    start = benchNs();
+    do {
+        frames += benchPass(bc, s, &rtp, udp, &ts);
+        bytes += s->size;
+        passes++;
+        elapsed = benchNs() - start;
+    } while (elapsed < (uint64_t)(minSeconds * 1e9));
+    benchPerfStop(&perf, counter);
+    gCount = 0;
+    benchPerfClose(&perf);
+
+    fprintf(out, "{\"version\":\"%s\",\"case\":\"%s\",\"stream\":\"%s\",\"codec\":\"%s\",\"sink\":\"%s\","
+                 "\"passes\":%d,\"frames\":%llu,\"bytes\":%llu,\"packets\":%llu,\"packet_bytes\":%llu,"
+                 "\"ns\":%llu,\"ns_per_byte\":%.4f,\"ns_per_frame\":%.1f,\"pkts_per_s\":%.0f,\"mbytes_per_s\":%.2f,"
+                 "\"allocs\":%llu,\"allocs_per_frame\":%.3f,\"cache_misses\":%lld,\"instructions\":%lld,"
+                 "\"instructions_per_byte\":%.3f}\n",
+            BENCH_VERSION, bc->name, s->name, s->codec ? "h265" : "h264", gSinkLoopback ? "loopback" : "null",
+            passes, (unsigned long long)frames, (unsigned long long)bytes,
+            (unsigned long long)gPackets, (unsigned long long)gPacketBytes,
+            (unsigned long long)elapsed, (double)elapsed / (double)bytes, (double)elapsed / (double)frames,
+            (double)gPackets * 1e9 / (double)elapsed, (double)bytes * 1e3 / (double)elapsed,
+            (unsigned long long)gAllocs, (double)gAllocs / (double)frames,
+            (long long)counter[0], (long long)counter[1],
+            counter[1] < 0 ? -1.0 : (double)counter[1] / (double)bytes);
+    fflush(out);
+}
+
+static void *benchDrain(void *arg) {
+    int fd = *(int *)arg;
+    uint8_t buf[2048];
+
+    while (recv(fd, buf, sizeof(buf), 0) > 0);
+    return NULL;
+}
+
+static void benchUsage(const char *prg) {
+    printf("Usage : %s [-l] [-t seconds] [-s seconds] [-o file] [stream.h264|stream.h265 ...]\n", prg);
+    printf("\t -l: send to a loopback udp receiver instead of the null sink.\n");
+    printf("\t -t: minimum measured time per stream, default 1 s.\n");
+    printf("\t -s: length of the built-in streams, default 10 s.\n");
+    printf("\t -o: write the JSON results to a file, default stdout.\n");
+    printf("Without streams the built-in 1080p/720p/D1 corpus is used.\n");
+}
+
+int main(int argc, char **argv) {
+    BenchStream stream;
+    UDPContext udp;
+    struct sockaddr_in addr;
+    pthread_t drain;
+    FILE *out = stdout;
+    double minSeconds = 1.0;
+    int seconds = 10, rxFd = -1, opt, i, j, n;
+
+    while ((opt = getopt(argc, argv, "lt:s:o:h")) != -1) {
+        switch (opt) {
+            case 'l': gSinkLoopback = 1; break;
+            case 't': minSeconds = atof(optarg); break;
+            case 's': seconds = atoi(optarg); break;
+            case 'o':
+                out = fopen(optarg, "w");
+                if (NULL == out) {
+                    printf("open %s error %d.\n", optarg, errno);
+                    return -1;
+                }
+                break;
+            default:
+                benchUsage(argv[0]);
+                return -1;
+        }
+    }
+    if (minSeconds <= 0 || seconds <= 0) {
+        benchUsage(argv[0]);
+        return -1;
+    }
+
+    memset(&udp, 0, sizeof(udp));
+    if (gSinkLoopback) {
+        rxFd = socket(AF_INET, SOCK_DGRAM, 0);
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(BENCH_PORT);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (rxFd < 0 || bind(rxFd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            printf("bind loopback port %d error %d.\n", BENCH_PORT, errno);
+            return -1;
+        }
+        pthread_create(&drain, NULL, benchDrain, &rxFd);
+
+        /* udpInit prints to stdout, which carries the results */
+        strcpy(udp.dstIp, "127.0.0.1");
+        udp.dstPort = BENCH_PORT;
+        udp.servAddr = addr;
+        udp.socket = socket(AF_INET, SOCK_DGRAM, 0);
+        if (udp.socket < 0)
+            return -1;
+    }
+
+    n = optind < argc ? argc - optind : (int)(sizeof(gProfiles) / sizeof(gProfiles[0]));
+    for (i = 0; i < n; i++) {
+        if ((optind < argc ? benchLoad(&stream, argv[optind + i]) : benchSynth(&stream, &gProfiles[i], seconds))
+            || benchSplitSlices(&stream)) {
+            printf("stream %s skipped.\n", optind < argc ? argv[optind + i] : gProfiles[i].name);
+            free(stream.data);
+            free(stream.auOffset);
+            free(stream.sliceEnd);
+            free(stream.auSlice);
+            continue;
+        }
+        for (j = 0; j < (int)(sizeof(gCases) / sizeof(gCases[0])); j++)
+            benchRun(out, &gCases[j], &stream, &udp, minSeconds);
+        free(stream.data);
+        free(stream.auOffset);
+        free(stream.sliceEnd);
+        free(stream.auSlice);
+    }
+
+    if (out != stdout)
+        fclose(out);
+    if (gSinkLoopback) {
+        shutdown(rxFd, SHUT_RDWR);
+        close(udp.socket);
+    }
+    return 0;
+}
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+/*
+ * Stream bus benchmark, built on the host with `make bench`.
+ *
+ * The writer publishes a synthetic GOP over and over, each reader is a process of its own
+ * going through the reader API like an external consumer, and compares every frame it got
+ * with the corpus, so a torn read shows up as corrupt. -d slows reader 0 down to show a
+ * lagging reader resyncs at key frames while the others keep up.
+ *
+ * One JSON object per reader count is written to stdout or -o file.
+ *
+ *   bench/shmbench                     1,2,4,8 readers, as fast as possible
+ *   bench/shmbench -r 4 -f 30 -d 50000 4 readers at 30 fps, reader 0 needs 50 ms a frame
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "ShmBus.h"
+
+#ifndef BENCH_VERSION
+#define BENCH_VERSION   "unknown"
+#endif
+
+#define BENCH_GOP       30
+#define BENCH_IWEIGHT   8
+
+typedef struct {
+    uint8_t *data;
+    uint32_t offset[BENCH_GOP + 1];
+    int maxSize;
+}BenchGop;
+
+typedef struct {
+    int index;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t ns;
+    uint32_t resyncs;
+    uint32_t skipped;
+    uint32_t corrupt;
+}BenchReaderResult;
+
+static uint32_t gRand = 0x1234567;
+
+static uint32_t benchRand() {
+    gRand ^= gRand << 13;
+    gRand ^= gRand >> 17;
+    gRand ^= gRand << 5;
+    return gRand;
+}
+
+static uint64_t benchNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* a NALU of random non-zero bytes, so no start code is emulated */
+static uint8_t *benchPutNal(uint8_t *p, int type, int size) {
+    int i;
+
+    *p++ = 0; *p++ = 0; *p++ = 0; *p++ = 1;
+    *p++ = (uint8_t)(0x60 | type);
+    for (i = 1; i < size; i++)
+        *p++ = (uint8_t)(benchRand() % 255 + 1);
+    return p;
+}
+
+/* one 1080p H.264 GOP at kbps and 30 fps */
+static int benchSynth(BenchGop *gop, int kbps) {
+    int avg = kbps * 1000 / 8 / 30, i, size;
+    int pSize = avg * BENCH_GOP / (BENCH_IWEIGHT + BENCH_GOP - 1);
+    uint8_t *p;
+
+    gop->data = (uint8_t *)malloc((size_t)avg * BENCH_GOP * 2 + 1024);
+    if (NULL == gop->data)
+        return -1;
+
+    p = gop->data;
+    gop->maxSize = 0;
+    for (i = 0; i < BENCH_GOP; i++) {
+        gop->offset[i] = (uint32_t)(p - gop->data);
+        size = pSize * (80 + (int)(benchRand() % 41)) / 100;   // +-20%
+        if (0 == i) {
+            p = benchPutNal(p, 7, 16);      // SPS
+            p = benchPutNal(p, 8, 5);       // PPS
+            p = benchPutNal(p, 5, size * BENCH_IWEIGHT);
+        } else {
+            p = benchPutNal(p, 1, size);
+        }
+        if ((int)(p - gop->data - gop->offset[i]) > gop->maxSize)
+            gop->maxSize = (int)(p - gop->data - gop->offset[i]);
+    }
+    gop->offset[BENCH_GOP] = (uint32_t)(p - gop->data);
+    return 0;
+}
+
+static void benchReader(const char *name, const BenchGop *gop, int index, int delayUs, int out) {
+    BenchReaderResult res;
+    ShmBusReader r;
+    ShmBusFrame frame;
+    uint8_t *buf = (uint8_t *)malloc((size_t)gop->maxSize);
+    uint64_t start = 0;
+    int i, size, idx;
+
+    memset(&res, 0, sizeof(res));
+    res.index = index;
+    for (i = 0; i < 100 && shmBusOpen(&r, name) < 0; i++)
+        usleep(10000);
+    if (i == 100 || NULL == buf)
+        exit(1);
+
+    while (shmBusWait(&r, 1000) >= 0) {
+        while ((size = shmBusRead(&r, &frame, buf, gop->maxSize)) > 0) {
+            if (0 == start)
+                start = benchNs();
+            idx = (int)(frame.frameSeq % BENCH_GOP);
+            if (size != (int)(gop->offset[idx + 1] - gop->offset[idx]) ||
+                memcmp(buf, gop->data + gop->offset[idx], (size_t)size) ||
+                frame.keyFrame != (0 == idx))
+                res.corrupt++;
+            res.frames++;
+            res.bytes += (uint64_t)size;
+            if (delayUs)
+                usleep((useconds_t)delayUs);
+        }
+    }
+
+    res.ns = start ? benchNs() - start : 0;
+    res.resyncs = r.resyncs;
+    res.skipped = r.skipped;
+    shmBusClose(&r);
+    if (write(out, &res, sizeof(res)) != sizeof(res))
+        exit(1);
+    exit(0);
+}
+
+static void benchRun(FILE *out, const BenchGop *gop, int readers, double seconds, int fps, int delayUs) {
+    BenchReaderResult res[SHM_BUS_READER_MAX], one;
+    SinkVideoInfo info = {0, 1920, 1080, 30};
+    ShmBusWriter w;
+    ShmBusSlot meta;
+    char name[32];
+    int pipes[2], i, idx;
+    pid_t pid[SHM_BUS_READER_MAX];
+    uint64_t start, elapsed, publishNs = 0, t, frames = 0, bytes = 0, readBytes = 0, readNs = 0;
+    uint64_t minFrames = ~0ull;
+    uint32_t resyncs = 0, corrupt = 0;
+    struct timespec due;
+
+    snprintf(name, sizeof(name), "bench.%d", (int)getpid());
+    if (shmBusCreate(&w, name, &info, SHM_BUS_DATA_MB) < 0 || pipe(pipes) < 0)
+        return;
+
+    for (i = 0; i < readers; i++) {
+        pid[i] = fork();
+        if (0 == pid[i]) {
+            close(pipes[0]);
+            benchReader(name, gop, i, 0 == i ? delayUs : 0, pipes[1]);
+        }
+    }
+    close(pipes[1]);
+
+    for (i = 0; i < 2000 && w.peerNum < readers; i++) {
+        shmBusAccept(&w);
+        usleep(1000);
+    }
+
+    memset(&meta, 0, sizeof(meta));
+    clock_gettime(CLOCK_MONOTONIC, &due);
+    start = benchNs();
+    do {
+        idx = (int)(frames % BENCH_GOP);
+        meta.frameSeq = (uint32_t)frames;
+        meta.pts = frames * 1000000 / 30;
+        meta.keyFrame = (0 == idx);
+        meta.nalMask = meta.keyFrame ? (1 << 5) | (1 << 7) | (1 << 8) : (1 << 1);
+
+        t = benchNs();
+        shmBusPublish(&w, gop->data + gop->offset[idx], (int)(gop->offset[idx + 1] - gop->offset[idx]), &meta);
+        publishNs += benchNs() - t;
+        bytes += gop->offset[idx + 1] - gop->offset[idx];
+        frames++;
+
+        if (fps > 0) {
+            due.tv_nsec += 1000000000 / fps;
+            if (due.tv_nsec >= 1000000000) {
+                due.tv_sec++;
+                due.tv_nsec -= 1000000000;
+            }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR);
+        }
+        elapsed = benchNs() - start;
+    } while (elapsed < (uint64_t)(seconds * 1e9));
+
+    // readers see the socket close and report
+    usleep(100000);
+    shmBusDestroy(&w);
+
+    memset(res, 0, sizeof(res));
+    for (i = 0; i < readers; i++) {
+        if (read(pipes[0], &one, sizeof(one)) == sizeof(one) && one.index >= 0 && one.index < readers)
+            res[one.index] = one;
+        else
+            corrupt++;      // a reader died
+        waitpid(pid[i], NULL, 0);
+    }
+    close(pipes[0]);
+
+    for (i = 0; i < readers; i++) {
+        readBytes += res[i].bytes;
+        if (res[i].ns > readNs)
+            readNs = res[i].ns;
+        if (res[i].frames < minFrames)
+            minFrames = res[i].frames;
+        resyncs += res[i].resyncs;
+        corrupt += res[i].corrupt;
+    }
+
+    fprintf(out, "{\"version\":\"%s\",\"readers\":%d,\"fps\":%d,\"slow_reader_us\":%d,\"frames\":%llu,\"bytes\":%llu,"
+                 "\"ns\":%llu,\"write_mbytes_per_s\":%.2f,\"publish_ns_per_frame\":%.1f,"
+                 "\"read_mbytes_per_s\":%.2f,\"reader_frames_min\":%llu,\"resyncs\":%u,\"slow_reader_resyncs\":%u,"
+                 "\"corrupt\":%u}\n",
+            BENCH_VERSION, readers, fps, delayUs, (unsigned long long)frames, (unsigned long long)bytes,
+            (unsigned long long)elapsed, (double)bytes * 1e3 / (double)elapsed, (double)publishNs / (double)frames,
+            readNs ? (double)readBytes * 1e3 / (double)readNs : 0.0, (unsigned long long)minFrames,
+            resyncs, delayUs ? res[0].resyncs : 0, corrupt);
+    fflush(out);
+}
+
+static void benchUsage(const char *prg) {
+    printf("Usage : %s [-r readers[,readers...]] [-t seconds] [-f fps] [-k kbps] [-d us] [-o file]\n", prg);
+    printf("\t -r: reader processes of each run, at most %d, default 1,2,4,8.\n", SHM_BUS_READER_MAX);
+    printf("\t -t: measured time per run, default 2 s.\n");
+    printf("\t -f: frames per second published, default 0, as fast as possible.\n");
+    printf("\t -k: bitrate of the 1080p stream at 30 fps, default 4096 kbps.\n");
+    printf("\t -d: reader 0 sleeps so long after each frame, default 0.\n");
+    printf("\t -o: write the JSON results to a file, default stdout.\n");
+}
+
+int main(int argc, char **argv) {
+    BenchGop gop;
+    FILE *out = stdout;
+    char list[64] = "1,2,4,8", *str;
+    double seconds = 2.0;
+    int fps = 0, kbps = 4096, delayUs = 0, opt, readers;
+
+    while ((opt = getopt(argc, argv, "r:t:f:k:d:o:h")) != -1) {
+        switch (opt) {
+            case 'r': snprintf(list, sizeof(list), "%s", optarg); break;
+            case 't': seconds = atof(optarg); break;
+            case 'f': fps = atoi(optarg); break;
+            case 'k': kbps = atoi(optarg); break;
+            case 'd': delayUs = atoi(optarg); break;
+            case 'o':
+                out = fopen(optarg, "w");
+                if (NULL == out) {
+                    printf("open %s error %d.\n", optarg, errno);
+                    return -1;
+                }
+                break;
+            default:
+                benchUsage(argv[0]);
+                return -1;
+        }
+    }
+    if (seconds <= 0 || fps < 0 || kbps <= 0 || delayUs < 0 || benchSynth(&gop, kbps) < 0) {
+        benchUsage(argv[0]);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    for (str = strtok(list, ","); str; str = strtok(NULL, ",")) {
+        readers = atoi(str);
+        if (readers <= 0 || readers > SHM_BUS_READER_MAX) {
+            printf("readers %s skipped.\n", str);
+            continue;
+        }
+        benchRun(out, &gop, readers, seconds, fps, delayUs);
+    }
+
+    free(gop.data);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
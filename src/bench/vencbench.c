@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+/*
+ * Steady state allocation check of the venc pull path, built on the host with `make bench`.
+ *
+ * The mock venc encodes a synthetic 1080p stream, or -i file, at 10 times the frame rate
+ * (HILI_MOCK_SPEED). Each stream is pulled from the reactor like HisiLive does: Query, pack
+ * nodes from the SDK pack pool, GetStream, a frame of the frame pool for the packs, pushed to
+ * two null sinks (one waiting for key frames) and ReleaseStream. The allocator is wrapped at
+ * link time (ld --wrap) and counted in the pulling thread and the sink threads, the encoder
+ * thread of the mock stands in for the chip and is not.
+ *
+ * The pack pool and the frame buffers grow to what the stream needs, so the warm-up holds
+ * the first SINK_QUEUE_SIZE frames at once, as a stalled sink would, and ends after -w frames
+ * in a row without an allocation. It fails if that takes more than BENCH_SETTLE times as long.
+ * Then -n frames must not allocate at all. The exit status is 1 if either fails.
+ *
+ *   bench/vencbench                    300 quiet frames of warm-up, 3000 checked
+ *   bench/vencbench -i a.h264 -n 20000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include "sample_comm.h"
+#include "Reactor.h"
+#include "Frame.h"
+#include "Sink.h"
+
+#ifndef BENCH_VERSION
+#define BENCH_VERSION   "unknown"
+#endif
+
+#define BENCH_VENC_CHN  0
+#define BENCH_FPS       30
+#define BENCH_GOP       30
+#define BENCH_FRAMES    (SINK_QUEUE_SIZE * 2 + 16)     // frame pool, as the main stream of HisiLive
+#define BENCH_STALL_MS  2000    // no stream for so long, the mock has no input
+#define BENCH_SETTLE    10      // warm-up frames at most, in -w
+
+typedef struct {
+    VENC_CHN VencChn;
+    SAMPLE_VENC_PACK_POOL_S stPackPool;
+    FramePool stFramePool;
+    Sink astSink[2];
+    ReactorContext stReactor;
+    uint32_t u32Warmup;
+    uint32_t u32Checked;
+    uint32_t u32Frames;
+    uint32_t u32QuietFrom;      // warm-up, the last frame with an allocation
+    uint32_t u32CheckFrom;      // 0 warming up
+    MediaFrame *apstHeld[SINK_QUEUE_SIZE];
+    int heldNum;                // -1 released
+    uint64_t u64WarmupAllocs;
+    uint32_t u32Dropped;        // no free frame
+    uint32_t u32Idle;           // timer ticks without a stream
+    uint64_t u64Bytes;
+    uint64_t u64StartNs;
+    uint64_t u64Ns;
+    int error;
+}BenchContext;
+
+/************ link time wraps ************/
+
+static volatile int gCount = 0;
+static volatile uint64_t gAllocs;
+static volatile size_t gFirstSize;
+static __thread int gCounted;       // the pulling thread and the sink threads
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static void benchAlloc(size_t size) {
+    if (gCount && gCounted) {
+        if (0 == __sync_fetch_and_add(&gAllocs, 1))
+            gFirstSize = size;
+    }
+}
+
+void *__wrap_malloc(size_t size) {
+    benchAlloc(size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    benchAlloc(n * size);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    benchAlloc(size);
+    return __real_realloc(ptr, size);
+}
+
+/************ null sink ************/
+
+static int benchSinkOpen(Sink *sink, const char *url) {
+    return 0;
+}
+
+static int benchSinkWriteFrame(Sink *sink, MediaFrame *frame) {
+    gCounted = 1;
+    return frame->size;
+}
+
+static void benchSinkClose(Sink *sink) {
+}
+
+static const SinkOps benchSinkOps = {
+    .name = "null",
+    .caps = SINK_CAP_NETWORK,
+    .open = benchSinkOpen,
+    .writeFrame = benchSinkWriteFrame,
+    .close = benchSinkClose,
+};
+
+static const SinkOps benchKeySinkOps = {
+    .name = "null-key",
+    .caps = SINK_CAP_STORAGE | SINK_CAP_KEYFRAME,
+    .open = benchSinkOpen,
+    .writeFrame = benchSinkWriteFrame,
+    .close = benchSinkClose,
+};
+
+/************ input ************/
+
+static uint32_t gRand = 0x1234567;
+
+static uint32_t benchRand() {
+    gRand ^= gRand << 13;
+    gRand ^= gRand >> 17;
+    gRand ^= gRand << 5;
+    return gRand;
+}
+
+/* a H.264 NALU of random non-zero bytes, so no start code is emulated */
+static void benchPutNal(FILE *fp, int type, int first, int size) {
+    uint8_t buf[4096];
+    int i, n;
+
+    buf[0] = 0; buf[1] = 0; buf[2] = 0; buf[3] = 1;
+    buf[4] = (uint8_t)(0x60 | type);
+    buf[5] = first ? 0x80 : 0x40;       // first_mb_in_slice 0, or 1
+    fwrite(buf, 1, 6, fp);
+    for (size -= 2; size > 0; size -= n) {
+        n = size < (int)sizeof(buf) ? size : (int)sizeof(buf);
+        for (i = 0; i < n; i++)
+            buf[i] = (uint8_t)(benchRand() % 255 + 1);
+        fwrite(buf, 1, (size_t)n, fp);
+    }
+}
+
+/* 10 s of 1080p 4 Mbps, the I frames in 4 slices and the P frames in 2, the sizes vary +-20% */
+static int benchSynth(const char *path) {
+    int avg = 4096 * 1000 / 8 / BENCH_FPS, pSize = avg * BENCH_GOP / (8 + BENCH_GOP - 1), i, j, size;
+    FILE *fp = fopen(path, "wb");
+
+    if (NULL == fp) {
+        printf("open %s error %d.\n", path, errno);
+        return -1;
+    }
+    for (i = 0; i < 10 * BENCH_FPS; i++) {
+        size = pSize * (80 + (int)(benchRand() % 41)) / 100;
+        if (i % BENCH_GOP == 0) {
+            benchPutNal(fp, 7, 1, 16);      // SPS
+            benchPutNal(fp, 8, 1, 5);       // PPS
+            benchPutNal(fp, 6, 1, 12);      // SEI
+            for (j = 0; j < 4; j++)
+                benchPutNal(fp, 5, 0 == j, size * 8 / 4);
+        } else {
+            for (j = 0; j < 2; j++)
+                benchPutNal(fp, 1, 0 == j, size / 2);
+        }
+    }
+    return fclose(fp);
+}
+
+/************ pull loop ************/
+
+static uint64_t benchNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* all packs of the stream copied into a frame of the pool, NULL if there is none free */
+static MediaFrame *benchStreamToFrame(BenchContext *b, const VENC_STREAM_S *pstStream) {
+    MediaFrame *pstFrame;
+    const VENC_PACK_S *pstPack;
+    HI_U32 i, u32Len, u32Size = 0;
+
+    for (i = 0; i < pstStream->u32PackCount; i++)
+        u32Size += pstStream->pstPack[i].u32Len - pstStream->pstPack[i].u32Offset;
+
+    pstFrame = frameGet(&b->stFramePool, (int)u32Size);
+    if (NULL == pstFrame)
+        return NULL;
+    for (i = 0; i < pstStream->u32PackCount; i++) {
+        pstPack = &pstStream->pstPack[i];
+        u32Len = pstPack->u32Len - pstPack->u32Offset;
+        memcpy(pstFrame->data + pstFrame->size, pstPack->pu8Addr + pstPack->u32Offset, u32Len);
+        pstFrame->size += (int)u32Len;
+        if (H264E_NALU_ISLICE == pstPack->DataType.enH264EType)
+            pstFrame->keyFrame = 1;
+    }
+    pstFrame->pts = pstStream->pstPack[0].u64PTS;
+    pstFrame->seq = pstStream->u32Seq;
+    return pstFrame;
+}
+
+static int benchVencHandler(int fd, uint32_t events, void *arg) {
+    BenchContext *b = (BenchContext *)arg;
+    VENC_CHN_STAT_S stStat;
+    VENC_STREAM_S stStream;
+    MediaFrame *pstFrame;
+    HI_S32 s32Ret;
+    int i;
+
+    s32Ret = HI_MPI_VENC_Query(b->VencChn, &stStat);
+    if (HI_SUCCESS != s32Ret) {
+        printf("HI_MPI_VENC_Query failed with %#x!\n", s32Ret);
+        b->error = 1;
+        reactorStop(&b->stReactor);
+        return -1;
+    }
+    if (0 == stStat.u32CurPacks)
+        return 0;
+
+    memset(&stStream, 0, sizeof(VENC_STREAM_S));
+    stStream.pstPack = SAMPLE_COMM_VENC_PackPoolGet(&b->stPackPool, stStat.u32CurPacks);
+    if (NULL == stStream.pstPack) {
+        b->error = 1;
+        reactorStop(&b->stReactor);
+        return -1;
+    }
+    stStream.u32PackCount = stStat.u32CurPacks;
+    s32Ret = HI_MPI_VENC_GetStream(b->VencChn, &stStream, HI_TRUE);
+    if (HI_SUCCESS != s32Ret) {
+        printf("HI_MPI_VENC_GetStream failed with %#x!\n", s32Ret);
+        return 0;
+    }
+
+    pstFrame = benchStreamToFrame(b, &stStream);
+    s32Ret = HI_MPI_VENC_ReleaseStream(b->VencChn, &stStream);
+    if (HI_SUCCESS != s32Ret)
+        printf("HI_MPI_VENC_ReleaseStream failed with %#x!\n", s32Ret);
+
+    if (pstFrame) {
+        for (i = 0; i < 2; i++)
+            sinkPush(&b->astSink[i], pstFrame);
+        b->u64Bytes += (uint64_t)pstFrame->size;
+        if (b->heldNum >= 0)
+            b->apstHeld[b->heldNum++] = frameRef(pstFrame);
+        frameUnref(pstFrame);
+    } else {
+        b->u32Dropped++;
+    }
+
+    b->u32Frames++;
+    b->u32Idle = 0;
+    if (SINK_QUEUE_SIZE == b->heldNum) {
+        while (b->heldNum > 0)
+            frameUnref(b->apstHeld[--b->heldNum]);
+        b->heldNum = -1;
+    }
+    if (0 == b->u32CheckFrom) {
+        if (gAllocs) {
+            b->u64WarmupAllocs += gAllocs;
+            gAllocs = 0;
+            b->u32QuietFrom = b->u32Frames;
+        }
+        if (b->u32Frames - b->u32QuietFrom == b->u32Warmup) {
+            b->u32CheckFrom = b->u32Frames;
+            b->u64Bytes = 0;
+            b->u64StartNs = benchNs();
+        } else if (b->u32Frames == b->u32Warmup * BENCH_SETTLE) {
+            printf("still allocating after %u frames, %llu allocations.\n",
+                   b->u32Frames, (unsigned long long)b->u64WarmupAllocs);
+            b->error = 1;
+            reactorStop(&b->stReactor);
+        }
+    } else if (b->u32Frames == b->u32CheckFrom + b->u32Checked) {
+        gCount = 0;
+        b->u64Ns = benchNs() - b->u64StartNs;
+        reactorStop(&b->stReactor);
+    }
+    return 0;
+}
+
+static int benchTimerHandler(int fd, uint32_t events, void *arg) {
+    BenchContext *b = (BenchContext *)arg;
+
+    if (++b->u32Idle * 100 >= BENCH_STALL_MS) {
+        printf("no venc stream for %d ms after %u frames.\n", BENCH_STALL_MS, b->u32Frames);
+        b->error = 1;
+        reactorStop(&b->stReactor);
+    }
+    return 0;
+}
+
+static int benchStartVenc(BenchContext *b) {
+    VENC_CHN_ATTR_S stAttr;
+    HI_S32 s32Ret;
+
+    memset(&stAttr, 0, sizeof(VENC_CHN_ATTR_S));
+    stAttr.stVeAttr.enType = PT_H264;
+    stAttr.stVeAttr.stAttrH264e.u32MaxPicWidth = 1920;
+    stAttr.stVeAttr.stAttrH264e.u32MaxPicHeight = 1080;
+    stAttr.stVeAttr.stAttrH264e.u32PicWidth = 1920;
+    stAttr.stVeAttr.stAttrH264e.u32PicHeight = 1080;
+    stAttr.stVeAttr.stAttrH264e.u32BufSize = 1920 * 1080 * 2;
+    stAttr.stVeAttr.stAttrH264e.bByFrame = HI_TRUE;
+    stAttr.stRcAttr.enRcMode = VENC_RC_MODE_H264CBR;
+    stAttr.stRcAttr.stAttrH264Cbr.u32Gop = BENCH_GOP;
+    stAttr.stRcAttr.stAttrH264Cbr.fr32DstFrmRate = BENCH_FPS;
+
+    s32Ret = HI_MPI_VENC_CreateChn(b->VencChn, &stAttr);
+    if (HI_SUCCESS != s32Ret) {
+        printf("HI_MPI_VENC_CreateChn failed with %#x!\n", s32Ret);
+        return -1;
+    }
+    s32Ret = HI_MPI_VENC_StartRecvPic(b->VencChn);
+    if (HI_SUCCESS != s32Ret) {
+        printf("HI_MPI_VENC_StartRecvPic failed with %#x!\n", s32Ret);
+        HI_MPI_VENC_DestroyChn(b->VencChn);
+        return -1;
+    }
+    return 0;
+}
+
+static void benchUsage(const char *prg) {
+    printf("Usage : %s [-i stream.h264] [-w frames] [-n frames]\n", prg);
+    printf("\t -i: H.264 stream encoded by the mock venc, default a built-in 10 s 1080p one.\n");
+    printf("\t -w: frames in a row without an allocation that end the warm-up, default 300.\n");
+    printf("\t -n: frames that must not allocate, default 3000.\n");
+}
+
+int main(int argc, char **argv) {
+    BenchContext b;
+    SinkVideoInfo info;
+    char path[] = "/tmp/vencbench-XXXXXX";
+    const char *input = NULL;
+    int opt, fd, i, ret = 1;
+
+    memset(&b, 0, sizeof(BenchContext));
+    b.VencChn = BENCH_VENC_CHN;
+    b.u32Warmup = 300;
+    b.u32Checked = 3000;
+    while ((opt = getopt(argc, argv, "i:w:n:h")) != -1) {
+        switch (opt) {
+            case 'i': input = optarg; break;
+            case 'w': b.u32Warmup = (uint32_t)atoi(optarg); break;
+            case 'n': b.u32Checked = (uint32_t)atoi(optarg); break;
+            default:
+                benchUsage(argv[0]);
+                return -1;
+        }
+    }
+    if (0 == b.u32Warmup || 0 == b.u32Checked) {
+        benchUsage(argv[0]);
+        return -1;
+    }
+
+    if (NULL == input) {
+        fd = mkstemp(path);
+        if (fd < 0) {
+            printf("mkstemp error %d.\n", errno);
+            return -1;
+        }
+        close(fd);
+        if (benchSynth(path) < 0) {
+            unlink(path);
+            return -1;
+        }
+        input = path;
+    }
+    setenv("HILI_MOCK_VIDEO", input, 1);
+    setenv("HILI_MOCK_SPEED", "10", 0);
+    setenv("HILI_MOCK_LOOPS", "0", 1);
+
+    memset(&info, 0, sizeof(SinkVideoInfo));
+    info.width = 1920;
+    info.height = 1080;
+    info.frameRate = BENCH_FPS;
+    info.layers = 1;
+    if (reactorInit(&b.stReactor) < 0)
+        goto INPUT;
+    if (SAMPLE_COMM_VENC_PackPoolInit(&b.stPackPool, SAMPLE_VENC_MAX_PACKS) != HI_SUCCESS ||
+        framePoolInit(&b.stFramePool, BENCH_FRAMES) < 0)
+        goto END;
+    if (sinkOpen(&b.astSink[0], &benchSinkOps, "null", &info) < 0)
+        goto END;
+    if (sinkOpen(&b.astSink[1], &benchKeySinkOps, "null", &info) < 0) {
+        sinkClose(&b.astSink[0]);
+        goto END;
+    }
+    if (benchStartVenc(&b) < 0)
+        goto SINKS;
+
+    gCounted = 1;
+    gCount = 1;
+    if (reactorAddFd(&b.stReactor, HI_MPI_VENC_GetFd(b.VencChn), EPOLLIN, benchVencHandler, &b) < 0 ||
+        reactorAddTimer(&b.stReactor, 100, benchTimerHandler, &b) < 0) {
+        b.error = 1;
+    } else {
+        reactorRun(&b.stReactor);
+    }
+    gCount = 0;
+    gCounted = 0;
+
+    HI_MPI_VENC_StopRecvPic(b.VencChn);
+    HI_MPI_VENC_DestroyChn(b.VencChn);
+SINKS:
+    for (i = 0; i < 2; i++)
+        sinkClose(&b.astSink[i]);
+
+    if (!b.error) {
+        printf("{\"version\":\"%s\",\"case\":\"venc_pull\",\"stream\":\"%s\",\"warmup\":%u,"
+               "\"warmup_allocs\":%llu,\"frames\":%u,\"bytes\":%llu,\"dropped\":%u,\"ns_per_frame\":%.1f,"
+               "\"allocs\":%llu}\n",
+               BENCH_VERSION, input == path ? "built-in" : input, b.u32CheckFrom,
+               (unsigned long long)b.u64WarmupAllocs, b.u32Checked,
+               (unsigned long long)b.u64Bytes, b.u32Dropped, (double)b.u64Ns / (double)b.u32Checked,
+               (unsigned long long)gAllocs);
+        if (gAllocs) {
+            printf("%llu allocations in the steady state, the first of %zu bytes.\n",
+                   (unsigned long long)gAllocs, (size_t)gFirstSize);
+        } else {
+            ret = 0;
+        }
+    }
+
+END:
+    reactorDestroy(&b.stReactor);
+    framePoolDestroy(&b.stFramePool);
+    SAMPLE_COMM_VENC_PackPoolDeInit(&b.stPackPool);
+INPUT:
+    if (input == path)
+        unlink(path);
+    return ret;
+}
@@ -109,6 +109,8 @@ extern "C" {
 #define SAMPLE_AUDIO_AO_DEV 0
 #define SAMPLE_AUDIO_PTNUMPERFRM   320
 
+#define SAMPLE_VENC_MAX_PACKS   16   /* sps/pps/sei + slices of one frame */
+
 #define VI_MST_NOTPASS_WITH_VALUE_RETURN(s32TempRet) \
     do{\
         NOT_PASS(s32TempRet);\
@@ -252,6 +254,13 @@ typedef struct sample_venc_getstream_s
     HI_S32  s32Cnt;
 } SAMPLE_VENC_GETSTREAM_PARA_S;
 
+/* preallocated pack nodes of one venc channel, grows only if a frame has more packs */
+typedef struct sample_venc_pack_pool_s
+{
+    VENC_PACK_S* pstPack;
+    HI_U32 u32Size;
+} SAMPLE_VENC_PACK_POOL_S;
+
 typedef struct sample_vi_config_s
 {
     SAMPLE_VI_MODE_E enViMode;
@@ -355,9 +364,13 @@ HI_S32 SAMPLE_COMM_VENC_StopGetStream();
 HI_S32 SAMPLE_COMM_VENC_BindVpss(VENC_CHN VencChn, VPSS_GRP VpssGrp, VPSS_CHN VpssChn);
 HI_S32 SAMPLE_COMM_VENC_UnBindVpss(VENC_CHN VencChn, VPSS_GRP VpssGrp, VPSS_CHN VpssChn);
 HI_S32 SAMPLE_COMM_VENC_StartGetStream_Svc_t(HI_S32 s32Cnt);
+HI_S32 SAMPLE_COMM_VENC_PackPoolInit(SAMPLE_VENC_PACK_POOL_S* pstPool, HI_U32 u32Size);
+VENC_PACK_S* SAMPLE_COMM_VENC_PackPoolGet(SAMPLE_VENC_PACK_POOL_S* pstPool, HI_U32 u32Packs);
+HI_VOID SAMPLE_COMM_VENC_PackPoolDeInit(SAMPLE_VENC_PACK_POOL_S* pstPool);
 
 
 HI_S32 SAMPLE_COMM_VDA_MdStart(VDA_CHN VdaChn, HI_U32 u32Chn, SIZE_S* pstSize);
+HI_S32 SAMPLE_COMM_VDA_MdCreate(VDA_CHN VdaChn, HI_U32 u32Chn, SIZE_S* pstSize);
 HI_S32 SAMPLE_COMM_VDA_OdStart(VDA_CHN VdaChn, HI_U32 u32Chn, SIZE_S* pstSize);
 HI_VOID SAMPLE_COMM_VDA_MdStop(VDA_CHN VdaChn, HI_U32 u32Chn);
 HI_VOID SAMPLE_COMM_VDA_OdStop(VDA_CHN VdaChn, HI_U32 u32Chn);
@@ -37,7 +37,7 @@ extern "C" {
 #endif
 
 #define AUDIO_ADPCM_TYPE ADPCM_TYPE_DVI4/* ADPCM_TYPE_IMA, ADPCM_TYPE_DVI4*/
-#define G726_BPS MEDIA_G726_40K         /* MEDIA_G726_16K, MEDIA_G726_24K ... */
+#define G726_BPS G726_32K               /* RTP packing of RFC 3551, MEDIA_G726_xxK for ASF */
 
 typedef struct tagSAMPLE_AENC_S
 {
@@ -429,7 +429,9 @@ HI_S32 SAMPLE_INNER_CODEC_CfgAudio(AUDIO_SAMPLE_RATE_E enSample)
 /* config codec */
 HI_S32 SAMPLE_COMM_AUDIO_CfgAcodec(AIO_ATTR_S* pstAioAttr)
 {
+#if defined(HI_ACODEC_TYPE_AK7756) || defined(HI_ACODEC_TYPE_INNER) || defined(HI_ACODEC_TYPE_TLV320AIC31)
     HI_S32 s32Ret = HI_SUCCESS;
+#endif
     HI_BOOL bCodecCfg = HI_FALSE;
 #ifdef HI_ACODEC_TYPE_AK7756
     /*** ACODEC_TYPE_AK7756EN ***/
@@ -113,7 +113,7 @@ HI_S32 SAMPLE_COMM_VDA_MdPrtSad(FILE* fp, VDA_DATA_S* pstVdaData)
 
     for (i = 0; i < pstVdaData->u32MbHeight; i++)
     {
-        pAddr = (HI_VOID*)((HI_U32)pstVdaData->unData.stMdData.stMbSadData.pAddr
+        pAddr = (HI_VOID*)((HI_U8 *)pstVdaData->unData.stMdData.stMbSadData.pAddr
                            + i * pstVdaData->unData.stMdData.stMbSadData.u32Stride);
 
         for (j = 0; j < pstVdaData->u32MbWidth; j++)
@@ -305,9 +305,10 @@ HI_VOID* SAMPLE_COMM_VDA_OdGetResult(HI_VOID* pdata)
 }
 
 /******************************************************************************
-* funciton : start vda MD mode
+* funciton : start vda MD mode without the result thread, the caller gets the
+*            results from HI_MPI_VDA_GetFd
 ******************************************************************************/
-HI_S32 SAMPLE_COMM_VDA_MdStart(VDA_CHN VdaChn, HI_U32 u32Chn, SIZE_S* pstSize)
+HI_S32 SAMPLE_COMM_VDA_MdCreate(VDA_CHN VdaChn, HI_U32 u32Chn, SIZE_S* pstSize)
 {
     HI_S32 s32Ret = HI_SUCCESS;
     VDA_CHN_ATTR_S stVdaChnAttr;
@@ -364,6 +365,23 @@ HI_S32 SAMPLE_COMM_VDA_MdStart(VDA_CHN VdaChn, HI_U32 u32Chn, SIZE_S* pstSize)
         SAMPLE_PRT("err!\n");
         return s32Ret;
     }
+
+    return HI_SUCCESS;
+}
+
+/******************************************************************************
+* funciton : start vda MD mode
+******************************************************************************/
+HI_S32 SAMPLE_COMM_VDA_MdStart(VDA_CHN VdaChn, HI_U32 u32Chn, SIZE_S* pstSize)
+{
+    HI_S32 s32Ret;
+
+    s32Ret = SAMPLE_COMM_VDA_MdCreate(VdaChn, u32Chn, pstSize);
+    if (s32Ret != HI_SUCCESS)
+    {
+        return s32Ret;
+    }
+
     /* step 4: create thread to get result */
     gs_stMdParam.bThreadStart = HI_TRUE;
     gs_stMdParam.VdaChn   = VdaChn;
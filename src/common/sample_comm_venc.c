@@ -589,7 +589,6 @@ HI_S32 SAMPLE_COMM_VENC_SaveMJpeg(FILE* fpMJpegFile, VENC_STREAM_S* pstStream)
     {
         pstData = &pstStream->pstPack[i];
         fwrite(pstData->pu8Addr + pstData->u32Offset, pstData->u32Len - pstData->u32Offset, 1, fpMJpegFile);
-        fflush(fpMJpegFile);
     }
 
     return HI_SUCCESS;
@@ -607,7 +606,6 @@ HI_S32 SAMPLE_COMM_VENC_SaveJpeg(FILE* fpJpegFile, VENC_STREAM_S* pstStream)
     {
         pstData = &pstStream->pstPack[i];
         fwrite(pstData->pu8Addr + pstData->u32Offset, pstData->u32Len - pstData->u32Offset, 1, fpJpegFile);
-        fflush(fpJpegFile);
     }
 
     return HI_SUCCESS;
@@ -625,8 +623,6 @@ HI_S32 SAMPLE_COMM_VENC_SaveH264(FILE* fpH264File, VENC_STREAM_S* pstStream)
     {
         fwrite(pstStream->pstPack[i].pu8Addr + pstStream->pstPack[i].u32Offset,
                pstStream->pstPack[i].u32Len - pstStream->pstPack[i].u32Offset, 1, fpH264File);
-
-        fflush(fpH264File);
     }
 
 
@@ -644,8 +640,6 @@ HI_S32 SAMPLE_COMM_VENC_SaveH265(FILE* fpH265File, VENC_STREAM_S* pstStream)
     {
         fwrite(pstStream->pstPack[i].pu8Addr + pstStream->pstPack[i].u32Offset,
                pstStream->pstPack[i].u32Len - pstStream->pstPack[i].u32Offset, 1, fpH265File);
-
-        fflush(fpH265File);
     }
 
     return HI_SUCCESS;
@@ -663,7 +657,6 @@ HI_S32 SAMPLE_COMM_VENC_SaveJPEG(FILE* fpJpegFile, VENC_STREAM_S* pstStream)
     {
         pstData = &pstStream->pstPack[i];
         fwrite(pstData->pu8Addr + pstData->u32Offset, pstData->u32Len - pstData->u32Offset, 1, fpJpegFile);
-        fflush(fpJpegFile);
     }
 
     return HI_SUCCESS;
@@ -1729,6 +1722,53 @@ HI_S32 SAMPLE_COMM_VENC_SnapProcess(VENC_CHN VencChn, HI_BOOL bSaveJpg, HI_BOOL
     return HI_SUCCESS;
 }
 
+/******************************************************************************
+* funciton : alloc pack nodes of one channel once, instead of per frame
+******************************************************************************/
+HI_S32 SAMPLE_COMM_VENC_PackPoolInit(SAMPLE_VENC_PACK_POOL_S* pstPool, HI_U32 u32Size)
+{
+    pstPool->pstPack = (VENC_PACK_S*)malloc(sizeof(VENC_PACK_S) * u32Size);
+    if (NULL == pstPool->pstPack)
+    {
+        SAMPLE_PRT("malloc stream pack pool failed!\n");
+        pstPool->u32Size = 0;
+        return HI_FAILURE;
+    }
+    pstPool->u32Size = u32Size;
+
+    return HI_SUCCESS;
+}
+
+/******************************************************************************
+* funciton : get pack nodes for one frame, only reallocs if the frame has
+*            more packs than ever seen (e.g. slice mode), never shrinks
+******************************************************************************/
+VENC_PACK_S* SAMPLE_COMM_VENC_PackPoolGet(SAMPLE_VENC_PACK_POOL_S* pstPool, HI_U32 u32Packs)
+{
+    VENC_PACK_S* pstPack;
+
+    if (u32Packs > pstPool->u32Size)
+    {
+        SAMPLE_PRT("pack pool grows from %u to %u!\n", pstPool->u32Size, u32Packs);
+        pstPack = (VENC_PACK_S*)realloc(pstPool->pstPack, sizeof(VENC_PACK_S) * u32Packs);
+        if (NULL == pstPack)
+        {
+            return NULL;
+        }
+        pstPool->pstPack = pstPack;
+        pstPool->u32Size = u32Packs;
+    }
+
+    return pstPool->pstPack;
+}
+
+HI_VOID SAMPLE_COMM_VENC_PackPoolDeInit(SAMPLE_VENC_PACK_POOL_S* pstPool)
+{
+    free(pstPool->pstPack);
+    pstPool->pstPack = NULL;
+    pstPool->u32Size = 0;
+}
+
 /******************************************************************************
 * funciton : get stream from each channels and save them
 ******************************************************************************/
@@ -1750,9 +1790,11 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc(HI_VOID* p)
     HI_S32 s32Ret;
     VENC_CHN VencChn;
     PAYLOAD_TYPE_E enPayLoadType[VENC_MAX_CHN_NUM];
+    SAMPLE_VENC_PACK_POOL_S astPool[VENC_MAX_CHN_NUM];
 
     pstPara = (SAMPLE_VENC_GETSTREAM_PARA_S*)p;
     s32ChnTotal = pstPara->s32Cnt;
+    memset(astPool, 0, sizeof(astPool));
 
     /******************************************
      step 1:  check & prepare save-file & venc-fd
@@ -1803,6 +1845,12 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc(HI_VOID* p)
         {
             maxfd = VencFd[i];
         }
+
+        if (HI_SUCCESS != SAMPLE_COMM_VENC_PackPoolInit(&astPool[i], SAMPLE_VENC_MAX_PACKS))
+        {
+            s32ChnTotal = i + 1;    /* close the files & free the pools of chn 0..i */
+            goto END_GETSTREAM;
+        }
     }
 
     /******************************************
@@ -1860,12 +1908,12 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc(HI_VOID* p)
 						  continue;
 					}
                     /*******************************************************
-                     step 2.3 : malloc corresponding number of pack nodes.
+                     step 2.3 : take pack nodes from the channel pool.
                     *******************************************************/
-                    stStream.pstPack = (VENC_PACK_S*)malloc(sizeof(VENC_PACK_S) * stStat.u32CurPacks);
+                    stStream.pstPack = SAMPLE_COMM_VENC_PackPoolGet(&astPool[i], stStat.u32CurPacks);
                     if (NULL == stStream.pstPack)
                     {
-                        SAMPLE_PRT("malloc stream pack failed!\n");
+                        SAMPLE_PRT("get stream pack failed!\n");
                         break;
                     }
 
@@ -1876,8 +1924,6 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc(HI_VOID* p)
                     s32Ret = HI_MPI_VENC_GetStream(i, &stStream, HI_TRUE);
                     if (HI_SUCCESS != s32Ret)
                     {
-                        free(stStream.pstPack);
-                        stStream.pstPack = NULL;
                         SAMPLE_PRT("HI_MPI_VENC_GetStream failed with %#x!\n", \
                                    s32Ret);
                         break;
@@ -1889,8 +1935,6 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc(HI_VOID* p)
                     s32Ret = SAMPLE_COMM_VENC_SaveStream(enPayLoadType[i], pFile[i], &stStream);
                     if (HI_SUCCESS != s32Ret)
                     {
-                        free(stStream.pstPack);
-                        stStream.pstPack = NULL;
                         SAMPLE_PRT("save stream failed!\n");
                         break;
                     }
@@ -1900,26 +1944,21 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc(HI_VOID* p)
                     s32Ret = HI_MPI_VENC_ReleaseStream(i, &stStream);
                     if (HI_SUCCESS != s32Ret)
                     {
-                        free(stStream.pstPack);
-                        stStream.pstPack = NULL;
                         break;
                     }
-                    /*******************************************************
-                     step 2.7 : free pack nodes
-                    *******************************************************/
-                    free(stStream.pstPack);
-                    stStream.pstPack = NULL;
                 }
             }
         }
     }
 
+END_GETSTREAM:
     /*******************************************************
-    * step 3 : close save-file
+    * step 3 : close save-file & free pack pool
     *******************************************************/
     for (i = 0; i < s32ChnTotal; i++)
     {
         fclose(pFile[i]);
+        SAMPLE_COMM_VENC_PackPoolDeInit(&astPool[i]);
     }
 
     return NULL;
@@ -1949,9 +1988,11 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc_Svc_t(void* p)
     HI_S32 s32Ret;
     VENC_CHN VencChn;
     PAYLOAD_TYPE_E enPayLoadType[VENC_MAX_CHN_NUM];
+    SAMPLE_VENC_PACK_POOL_S astPool[VENC_MAX_CHN_NUM];
 
     pstPara = (SAMPLE_VENC_GETSTREAM_PARA_S*)p;
     s32ChnTotal = pstPara->s32Cnt;
+    memset(astPool, 0, sizeof(astPool));
 
     /******************************************
      step 1:  check & prepare save-file & venc-fd
@@ -2006,6 +2047,12 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc_Svc_t(void* p)
         {
             maxfd = VencFd[i];
         }
+
+        if (HI_SUCCESS != SAMPLE_COMM_VENC_PackPoolInit(&astPool[i], SAMPLE_VENC_MAX_PACKS))
+        {
+            s32ChnTotal = i + 1;    /* close the files & free the pools of chn 0..i */
+            goto END_GETSTREAM;
+        }
     }
 
     /******************************************
@@ -2064,12 +2111,12 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc_Svc_t(void* p)
 						  continue;
 					}
                     /*******************************************************
-                     step 2.3 : malloc corresponding number of pack nodes.
+                     step 2.3 : take pack nodes from the channel pool.
                     *******************************************************/
-                    stStream.pstPack = (VENC_PACK_S*)malloc(sizeof(VENC_PACK_S) * stStat.u32CurPacks);
+                    stStream.pstPack = SAMPLE_COMM_VENC_PackPoolGet(&astPool[i], stStat.u32CurPacks);
                     if (NULL == stStream.pstPack)
                     {
-                        SAMPLE_PRT("malloc stream pack failed!\n");
+                        SAMPLE_PRT("get stream pack failed!\n");
                         break;
                     }
 
@@ -2080,8 +2127,6 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc_Svc_t(void* p)
                     s32Ret = HI_MPI_VENC_GetStream(i, &stStream, HI_TRUE);
                     if (HI_SUCCESS != s32Ret)
                     {
-                        free(stStream.pstPack);
-                        stStream.pstPack = NULL;
                         SAMPLE_PRT("HI_MPI_VENC_GetStream failed with %#x!\n", \
                                    s32Ret);
                         break;
@@ -2121,8 +2166,6 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc_Svc_t(void* p)
 
                         if (HI_SUCCESS != s32Ret)
                         {
-                            free(stStream.pstPack);
-                            stStream.pstPack = NULL;
                             SAMPLE_PRT("save stream failed!\n");
                             break;
                         }
@@ -2169,8 +2212,6 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc_Svc_t(void* p)
                     }
                     if (HI_SUCCESS != s32Ret)
                     {
-                        free(stStream.pstPack);
-                        stStream.pstPack = NULL;
                         SAMPLE_PRT("save stream failed!\n");
                         break;
                     }
@@ -2181,22 +2222,16 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc_Svc_t(void* p)
                     s32Ret = HI_MPI_VENC_ReleaseStream(i, &stStream);
                     if (HI_SUCCESS != s32Ret)
                     {
-                        free(stStream.pstPack);
-                        stStream.pstPack = NULL;
                         break;
                     }
-                    /*******************************************************
-                     step 2.7 : free pack nodes
-                    *******************************************************/
-                    free(stStream.pstPack);
-                    stStream.pstPack = NULL;
                 }
             }
         }
     }
 
+END_GETSTREAM:
     /*******************************************************
-     step 3 : close save-file
+     step 3 : close save-file & free pack pool
     *******************************************************/
     for (i = 0; i < s32ChnTotal; i++)
     {
@@ -2207,6 +2242,7 @@ HI_VOID* SAMPLE_COMM_VENC_GetVencStreamProc_Svc_t(void* p)
                 fclose(pFile[i + s32Cnt]);
             }
         }
+        SAMPLE_COMM_VENC_PackPoolDeInit(&astPool[i]);
     }
 
     return NULL;
@@ -15,58 +15,364 @@ extern "C" {
 #include <unistd.h>
 #include <pthread.h>
 #include <signal.h>
+#include <sys/signalfd.h>
+#include <fcntl.h>
 #include <arpa/inet.h>
 
 #include "sample_comm.h"
 #include "Utils.h"
+#include "Media.h"
 #include "RTP.h"
 #include "Network.h"
+#include "Reactor.h"
+#include "Frame.h"
+#include "Sink.h"
+#include "MP4.h"
+#include "Record.h"
+#include "Loop.h"
+#include "Event.h"
+#include "Replay.h"
+#include "ShmBus.h"
+#include "RTPRecv.h"
+#include "JitterBuffer.h"
+#include "Roi.h"
+#include "Snap.h"
 
 
 /************ Global Variables ************/
 
+/* run modes can be combined, e.g. -m file,rtp */
 typedef enum {
-    MODE_FILE,
-    MODE_RTP,
-    MODE_RTSP
+    MODE_FILE = 0x1,
+    MODE_RTP  = 0x2,
+    MODE_RTSP = 0x4,
+    MODE_ES   = 0x8,    // raw .h264/.h265 elementary stream
+    MODE_LOOP = 0x10,   // loop recording on a ring of preallocated segments
+    MODE_EVENT = 0x20,  // record around motion or SIGUSR1 triggers
+    MODE_SHM  = 0x40    // shared memory bus for local processes
 }RunMode;
 
+#define HILI_SINK_MAX   9
+#define HILI_RTP_VIEWER_MAX 4   // -i, rtp sinks of the video
+#define HILI_STAT_TICKS 15      // watchdog ticks between statistics
+#define HILI_SHM_BUS    "venc0"     // /dev/shm/hisilive.venc0, see ShmBus.h
+
+#define HILI_RTP_PORT   1234        // video, rtcp on the next port
+#define HILI_AUDIO_PORT 1236        // audio, rtcp on the next port
+#define HILI_SDP_FILE   "hisilive.sdp"
+
+#define HILI_AUDIO_PTNUM    160     // samples per aenc frame, 20 ms at 8 kHz, the default ptime of RFC 3551
+#define HILI_AUDIO_PTIME    20      // ms of audio per rtp packet, -a format,ptime
+#define HILI_TALK_BATCH     32      // packets read per talkback socket event
+#define HILI_CAPTURE_EXT_ID 1       // rtp header extension id of abs-capture-time
+
+#define HILI_MD_VPSS_CHN    1   // small picture for motion detection, VDA is at most 960x960
+#define HILI_SUB_VPSS_CHN   2   // -u, picture of the simulcast sub stream
+#define HILI_SUB_VENC_CHN   1
+#define HILI_MD_VDA_CHN     0
+
+#define HILI_ROI_MARGIN     16          // -q, pixels around a moving region encoded at its qp too
+#define HILI_ROI_INTERVAL_US 500000     // regions reconfigured at most so often
+#define HILI_ROI_HOLD_US    2000000     // and made smaller only after they were too large so long
+
+#define HILI_SNAP_VENC_CHN  2           // -j, jpeg snapshots of the main picture
+#define HILI_SNAP_MAX_AGE_MS 1000       // -j fps 0, a snapshot is served for so long, then taken on request
+#define HILI_SNAP_LOST_US   1000000     // a picture asked for and not got so long is asked for again
+#define HILI_SNAP_PACK_MAX  16
+
+#define HILI_SLICE_MAX      16  // -l, slices per frame
+#define HILI_H265_LCU       64  // h.265 slices are split by lcu lines
+
+#define HILI_REFRESH_GOP    65536   // -k, the longest gop the rc takes, IDRs come on request
+#define HILI_IDR_GAP_US     500000  // requested IDRs at most so often
+#define HILI_LOOP_GOPS      4       // -z, 2 s GOPs at the bit rate a loop segment holds at least
+#define HILI_EVENT_PRE_MAX  30      // -w, s of pre-roll held in RAM at most
+#define HILI_EVENT_GOP      30      // frames of the periodic GOP, PAL 25, NTSC 30
+
+#define HILI_HOLD_MAX       (SINK_QUEUE_SIZE * 2)   // venc streams got and not released yet
+#define HILI_HOLD_TIGHT     4   // copy instead of borrow while less than 1/4 of the stream buffer is free
+
+/* low rate encoding while the scene is static */
+typedef struct {
+    HI_BOOL bStatic;
+    HI_U64 u64LastMotion;   // us, monotonic
+    HI_U64 u64StateStart;
+    HI_U64 au64Bytes[2];    // encoded bytes, [0] full rate, [1] static
+    HI_U64 au64Us[2];       // time spent in each state
+    VENC_CHN_ATTR_S stFullAttr; // restored on motion
+}MotionGate;
+
+/* one venc stream got, its packs stay valid until it is released */
+typedef struct {
+    VENC_STREAM_S stStream;
+    SAMPLE_VENC_PACK_POOL_S stPackPool;
+    HI_U32 u32Bytes;
+    HI_BOOL bDone;          // no frame points into it any more
+    struct VencStreamHold *pstHold;
+}VencHeldStream;
+
+/*
+ * Frames borrowed from the venc stream buffer instead of copied. Venc wants the streams
+ * back in the order they were got, so every stream goes through this queue, copied ones
+ * are done at once, borrowed ones when the last sink unrefs the frame.
+ */
+typedef struct VencStreamHold {
+    pthread_mutex_t lock;
+    VencHeldStream astStream[HILI_HOLD_MAX];
+    HI_U32 u32Head;
+    HI_U32 u32Count;
+    HI_U32 u32HeldBytes;    // got and not released
+    VENC_CHN VencChn;
+    VENC_STREAM_BUF_INFO_S stBufInfo;   // u32BufSize 0: copy every frame
+    HI_BOOL bPaused;        // venc fd is off while the queue is full
+    ReactorContext *pstReactor;
+    HI_S32 VencFd;
+    HI_U32 u32Borrowed;     // statistics since the last report
+    HI_U32 u32Copied;
+    HI_U32 u32Tight;        // copied because the stream buffer was getting full
+}VencStreamHold;
+
+typedef struct VencChnContext {
+    VENC_CHN VencChn;
+    HI_S32 VencFd;
+    HI_S32 TimerFd;
+    HI_U32 u32FrameCnt;    // frames got since last watchdog check
+    HI_U32 u32Ticks;
+    HI_U32 u32MaxStallUs;  // worst time spent in the pull handler
+    VencStreamHold stHold;
+    FramePool stFramePool;
+    Sink astSink[HILI_SINK_MAX];
+    HI_S32 s32SinkNum;
+    struct VencChnContext *pstSinks;    // whose sinks get the frames, the main chn for the sub stream
+    HI_S32 s32Stream;       // MediaFrame.stream, 1 the simulcast sub stream
+    HI_S32 VdaFd;           // md results, dispatched by the reactor
+    MotionGate stGate;
+    RoiPlanner stRoi;       // -q, the regions of the vda results
+    HI_U32 u32RoiFailed;    // region configs the venc didn't take
+    HI_S64 s64PtsOffset;    // monotonic us - venc pts us, for the capture time of a frame
+    HI_BOOL bBorrow;        // some sinks take frames pointing into the venc stream buffer
+    HI_BOOL bSliceMode;     // the venc gives one slice at a time, -l
+    HI_U32 u32AuSlices;     // slices of the current access unit got so far
+    MediaFrame *pstAuFrame; // the current access unit collected for the sinks not taking slices
+    HI_U32 u32SeiFailed;    // capture time SEIs the venc didn't take, -c 2
+    HI_U32 u32AuBytes;      // of the access unit so far
+    HI_U64 u64StatBytes;    // frame sizes since the last report
+    HI_U32 u32StatFrames;
+    HI_U32 u32PeakBytes;
+    HI_BOOL bIdrWanted;     // SIGUSR2 or a request put off by HILI_IDR_GAP_US
+    HI_U64 u64LastIdrUs;
+    HI_U32 u32IdrRequests;  // since the last report
+    HI_BOOL bAuKey;
+    HI_U64 u64LastPts;
+    HI_U32 u32SuperFrames;  // over the -p threshold, since the last report
+    HI_U32 u32MissingFrames;    // estimated from gaps in the pts at the nominal rate
+}VencChnContext;
+
+/*
+ * Audio of the rtp mode, aenc frames are put into packets of the ptime and sent from
+ * the reactor thread, small enough not to need a sink queue. The aenc pts and the venc pts are both taken
+ * from the system pts, so one sender report per stream lets receivers line them up.
+ */
+typedef struct {
+    AUDIO_DEV AiDev;
+    AI_CHN AiChn;
+    AENC_CHN AeChn;
+    HI_S32 AencFd;
+    PAYLOAD_TYPE_E enType;
+    HI_U32 u32Rate;         // samples per second, the rtp clock too
+    HI_U32 u32PtNum;        // samples per frame
+    HI_U32 u32Aggregate;    // aenc frames per rtp packet, ptime / frame time
+    HI_U8 au8Packet[RTP_PAYLOAD_MAX];   // frames waiting for the rest of the packet
+    HI_U32 u32PacketLen;
+    HI_U32 u32PacketFrames;
+    HI_U32 u32PacketTs;     // timestamp of the first sample in the packet
+    HI_U64 u64PacketPts;    // pts of the first frame, us
+    HI_U64 u64PacketGot;    // monotonic us the first frame was got
+    HI_U32 u32NextTs;       // timestamp the next frame is expected at
+    HI_S32 s32Mark;         // marker bit for the next packet
+    RTPMuxContext stRtp;
+    UDPContext stUdp;
+    UDPContext stRtcp;
+    HI_S64 s64PtsOffset;    // monotonic us - aenc pts us
+    HI_BOOL bStarted;       // a packet was sent, the timestamp counts on from it
+    HI_U64 u64LastSr;
+    HI_U32 u32Frames;
+    HI_U32 u32Resyncs;      // timestamp taken from the pts again, aenc frames were lost
+    HI_U32 u32Packets;      // the latency added by aggregation, the rest is capture and encoding
+    HI_U64 u64HoldUs;       // first frame got until its packet is sent, summed
+    HI_U32 u32MaxHoldUs;
+    HI_U64 u64SendUs;       // first sample captured until its packet is sent, summed
+    HI_U32 u32MaxSendUs;
+}AudioChnContext;
+
+/*
+ * Talkback, rtp audio of a client played on the ao. Packets go into a jitter buffer from
+ * the socket handler, a timer every frame time takes out what was played meanwhile and
+ * hands it to adec without blocking, both in the reactor.
+ */
+typedef struct {
+    AUDIO_DEV AoDev;
+    AO_CHN AoChn;
+    ADEC_CHN AdChn;
+    PAYLOAD_TYPE_E enType;
+    HI_S32 s32Pt;           // rtp payload type taken
+    HI_U32 u32Rate;
+    HI_S32 SockFd;
+    HI_S32 TimerFd;
+    JitterBuffer stJb;
+    HI_U64 u64LastTick;
+    HI_S64 s64Credit;       // samples played by the ao since the last tick, due from the buffer
+    HI_U32 u32Seq;
+    HI_U8 au8Frame[4 + JB_PAYLOAD_MAX];     // hisi frame header and payload for adec
+    HI_U32 u32Invalid;      // not rtp or another payload type
+    HI_U32 u32AdecFull;     // frames adec didn't take
+}TalkChnContext;
+
+/*
+ * -j, JPEG snapshots for pollers. A jpeg chn on the main picture encodes one picture at a time
+ * (StartRecvPicEx), every 1/fps or when a request finds the latest one older than
+ * HILI_SNAP_MAX_AGE_MS, and its stream is copied into the snapshot server, which serves
+ * all the pollers from memory. All in the reactor.
+ */
+typedef struct {
+    VENC_CHN VencChn;
+    HI_S32 VencFd;
+    HI_S32 TimerFd;         // every 1/fps, -1 on request
+    HI_BOOL bStarted;
+    HI_BOOL bRecv;          // a picture was asked for and not got yet
+    HI_U64 u64AskedUs;
+    SnapServer stServer;
+    HI_U32 u32Encodes;
+    HI_U32 u32Late;         // still coming when the next one was due, not asked for again
+    HI_U32 u32Lost;         // not got in HILI_SNAP_LOST_US
+    HI_U32 u32Failed;       // StartRecvPicEx or GetStream failed
+    HI_U64 u64EncodeUs;     // asked until got, summed
+    HI_U32 u32MaxEncodeUs;
+}SnapChnContext;
+
+typedef struct {
+    int holdSeconds;    // no motion for so long: static, 0 disables gating
+    int frameRate;      // fps while static
+    int bitRate;        // kbps while static
+}GateOption;
+
+typedef struct {
+    int qp;             // relative qp of the moving regions, 0 no roi
+    int bgFrameRate;    // fps of the rest while there are regions, 0 full rate
+}RoiOption;
+
+typedef struct {
+    int port;           // tcp port of the http server, 0 off
+    int frameRate;      // snapshots per second, 0 on request
+    int quality;        // jpeg qfactor 1-99, 0 the chip default
+}SnapOption;
+
+typedef struct {
+    VENC_SUPERFRM_MODE_E mode;  // SUPERFRM_NONE off
+    int iKbit;          // an I frame larger than this is a super frame
+    int pKbit;
+}SuperFrameOption;
+
 typedef struct {
-    RunMode mode;  // -m
+    int mode;       // -m, RunMode bits
     int frameRate;  // -f
     int bitRate;    // -b
-    char ip[16];    // -i
+    char ip[16];    // -i, the first viewer, the audio goes there too
+    char viewerIp[HILI_RTP_VIEWER_MAX - 1][16];  // -i, more viewers of the video
+    int viewerNum;
     PAYLOAD_TYPE_E videoFormat;  // -e
     PIC_SIZE_E videoSize;   // -s
+    RecordConfig record;    // -y, -d
+    LoopConfig loop;        // -r, -z
+    EventConfig event;      // -w
+    GateOption gate;        // -g
+    RoiOption roi;          // -q
+    SnapOption snap;        // -j
+    SuperFrameOption superFrame;    // -p
+    char *replayFile;       // -x, replace the encoder by a recorded stream
+    double replaySpeed;     // -v
+    int replayLoops;
+    int slices;             // -l, slices per frame in low latency slice mode, 0 frame mode
+    PAYLOAD_TYPE_E audioFormat; // -a, PT_BUTT no audio
+    int audioPtime;         // -a, ms per rtp packet
+    int talkPort;           // -t, udp port of the talkback, 0 off
+    int captureTime;        // -c, 0 none, 1 rtp header extension, 2 also SEI
+    int refreshFrames;      // -k, intra refresh over so many frames, 0 periodic IDR
+    int layers;             // -n, svc-t temporal layers, 1 none
+    PIC_SIZE_E subSize;     // -u, simulcast sub stream, PIC_BUTT none
+    int subBitRate;         // -u, kbps
+    int talkMinMs;          // -t, jitter buffer delay range
+    int talkMaxMs;
 }ParamOption;
 
 /************ Global Variables ************/
 VIDEO_NORM_E gs_enNorm = VIDEO_ENCODING_MODE_NTSC;
 ParamOption gParamOption;
-RTPMuxContext gRTPCtx;
-UDPContext gUDPCtx;
+ReactorContext gReactor;
+VencChnContext gVencCtx;
+VencChnContext gSubVencCtx;
+AudioChnContext gAudioCtx;
+TalkChnContext gTalkCtx;
+SnapChnContext gSnapCtx;
 
 
 /************ Show Usage ************/
 void hiliShowUsage(char* sPrgNm)
 {
     printf("Usage : %s \n", sPrgNm);
-    printf("\t -m: mode: file/rtp, default file.\n");
+    printf("\t -m: mode: file(mp4)/es(raw h264/h265)/loop/event/rtp/shm, can be combined (file,rtp), default file.\n");
     printf("\t -e: vedeo decode format, default H.264.\n");
     printf("\t -f: frame rate, default 24 fps.\n");
     printf("\t -b: bitrate, default 1024 kbps.\n");
-    printf("\t -i: IP, default 192.168.1.100.\n");
+    printf("\t -i: IP[,IP...], rtp viewers, at most %d, the audio goes to the first, default 192.168.1.100.\n",
+           HILI_RTP_VIEWER_MAX);
+    printf("\t -u: size[,kbps], simulcast sub stream, each rtp viewer gets the main or the sub stream by its receiver reports,\n"
+           "\t     size as -s, default bitrate 1/4 of -b.\n");
+    printf("\t -n: svc-t temporal layers 1-3, each viewer gets as many as its receiver reports allow, default 1.\n");
     printf("\t -s: video size: 1080p/720p/D1/CIF, default 1080p\n");
+    printf("\t -y: record durability, fdatasync every n GOPs, 0 only at close, default 1.\n");
+    printf("\t -d: record with O_DIRECT 0/1, default 0.\n");
+    printf("\t -r: loop record segments, default 16.\n");
+    printf("\t -z: loop record segment size, default 64 MB.\n");
+    printf("\t -w: event record seconds before,after trigger (motion or SIGUSR1), before at most %d, default 5,10.\n",
+           HILI_EVENT_PRE_MAX);
+    printf("\t -x: replay a .h264/.h265 file instead of the encoder, no MPP needed.\n");
+    printf("\t -v: replay speed[,loops], 1 real time, 0 as fast as possible, loops 0 forever, default 1,1.\n");
+    printf("\t -l: low latency, slices per frame, each sent as soon as it is encoded, 0 frame mode, default 0.\n");
+    printf("\t -a: audio sent with rtp mode: g711a/g711u/g726/adpcm[,ptime 20/40/60/100 ms], default none,20.\n");
+    printf("\t -t: talkback, rtp audio received on udp port[,min,max jitter buffer ms] played out, codec of -a, default off,20,400.\n");
+    printf("\t -c: capture time of each frame: 0 none, 1 rtp abs-capture-time extension, 2 also SEI user data, default 1.\n");
+    printf("\t -k: intra refresh over frames, IDR only on request (new viewer, lost frames, SIGUSR2), rtp/shm only, default 0 (periodic IDR).\n");
+    printf("\t -p: super frame policy reencode|discard,I kbit,P kbit, rtp paced at the I threshold per frame time, default off.\n");
+    printf("\t -g: motion gating hold seconds[,fps,kbps], low rate after no motion for so long, default 0 (off),2,128.\n");
+    printf("\t -q: roi qp[,fps], up to %d moving regions encoded at this relative qp, the rest at fps, default 0 (off),full rate.\n",
+           ROI_MAX);
+    printf("\t -j: jpeg snapshots over http on tcp port[,fps,quality 1-99] at %s, fps 0 encodes one when a request finds\n"
+           "\t     the latest older than %d ms, default off,0,chip default.\n", SNAP_PATH, HILI_SNAP_MAX_AGE_MS);
     printf("Default parameters: %s -m file -e 96 -f 264 -b 1024 -s 1080p -i 192.168.1.100\n", sPrgNm);
     return;
 }
 
 /************ Parse Parameters ************/
+PIC_SIZE_E hiliParseSize(const char *pszSize){
+    if (!strcmp(pszSize, "1080p") || !strcmp(pszSize, "1080P")){
+        return PIC_HD1080;
+    } else if (!strcmp(pszSize, "720p") || !strcmp(pszSize, "720P")){
+        return PIC_HD720;
+    } else if (!strcmp(pszSize, "D1") || !strcmp(pszSize, "d1")){
+        return PIC_D1;
+    } else if (!strcmp(pszSize, "CIF") || !strcmp(pszSize, "cif")){
+        return PIC_CIF;
+    }
+    return PIC_BUTT;
+}
+
 int hiliParseParam(int argc, char**argv){
     int ret = 0, optIndex = 1;
     char *videoSize = "1080p";
     char *format = "H.264";
     char *mode = "file";
+    char modeList[32];
 
     if (argc % 2 == 0)
         return -1;
@@ -74,6 +380,33 @@ int hiliParseParam(int argc, char**argv){
     // init default parameters
     gParamOption.mode = MODE_FILE;
     gParamOption.frameRate = 24;    // fps
+    gParamOption.record.direct = 0;
+    gParamOption.record.syncGops = 1;
+    gParamOption.loop.segments = 16;
+    gParamOption.loop.segmentMB = 64;
+    gParamOption.event.preSeconds = 5;
+    gParamOption.event.postSeconds = 10;
+    gParamOption.event.maxKB = 8192;    // sized by -w, -f and -b
+    gParamOption.event.maxFrames = 192;
+    gParamOption.gate.holdSeconds = 0;
+    gParamOption.gate.frameRate = 2;
+    gParamOption.gate.bitRate = 128;
+    gParamOption.replayFile = NULL;
+    gParamOption.replaySpeed = 1.0;
+    gParamOption.replayLoops = 1;
+    gParamOption.slices = 0;
+    gParamOption.audioFormat = PT_BUTT;
+    gParamOption.audioPtime = HILI_AUDIO_PTIME;
+    gParamOption.talkPort = 0;
+    gParamOption.captureTime = 1;
+    gParamOption.refreshFrames = 0;
+    gParamOption.layers = 1;
+    gParamOption.viewerNum = 0;
+    gParamOption.subSize = PIC_BUTT;
+    gParamOption.subBitRate = 0;
+    gParamOption.superFrame.mode = SUPERFRM_NONE;
+    gParamOption.talkMinMs = 20;
+    gParamOption.talkMaxMs = 400;
     gParamOption.bitRate = 1024;    // kbps
     sprintf(gParamOption.ip, "%s", "192.168.1.100");
     gParamOption.videoSize = PIC_HD1080;
@@ -87,13 +420,28 @@ int hiliParseParam(int argc, char**argv){
         
         if (opt[0] == '-' && opt[1] == 'm' && !opt[2]){
             mode = argv[optIndex++];
-            if (!strcmp(mode, "file") || !strcmp(mode, "FILE")){
-                gParamOption.mode = MODE_FILE;
-            } else if (!strcmp(mode, "rtp") || !strcmp(mode, "RTP")){
-                gParamOption.mode = MODE_RTP;
-            } else {
-                printf("mode %s is invalid\n", mode);
-                ret = -1;
+            snprintf(modeList, sizeof(modeList), "%s", mode);
+            gParamOption.mode = 0;
+            for (str = strtok(modeList, ","); str && !ret; str = strtok(NULL, ",")) {
+                if (!strcmp(str, "file") || !strcmp(str, "FILE")){
+                    gParamOption.mode |= MODE_FILE;
+                } else if (!strcmp(str, "es") || !strcmp(str, "ES")){
+                    gParamOption.mode |= MODE_ES;
+                } else if (!strcmp(str, "loop") || !strcmp(str, "LOOP")){
+                    gParamOption.mode |= MODE_LOOP;
+                } else if (!strcmp(str, "event") || !strcmp(str, "EVENT")){
+                    gParamOption.mode |= MODE_EVENT;
+                } else if (!strcmp(str, "rtp") || !strcmp(str, "RTP")){
+                    gParamOption.mode |= MODE_RTP;
+                } else if (!strcmp(str, "shm") || !strcmp(str, "SHM")){
+                    gParamOption.mode |= MODE_SHM;
+                } else if (!strcmp(str, "rtsp") || !strcmp(str, "RTSP")){
+                    printf("mode rtsp is not supported yet\n");
+                    ret = -1;
+                } else {
+                    printf("mode %s is invalid\n", str);
+                    ret = -1;
+                }
             }
             continue;
         }
@@ -111,276 +459,2497 @@ int hiliParseParam(int argc, char**argv){
                 ret = -1;
             }
 
-            continue;
-        }
+            continue;
+        }
+
+        if (opt[0] == '-' && opt[1] == 'f' && !opt[2]){
+            val = atoi(argv[optIndex++]);
+            if (val <= 0 || val > 30){
+                printf("frameRate is not in (0, 30]\n");
+                ret = -1;
+            } else
+                gParamOption.frameRate = val;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'b' && !opt[2]){
+            val = atoi(argv[optIndex++]);
+            if (val <= 0 || val > 4096){
+                printf("bitRate is not in (0, 4096]\n");
+                ret = -1;
+            } else
+                gParamOption.bitRate = val;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'i' && !opt[2]){
+            char szList[HILI_RTP_VIEWER_MAX * 16];
+            HI_S32 s32Num = 0;
+            snprintf(szList, sizeof(szList), "%s", argv[optIndex++]);
+            gParamOption.viewerNum = 0;
+            for (str = strtok(szList, ","); str; str = strtok(NULL, ","), s32Num++) {
+                if (s32Num == HILI_RTP_VIEWER_MAX || strlen(str) > 15 || inet_addr(str) == INADDR_NONE){
+                    printf("IP %s is invalid or one too many.\n", str);
+                    ret = -1;
+                } else if (0 == s32Num)
+                    sprintf(gParamOption.ip, "%s", str);
+                else
+                    sprintf(gParamOption.viewerIp[gParamOption.viewerNum++], "%s", str);
+            }
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'n' && !opt[2]){
+            val = atoi(argv[optIndex++]);
+            if (val < 1 || val > 3){
+                printf("temporal layers is not in [1, 3]\n");
+                ret = -1;
+            } else
+                gParamOption.layers = val;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 's' && !opt[2]){
+            videoSize = argv[optIndex++];
+            gParamOption.videoSize = hiliParseSize(videoSize);
+            if (PIC_BUTT == gParamOption.videoSize){
+                printf("VedeoSize is invalid.\n");
+                ret = -1;
+            }
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'u' && !opt[2]){
+            snprintf(modeList, sizeof(modeList), "%s", argv[optIndex++]);
+            str = strchr(modeList, ',');
+            if (str){
+                *str++ = '\0';
+                gParamOption.subBitRate = atoi(str);
+            }
+            gParamOption.subSize = hiliParseSize(modeList);
+            if (PIC_BUTT == gParamOption.subSize || (str && gParamOption.subBitRate <= 0)){
+                printf("sub stream is invalid, use size[,kbps].\n");
+                ret = -1;
+            }
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'y' && !opt[2]){
+            val = atoi(argv[optIndex++]);
+            if (val < 0){
+                printf("sync GOPs is invalid.\n");
+                ret = -1;
+            } else
+                gParamOption.record.syncGops = val;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'd' && !opt[2]){
+            gParamOption.record.direct = atoi(argv[optIndex++]) ? 1 : 0;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'r' && !opt[2]){
+            val = atoi(argv[optIndex++]);
+            if (val <= 0 || val > LOOP_SEGMENT_MAX){
+                printf("loop segments is invalid.\n");
+                ret = -1;
+            } else
+                gParamOption.loop.segments = val;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'w' && !opt[2]){
+            int pre, post;
+            if (sscanf(argv[optIndex++], "%d,%d", &pre, &post) != 2 || pre < 0 || pre > HILI_EVENT_PRE_MAX || post < 0){
+                printf("event seconds is invalid, use before,after, before at most %d.\n", HILI_EVENT_PRE_MAX);
+                ret = -1;
+            } else {
+                gParamOption.event.preSeconds = pre;
+                gParamOption.event.postSeconds = post;
+            }
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'g' && !opt[2]){
+            GateOption gate = gParamOption.gate;
+            if (sscanf(argv[optIndex++], "%d,%d,%d", &gate.holdSeconds, &gate.frameRate, &gate.bitRate) < 1 ||
+                gate.holdSeconds < 0 || gate.frameRate <= 0 || gate.bitRate <= 0){
+                printf("motion gating is invalid, use seconds[,fps,kbps].\n");
+                ret = -1;
+            } else
+                gParamOption.gate = gate;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'q' && !opt[2]){
+            RoiOption roi = {0, 0};
+            if (sscanf(argv[optIndex++], "%d,%d", &roi.qp, &roi.bgFrameRate) < 1 ||
+                roi.qp < -20 || roi.qp > 20 || roi.bgFrameRate < 0){
+                printf("roi is invalid, use qp -20..20[,fps].\n");
+                ret = -1;
+            } else
+                gParamOption.roi = roi;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'j' && !opt[2]){
+            SnapOption snap = {0, 0, 0};
+            if (sscanf(argv[optIndex++], "%d,%d,%d", &snap.port, &snap.frameRate, &snap.quality) < 1 ||
+                snap.port <= 0 || snap.port > 65535 || snap.frameRate < 0 || snap.quality < 0 || snap.quality > 99){
+                printf("snapshot is invalid, use port[,fps,quality 1-99].\n");
+                ret = -1;
+            } else
+                gParamOption.snap = snap;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'x' && !opt[2]){
+            gParamOption.replayFile = argv[optIndex++];
+            str = strrchr(gParamOption.replayFile, '.');
+            if (str && (!strcmp(str, ".h265") || !strcmp(str, ".265") || !strcmp(str, ".hevc")))
+                gParamOption.videoFormat = PT_H265;
+            else if (str && (!strcmp(str, ".h264") || !strcmp(str, ".264")))
+                gParamOption.videoFormat = PT_H264;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'v' && !opt[2]){
+            if (sscanf(argv[optIndex++], "%lf,%d", &gParamOption.replaySpeed, &gParamOption.replayLoops) < 1 ||
+                gParamOption.replaySpeed < 0 || gParamOption.replayLoops < 0){
+                printf("replay speed is invalid, use speed[,loops].\n");
+                ret = -1;
+            }
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'c' && !opt[2]){
+            val = atoi(argv[optIndex++]);
+            if (val < 0 || val > 2){
+                printf("capture time is not in [0, 2]\n");
+                ret = -1;
+            } else
+                gParamOption.captureTime = val;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'p' && !opt[2]){
+            char szMode[16];
+            int iKbit, pKbit;
+            if (sscanf(argv[optIndex++], "%15[a-z],%d,%d", szMode, &iKbit, &pKbit) != 3 || iKbit <= 0 || pKbit <= 0 ||
+                iKbit > 100000 || pKbit > 100000){
+                printf("super frame policy is invalid, use reencode|discard,I kbit,P kbit.\n");
+                ret = -1;
+            } else if (!strcmp(szMode, "reencode")){
+                gParamOption.superFrame.mode = SUPERFRM_REENCODE;
+            } else if (!strcmp(szMode, "discard")){
+                gParamOption.superFrame.mode = SUPERFRM_DISCARD;
+            } else {
+                printf("super frame mode %s is not reencode or discard.\n", szMode);
+                ret = -1;
+            }
+            gParamOption.superFrame.iKbit = iKbit;
+            gParamOption.superFrame.pKbit = pKbit;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'k' && !opt[2]){
+            val = atoi(argv[optIndex++]);
+            if (val < 0 || val > 300){
+                printf("intra refresh frames is not in [0, 300]\n");
+                ret = -1;
+            } else
+                gParamOption.refreshFrames = val;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'l' && !opt[2]){
+            val = atoi(argv[optIndex++]);
+            if (val < 0 || val > HILI_SLICE_MAX){
+                printf("slices is not in [0, %d]\n", HILI_SLICE_MAX);
+                ret = -1;
+            } else
+                gParamOption.slices = val;
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'a' && !opt[2]){
+            snprintf(modeList, sizeof(modeList), "%s", argv[optIndex++]);
+            str = strchr(modeList, ',');
+            if (str){
+                *str++ = '\0';
+                val = atoi(str);
+                if (val != 20 && val != 40 && val != 60 && val != 100){
+                    printf("audio ptime is not 20/40/60/100 ms\n");
+                    ret = -1;
+                } else
+                    gParamOption.audioPtime = val;
+            }
+            str = modeList;
+            if (!strcmp(str, "g711a") || !strcmp(str, "G711A") || !strcmp(str, "pcma")){
+                gParamOption.audioFormat = PT_G711A;
+            } else if (!strcmp(str, "g711u") || !strcmp(str, "G711U") || !strcmp(str, "pcmu")){
+                gParamOption.audioFormat = PT_G711U;
+            } else if (!strcmp(str, "g726") || !strcmp(str, "G726")){
+                gParamOption.audioFormat = PT_G726;
+            } else if (!strcmp(str, "adpcm") || !strcmp(str, "ADPCM") || !strcmp(str, "dvi4")){
+                gParamOption.audioFormat = PT_ADPCMA;
+                if (gParamOption.audioPtime > 60){
+                    printf("adpcm ptime is at most 60 ms\n");
+                    ret = -1;
+                }
+            } else if (!strcmp(str, "aac") || !strcmp(str, "AAC")){
+                printf("aac needs an aac encoder library, this SDK has none.\n");
+                ret = -1;
+            } else {
+                printf("audio format %s is invalid.\n", str);
+                ret = -1;
+            }
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 't' && !opt[2]){
+            int port, minMs = gParamOption.talkMinMs, maxMs = gParamOption.talkMaxMs;
+            if (sscanf(argv[optIndex++], "%d,%d,%d", &port, &minMs, &maxMs) < 1 ||
+                port <= 0 || port > 65535 || minMs < 0 || maxMs < minMs || maxMs > 1000){
+                printf("talkback is invalid, use port[,min,max ms].\n");
+                ret = -1;
+            } else {
+                gParamOption.talkPort = port;
+                gParamOption.talkMinMs = minMs;
+                gParamOption.talkMaxMs = maxMs;
+            }
+            continue;
+        }
+
+        else if (opt[0] == '-' && opt[1] == 'z' && !opt[2]){
+            val = atoi(argv[optIndex++]);
+            if (val <= 0 || val > 2048){
+                printf("loop segment size is invalid.\n");
+                ret = -1;
+            } else
+                gParamOption.loop.segmentMB = val;
+            continue;
+        }
+
+        else {
+            printf("param [%s] is invalid.\n", opt);
+            ret = -1;
+        }
+    }
+
+    if (!ret && PT_BUTT != gParamOption.audioFormat &&
+        (!(gParamOption.mode & MODE_RTP) || gParamOption.replayFile)){
+        printf("audio is sent in rtp mode with the encoder only.\n");
+        ret = -1;
+    }
+    if (!ret && gParamOption.layers > 1 && gParamOption.replayFile){
+        printf("temporal layers are made by the encoder, not with replay.\n");
+        ret = -1;
+    }
+    if (!ret && SUPERFRM_NONE != gParamOption.superFrame.mode && gParamOption.replayFile){
+        printf("the super frame policy is for the encoder, not with replay.\n");
+        ret = -1;
+    }
+    if (!ret && gParamOption.refreshFrames && (gParamOption.replayFile || (gParamOption.mode & ~(MODE_RTP | MODE_SHM)))){
+        printf("intra refresh is for the rtp and shm modes of the encoder, recording needs periodic key frames.\n");
+        ret = -1;
+    }
+    if (!ret && PIC_BUTT != gParamOption.subSize &&
+        (!(gParamOption.mode & MODE_RTP) || gParamOption.replayFile || gParamOption.layers > 1)){
+        printf("the sub stream is for the rtp viewers of the encoder, not with replay or temporal layers.\n");
+        ret = -1;
+    }
+    if (!ret && PIC_BUTT != gParamOption.subSize && 0 == gParamOption.subBitRate){
+        gParamOption.subBitRate = gParamOption.bitRate / 4;
+    }
+    if (!ret && (gParamOption.mode & MODE_LOOP) &&
+        ((HI_U64)gParamOption.loop.segmentMB << 20) < (HI_U64)gParamOption.bitRate * 1000 / 8 * 2 * HILI_LOOP_GOPS){
+        printf("loop segment size is smaller than %d GOPs at %d kbps.\n", HILI_LOOP_GOPS, gParamOption.bitRate);
+        ret = -1;
+    }
+    if (!ret && gParamOption.roi.qp && gParamOption.replayFile){
+        printf("roi needs the motion detection of the mpp, not with replay.\n");
+        ret = -1;
+    }
+    if (!ret && gParamOption.roi.bgFrameRate >= gParamOption.frameRate){
+        gParamOption.roi.bgFrameRate = 0;
+    }
+    if (!ret && gParamOption.snap.port && gParamOption.replayFile){
+        printf("snapshots need the jpeg encoder of the mpp, not with replay.\n");
+        ret = -1;
+    }
+    if (!ret && gParamOption.snap.frameRate > gParamOption.frameRate){
+        gParamOption.snap.frameRate = gParamOption.frameRate;
+    }
+    if (!ret && gParamOption.talkPort && gParamOption.replayFile){
+        printf("talkback needs the mpp, not with replay.\n");
+        ret = -1;
+    }
+
+    /* the pre-event ring covers the pre-roll and the GOP it starts in, at twice the bit rate for the I frames */
+    if (!ret && (gParamOption.mode & MODE_EVENT)){
+        gParamOption.event.maxFrames = gParamOption.event.preSeconds * gParamOption.frameRate + HILI_EVENT_GOP;
+        gParamOption.event.maxKB = (int)((HI_U64)gParamOption.bitRate * 1000 * 2 / 8 / 1024 *
+                                         gParamOption.event.maxFrames / gParamOption.frameRate) + 1;
+    }
+
+    printf("param:\nmode=%s, format=%s, frameRate=%d fps, bitRate=%d kbps, videoSize=%s, IP=%s\n",
+           mode, format, gParamOption.frameRate,
+           gParamOption.bitRate, videoSize, gParamOption.ip);
+    if (!ret && (gParamOption.mode & MODE_EVENT)){
+        printf("event pre-roll %d s, ring of %d frames, %d KB\n", gParamOption.event.preSeconds,
+               gParamOption.event.maxFrames, gParamOption.event.maxKB);
+    }
+
+    return ret;
+}
+
+/******************************************************************************
+* function : to process abnormal case
+******************************************************************************/
+void SAMPLE_VENC_HandleSig(HI_S32 signo)
+{
+    if (SIGINT == signo || SIGTERM == signo)
+    {
+        SAMPLE_COMM_ISP_Stop();
+        SAMPLE_COMM_SYS_Exit();
+        LOGE("program termination abnormally!\n");
+    }
+    exit(-1);
+}
+
+/******************************************************************************
+* funciton : svc-t layer of a frame, as SAMPLE_COMM_VENC_GetVencStreamProc_Svc_t
+*            splits them: the base frames referenced by base frames, those
+*            referenced by enhance frames, the enhance frames
+******************************************************************************/
+HI_S32 hiliVencTemporalId(H264E_REF_TYPE_E enRefType)
+{
+    switch (enRefType) {
+        case BASE_PSLICE_REFBYENHANCE:
+            return 1;
+        case ENHANCE_PSLICE_REFBYENHANCE:
+        case ENHANCE_PSLICE_NOTFORREF:
+            return gParamOption.layers - 1;
+        default:
+            return 0;
+    }
+}
+
+/******************************************************************************
+* funciton : frame attributes from the packs of one venc stream
+******************************************************************************/
+HI_VOID hiliVencStreamInfo(MediaFrame *pstFrame, const VENC_STREAM_S* pstStream)
+{
+    VENC_PACK_S *pstPack;
+    HI_U32 i;
+
+    for (i = 0; i < pstStream->u32PackCount; i++) {
+        pstPack = &pstStream->pstPack[i];
+        if ((PT_H264 == gParamOption.videoFormat && H264E_NALU_ISLICE == pstPack->DataType.enH264EType) ||
+            (PT_H265 == gParamOption.videoFormat && H265E_NALU_ISLICE == pstPack->DataType.enH265EType)) {
+            pstFrame->keyFrame = 1;
+        }
+    }
+
+    pstFrame->temporalId = hiliVencTemporalId((PT_H264 == gParamOption.videoFormat) ?
+                                              pstStream->stH264Info.enRefType : pstStream->stH265Info.enRefType);
+    pstFrame->pts = pstStream->pstPack[0].u64PTS;
+    pstFrame->seq = pstStream->u32Seq;
+    pstFrame->codec = (gParamOption.videoFormat == PT_H264) ? 0 : 1;
+}
+
+/******************************************************************************
+* funciton : copy all packs of one venc stream into a frame, so the venc
+*            buffer can be released at once and the frame shared by sinks
+******************************************************************************/
+MediaFrame* hiliVencStreamToFrame(FramePool *pstPool, VENC_STREAM_S* pstStream)
+{
+    MediaFrame *pstFrame;
+    VENC_PACK_S *pstPack;
+    HI_U32 i, u32Len, u32Size = 0;
+
+    for (i = 0; i < pstStream->u32PackCount; i++) {
+        u32Size += pstStream->pstPack[i].u32Len - pstStream->pstPack[i].u32Offset;
+    }
+
+    pstFrame = frameGet(pstPool, u32Size);
+    if (NULL == pstFrame) {
+        return NULL;
+    }
+
+    for (i = 0; i < pstStream->u32PackCount; i++) {
+        pstPack = &pstStream->pstPack[i];
+        u32Len = pstPack->u32Len - pstPack->u32Offset;
+        memcpy(pstFrame->data + pstFrame->size, pstPack->pu8Addr + pstPack->u32Offset, u32Len);
+        pstFrame->size += u32Len;
+    }
+    hiliVencStreamInfo(pstFrame, pstStream);
+
+    return pstFrame;
+}
+
+/******************************************************************************
+* funciton : init the queue of got streams, the pack nodes of each entry are
+*            alloced once. without stream buffer info every frame is copied
+******************************************************************************/
+HI_S32 hiliVencHoldInit(VencStreamHold *pstHold, VENC_CHN VencChn, ReactorContext *pstReactor)
+{
+    HI_S32 i, s32Ret;
+
+    memset(pstHold, 0, sizeof(VencStreamHold));
+    for (i = 0; i < HILI_HOLD_MAX; i++) {
+        if (HI_SUCCESS != SAMPLE_COMM_VENC_PackPoolInit(&pstHold->astStream[i].stPackPool, SAMPLE_VENC_MAX_PACKS)) {
+            while (i-- > 0) {
+                SAMPLE_COMM_VENC_PackPoolDeInit(&pstHold->astStream[i].stPackPool);
+            }
+            return HI_FAILURE;
+        }
+        pstHold->astStream[i].pstHold = pstHold;
+    }
+    pthread_mutex_init(&pstHold->lock, NULL);
+    pstHold->VencChn = VencChn;
+    pstHold->VencFd = -1;
+    pstHold->pstReactor = pstReactor;
+
+    s32Ret = HI_MPI_VENC_GetStreamBufInfo(VencChn, &pstHold->stBufInfo);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VENC_GetStreamBufInfo failed with %#x, frames are copied!\n", s32Ret);
+        pstHold->stBufInfo.u32BufSize = 0;
+    }
+
+    return HI_SUCCESS;
+}
+
+/* all frames must be unrefed, the sinks closed */
+HI_VOID hiliVencHoldDeInit(VencStreamHold *pstHold)
+{
+    HI_S32 i;
+
+    if (pstHold->u32Count) {
+        LOGE("%u venc streams still held!\n", pstHold->u32Count);
+    }
+    for (i = 0; i < HILI_HOLD_MAX; i++) {
+        SAMPLE_COMM_VENC_PackPoolDeInit(&pstHold->astStream[i].stPackPool);
+    }
+    pthread_mutex_destroy(&pstHold->lock);
+}
+
+/******************************************************************************
+* funciton : the entry to get the next stream into. NULL while all entries are
+*            held, the venc fd is paused then until the oldest is released
+******************************************************************************/
+VencHeldStream* hiliVencHoldNext(VencStreamHold *pstHold)
+{
+    VencHeldStream *pstHeld = NULL;
+
+    pthread_mutex_lock(&pstHold->lock);
+    if (pstHold->u32Count < HILI_HOLD_MAX) {
+        pstHeld = &pstHold->astStream[(pstHold->u32Head + pstHold->u32Count) % HILI_HOLD_MAX];
+    } else {
+        /* under the lock, so a release can't resume it before. paused again each time,
+           a late resume of an earlier release may have enabled the fd after the pause */
+        pstHold->bPaused = HI_TRUE;
+        reactorModFd(pstHold->pstReactor, pstHold->VencFd, 0);
+    }
+    pthread_mutex_unlock(&pstHold->lock);
+
+    return pstHeld;
+}
+
+/* the stream was got into the entry from hiliVencHoldNext() */
+HI_VOID hiliVencHoldAdd(VencStreamHold *pstHold, VencHeldStream *pstHeld)
+{
+    HI_U32 i;
+
+    pstHeld->u32Bytes = 0;
+    for (i = 0; i < pstHeld->stStream.u32PackCount; i++) {
+        pstHeld->u32Bytes += pstHeld->stStream.pstPack[i].u32Len - pstHeld->stStream.pstPack[i].u32Offset;
+    }
+    pstHeld->bDone = HI_FALSE;
+
+    pthread_mutex_lock(&pstHold->lock);
+    pstHold->u32Count++;
+    pstHold->u32HeldBytes += pstHeld->u32Bytes;
+    pthread_mutex_unlock(&pstHold->lock);
+}
+
+/******************************************************************************
+* funciton : nothing points into the stream any more, release it and the done
+*            ones after it, if the streams before are released. any thread
+******************************************************************************/
+HI_VOID hiliVencHoldDone(VencHeldStream *pstHeld)
+{
+    VencStreamHold *pstHold = pstHeld->pstHold;
+    VencHeldStream *pstHead;
+    HI_BOOL bResume = HI_FALSE;
+    HI_S32 s32Ret;
+
+    pthread_mutex_lock(&pstHold->lock);
+    pstHeld->bDone = HI_TRUE;
+    while (pstHold->u32Count > 0) {
+        pstHead = &pstHold->astStream[pstHold->u32Head];
+        if (!pstHead->bDone) {
+            break;
+        }
+        s32Ret = HI_MPI_VENC_ReleaseStream(pstHold->VencChn, &pstHead->stStream);
+        if (HI_SUCCESS != s32Ret) {
+            LOGE("HI_MPI_VENC_ReleaseStream failed with %#x!\n", s32Ret);
+        }
+        pstHold->u32HeldBytes -= pstHead->u32Bytes;
+        pstHold->u32Head = (pstHold->u32Head + 1) % HILI_HOLD_MAX;
+        pstHold->u32Count--;
+    }
+    if (pstHold->bPaused && pstHold->u32Count < HILI_HOLD_MAX) {
+        pstHold->bPaused = HI_FALSE;
+        bResume = HI_TRUE;
+    }
+    pthread_mutex_unlock(&pstHold->lock);
+
+    /* not under the hold lock, the reactor thread takes it with the reactor lock held.
+       if the reactor paused again meanwhile, its next hiliVencHoldNext() pauses once more */
+    if (bResume) {
+        reactorModFd(pstHold->pstReactor, pstHold->VencFd, EPOLLIN);
+    }
+}
+
+/* FrameRelease of borrowed frames */
+HI_VOID hiliVencFrameRelease(MediaFrame *pstFrame)
+{
+    hiliVencHoldDone((VencHeldStream *)pstFrame->opaque);
+}
+
+/******************************************************************************
+* funciton : a frame pointing into the venc stream buffer, NULL if it must be
+*            copied: the packs wrap at the end of the buffer, or the buffer
+*            gets tight and the encoder would have to drop frames
+******************************************************************************/
+MediaFrame* hiliVencStreamBorrow(VencChnContext *pstVenc, VencHeldStream *pstHeld, const VENC_CHN_STAT_S *pstStat)
+{
+    VencStreamHold *pstHold = &pstVenc->stHold;
+    VENC_STREAM_S *pstStream = &pstHeld->stStream;
+    VENC_PACK_S *pstPack;
+    HI_U8 *pu8Buf = (HI_U8 *)pstHold->stBufInfo.pUserAddr;
+    HI_U32 u32Size = pstHold->stBufInfo.u32BufSize;
+    HI_U8 *pu8Start, *pu8End;
+    MediaFrame *pstFrame;
+    HI_U32 i;
+
+    if (!pstVenc->bBorrow || 0 == u32Size) {
+        return NULL;
+    }
+
+    pu8Start = pstStream->pstPack[0].pu8Addr + pstStream->pstPack[0].u32Offset;
+    pu8End = pu8Start;
+    for (i = 0; i < pstStream->u32PackCount; i++) {
+        pstPack = &pstStream->pstPack[i];
+        if (pstPack->pu8Addr + pstPack->u32Offset != pu8End) {
+            return NULL;
+        }
+        pu8End = pstPack->pu8Addr + pstPack->u32Len;
+    }
+    if (pu8Start < pu8Buf || pu8End > pu8Buf + u32Size) {
+        return NULL;
+    }
+
+    /* what venc has not handed out yet and what the sinks hold, against the room left to encode */
+    if (pstStat->u32LeftStreamBytes + pstHold->u32HeldBytes > u32Size - u32Size / HILI_HOLD_TIGHT) {
+        pstHold->u32Tight++;
+        return NULL;
+    }
+
+    pstFrame = frameBorrow(&pstVenc->stFramePool, pu8Start, (int)(pu8End - pu8Start), hiliVencFrameRelease, pstHeld);
+    if (pstFrame) {
+        hiliVencStreamInfo(pstFrame, pstStream);
+    }
+    return pstFrame;
+}
+
+/******************************************************************************
+* funciton : streams borrowed and copied since the last report
+******************************************************************************/
+HI_VOID hiliVencHoldReport(VencChnContext *pstVenc)
+{
+    VencStreamHold *pstHold = &pstVenc->stHold;
+
+    if (!pstVenc->bBorrow || 0 == pstHold->u32Borrowed + pstHold->u32Copied) {
+        return;
+    }
+    LOGD("venc chn %d frames borrowed %u, copied %u (%u stream buffer tight), %u streams %u KB held\n",
+         pstVenc->VencChn, pstHold->u32Borrowed, pstHold->u32Copied, pstHold->u32Tight,
+         pstHold->u32Count, pstHold->u32HeldBytes >> 10);
+    pstHold->u32Borrowed = 0;
+    pstHold->u32Copied = 0;
+    pstHold->u32Tight = 0;
+}
+
+/******************************************************************************
+* funciton : the frame for one sink. storage sinks may block or keep frames for
+*            long, they get one shared copy of a borrowed frame instead
+******************************************************************************/
+MediaFrame* hiliVencSinkFrame(VencChnContext *pstVenc, const Sink *pstSink, MediaFrame *pstFrame, MediaFrame **ppstCopy)
+{
+    if (NULL == pstFrame->release || !(pstSink->ops->caps & SINK_CAP_STORAGE)) {
+        return pstFrame;
+    }
+    if (NULL == *ppstCopy) {
+        *ppstCopy = frameClone(&pstVenc->stFramePool, pstFrame);
+        if (NULL == *ppstCopy) {
+            LOGE("no free frame, drop stream %d for sink %s!\n", pstFrame->seq, pstSink->ops->name);
+        }
+    }
+    return *ppstCopy;
+}
+
+/******************************************************************************
+* funciton : hand one frame to all sinks, the frame reference is taken over
+******************************************************************************/
+HI_VOID hiliVencDispatch(VencChnContext *pstVenc, MediaFrame *pstFrame)
+{
+    VencChnContext *pstSinks = pstVenc->pstSinks;
+    MediaFrame *pstCopy = NULL, *pstSinkFrame;
+    HI_S32 i;
+
+    pstFrame->stream = pstVenc->s32Stream;
+    for (i = 0; i < pstSinks->s32SinkNum; i++) {
+        /* they got this frame slice by slice */
+        if (pstVenc->bSliceMode && (pstSinks->astSink[i].ops->caps & SINK_CAP_SLICE)) {
+            continue;
+        }
+        if (pstVenc->s32Stream && !pstSinks->astSink[i].info.simulcast) {
+            continue;
+        }
+        pstSinkFrame = hiliVencSinkFrame(pstVenc, &pstSinks->astSink[i], pstFrame, &pstCopy);
+        if (pstSinkFrame) {
+            sinkPush(&pstSinks->astSink[i], pstSinkFrame);
+        }
+    }
+    pstVenc->stGate.au64Bytes[pstVenc->stGate.bStatic] += pstFrame->size;
+    frameUnref(pstFrame);
+    if (pstCopy) {
+        frameUnref(pstCopy);
+    }
+
+    pstVenc->u32FrameCnt++;
+}
+
+/******************************************************************************
+* funciton : slice mode, hand one slice to the sinks taking slices at once and
+*            collect the access unit for the others. NULL for a lost slice.
+******************************************************************************/
+HI_VOID hiliVencSliceDispatch(VencChnContext *pstVenc, MediaFrame *pstSlice, HI_BOOL bFrameEnd)
+{
+    VencChnContext *pstSinks = pstVenc->pstSinks;
+    MediaFrame *pstAu = pstVenc->pstAuFrame;
+    MediaFrame *pstCopy = NULL, *pstSinkFrame;
+    HI_S32 i;
+
+    if (pstSlice) {
+        if (0 == pstVenc->u32AuSlices) {
+            pstAu = frameGet(&pstVenc->stFramePool, pstSlice->size);
+            if (pstAu) {
+                pstAu->pts = pstSlice->pts;
+                pstAu->seq = pstSlice->seq;
+                pstAu->codec = pstSlice->codec;
+                pstAu->captureUs = pstSlice->captureUs;
+            }
+        }
+        if (pstAu) {
+            pstAu->keyFrame |= pstSlice->keyFrame;
+            if (frameAppend(pstAu, pstSlice->data, pstSlice->size) < 0) {
+                frameUnref(pstAu);
+                pstAu = NULL;
+            }
+        }
+
+        /* a sink may start or resync on the first slice of a key frame only */
+        pstSlice->keyFrame = pstSlice->keyFrame && 0 == pstVenc->u32AuSlices;
+        pstSlice->stream = pstVenc->s32Stream;
+        for (i = 0; i < pstSinks->s32SinkNum; i++) {
+            if (!(pstSinks->astSink[i].ops->caps & SINK_CAP_SLICE)) {
+                continue;
+            }
+            if (pstVenc->s32Stream && !pstSinks->astSink[i].info.simulcast) {
+                continue;
+            }
+            pstSinkFrame = hiliVencSinkFrame(pstVenc, &pstSinks->astSink[i], pstSlice, &pstCopy);
+            if (pstSinkFrame) {
+                sinkPush(&pstSinks->astSink[i], pstSinkFrame);
+            }
+        }
+        frameUnref(pstSlice);
+        if (pstCopy) {
+            frameUnref(pstCopy);
+        }
+    } else if (pstAu) {
+        /* a frame with a hole is no use to storage */
+        frameUnref(pstAu);
+        pstAu = NULL;
+    }
+    pstVenc->u32AuSlices++;
+    pstVenc->pstAuFrame = pstAu;
+
+    if (bFrameEnd) {
+        pstVenc->u32AuSlices = 0;
+        pstVenc->pstAuFrame = NULL;
+        if (pstAu) {
+            hiliVencDispatch(pstVenc, pstAu);
+        }
+    }
+}
+
+/******************************************************************************
+* funciton : the venc puts user data into the frame after this one, so the SEI
+*            carries the pts expected next with its capture time. A frame
+*            dropped by the rate control moves it one frame later, the pts
+*            in it still gives the right capture time with the rtp timestamp.
+******************************************************************************/
+HI_VOID hiliVencCaptureSei(VencChnContext *pstVenc, const MediaFrame *pstFrame)
+{
+    HI_U8 au8Data[SEI_CAPTURE_SIZE];
+    HI_U64 u64Pts = pstFrame->pts + 1000000 / gParamOption.frameRate;
+    HI_U64 u64Wall = getWallClockTime() - (getMonotonicTime() - (u64Pts + pstVenc->s64PtsOffset));
+    HI_S32 s32Ret;
+
+    seiCaptureBuild(au8Data, u64Pts, wallToNtp(u64Wall));
+    s32Ret = HI_MPI_VENC_InsertUserData(pstVenc->VencChn, au8Data, sizeof(au8Data));
+    if (HI_SUCCESS != s32Ret && 0 == pstVenc->u32SeiFailed++) {
+        LOGE("HI_MPI_VENC_InsertUserData failed with %#x!\n", s32Ret);
+    }
+}
+
+/******************************************************************************
+* funciton : svc-t, an enhance frame between two base frames, and with 3
+*            layers every other base frame only referenced by it: 7.5, 15
+*            and 30 fps out of one encode, see hiliVencTemporalId()
+******************************************************************************/
+HI_S32 hiliVencTemporalLayers(VENC_CHN VencChn, HI_U32 u32Layers)
+{
+    VENC_PARAM_REF_S stRef;
+    HI_S32 s32Ret;
+
+    s32Ret = HI_MPI_VENC_GetRefParam(VencChn, &stRef);
+    if (HI_SUCCESS == s32Ret) {
+        stRef.u32Base = (u32Layers > 2) ? 2 : 1;
+        stRef.u32Enhance = 1;
+        stRef.bEnablePred = HI_TRUE;
+        s32Ret = HI_MPI_VENC_SetRefParam(VencChn, &stRef);
+    }
+
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("venc chn %d ref param failed with %#x!\n", VencChn, s32Ret);
+    } else {
+        LOGD("venc chn %d has %u temporal layers\n", VencChn, u32Layers);
+    }
+    return s32Ret;
+}
+
+/******************************************************************************
+* funciton : a frame over the -p threshold got through (SUPERFRM_REENCODE
+*            couldn't bring it down). a gap in the pts is taken as a frame the
+*            venc discarded or never got, only while it runs at the nominal
+*            rate: the motion gate and the roi background rate lower it
+******************************************************************************/
+HI_VOID hiliVencSuperFrameCount(VencChnContext *pstVenc, HI_U64 u64Pts)
+{
+    HI_U64 u64Interval = 1000000 / gParamOption.frameRate;
+    HI_U32 u32Kbit = pstVenc->bAuKey ? gParamOption.superFrame.iKbit : gParamOption.superFrame.pKbit;
+
+    if (SUPERFRM_NONE == gParamOption.superFrame.mode) {
+        return;
+    }
+    if ((HI_U64)pstVenc->u32AuBytes * 8 > (HI_U64)u32Kbit * 1000) {
+        pstVenc->u32SuperFrames++;
+    }
+    if (pstVenc->stGate.bStatic || gParamOption.roi.bgFrameRate > 0) {
+        pstVenc->u64LastPts = 0;    // no gap counted across a low rate period
+        return;
+    }
+    if (pstVenc->u64LastPts && u64Pts > pstVenc->u64LastPts + u64Interval * 3 / 2) {
+        pstVenc->u32MissingFrames += (HI_U32)((u64Pts - pstVenc->u64LastPts + u64Interval / 2) / u64Interval) - 1;
+    }
+    pstVenc->u64LastPts = u64Pts;
+}
+
+/******************************************************************************
+* funciton : cap the frame size, a larger frame is encoded again with a
+*            higher qp or dropped, so no frame stalls the link for long
+******************************************************************************/
+HI_S32 hiliVencSuperFrame(VENC_CHN VencChn, const SuperFrameOption *pstOption)
+{
+    VENC_SUPERFRAME_CFG_S stCfg;
+    HI_S32 s32Ret;
+
+    s32Ret = HI_MPI_VENC_GetSuperFrameCfg(VencChn, &stCfg);
+    if (HI_SUCCESS == s32Ret) {
+        stCfg.enSuperFrmMode = pstOption->mode;
+        stCfg.u32SuperIFrmBitsThr = (HI_U32)pstOption->iKbit * 1000;
+        stCfg.u32SuperPFrmBitsThr = (HI_U32)pstOption->pKbit * 1000;
+        stCfg.u32SuperBFrmBitsThr = (HI_U32)pstOption->pKbit * 1000;
+        s32Ret = HI_MPI_VENC_SetSuperFrameCfg(VencChn, &stCfg);
+    }
+
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("venc chn %d super frame cfg failed with %#x!\n", VencChn, s32Ret);
+    } else {
+        LOGD("venc chn %d %s frames over I %u / P %u bits\n", VencChn,
+             SUPERFRM_REENCODE == pstOption->mode ? "reencodes" : "discards",
+             stCfg.u32SuperIFrmBitsThr, stCfg.u32SuperPFrmBitsThr);
+    }
+    return s32Ret;
+}
+
+/******************************************************************************
+* funciton : with intra refresh no IDR comes by itself, ask for one when a
+*            sink waits for a key frame (a new viewer, frames dropped) or
+*            on SIGUSR2, at most every HILI_IDR_GAP_US
+******************************************************************************/
+HI_VOID hiliVencKeyRequest(VencChnContext *pstVenc)
+{
+    VencChnContext *pstSinks = pstVenc->pstSinks;
+    Sink *pstSink;
+    HI_U64 u64Now;
+    HI_S32 i, s32Ret;
+
+    for (i = 0; i < pstSinks->s32SinkNum; i++) {
+        pstSink = &pstSinks->astSink[i];
+        /* the key requests of a sink are for the stream it takes, a simulcast switch waits for one of the other */
+        if (pstSink->stream == pstVenc->s32Stream && sinkTakeKeyRequest(pstSink)) {
+            pstVenc->bIdrWanted = HI_TRUE;
+        }
+        if (pstSink->wantStream == pstVenc->s32Stream && pstSink->stream != pstVenc->s32Stream) {
+            pstVenc->bIdrWanted = HI_TRUE;
+        }
+    }
+    u64Now = getMonotonicTime();
+    if (!pstVenc->bIdrWanted || u64Now - pstVenc->u64LastIdrUs < HILI_IDR_GAP_US) {
+        return;
+    }
+
+    s32Ret = HI_MPI_VENC_RequestIDR(pstVenc->VencChn, HI_TRUE);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VENC_RequestIDR failed with %#x!\n", s32Ret);
+    }
+    pstVenc->bIdrWanted = HI_FALSE;
+    pstVenc->u64LastIdrUs = u64Now;
+    pstVenc->u32IdrRequests++;
+}
+
+/******************************************************************************
+* funciton : refresh the picture a few rows in every P frame instead of in
+*            periodic IDRs, set before the chn starts
+******************************************************************************/
+HI_S32 hiliVencIntraRefresh(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, HI_U32 u32Height, HI_U32 u32Frames)
+{
+    VENC_PARAM_INTRA_REFRESH_S stRefresh;
+    HI_U32 u32Rows = (PT_H264 == enType) ? (u32Height + 15) / 16 : (u32Height + HILI_H265_LCU - 1) / HILI_H265_LCU;
+    HI_S32 s32Ret;
+
+    s32Ret = HI_MPI_VENC_GetIntraRefresh(VencChn, &stRefresh);
+    if (HI_SUCCESS == s32Ret) {
+        stRefresh.bRefreshEnable = HI_TRUE;
+        stRefresh.bISliceEnable = HI_FALSE;     // intra macroblock rows in P slices
+        stRefresh.u32RefreshLineNum = (u32Rows + u32Frames - 1) / u32Frames;
+        s32Ret = HI_MPI_VENC_SetIntraRefresh(VencChn, &stRefresh);
+    }
+
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("venc chn %d intra refresh failed with %#x!\n", VencChn, s32Ret);
+    } else {
+        LOGD("venc chn %d refreshes %u rows a frame, all in %u frames\n", VencChn, stRefresh.u32RefreshLineNum,
+             (u32Rows + stRefresh.u32RefreshLineNum - 1) / stRefresh.u32RefreshLineNum);
+    }
+    return s32Ret;
+}
+
+/******************************************************************************
+* funciton : get one frame stream from venc channel and dispatch it to
+*            all sinks, called by reactor when venc fd is readable.
+******************************************************************************/
+int hiliVencStreamHandler(int fd, uint32_t events, void *arg)
+{
+    VencChnContext *pstVenc = (VencChnContext *)arg;
+    VENC_CHN_STAT_S stStat;
+    VENC_STREAM_S *pstStream;
+    VencHeldStream *pstHeld;
+    MediaFrame *pstFrame;
+    HI_S32 s32Ret;
+    HI_U64 u64Start = getMonotonicTime();
+    HI_U32 u32Us;
+    HI_BOOL bFrameEnd;
+
+    /*******************************************************
+     step 1 : query how many packs in one-frame stream.
+    *******************************************************/
+    s32Ret = HI_MPI_VENC_Query(pstVenc->VencChn, &stStat);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VENC_Query failed with %#x!\n", s32Ret);
+        return -1;
+    }
+
+    /*******************************************************
+     step 2 :suggest to check both u32CurPacks and u32LeftStreamFrames at the same time,for example:
+     if(0 == stStat.u32CurPacks || 0 == stStat.u32LeftStreamFrames)
+     {
+        SAMPLE_PRT("NOTE: Current  frame is NULL!\n");
+        continue;
+     }
+    *******************************************************/
+    if(0 == stStat.u32CurPacks) {
+        LOGE("NOTE: Current  frame is NULL!\n");
+        return 0;
+    }
+    /*******************************************************
+     step 3 : take the next hold entry, its pack nodes are reused, no malloc per frame.
+    *******************************************************/
+    pstHeld = hiliVencHoldNext(&pstVenc->stHold);
+    if (NULL == pstHeld) {
+        LOGE("all %d venc streams are held, wait for the sinks!\n", HILI_HOLD_MAX);
+        return 0;
+    }
+    pstStream = &pstHeld->stStream;
+    memset(pstStream, 0, sizeof(VENC_STREAM_S));
+    pstStream->pstPack = SAMPLE_COMM_VENC_PackPoolGet(&pstHeld->stPackPool, stStat.u32CurPacks);
+    if (NULL == pstStream->pstPack) {
+        LOGE("get stream pack failed!\n");
+        return -1;
+    }
+
+    /*******************************************************
+     step 4 : call mpi to get one-frame stream
+    *******************************************************/
+    pstStream->u32PackCount = stStat.u32CurPacks;
+    s32Ret = HI_MPI_VENC_GetStream(pstVenc->VencChn, pstStream, HI_TRUE);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VENC_GetStream failed with %#x!\n", s32Ret);
+        return -1;
+    }
+    hiliVencHoldAdd(&pstVenc->stHold, pstHeld);
+    bFrameEnd = pstStream->pstPack[pstStream->u32PackCount - 1].bFrameEnd;
+
+    /*******************************************************
+     step 5 : borrow the stream for the sinks, or copy it to a frame and
+              release it, as soon as the streams got before are released
+    *******************************************************/
+    pstFrame = hiliVencStreamBorrow(pstVenc, pstHeld, &stStat);
+    if (pstFrame) {
+        pstVenc->stHold.u32Borrowed++;
+    } else {
+        pstFrame = hiliVencStreamToFrame(&pstVenc->stFramePool, pstStream);
+        pstVenc->stHold.u32Copied++;
+        hiliVencHoldDone(pstHeld);
+    }
+
+    if (NULL == pstFrame) {
+        LOGE("no free frame, drop stream %d!\n", pstStream->u32Seq);
+        if (pstVenc->bSliceMode) {
+            hiliVencSliceDispatch(pstVenc, NULL, bFrameEnd);
+        }
+        return 0;
+    }
+    pstFrame->captureUs = pstFrame->pts + pstVenc->s64PtsOffset;
+    if (gParamOption.captureTime > 1 && bFrameEnd) {
+        hiliVencCaptureSei(pstVenc, pstFrame);
+    }
+
+    /*******************************************************
+     step 6 : dispatch frame to sinks, each sink has its own queue
+    *******************************************************/
+    if (pstVenc->bSliceMode) {
+        pstFrame->slice = 1;
+        pstFrame->frameEnd = bFrameEnd;
+        hiliVencSliceDispatch(pstVenc, pstFrame, bFrameEnd);
+    } else {
+        hiliVencDispatch(pstVenc, pstFrame);
+    }
+
+    pstVenc->u32AuBytes += pstFrame->size;
+    pstVenc->bAuKey |= pstFrame->keyFrame;
+    if (bFrameEnd) {
+        hiliVencSuperFrameCount(pstVenc, pstFrame->pts);
+        pstVenc->bAuKey = HI_FALSE;
+        pstVenc->u64StatBytes += pstVenc->u32AuBytes;
+        pstVenc->u32StatFrames++;
+        if (pstVenc->u32AuBytes > pstVenc->u32PeakBytes) {
+            pstVenc->u32PeakBytes = pstVenc->u32AuBytes;
+        }
+        pstVenc->u32AuBytes = 0;
+    }
+    if (gParamOption.refreshFrames || PIC_BUTT != gParamOption.subSize) {
+        hiliVencKeyRequest(pstVenc);
+    }
+
+    u32Us = (HI_U32)(getMonotonicTime() - u64Start);
+    if (u32Us > pstVenc->u32MaxStallUs) {
+        pstVenc->u32MaxStallUs = u32Us;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+* funciton : change frame rate & bit rate of a running venc chn
+******************************************************************************/
+HI_S32 hiliVencSetRate(VENC_CHN VencChn, HI_U32 u32FrameRate, HI_U32 u32BitRate)
+{
+    VENC_CHN_ATTR_S stVencChnAttr;
+    HI_S32 s32Ret;
+
+    s32Ret = HI_MPI_VENC_GetChnAttr(VencChn, &stVencChnAttr);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VENC_GetChnAttr failed with %#x!\n", s32Ret);
+        return s32Ret;
+    }
+
+    /* dynamic attributes, take effect from the next frame */
+    switch (stVencChnAttr.stRcAttr.enRcMode) {
+        case VENC_RC_MODE_H264CBR:
+            stVencChnAttr.stRcAttr.stAttrH264Cbr.fr32DstFrmRate = u32FrameRate;
+            stVencChnAttr.stRcAttr.stAttrH264Cbr.u32BitRate = u32BitRate;
+            break;
+        case VENC_RC_MODE_H264VBR:
+            stVencChnAttr.stRcAttr.stAttrH264Vbr.fr32DstFrmRate = u32FrameRate;
+            stVencChnAttr.stRcAttr.stAttrH264Vbr.u32MaxBitRate = u32BitRate;
+            break;
+        case VENC_RC_MODE_H265CBR:
+            stVencChnAttr.stRcAttr.stAttrH265Cbr.fr32DstFrmRate = u32FrameRate;
+            stVencChnAttr.stRcAttr.stAttrH265Cbr.u32BitRate = u32BitRate;
+            break;
+        case VENC_RC_MODE_H265VBR:
+            stVencChnAttr.stRcAttr.stAttrH265Vbr.fr32DstFrmRate = u32FrameRate;
+            stVencChnAttr.stRcAttr.stAttrH265Vbr.u32MaxBitRate = u32BitRate;
+            break;
+        default:
+            return HI_ERR_VENC_NOT_SUPPORT;
+    }
+
+    s32Ret = HI_MPI_VENC_SetChnAttr(VencChn, &stVencChnAttr);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VENC_SetChnAttr failed with %#x!\n", s32Ret);
+    }
+    return s32Ret;
+}
+
+/******************************************************************************
+* funciton : motion gating, full rate at once on motion, low rate after
+*            holdSeconds without motion. called with every vda result.
+******************************************************************************/
+HI_VOID hiliMotionGateUpdate(VencChnContext *pstVenc, HI_BOOL bMotion)
+{
+    MotionGate *pstGate = &pstVenc->stGate;
+    HI_U64 u64Now = getMonotonicTime();
+    HI_BOOL bStatic;
+    HI_S32 s32Ret;
+
+    if (0 == pstGate->u64StateStart) {
+        pstGate->u64StateStart = u64Now;
+        pstGate->u64LastMotion = u64Now;
+    }
+    if (bMotion) {
+        pstGate->u64LastMotion = u64Now;
+    }
+
+    bStatic = (u64Now - pstGate->u64LastMotion >= (HI_U64)gParamOption.gate.holdSeconds * 1000000) ? HI_TRUE : HI_FALSE;
+    if (bStatic == pstGate->bStatic) {
+        return;
+    }
+
+    if (bStatic) {
+        if (HI_SUCCESS != HI_MPI_VENC_GetChnAttr(pstVenc->VencChn, &pstGate->stFullAttr) ||
+            HI_SUCCESS != hiliVencSetRate(pstVenc->VencChn, gParamOption.gate.frameRate, gParamOption.gate.bitRate)) {
+            return;
+        }
+    } else {
+        s32Ret = HI_MPI_VENC_SetChnAttr(pstVenc->VencChn, &pstGate->stFullAttr);
+        if (HI_SUCCESS != s32Ret) {
+            LOGE("HI_MPI_VENC_SetChnAttr failed with %#x!\n", s32Ret);
+        }
+    }
+    LOGD("scene is %s\n", bStatic ? "static, low rate" : "moving, full rate");
+
+    pstGate->au64Us[pstGate->bStatic] += u64Now - pstGate->u64StateStart;
+    pstGate->u64StateStart = u64Now;
+    pstGate->bStatic = bStatic;
+}
+
+/******************************************************************************
+* funciton : storage saved by gating, against the full rate bytes per second
+******************************************************************************/
+HI_VOID hiliMotionGateReport(VencChnContext *pstVenc)
+{
+    MotionGate *pstGate = &pstVenc->stGate;
+    HI_U64 au64Us[2], u64Total, u64Full;
+    HI_U32 u32Saved = 0;
+
+    if (0 == pstGate->u64StateStart) {
+        return;
+    }
+
+    au64Us[0] = pstGate->au64Us[0];
+    au64Us[1] = pstGate->au64Us[1];
+    au64Us[pstGate->bStatic] += getMonotonicTime() - pstGate->u64StateStart;
+    u64Total = pstGate->au64Bytes[0] + pstGate->au64Bytes[1];
+
+    /* what the same time would have cost at the full rate measured while moving */
+    if (au64Us[0] > 0) {
+        u64Full = pstGate->au64Bytes[0] * (au64Us[0] + au64Us[1]) / au64Us[0];
+        if (u64Full > u64Total) {
+            u32Saved = (HI_U32)((u64Full - u64Total) * 100 / u64Full);
+        }
+    }
+
+    LOGD("motion gating: static %llu s of %llu s, %llu KB encoded, %u%% less than full rate\n",
+         au64Us[1] / 1000000, (au64Us[0] + au64Us[1]) / 1000000, u64Total >> 10, u32Saved);
+}
+
+/******************************************************************************
+* funciton : roi of the moving regions, the rest at the background frame rate
+*            while there are any. pstMdSize is the vda picture
+******************************************************************************/
+HI_S32 hiliRoiStart(VencChnContext *pstVenc, const SIZE_S *pstMdSize)
+{
+    VENC_ROIBG_FRAME_RATE_S stBgRate;
+    RoiConfig stCfg;
+    SIZE_S stSize;
+    HI_S32 s32Ret;
+
+    s32Ret = SAMPLE_COMM_SYS_GetPicSize(gs_enNorm, gParamOption.videoSize, &stSize);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_SYS_GetPicSize failed!\n");
+        return s32Ret;
+    }
+
+    stCfg.width = (int)stSize.u32Width;
+    stCfg.height = (int)stSize.u32Height;
+    stCfg.srcWidth = (int)pstMdSize->u32Width;
+    stCfg.srcHeight = (int)pstMdSize->u32Height;
+    stCfg.margin = HILI_ROI_MARGIN;
+    stCfg.intervalUs = HILI_ROI_INTERVAL_US;
+    stCfg.holdUs = HILI_ROI_HOLD_US;
+    roiInit(&pstVenc->stRoi, &stCfg);
+
+    if (gParamOption.roi.bgFrameRate > 0) {
+        stBgRate.s32SrcFrmRate = gParamOption.frameRate;
+        stBgRate.s32DstFrmRate = gParamOption.roi.bgFrameRate;
+        s32Ret = HI_MPI_VENC_SetRoiBgFrameRate(pstVenc->VencChn, &stBgRate);
+        if (HI_SUCCESS != s32Ret) {
+            LOGE("HI_MPI_VENC_SetRoiBgFrameRate failed with %#x!\n", s32Ret);
+        }
+    }
+    LOGD("roi qp %d, background %d fps\n", gParamOption.roi.qp,
+         gParamOption.roi.bgFrameRate ? gParamOption.roi.bgFrameRate : gParamOption.frameRate);
+    return HI_SUCCESS;
+}
+
+/******************************************************************************
+* funciton : hand the applied plan to the venc, unused indexes disabled
+******************************************************************************/
+HI_VOID hiliRoiApply(VencChnContext *pstVenc)
+{
+    const RoiPlan *pstPlan = &pstVenc->stRoi.applied;
+    VENC_ROI_CFG_S stRoi;
+    HI_S32 i, s32Ret;
+
+    for (i = 0; i < ROI_MAX; i++) {
+        memset(&stRoi, 0, sizeof(stRoi));
+        stRoi.u32Index = (HI_U32)i;
+        stRoi.bEnable = (i < pstPlan->num) ? HI_TRUE : HI_FALSE;
+        stRoi.bAbsQp = HI_FALSE;
+        stRoi.s32Qp = gParamOption.roi.qp;
+        if (stRoi.bEnable) {
+            stRoi.stRect.s32X = pstPlan->rects[i].left;
+            stRoi.stRect.s32Y = pstPlan->rects[i].top;
+            stRoi.stRect.u32Width = (HI_U32)(pstPlan->rects[i].right - pstPlan->rects[i].left);
+            stRoi.stRect.u32Height = (HI_U32)(pstPlan->rects[i].bottom - pstPlan->rects[i].top);
+        }
+        s32Ret = HI_MPI_VENC_SetRoiCfg(pstVenc->VencChn, &stRoi);
+        if (HI_SUCCESS != s32Ret && 0 == pstVenc->u32RoiFailed++) {
+            LOGE("HI_MPI_VENC_SetRoiCfg failed with %#x!\n", s32Ret);
+        }
+    }
+}
+
+/******************************************************************************
+* funciton : the regions of one vda MD result, called in reactor
+******************************************************************************/
+HI_VOID hiliRoiUpdate(VencChnContext *pstVenc, const VDA_MD_DATA_S *pstMdData)
+{
+    RoiRect astRegion[ROI_INPUT_MAX];
+    const VDA_OBJ_S *pstObj;
+    HI_U32 i, u32Num = 0;
+
+    if (pstMdData->bObjValid) {
+        for (i = 0; i < pstMdData->stObjData.u32ObjNum && u32Num < ROI_INPUT_MAX; i++) {
+            pstObj = &pstMdData->stObjData.pstAddr[i];
+            astRegion[u32Num].left = pstObj->u16Left;
+            astRegion[u32Num].top = pstObj->u16Top;
+            astRegion[u32Num].right = pstObj->u16Right;
+            astRegion[u32Num].bottom = pstObj->u16Bottom;
+            u32Num++;
+        }
+    }
+    if (roiUpdate(&pstVenc->stRoi, astRegion, (int)u32Num, getMonotonicTime())) {
+        hiliRoiApply(pstVenc);
+    }
+}
+
+/******************************************************************************
+* funciton : how often the regions changed and how well they fit the motion
+******************************************************************************/
+HI_VOID hiliRoiReport(VencChnContext *pstVenc)
+{
+    const RoiStats *pstStats = &pstVenc->stRoi.stats;
+    HI_U64 u64Picture = (HI_U64)pstVenc->stRoi.cfg.width * (HI_U64)pstVenc->stRoi.cfg.height * pstStats->results;
+
+    LOGD("roi: %u updates, %u put off, of %u vda results; regions %llu%% of the picture, "
+         "%llu%% of the motion outside them\n", pstStats->updates, pstStats->deferred, pstStats->results,
+         u64Picture ? pstStats->planArea * 100 / u64Picture : 0ull,
+         pstStats->regionArea ? pstStats->missArea * 100 / pstStats->regionArea : 0ull);
+    if (pstVenc->u32RoiFailed) {
+        LOGE("venc chn %d %u roi configs failed\n", pstVenc->VencChn, pstVenc->u32RoiFailed);
+    }
+}
+
+/******************************************************************************
+* funciton : -j, ask the jpeg chn for one picture, in reactor
+******************************************************************************/
+HI_VOID hiliSnapAsk(SnapChnContext *pstSnap)
+{
+    VENC_RECV_PIC_PARAM_S stRecvParam;
+    HI_U64 u64Now = getMonotonicTime();
+    HI_S32 s32Ret;
+
+    if (pstSnap->bRecv) {
+        if (u64Now - pstSnap->u64AskedUs < HILI_SNAP_LOST_US) {
+            pstSnap->u32Late++;     // the one coming is served
+            return;
+        }
+        pstSnap->u32Lost++;
+        HI_MPI_VENC_StopRecvPic(pstSnap->VencChn);
+        pstSnap->bRecv = HI_FALSE;
+    }
+
+    stRecvParam.s32RecvPicNum = 1;
+    s32Ret = HI_MPI_VENC_StartRecvPicEx(pstSnap->VencChn, &stRecvParam);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VENC_StartRecvPicEx failed with %#x!\n", s32Ret);
+        pstSnap->u32Failed++;
+        snapCommit(&pstSnap->stServer, 0);      // the waiting requests get the one there is
+        return;
+    }
+    pstSnap->bRecv = HI_TRUE;
+    pstSnap->u64AskedUs = u64Now;
+}
+
+/* a request found the latest snapshot too old */
+HI_VOID hiliSnapWanted(SnapServer *pstServer, HI_VOID *pArg)
+{
+    hiliSnapAsk((SnapChnContext *)pArg);
+}
+
+int hiliSnapTickHandler(int fd, uint32_t events, void *arg)
+{
+    hiliSnapAsk((SnapChnContext *)arg);
+    return 0;
+}
+
+/******************************************************************************
+* funciton : -j, the jpeg is copied into the snapshot server and released at once,
+*            in reactor
+******************************************************************************/
+int hiliSnapStreamHandler(int fd, uint32_t events, void *arg)
+{
+    SnapChnContext *pstSnap = (SnapChnContext *)arg;
+    VENC_PACK_S astPack[HILI_SNAP_PACK_MAX];
+    VENC_CHN_STAT_S stStat;
+    VENC_STREAM_S stStream;
+    HI_U8 *pu8Buf;
+    HI_U32 i, u32Len = 0, u32Us;
+    HI_S32 s32Ret;
+
+    s32Ret = HI_MPI_VENC_Query(pstSnap->VencChn, &stStat);
+    if (HI_SUCCESS != s32Ret || 0 == stStat.u32CurPacks) {
+        return 0;
+    }
+    if (stStat.u32CurPacks > HILI_SNAP_PACK_MAX) {
+        LOGE("jpeg of %u packs, at most %d!\n", stStat.u32CurPacks, HILI_SNAP_PACK_MAX);
+        return -1;
+    }
+
+    memset(&stStream, 0, sizeof(stStream));
+    stStream.pstPack = astPack;
+    stStream.u32PackCount = stStat.u32CurPacks;
+    s32Ret = HI_MPI_VENC_GetStream(pstSnap->VencChn, &stStream, HI_TRUE);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VENC_GetStream failed with %#x!\n", s32Ret);
+        pstSnap->u32Failed++;
+        return 0;
+    }
+
+    for (i = 0; i < stStream.u32PackCount; i++) {
+        u32Len += astPack[i].u32Len - astPack[i].u32Offset;
+    }
+    pu8Buf = snapBuffer(&pstSnap->stServer, (int)u32Len);
+    u32Len = 0;
+    for (i = 0; pu8Buf && i < stStream.u32PackCount; i++) {
+        memcpy(pu8Buf + u32Len, astPack[i].pu8Addr + astPack[i].u32Offset, astPack[i].u32Len - astPack[i].u32Offset);
+        u32Len += astPack[i].u32Len - astPack[i].u32Offset;
+    }
+    HI_MPI_VENC_ReleaseStream(pstSnap->VencChn, &stStream);
+
+    /* the next StartRecvPicEx needs the chn stopped, like SAMPLE_COMM_VENC_SnapProcess */
+    if (pstSnap->bRecv) {
+        HI_MPI_VENC_StopRecvPic(pstSnap->VencChn);
+        pstSnap->bRecv = HI_FALSE;
+        u32Us = (HI_U32)(getMonotonicTime() - pstSnap->u64AskedUs);
+        pstSnap->u64EncodeUs += u32Us;
+        if (u32Us > pstSnap->u32MaxEncodeUs) {
+            pstSnap->u32MaxEncodeUs = u32Us;
+        }
+    }
+    pstSnap->u32Encodes++;
+    snapCommit(&pstSnap->stServer, pu8Buf ? (int)u32Len : 0);
+    return 0;
+}
+
+HI_VOID hiliSnapReport(SnapChnContext *pstSnap)
+{
+    const SnapStats *pstStats = &pstSnap->stServer.stats;
+
+    LOGD("snapshots: %u encoded in %llu us avg, %u us max, %u late, %u lost, %u failed, %u dropped while sent; "
+         "%u requests, %u sent (%llu KB), %u not modified, %u unavailable, %u bad, connections full %u times\n",
+         pstSnap->u32Encodes, pstSnap->u32Encodes ? pstSnap->u64EncodeUs / pstSnap->u32Encodes : 0ull,
+         pstSnap->u32MaxEncodeUs, pstSnap->u32Late, pstSnap->u32Lost, pstSnap->u32Failed, pstStats->held,
+         pstStats->requests, pstStats->sent, (HI_U64)(pstStats->bytes >> 10), pstStats->notModified, pstStats->unavailable,
+         pstStats->errors, pstStats->full);
+}
+
+/******************************************************************************
+* funciton : -j, a jpeg chn on the picture of the main stream and the http server
+*            of its latest snapshot
+******************************************************************************/
+HI_S32 hiliSnapStart(ReactorContext *pstReactor, SnapChnContext *pstSnap, VPSS_GRP VpssGrp, VPSS_CHN VpssChn)
+{
+    VENC_PARAM_JPEG_S stJpegParam;
+    const SnapOption *pstOption = &gParamOption.snap;
+    SIZE_S stSize;
+    HI_S32 s32Ret;
+
+    memset(pstSnap, 0, sizeof(SnapChnContext));
+    pstSnap->VencChn = HILI_SNAP_VENC_CHN;
+    pstSnap->VencFd = -1;
+    pstSnap->TimerFd = -1;
+
+    s32Ret = SAMPLE_COMM_SYS_GetPicSize(gs_enNorm, gParamOption.videoSize, &stSize);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_SYS_GetPicSize failed!\n");
+        return s32Ret;
+    }
+
+    s32Ret = SAMPLE_COMM_VENC_SnapStart(pstSnap->VencChn, &stSize, HI_FALSE);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("Start snap Venc failed!\n");
+        return s32Ret;
+    }
+
+    /* every picture asked for, not only the flashed ones */
+    s32Ret = HI_MPI_VENC_SetJpegSnapMode(pstSnap->VencChn, JPEG_SNAP_ALL);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VENC_SetJpegSnapMode failed with %#x!\n", s32Ret);
+        goto ERR_VENC;
+    }
+    if (pstOption->quality) {
+        s32Ret = HI_MPI_VENC_GetJpegParam(pstSnap->VencChn, &stJpegParam);
+        if (HI_SUCCESS == s32Ret) {
+            stJpegParam.u32Qfactor = (HI_U32)pstOption->quality;
+            s32Ret = HI_MPI_VENC_SetJpegParam(pstSnap->VencChn, &stJpegParam);
+        }
+        if (HI_SUCCESS != s32Ret) {
+            LOGE("jpeg quality %d failed with %#x!\n", pstOption->quality, s32Ret);
+        }
+    }
+
+    s32Ret = SAMPLE_COMM_VENC_BindVpss(pstSnap->VencChn, VpssGrp, VpssChn);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("Bind snap Venc failed!\n");
+        goto ERR_VENC;
+    }
+
+    pstSnap->VencFd = HI_MPI_VENC_GetFd(pstSnap->VencChn);
+    if (pstSnap->VencFd < 0 ||
+        reactorAddFd(pstReactor, pstSnap->VencFd, EPOLLIN, hiliSnapStreamHandler, pstSnap) < 0) {
+        LOGE("register snap Venc failed!\n");
+        s32Ret = HI_FAILURE;
+        goto ERR_BIND;
+    }
+
+    if (snapServerInit(&pstSnap->stServer, pstReactor, pstOption->port,
+                       pstOption->frameRate ? 0 : HILI_SNAP_MAX_AGE_MS,
+                       pstOption->frameRate ? NULL : hiliSnapWanted, pstSnap) < 0) {
+        s32Ret = HI_FAILURE;
+        goto ERR_FD;
+    }
+    if (pstOption->frameRate) {
+        pstSnap->TimerFd = reactorAddTimer(pstReactor, 1000 / pstOption->frameRate, hiliSnapTickHandler, pstSnap);
+        if (pstSnap->TimerFd < 0) {
+            LOGE("snap timer failed!\n");
+            snapServerDestroy(&pstSnap->stServer);
+            s32Ret = HI_FAILURE;
+            goto ERR_FD;
+        }
+        hiliSnapAsk(pstSnap);
+    }
+
+    pstSnap->bStarted = HI_TRUE;
+    if (pstOption->frameRate) {
+        LOGD("snapshots %ux%u at %d fps on http tcp %d %s\n", stSize.u32Width, stSize.u32Height,
+             pstOption->frameRate, pstOption->port, SNAP_PATH);
+    } else {
+        LOGD("snapshots %ux%u on request on http tcp %d %s\n", stSize.u32Width, stSize.u32Height,
+             pstOption->port, SNAP_PATH);
+    }
+    return HI_SUCCESS;
+
+ERR_FD:
+    reactorDelFd(pstReactor, pstSnap->VencFd);
+ERR_BIND:
+    SAMPLE_COMM_VENC_UnBindVpss(pstSnap->VencChn, VpssGrp, VpssChn);
+ERR_VENC:
+    SAMPLE_COMM_VENC_SnapStop(pstSnap->VencChn);
+    return s32Ret;
+}
+
+HI_VOID hiliSnapStop(ReactorContext *pstReactor, SnapChnContext *pstSnap, VPSS_GRP VpssGrp, VPSS_CHN VpssChn)
+{
+    reactorDelFd(pstReactor, pstSnap->TimerFd);
+    reactorDelFd(pstReactor, pstSnap->VencFd);
+    hiliSnapReport(pstSnap);
+    snapServerDestroy(&pstSnap->stServer);
+    SAMPLE_COMM_VENC_UnBindVpss(pstSnap->VencChn, VpssGrp, VpssChn);
+    SAMPLE_COMM_VENC_SnapStop(pstSnap->VencChn);
+    pstSnap->bStarted = HI_FALSE;
+}
+
+/******************************************************************************
+* funciton : capture to written (sent) latency of the sinks
+******************************************************************************/
+HI_VOID hiliVencLatencyReport(VencChnContext *pstVenc)
+{
+    SinkLatency stLat;
+    HI_S32 i;
+
+    for (i = 0; i < pstVenc->s32SinkNum; i++) {
+        if (sinkLatency(&pstVenc->astSink[i], &stLat) > 0) {
+            LOGD("sink %s capture to %s latency mean %u us, max %u us, per slice %u us, %u frames, "
+                 "queue delay p99 %u us, max %u us, frame written in %u us at most\n",
+                 pstVenc->astSink[i].ops->name, (pstVenc->astSink[i].ops->caps & SINK_CAP_NETWORK) ? "wire" : "write",
+                 stLat.meanUs, stLat.maxUs, stLat.partMeanUs, stLat.frames, stLat.queueP99Us, stLat.queueMaxUs,
+                 stLat.writeMaxUs);
+        }
+    }
+}
+
+/******************************************************************************
+* funciton : frame sizes since the last report, the peak to mean ratio shows
+*            the bursts the IDRs put on the network
+******************************************************************************/
+HI_VOID hiliVencSizeReport(VencChnContext *pstVenc)
+{
+    HI_U32 u32Mean;
+
+    if (0 == pstVenc->u32StatFrames) {
+        return;
+    }
+    u32Mean = (HI_U32)(pstVenc->u64StatBytes / pstVenc->u32StatFrames);
+    LOGD("venc chn %d frame size mean %u, peak %u bytes, peak/mean %.1f, %u IDRs requested\n", pstVenc->VencChn,
+         u32Mean, pstVenc->u32PeakBytes, u32Mean ? (double)pstVenc->u32PeakBytes / u32Mean : 0.0,
+         pstVenc->u32IdrRequests);
+    if (SUPERFRM_NONE != gParamOption.superFrame.mode) {
+        LOGD("venc chn %d super frames %u over the threshold, about %u frames missing (estimated from the pts)\n",
+             pstVenc->VencChn, pstVenc->u32SuperFrames, pstVenc->u32MissingFrames);
+    }
+    pstVenc->u32SuperFrames = 0;
+    pstVenc->u32MissingFrames = 0;
+    pstVenc->u64StatBytes = 0;
+    pstVenc->u32StatFrames = 0;
+    pstVenc->u32PeakBytes = 0;
+    pstVenc->u32IdrRequests = 0;
+}
+
+/******************************************************************************
+* funciton : watchdog timer, replaces the 2s select() timeout of each loop
+******************************************************************************/
+int hiliVencWatchdogHandler(int fd, uint32_t events, void *arg)
+{
+    VencChnContext *pstVenc = (VencChnContext *)arg;
+
+    if (pstVenc->u32FrameCnt == 0) {
+        LOGE("get venc stream time out!\n");
+    }
+    pstVenc->u32FrameCnt = 0;
+
+    if (++pstVenc->u32Ticks >= HILI_STAT_TICKS) {
+        LOGD("venc chn %d worst pull loop stall %u us\n", pstVenc->VencChn, pstVenc->u32MaxStallUs);
+        hiliVencLatencyReport(pstVenc);
+        hiliVencSizeReport(pstVenc);
+        hiliVencHoldReport(pstVenc);
+        if (pstVenc->u32SeiFailed) {
+            LOGE("venc chn %d %u capture time SEIs not inserted\n", pstVenc->VencChn, pstVenc->u32SeiFailed);
+        }
+        if (gParamOption.gate.holdSeconds > 0) {
+            hiliMotionGateReport(pstVenc);
+        }
+        if (pstVenc->stRoi.stats.results) {
+            hiliRoiReport(pstVenc);
+        }
+        if (pstVenc == &gVencCtx && gSnapCtx.bStarted) {
+            hiliSnapReport(&gSnapCtx);
+        }
+        pstVenc->u32Ticks = 0;
+        pstVenc->u32MaxStallUs = 0;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+* funciton : open sinks of the run modes
+******************************************************************************/
+HI_S32 hiliVencSinkOpen(VencChnContext *pstVenc)
+{
+    HI_CHAR aszUrl[FILE_NAME_LEN];
+    SinkVideoInfo stInfo;
+    SIZE_S stSize;
+    HI_S32 i;
+
+    if (HI_SUCCESS != SAMPLE_COMM_SYS_GetPicSize(gs_enNorm, gParamOption.videoSize, &stSize)) {
+        LOGE("SAMPLE_COMM_SYS_GetPicSize failed!\n");
+        return HI_FAILURE;
+    }
+    stInfo.codec = (gParamOption.videoFormat == PT_H264) ? 0 : 1;
+    stInfo.width = stSize.u32Width;
+    stInfo.height = stSize.u32Height;
+    stInfo.frameRate = gParamOption.frameRate;
+    stInfo.captureExtId = gParamOption.captureTime ? HILI_CAPTURE_EXT_ID : 0;
+    stInfo.layers = gParamOption.layers;
+    stInfo.simulcast = 0;
+    /* the largest frame the venc lets through goes out in a frame time */
+    stInfo.paceKbps = (SUPERFRM_NONE != gParamOption.superFrame.mode) ?
+                      (uint32_t)(gParamOption.superFrame.iKbit * gParamOption.frameRate) : 0;
+
+    if (gParamOption.mode & MODE_FILE) {
+        sprintf(aszUrl, "stream_%s.mp4", getCurrentTime());
+        if (sinkOpen(&pstVenc->astSink[pstVenc->s32SinkNum], &mp4SinkOps, aszUrl, &stInfo)) {
+            LOGE("open mp4 sink [%s] failed!\n", aszUrl);
+            return HI_FAILURE;
+        }
+        pstVenc->s32SinkNum++;
+    }
+
+    if (gParamOption.mode & MODE_ES) {
+        /* decide the stream file name */
+        if (gParamOption.videoFormat == PT_H264) {
+            LOGD("Payload = H.264/AVC\n");
+            sprintf(aszUrl, "stream_%s.h264", getCurrentTime());
+        } else if (gParamOption.videoFormat == PT_H265){
+            LOGD("Payload = HEVC/H.265\n");
+            sprintf(aszUrl, "stream_%s.h265", getCurrentTime());
+        } else {
+            LOGE("Video Format is invalid.\n");
+            return HI_FAILURE;
+        }
+
+        if (sinkOpen(&pstVenc->astSink[pstVenc->s32SinkNum], &fileSinkOps, aszUrl, &stInfo)) {
+            LOGE("open file sink [%s] failed!\n", aszUrl);
+            return HI_FAILURE;
+        }
+        pstVenc->s32SinkNum++;
+    }
+
+    if (gParamOption.mode & MODE_LOOP) {
+        sprintf(aszUrl, "%s", ".");
+        if (sinkOpen(&pstVenc->astSink[pstVenc->s32SinkNum], &loopSinkOps, aszUrl, &stInfo)) {
+            LOGE("open loop sink [%s] failed!\n", aszUrl);
+            return HI_FAILURE;
+        }
+        pstVenc->s32SinkNum++;
+    }
+
+    if (gParamOption.mode & MODE_EVENT) {
+        sprintf(aszUrl, "%s", ".");
+        if (sinkOpen(&pstVenc->astSink[pstVenc->s32SinkNum], &eventSinkOps, aszUrl, &stInfo)) {
+            LOGE("open event sink [%s] failed!\n", aszUrl);
+            return HI_FAILURE;
+        }
+        pstVenc->s32SinkNum++;
+    }
+
+    /* each viewer switches between the main and the sub stream on its own */
+    stInfo.simulcast = (PIC_BUTT != gParamOption.subSize);
+    for (i = 0; (gParamOption.mode & MODE_RTP) && i <= gParamOption.viewerNum; i++) {
+        sprintf(aszUrl, "%s:%d", i ? gParamOption.viewerIp[i - 1] : gParamOption.ip, HILI_RTP_PORT);
+        if (sinkOpen(&pstVenc->astSink[pstVenc->s32SinkNum], &rtpSinkOps, aszUrl, &stInfo)) {
+            LOGE("open rtp sink [%s] failed!\n", aszUrl);
+            return HI_FAILURE;
+        }
+        pstVenc->s32SinkNum++;
+    }
+
+    if (gParamOption.mode & MODE_SHM) {
+        sprintf(aszUrl, "%s", HILI_SHM_BUS);
+        if (sinkOpen(&pstVenc->astSink[pstVenc->s32SinkNum], &shmSinkOps, aszUrl, &stInfo)) {
+            LOGE("open shm sink [%s] failed!\n", aszUrl);
+            return HI_FAILURE;
+        }
+        pstVenc->s32SinkNum++;
+    }
+    stInfo.simulcast = 0;
+
+    return HI_SUCCESS;
+}
+
+HI_VOID hiliVencSinkClose(VencChnContext *pstVenc)
+{
+    HI_S32 i;
+
+    for (i = 0; i < pstVenc->s32SinkNum; i++) {
+        sinkClose(&pstVenc->astSink[i]);
+    }
+    pstVenc->s32SinkNum = 0;
+}
+
+/******************************************************************************
+* funciton : open sinks & register venc fd to reactor. the sub stream of a
+*            simulcast opens none, its frames go to the sinks of pstMain
+******************************************************************************/
+HI_S32 hiliVencStreamRegister(ReactorContext *pstReactor, VencChnContext *pstVenc, VENC_CHN VencChn,
+                              VencChnContext *pstMain)
+{
+    HI_U64 u64Pts;
+    HI_S32 i;
+
+    memset(pstVenc, 0, sizeof(VencChnContext));
+    pstVenc->VencChn = VencChn;
+    pstVenc->pstSinks = pstMain ? pstMain : pstVenc;
+    pstVenc->s32Stream = pstMain ? 1 : 0;
+    pstVenc->bSliceMode = (gParamOption.slices > 0) ? HI_TRUE : HI_FALSE;
+
+    /* venc pts are taken from the system pts at capture */
+    if (HI_SUCCESS == HI_MPI_SYS_GetCurPts(&u64Pts)) {
+        pstVenc->s64PtsOffset = (HI_S64)(getMonotonicTime() - u64Pts);
+    }
+
+    /* the event sink holds its pre-event frames from this pool, slices queue up in front of the frames,
+       storage sinks get copies of borrowed frames */
+    if (framePoolInit(&pstVenc->stFramePool, SINK_QUEUE_SIZE * 2 + 16 +
+                      ((gParamOption.mode & MODE_EVENT) ? gParamOption.event.maxFrames : 0) +
+                      (pstVenc->bSliceMode ? SINK_QUEUE_SIZE : 0))) {
+        return HI_FAILURE;
+    }
+
+    if (HI_SUCCESS != hiliVencHoldInit(&pstVenc->stHold, VencChn, pstReactor)) {
+        framePoolDestroy(&pstVenc->stFramePool);
+        return HI_FAILURE;
+    }
+
+    if (NULL == pstMain && HI_SUCCESS != hiliVencSinkOpen(pstVenc)) {
+        goto ERR;
+    }
+
+    /* worth borrowing if a sink is done with a frame when writeFrame returns */
+    for (i = 0; i < pstVenc->pstSinks->s32SinkNum; i++) {
+        if (!(pstVenc->pstSinks->astSink[i].ops->caps & SINK_CAP_STORAGE)) {
+            pstVenc->bBorrow = HI_TRUE;
+        }
+    }
+
+    /* Set Venc Fd. */
+    pstVenc->VencFd = HI_MPI_VENC_GetFd(VencChn);
+    if (pstVenc->VencFd < 0) {
+        LOGE("HI_MPI_VENC_GetFd failed with %#x!\n", pstVenc->VencFd);
+        goto ERR;
+    }
+    pstVenc->stHold.VencFd = pstVenc->VencFd;
+
+    if (reactorAddFd(pstReactor, pstVenc->VencFd, EPOLLIN, hiliVencStreamHandler, pstVenc) < 0) {
+        LOGE("register venc fd failed!\n");
+        goto ERR;
+    }
+
+    pstVenc->TimerFd = reactorAddTimer(pstReactor, 2000, hiliVencWatchdogHandler, pstVenc);
+
+    return HI_SUCCESS;
+
+ERR:
+    hiliVencSinkClose(pstVenc);
+    hiliVencHoldDeInit(&pstVenc->stHold);
+    framePoolDestroy(&pstVenc->stFramePool);
+    return HI_FAILURE;
+}
+
+HI_VOID hiliVencStreamUnRegister(ReactorContext *pstReactor, VencChnContext *pstVenc)
+{
+    reactorDelFd(pstReactor, pstVenc->TimerFd);
+    reactorDelFd(pstReactor, pstVenc->VencFd);
+    if (gParamOption.gate.holdSeconds > 0) {
+        hiliMotionGateReport(pstVenc);
+    }
+    if (pstVenc->stRoi.stats.results) {
+        hiliRoiReport(pstVenc);
+    }
+    hiliVencLatencyReport(pstVenc);
+    hiliVencSizeReport(pstVenc);
+    hiliVencHoldReport(pstVenc);
+    if (pstVenc->pstAuFrame) {
+        frameUnref(pstVenc->pstAuFrame);
+        pstVenc->pstAuFrame = NULL;
+    }
+
+    /* sinks write out their queued frames before the pool goes, the last borrowed ones release their streams */
+    hiliVencSinkClose(pstVenc);
+    hiliVencHoldDeInit(&pstVenc->stHold);
+    framePoolDestroy(&pstVenc->stFramePool);
+}
+
+/******************************************************************************
+* funciton : start event recording of all event sinks
+******************************************************************************/
+HI_VOID hiliVencEventTrigger(VencChnContext *pstVenc)
+{
+    HI_S32 i;
+
+    for (i = 0; i < pstVenc->s32SinkNum; i++) {
+        if (pstVenc->astSink[i].ops == &eventSinkOps) {
+            eventTrigger(&pstVenc->astSink[i]);
+        }
+    }
+}
+
+/******************************************************************************
+* funciton : vda MD result of one picture, in reactor so never waits for it.
+*            a failed result is skipped, the fd stays for the next ones
+******************************************************************************/
+int hiliVdaMdHandler(int fd, uint32_t events, void *arg)
+{
+    VencChnContext *pstVenc = (VencChnContext *)arg;
+    const VDA_MD_DATA_S *pstMdData;
+    VDA_DATA_S stVdaData;
+    HI_BOOL bMotion;
+    HI_S32 s32Ret;
+
+    s32Ret = HI_MPI_VDA_GetData(HILI_MD_VDA_CHN, &stVdaData, 0);
+    if (HI_ERR_VDA_BUF_EMPTY == s32Ret) {
+        return 0;
+    }
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VDA_GetData failed with %#x!\n", s32Ret);
+        return 0;
+    }
+
+    pstMdData = &stVdaData.unData.stMdData;
+    bMotion = (pstMdData->bObjValid && pstMdData->stObjData.u32ObjNum > 0) ? HI_TRUE : HI_FALSE;
+    if (bMotion) {
+        hiliVencEventTrigger(pstVenc);
+    }
+    if (gParamOption.gate.holdSeconds > 0) {
+        hiliMotionGateUpdate(pstVenc, bMotion);
+    }
+    if (gParamOption.roi.qp) {
+        hiliRoiUpdate(pstVenc, pstMdData);
+    }
+
+    s32Ret = HI_MPI_VDA_ReleaseData(HILI_MD_VDA_CHN, &stVdaData);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_VDA_ReleaseData failed with %#x!\n", s32Ret);
+    }
+    return 0;
+}
+
+/******************************************************************************
+* funciton : external trigger, kill -USR1 <pid>; kill -USR2 <pid> asks for an
+*            IDR when intra refresh is on
+******************************************************************************/
+int hiliTriggerSignalHandler(int fd, uint32_t events, void *arg)
+{
+    VencChnContext *pstVenc = (VencChnContext *)arg;
+    struct signalfd_siginfo stInfo;
+
+    if (read(fd, &stInfo, sizeof(stInfo)) != sizeof(stInfo)) {
+        return 0;
+    }
+    if (SIGUSR2 == stInfo.ssi_signo) {
+        LOGD("IDR requested by pid %u\n", stInfo.ssi_pid);
+        pstVenc->bIdrWanted = HI_TRUE;
+        return 0;
+    }
+    LOGD("external trigger from pid %u\n", stInfo.ssi_pid);
+    hiliVencEventTrigger(pstVenc);
+    return 0;
+}
+
+/******************************************************************************
+* funciton : motion detection on a small vpss chn, results in reactor
+******************************************************************************/
+HI_S32 hiliMotionStart(ReactorContext *pstReactor, VencChnContext *pstVenc, VPSS_GRP VpssGrp)
+{
+    VPSS_CHN_ATTR_S stVpssChnAttr;
+    VPSS_CHN_MODE_S stVpssChnMode;
+    SIZE_S stSize;
+    HI_S32 s32Ret;
+
+    s32Ret = SAMPLE_COMM_SYS_GetPicSize(gs_enNorm, PIC_CIF, &stSize);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_SYS_GetPicSize failed!\n");
+        return s32Ret;
+    }
+
+    stVpssChnMode.enChnMode      = VPSS_CHN_MODE_USER;
+    stVpssChnMode.bDouble        = HI_FALSE;
+    stVpssChnMode.enPixelFormat  = SAMPLE_PIXEL_FORMAT;
+    stVpssChnMode.u32Width       = stSize.u32Width;
+    stVpssChnMode.u32Height      = stSize.u32Height;
+    stVpssChnMode.enCompressMode = COMPRESS_MODE_NONE;
+    memset(&stVpssChnAttr, 0, sizeof(stVpssChnAttr));
+    stVpssChnAttr.s32SrcFrameRate = -1;
+    stVpssChnAttr.s32DstFrameRate = -1;
+    s32Ret = SAMPLE_COMM_VPSS_EnableChn(VpssGrp, HILI_MD_VPSS_CHN, &stVpssChnAttr, &stVpssChnMode, HI_NULL);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("Enable vpss chn failed!\n");
+        return s32Ret;
+    }
+
+    s32Ret = SAMPLE_COMM_VDA_MdCreate(HILI_MD_VDA_CHN, HILI_MD_VPSS_CHN, &stSize);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("VDA Md Start failed!\n");
+        SAMPLE_COMM_VPSS_DisableChn(VpssGrp, HILI_MD_VPSS_CHN);
+        return s32Ret;
+    }
+
+    pstVenc->VdaFd = HI_MPI_VDA_GetFd(HILI_MD_VDA_CHN);
+    if (pstVenc->VdaFd < 0 ||
+        reactorAddFd(pstReactor, pstVenc->VdaFd, EPOLLIN, hiliVdaMdHandler, pstVenc) < 0) {
+        LOGE("VDA Md fd register failed!\n");
+        SAMPLE_COMM_VDA_MdStop(HILI_MD_VDA_CHN, HILI_MD_VPSS_CHN);
+        SAMPLE_COMM_VPSS_DisableChn(VpssGrp, HILI_MD_VPSS_CHN);
+        return HI_FAILURE;
+    }
+
+    if (gParamOption.roi.qp) {
+        hiliRoiStart(pstVenc, &stSize);
+    }
+
+    return HI_SUCCESS;
+}
+
+HI_VOID hiliMotionStop(ReactorContext *pstReactor, VencChnContext *pstVenc, VPSS_GRP VpssGrp)
+{
+    reactorDelFd(pstReactor, pstVenc->VdaFd);
+    SAMPLE_COMM_VDA_MdStop(HILI_MD_VDA_CHN, HILI_MD_VPSS_CHN);
+    SAMPLE_COMM_VPSS_DisableChn(VpssGrp, HILI_MD_VPSS_CHN);
+}
+
+/******************************************************************************
+* funciton : describe the rtp streams for players, e.g. vlc hisilive.sdp
+******************************************************************************/
+HI_S32 hiliWriteSdp(const HI_CHAR *pszPath, const AudioChnContext *pstAudio)
+{
+    FILE *fp = fopen(pszPath, "w");
+
+    if (NULL == fp) {
+        LOGE("open %s failed!\n", pszPath);
+        return HI_FAILURE;
+    }
+
+    fprintf(fp, "v=0\r\no=- 0 0 IN IP4 %s\r\ns=HisiLive\r\nc=IN IP4 %s\r\nt=0 0\r\n",
+            gParamOption.ip, gParamOption.ip);
+    fprintf(fp, "m=video %d RTP/AVP %d\r\na=rtpmap:%d %s/90000\r\na=framerate:%d\r\n",
+            HILI_RTP_PORT, RTP_PT_H264, RTP_PT_H264,
+            (gParamOption.videoFormat == PT_H264) ? "H264" : "H265", gParamOption.frameRate);
+    if (gParamOption.captureTime) {
+        fprintf(fp, "a=extmap:%d %s\r\n", HILI_CAPTURE_EXT_ID, RTP_EXT_ABS_CAPTURE_TIME);
+    }
+    if (pstAudio) {
+        fprintf(fp, "m=audio %d RTP/AVP %d\r\na=rtpmap:%d %s/%u\r\na=ptime:%u\r\n", HILI_AUDIO_PORT,
+                pstAudio->stRtp.pt, pstAudio->stRtp.pt,
+                (PT_G711A == pstAudio->enType) ? "PCMA" : (PT_G711U == pstAudio->enType) ? "PCMU" :
+                (PT_G726 == pstAudio->enType) ? "G726-32" : "DVI4", pstAudio->u32Rate,
+                pstAudio->u32PtNum * pstAudio->u32Aggregate * 1000 / pstAudio->u32Rate);
+    }
+
+    fclose(fp);
+    LOGD("rtp streams described in %s\n", pszPath);
+    return HI_SUCCESS;
+}
+
+/******************************************************************************
+* funciton : send the frames collected so far as one rtp packet
+******************************************************************************/
+HI_VOID hiliAudioPacketSend(AudioChnContext *pstAudio)
+{
+    HI_U64 u64Now = getMonotonicTime();
+    HI_U32 u32HoldUs = (HI_U32)(u64Now - pstAudio->u64PacketGot);
+    HI_U32 u32SendUs = (HI_U32)(u64Now - (pstAudio->u64PacketPts + pstAudio->s64PtsOffset));
+
+    if (0 == pstAudio->u32PacketFrames) {
+        return;
+    }
+
+    pstAudio->stRtp.timestamp = pstAudio->u32PacketTs;
+    rtpSendAudio(&pstAudio->stRtp, &pstAudio->stUdp, pstAudio->au8Packet, (int)pstAudio->u32PacketLen,
+                 pstAudio->s32Mark);
+    pstAudio->s32Mark = 0;
+    pstAudio->u32PacketLen = 0;
+    pstAudio->u32PacketFrames = 0;
+
+    pstAudio->u32Packets++;
+    pstAudio->u64HoldUs += u32HoldUs;
+    pstAudio->u64SendUs += u32SendUs;
+    if (u32HoldUs > pstAudio->u32MaxHoldUs)
+        pstAudio->u32MaxHoldUs = u32HoldUs;
+    if (u32SendUs > pstAudio->u32MaxSendUs)
+        pstAudio->u32MaxSendUs = u32SendUs;
+}
+
+/******************************************************************************
+* funciton : aenc stream readable, collect the frame for the rtp packet of
+*            the next ptime, in reactor
+******************************************************************************/
+int hiliAudioStreamHandler(int fd, uint32_t events, void *arg)
+{
+    AudioChnContext *pstAudio = (AudioChnContext *)arg;
+    AUDIO_STREAM_S stStream;
+    HI_U8 *pu8Data;
+    HI_U32 u32Len, u32Ts;
+    HI_U64 u64Now;
+    HI_S32 s32Ret;
+
+    s32Ret = HI_MPI_AENC_GetStream(pstAudio->AeChn, &stStream, HI_FALSE);
+    if (HI_SUCCESS != s32Ret) {
+        return 0;
+    }
+
+    /* hisi frame header: 0x00 0x01, then the payload length in 16 bit words */
+    pu8Data = stStream.pStream;
+    u32Len = stStream.u32Len;
+    if (u32Len > 4 && 0x00 == pu8Data[0] && 0x01 == pu8Data[1] &&
+        (HI_U32)(pu8Data[2] | pu8Data[3] << 8) * 2 == u32Len - 4) {
+        pu8Data += 4;
+        u32Len -= 4;
+    }
+
+    /* frames follow each other by u32PtNum samples, the pts only corrects lost ones
+       and is on the same clock as the video timestamps */
+    u32Ts = (HI_U32)(stStream.u64TimeStamp * pstAudio->u32Rate / 1000000);
+    if (!pstAudio->bStarted) {
+        pstAudio->u32NextTs = u32Ts;
+        pstAudio->bStarted = HI_TRUE;
+        pstAudio->s32Mark = 1;
+    } else if ((HI_U32)abs((HI_S32)(u32Ts - pstAudio->u32NextTs)) > pstAudio->u32PtNum) {
+        /* a packet holds contiguous samples only */
+        hiliAudioPacketSend(pstAudio);
+        pstAudio->u32NextTs = u32Ts;
+        pstAudio->u32Resyncs++;
+        pstAudio->s32Mark = 1;  // first packet after a gap, receivers adapt their playout here
+    }
+
+    if (pstAudio->u32PacketLen + u32Len > sizeof(pstAudio->au8Packet)) {
+        hiliAudioPacketSend(pstAudio);
+    }
+    if (0 == pstAudio->u32PacketFrames) {
+        pstAudio->u32PacketTs = pstAudio->u32NextTs;
+        pstAudio->u64PacketPts = stStream.u64TimeStamp;
+        pstAudio->u64PacketGot = getMonotonicTime();
+    }
+    memcpy(pstAudio->au8Packet + pstAudio->u32PacketLen, pu8Data, u32Len);
+    pstAudio->u32PacketLen += u32Len;
+    pstAudio->u32PacketFrames++;
+    pstAudio->u32NextTs += pstAudio->u32PtNum;
+    pstAudio->u32Frames++;
+
+    if (pstAudio->u32PacketFrames >= pstAudio->u32Aggregate) {
+        hiliAudioPacketSend(pstAudio);
+    }
+
+    s32Ret = HI_MPI_AENC_ReleaseStream(pstAudio->AeChn, &stStream);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("HI_MPI_AENC_ReleaseStream failed with %#x!\n", s32Ret);
+    }
+
+    u64Now = getMonotonicTime();
+    if (u64Now - pstAudio->u64LastSr >= RTCP_SR_INTERVAL) {
+        pstAudio->u64LastSr = u64Now;
+        rtcpSendSR(&pstAudio->stRtp, &pstAudio->stRtcp, getWallClockTime(),
+                   (HI_U32)((u64Now - pstAudio->s64PtsOffset) * pstAudio->u32Rate / 1000000));
+    }
+    return 0;
+}
+
+/******************************************************************************
+* funciton : rtp payload type and samples of a packet of the audio codecs
+******************************************************************************/
+HI_S32 hiliAudioRtpPt(PAYLOAD_TYPE_E enType)
+{
+    return (PT_G711A == enType) ? RTP_PT_PCMA : (PT_G711U == enType) ? RTP_PT_PCMU :
+           (PT_G726 == enType) ? RTP_PT_G726 : RTP_PT_DVI4;
+}
+
+HI_U32 hiliAudioSamples(PAYLOAD_TYPE_E enType, HI_U32 u32Size)
+{
+    switch (enType) {
+        case PT_G726:   return u32Size * 2;     // 4 bits a sample
+        case PT_ADPCMA: return u32Size > 4 ? (u32Size - 4) * 2 : 0;   // dvi4 state, then 4 bits a sample
+        default:        return u32Size;
+    }
+}
+
+/******************************************************************************
+* funciton : capture and encode audio, its rtp goes to ip:HILI_AUDIO_PORT
+******************************************************************************/
+HI_S32 hiliAudioStart(ReactorContext *pstReactor, AudioChnContext *pstAudio, PAYLOAD_TYPE_E enType, HI_U32 u32Ptime)
+{
+    AIO_ATTR_S stAioAttr;
+    HI_U64 u64Pts;
+    HI_S32 s32Ret;
+
+    memset(pstAudio, 0, sizeof(AudioChnContext));
+    pstAudio->AiDev = SAMPLE_AUDIO_AI_DEV;
+    pstAudio->AiChn = 0;
+    pstAudio->AeChn = 0;
+    pstAudio->AencFd = -1;
+    pstAudio->enType = enType;
+    pstAudio->u32Rate = 8000;   // all of g711, g726 and dvi4 are 8 kHz on rtp
+    pstAudio->u32PtNum = HILI_AUDIO_PTNUM;
+    pstAudio->u32Aggregate = u32Ptime * pstAudio->u32Rate / 1000 / HILI_AUDIO_PTNUM;
+
+    /* a dvi4 packet starts with the coder state of its first sample, frames can't be
+       put together, the aenc frame gets as long as the ptime instead */
+    if (PT_ADPCMA == enType) {
+        pstAudio->u32PtNum = u32Ptime * pstAudio->u32Rate / 1000;
+        pstAudio->u32Aggregate = 1;
+    }
+    pstAudio->stUdp.socket = -1;
+    pstAudio->stRtcp.socket = -1;
+
+    if (HI_SUCCESS == HI_MPI_SYS_GetCurPts(&u64Pts)) {
+        pstAudio->s64PtsOffset = (HI_S64)(getMonotonicTime() - u64Pts);
+    }
+
+    initRTPMuxContext(&pstAudio->stRtp);
+    pstAudio->stRtp.ssrc += 1;  // the video keeps the default one
+    pstAudio->stRtp.pt = hiliAudioRtpPt(enType);
+
+    sprintf(pstAudio->stUdp.dstIp, "%s", gParamOption.ip);
+    pstAudio->stUdp.dstPort = HILI_AUDIO_PORT;
+    pstAudio->stRtcp = pstAudio->stUdp;
+    pstAudio->stRtcp.dstPort++;
+    if (udpInit(&pstAudio->stUdp) || udpInit(&pstAudio->stRtcp)) {
+        LOGE("audio udp init failed!\n");
+        goto ERR_UDP;
+    }
+
+    stAioAttr.enSamplerate   = AUDIO_SAMPLE_RATE_8000;
+    stAioAttr.enBitwidth     = AUDIO_BIT_WIDTH_16;
+    stAioAttr.enWorkmode     = AIO_MODE_I2S_MASTER;
+    stAioAttr.enSoundmode    = AUDIO_SOUND_MODE_MONO;
+    stAioAttr.u32EXFlag      = 0;
+    stAioAttr.u32FrmNum      = 30;
+    stAioAttr.u32PtNumPerFrm = pstAudio->u32PtNum;
+    stAioAttr.u32ChnCnt      = 1;
+    stAioAttr.u32ClkSel      = 0;
+
+    s32Ret = SAMPLE_COMM_AUDIO_CfgAcodec(&stAioAttr);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_AUDIO_CfgAcodec failed!\n");
+        goto ERR_UDP;
+    }
+
+    s32Ret = SAMPLE_COMM_AUDIO_StartAi(pstAudio->AiDev, stAioAttr.u32ChnCnt, &stAioAttr,
+                                       AUDIO_SAMPLE_RATE_BUTT, HI_FALSE, NULL, 0);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_AUDIO_StartAi failed!\n");
+        goto ERR_UDP;
+    }
+
+    s32Ret = SAMPLE_COMM_AUDIO_StartAenc(1, pstAudio->u32PtNum, enType);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_AUDIO_StartAenc failed!\n");
+        goto ERR_AI;
+    }
+
+    s32Ret = SAMPLE_COMM_AUDIO_AencBindAi(pstAudio->AiDev, pstAudio->AiChn, pstAudio->AeChn);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_AUDIO_AencBindAi failed!\n");
+        goto ERR_AENC;
+    }
 
-        if (opt[0] == '-' && opt[1] == 'f' && !opt[2]){
-            val = atoi(argv[optIndex++]);
-            if (val <= 0 || val > 30){
-                printf("frameRate is not in (0, 30]\n");
-                ret = -1;
-            } else
-                gParamOption.frameRate = val;
-            continue;
-        }
+    pstAudio->AencFd = HI_MPI_AENC_GetFd(pstAudio->AeChn);
+    if (pstAudio->AencFd < 0 ||
+        reactorAddFd(pstReactor, pstAudio->AencFd, EPOLLIN, hiliAudioStreamHandler, pstAudio) < 0) {
+        LOGE("register aenc fd failed!\n");
+        SAMPLE_COMM_AUDIO_AencUnbindAi(pstAudio->AiDev, pstAudio->AiChn, pstAudio->AeChn);
+        goto ERR_AENC;
+    }
 
-        else if (opt[0] == '-' && opt[1] == 'b' && !opt[2]){
-            val = atoi(argv[optIndex++]);
-            if (val <= 0 || val > 4096){
-                printf("bitRate is not in (0, 4096]\n");
-                ret = -1;
-            } else
-                gParamOption.bitRate = val;
-            continue;
-        }
+    LOGD("audio pt %d ptime %u ms to %s:%d\n", pstAudio->stRtp.pt, u32Ptime, gParamOption.ip, HILI_AUDIO_PORT);
+    return HI_SUCCESS;
 
-        else if (opt[0] == '-' && opt[1] == 'i' && !opt[2]){
-            str = argv[optIndex++];
-            if (inet_addr(str) == INADDR_NONE){
-                printf("IP is invalid.\n");
-                ret = -1;
-            } else
-                sprintf(gParamOption.ip, "%s", str);
+ERR_AENC:
+    SAMPLE_COMM_AUDIO_StopAenc(1);
+ERR_AI:
+    SAMPLE_COMM_AUDIO_StopAi(pstAudio->AiDev, stAioAttr.u32ChnCnt, HI_FALSE, HI_FALSE);
+ERR_UDP:
+    if (pstAudio->stUdp.socket >= 0)
+        close(pstAudio->stUdp.socket);
+    if (pstAudio->stRtcp.socket >= 0)
+        close(pstAudio->stRtcp.socket);
+    return HI_FAILURE;
+}
+
+HI_VOID hiliAudioStop(ReactorContext *pstReactor, AudioChnContext *pstAudio)
+{
+    reactorDelFd(pstReactor, pstAudio->AencFd);
+    hiliAudioPacketSend(pstAudio);     // the frames of the last, short packet
+    SAMPLE_COMM_AUDIO_AencUnbindAi(pstAudio->AiDev, pstAudio->AiChn, pstAudio->AeChn);
+    SAMPLE_COMM_AUDIO_StopAenc(1);
+    SAMPLE_COMM_AUDIO_StopAi(pstAudio->AiDev, 1, HI_FALSE, HI_FALSE);
+    close(pstAudio->stUdp.socket);
+    close(pstAudio->stRtcp.socket);
+    LOGD("audio sent %u frames in %u packets, %u timestamp resyncs\n",
+         pstAudio->u32Frames, pstAudio->u32Packets, pstAudio->u32Resyncs);
+    if (pstAudio->u32Packets) {
+        LOGD("audio latency: held for the packet mean %.1f max %.1f ms, capture to send mean %.1f max %.1f ms\n",
+             pstAudio->u64HoldUs / 1000.0 / pstAudio->u32Packets, pstAudio->u32MaxHoldUs / 1000.0,
+             pstAudio->u64SendUs / 1000.0 / pstAudio->u32Packets, pstAudio->u32MaxSendUs / 1000.0);
+    }
+}
+
+/******************************************************************************
+* funciton : talkback packets readable, into the jitter buffer, in reactor
+******************************************************************************/
+int hiliTalkRecvHandler(int fd, uint32_t events, void *arg)
+{
+    TalkChnContext *pstTalk = (TalkChnContext *)arg;
+    HI_U8 au8Buf[RTP_PAYLOAD_MAX + 64];
+    RTPPacket stPkt;
+    ssize_t len;
+    HI_U32 u32Samples;
+    HI_S32 i;
+
+    for (i = 0; i < HILI_TALK_BATCH; i++) {
+        len = recv(fd, au8Buf, sizeof(au8Buf), 0);
+        if (len < 0) {
+            break;      // EAGAIN, drained
+        }
+        if (rtpParse(&stPkt, au8Buf, (int)len) < 0 || stPkt.payloadType != pstTalk->s32Pt || stPkt.size <= 0) {
+            pstTalk->u32Invalid++;
             continue;
         }
+        u32Samples = hiliAudioSamples(pstTalk->enType, (HI_U32)stPkt.size);
+        jbPut(&pstTalk->stJb, stPkt.timestamp, stPkt.marker, stPkt.payload, stPkt.size, u32Samples,
+              getMonotonicTime());
+    }
+    return 0;
+}
 
-        else if (opt[0] == '-' && opt[1] == 's' && !opt[2]){
-            videoSize = argv[optIndex++];
-            if (!strcmp(videoSize, "1080p") || !strcmp(videoSize, "1080P")){
-                gParamOption.videoSize = PIC_HD1080;
-            } else if (!strcmp(videoSize, "720p") || !strcmp(videoSize, "720P")){
-                gParamOption.videoSize = PIC_HD720;
-            } else if (!strcmp(videoSize, "D1") || !strcmp(videoSize, "d1")){
-                gParamOption.videoSize = PIC_D1;
-            } else if (!strcmp(videoSize, "CIF") || !strcmp(videoSize, "cif")){
-                gParamOption.videoSize = PIC_CIF;
-            } else {
-                printf("VedeoSize is invalid.\n");
-                ret = -1;
-            }
-            continue;
+/******************************************************************************
+* funciton : talkback timer, what the ao played since the last tick is taken
+*            from the jitter buffer and sent to adec, in reactor
+******************************************************************************/
+int hiliTalkTickHandler(int fd, uint32_t events, void *arg)
+{
+    TalkChnContext *pstTalk = (TalkChnContext *)arg;
+    AUDIO_STREAM_S stStream;
+    JBFrame stFrame;
+    HI_U64 u64Now = getMonotonicTime();
+    HI_U32 u32Len;
+    HI_S32 s32Ret;
+
+    pstTalk->s64Credit += (HI_S64)((u64Now - pstTalk->u64LastTick) * pstTalk->u32Rate / 1000000);
+    pstTalk->u64LastTick = u64Now;
+
+    while (pstTalk->s64Credit > 0) {
+        if (JB_IDLE == jbGet(&pstTalk->stJb, u64Now, &stFrame)) {
+            pstTalk->s64Credit = 0;     // the ao runs dry meanwhile, nothing is owed
+            break;
         }
+        pstTalk->s64Credit -= stFrame.samples;
 
-        else {
-            printf("param [%s] is invalid.\n", opt);
-            ret = -1;
+        if (JB_SILENCE == stFrame.kind) {
+            u32Len = (PT_G726 == pstTalk->enType) ? stFrame.samples / 2 :
+                     (PT_ADPCMA == pstTalk->enType) ? 4 + stFrame.samples / 2 : stFrame.samples;
+            memset(pstTalk->au8Frame + 4, (PT_G711A == pstTalk->enType) ? 0xd5 :
+                   (PT_G711U == pstTalk->enType) ? 0xff : 0x00, u32Len);
+        } else {
+            u32Len = (HI_U32)stFrame.size;
+            memcpy(pstTalk->au8Frame + 4, stFrame.data, u32Len);
+        }
+        u32Len &= ~1u;      // the header counts 16 bit words
+
+        /* adec takes the frames as aenc gives them, behind the hisi frame header */
+        pstTalk->au8Frame[0] = 0x00;
+        pstTalk->au8Frame[1] = 0x01;
+        pstTalk->au8Frame[2] = (HI_U8)(u32Len / 2);
+        pstTalk->au8Frame[3] = (HI_U8)(u32Len / 2 >> 8);
+
+        memset(&stStream, 0, sizeof(stStream));
+        stStream.pStream = pstTalk->au8Frame;
+        stStream.u32Len = 4 + u32Len;
+        stStream.u32Seq = pstTalk->u32Seq++;
+        s32Ret = HI_MPI_ADEC_SendStream(pstTalk->AdChn, &stStream, HI_FALSE);
+        if (HI_SUCCESS != s32Ret) {
+            pstTalk->u32AdecFull++;
         }
     }
-
-    printf("param:\nmode=%s, format=%s, frameRate=%d fps, bitRate=%d kbps, videoSize=%s, IP=%s\n",
-           mode, format, gParamOption.frameRate,
-           gParamOption.bitRate, videoSize, gParamOption.ip);
-
-    return ret;
+    return 0;
 }
 
 /******************************************************************************
-* function : to process abnormal case
+* funciton : play rtp audio received on udp port through adec and ao
 ******************************************************************************/
-void SAMPLE_VENC_HandleSig(HI_S32 signo)
+HI_S32 hiliTalkStart(ReactorContext *pstReactor, TalkChnContext *pstTalk, PAYLOAD_TYPE_E enType, HI_S32 s32Port)
 {
-    if (SIGINT == signo || SIGTERM == signo)
-    {
-        SAMPLE_COMM_ISP_Stop();
-        SAMPLE_COMM_SYS_Exit();
-        LOGE("program termination abnormally!\n");
+    struct sockaddr_in stAddr;
+    AIO_ATTR_S stAioAttr;
+    HI_S32 s32Ret;
+
+    memset(pstTalk, 0, sizeof(TalkChnContext));
+    pstTalk->AoDev = SAMPLE_AUDIO_AO_DEV;
+    pstTalk->AoChn = 0;
+    pstTalk->AdChn = 0;
+    pstTalk->enType = enType;
+    pstTalk->s32Pt = hiliAudioRtpPt(enType);
+    pstTalk->u32Rate = 8000;
+    pstTalk->SockFd = -1;
+    pstTalk->TimerFd = -1;
+    jbInit(&pstTalk->stJb, pstTalk->u32Rate, HILI_AUDIO_PTNUM, (HI_U32)gParamOption.talkMinMs,
+           (HI_U32)gParamOption.talkMaxMs);
+
+    stAioAttr.enSamplerate   = AUDIO_SAMPLE_RATE_8000;
+    stAioAttr.enBitwidth     = AUDIO_BIT_WIDTH_16;
+    stAioAttr.enWorkmode     = AIO_MODE_I2S_MASTER;
+    stAioAttr.enSoundmode    = AUDIO_SOUND_MODE_MONO;
+    stAioAttr.u32EXFlag      = 0;
+    stAioAttr.u32FrmNum      = 30;
+    stAioAttr.u32PtNumPerFrm = HILI_AUDIO_PTNUM;
+    stAioAttr.u32ChnCnt      = 1;
+    stAioAttr.u32ClkSel      = 0;
+
+    s32Ret = SAMPLE_COMM_AUDIO_CfgAcodec(&stAioAttr);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_AUDIO_CfgAcodec failed!\n");
+        return HI_FAILURE;
     }
-    exit(-1);
-}
 
-HI_S32 hiliRTPSendVideo(VENC_STREAM_S* pstStream)
-{   //如果u32PackCount个包的时间一致，可以考虑把u32PackCount个数据拼成一个buff，一起发送。
-    int i;
-    gRTPCtx.payload_type = (gParamOption.videoFormat == PT_H264) ? 0 : 1;
+    s32Ret = SAMPLE_COMM_AUDIO_StartAdec(pstTalk->AdChn, enType);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_AUDIO_StartAdec failed!\n");
+        return HI_FAILURE;
+    }
 
-    for (i = 0; i < pstStream->u32PackCount; i++) {
-        LOGD("packet %d/ %d, %lld", i, pstStream->u32PackCount, pstStream->pstPack[i].u64PTS);
+    s32Ret = SAMPLE_COMM_AUDIO_StartAo(pstTalk->AoDev, stAioAttr.u32ChnCnt, &stAioAttr,
+                                       AUDIO_SAMPLE_RATE_BUTT, HI_FALSE, NULL, 0);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_AUDIO_StartAo failed!\n");
+        goto ERR_ADEC;
+    }
 
-        gRTPCtx.timestamp = (HI_U32) pstStream->pstPack[i].u64PTS * 9 / 100;    // (μs / 10^6) * (90 * 10^3) 
+    s32Ret = SAMPLE_COMM_AUDIO_AoBindAdec(pstTalk->AoDev, pstTalk->AoChn, pstTalk->AdChn);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_AUDIO_AoBindAdec failed!\n");
+        goto ERR_AO;
+    }
 
-        rtpSendH264HEVC(&gRTPCtx, &gUDPCtx, 
-                        pstStream->pstPack[i].pu8Addr + pstStream->pstPack[i].u32Offset,    // stream ptr
-                        pstStream->pstPack[i].u32Len - pstStream->pstPack[i].u32Offset);    // stream length
+    memset(&stAddr, 0, sizeof(stAddr));
+    stAddr.sin_family = AF_INET;
+    stAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    stAddr.sin_port = htons((HI_U16)s32Port);
+    pstTalk->SockFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (pstTalk->SockFd < 0 || bind(pstTalk->SockFd, (struct sockaddr *)&stAddr, sizeof(stAddr)) < 0 ||
+        reactorAddFd(pstReactor, pstTalk->SockFd, EPOLLIN, hiliTalkRecvHandler, pstTalk) < 0) {
+        LOGE("talkback udp port %d failed!\n", s32Port);
+        goto ERR_BIND;
+    }
 
+    pstTalk->u64LastTick = getMonotonicTime();
+    pstTalk->TimerFd = reactorAddTimer(pstReactor, HILI_AUDIO_PTNUM * 1000 / pstTalk->u32Rate,
+                                       hiliTalkTickHandler, pstTalk);
+    if (pstTalk->TimerFd < 0) {
+        LOGE("talkback timer failed!\n");
+        reactorDelFd(pstReactor, pstTalk->SockFd);
+        goto ERR_BIND;
     }
-    
-    return 0;
+
+    LOGD("talkback pt %d on udp %d, jitter buffer %d-%d ms\n", pstTalk->s32Pt, s32Port,
+         gParamOption.talkMinMs, gParamOption.talkMaxMs);
+    return HI_SUCCESS;
+
+ERR_BIND:
+    if (pstTalk->SockFd >= 0)
+        close(pstTalk->SockFd);
+    SAMPLE_COMM_AUDIO_AoUnbindAdec(pstTalk->AoDev, pstTalk->AoChn, pstTalk->AdChn);
+ERR_AO:
+    SAMPLE_COMM_AUDIO_StopAo(pstTalk->AoDev, stAioAttr.u32ChnCnt, HI_FALSE, HI_FALSE);
+ERR_ADEC:
+    SAMPLE_COMM_AUDIO_StopAdec(pstTalk->AdChn);
+    return HI_FAILURE;
+}
+
+HI_VOID hiliTalkStop(ReactorContext *pstReactor, TalkChnContext *pstTalk)
+{
+    const JBStats *pstStats = &pstTalk->stJb.stats;
+
+    reactorDelFd(pstReactor, pstTalk->TimerFd);
+    reactorDelFd(pstReactor, pstTalk->SockFd);
+    close(pstTalk->SockFd);
+    SAMPLE_COMM_AUDIO_AoUnbindAdec(pstTalk->AoDev, pstTalk->AoChn, pstTalk->AdChn);
+    SAMPLE_COMM_AUDIO_StopAo(pstTalk->AoDev, 1, HI_FALSE, HI_FALSE);
+    SAMPLE_COMM_AUDIO_StopAdec(pstTalk->AdChn);
+
+    LOGD("talkback received %u, played %u, late %u, dup %u, lost %u, underrun %u, dropped %u, "
+         "invalid %u, adec full %u, target %u ms\n", pstStats->received, pstStats->played, pstStats->late,
+         pstStats->duplicates, pstStats->lost, pstStats->underruns, pstStats->dropped,
+         pstTalk->u32Invalid, pstTalk->u32AdecFull, jbTargetMs(&pstTalk->stJb));
 }
 
 /******************************************************************************
-* funciton : get stream from each channels and save them
+* funciton : replay a recorded stream through the sinks instead of the encoder,
+*            runs on any linux host, ends with the file
 ******************************************************************************/
-HI_VOID* hiliGetVencStreamProc(HI_VOID* p)
+HI_S32 hiliReplayRun(HI_VOID)
 {
-    // HI_S32 i=0;
-    // HI_S32 s32ChnTotal;
-    SAMPLE_VENC_GETSTREAM_PARA_S* pstPara;
-    HI_S32 maxfd = 0;
-    struct timeval TimeoutVal;
-    fd_set read_fds;
-    HI_S32 VencFd;
-    HI_CHAR aszFileName[FILE_NAME_LEN];
-    FILE* pFile;
-
-    VENC_CHN_STAT_S stStat;
+    VencChnContext *pstVenc = &gVencCtx;
+    ReplayContext stReplay;
     VENC_STREAM_S stStream;
+    MediaFrame *pstFrame;
+    HI_U64 u64Start, u64Bytes = 0;
+    HI_U32 u32Frames = 0, u32Dropped = 0, u32Ms;
     HI_S32 s32Ret;
-    VENC_CHN VencChn = 0;
-
-    pstPara = (SAMPLE_VENC_GETSTREAM_PARA_S*)p;
-    // s32ChnTotal = pstPara->s32Cnt;
 
-    /******************************************
-     step 1:  check & prepare save-file & venc-fd
-    ******************************************/
-    /* decide the stream file name, and open file to save stream */
-    if (gParamOption.mode == MODE_FILE) {
-        if (gParamOption.videoFormat == PT_H264) {
-            LOGD("Payload = H.264/AVC\n");
-            sprintf(aszFileName, "stream_%s.h264", getCurrentTime());
-        } else if (gParamOption.videoFormat == PT_H265){
-            LOGD("Payload = HEVC/H.265\n");
-            sprintf(aszFileName, "stream_%s.h265", getCurrentTime());
-        } else {
-            LOGE("Video Format is invalid.\n");
-            return NULL;
-        }
-
-        pFile = fopen(aszFileName, "wb");
-        if (!pFile) {
-            LOGE("open file[%s] failed!\n", aszFileName);
-            return NULL;
-        }
+    memset(pstVenc, 0, sizeof(VencChnContext));
+    pstVenc->pstSinks = pstVenc;
+    if (framePoolInit(&pstVenc->stFramePool, SINK_QUEUE_SIZE + 16 +
+                      ((gParamOption.mode & MODE_EVENT) ? gParamOption.event.maxFrames : 0))) {
+        return HI_FAILURE;
     }
 
-    /* Set Venc Fd. */
-    VencFd = HI_MPI_VENC_GetFd(0);
-    if (VencFd < 0) {
-        LOGE("HI_MPI_VENC_GetFd failed with %#x!\n", VencFd);
-        return NULL;
-    }
-    
-    if (maxfd <= VencFd) {
-        maxfd = VencFd;
+    if (replayOpen(&stReplay, gParamOption.replayFile, (gParamOption.videoFormat == PT_H264) ? 0 : 1,
+                   gParamOption.frameRate, gParamOption.replaySpeed, gParamOption.replayLoops) < 0) {
+        framePoolDestroy(&pstVenc->stFramePool);
+        return HI_FAILURE;
     }
 
-    /******************************************
-     step 2:  Start to get streams of each channel.
-    ******************************************/
-    while (HI_TRUE == pstPara->bThreadStart)
-    {
-        FD_ZERO(&read_fds);
+    if (HI_SUCCESS != hiliVencSinkOpen(pstVenc)) {
+        s32Ret = HI_FAILURE;
+        goto END;
+    }
 
-        FD_SET(VencFd, &read_fds);
+    LOGD("replay %s at speed %.2f\n", gParamOption.replayFile, gParamOption.replaySpeed);
+    u64Start = getMonotonicTime();
+    while ((s32Ret = replayNext(&stReplay, &stStream)) > 0) {
+        pstFrame = hiliVencStreamToFrame(&pstVenc->stFramePool, &stStream);
 
-        TimeoutVal.tv_sec  = 2;
-        TimeoutVal.tv_usec = 0;
-        s32Ret = select(maxfd + 1, &read_fds, NULL, NULL, &TimeoutVal);
-        if (s32Ret < 0) {
-            LOGE("select failed!\n");
-            break;
-        } 
-        else if (s32Ret == 0) {
-            LOGE("get venc stream time out, exit thread\n");
+        /* as fast as possible means as fast as the sinks take it, paced replay drops like the encoder */
+        while (NULL == pstFrame && 0 == gParamOption.replaySpeed) {
+            usleep(1000);
+            pstFrame = hiliVencStreamToFrame(&pstVenc->stFramePool, &stStream);
+        }
+        if (NULL == pstFrame) {
+            u32Dropped++;
             continue;
         }
-        else {
-            if (FD_ISSET(VencFd, &read_fds)) {
-                /*******************************************************
-                 step 2.1 : query how many packs in one-frame stream.
-                *******************************************************/
-                memset(&stStream, 0, sizeof(stStream));
-                s32Ret = HI_MPI_VENC_Query(VencChn, &stStat);
-                if (HI_SUCCESS != s32Ret) {
-                    LOGE("HI_MPI_VENC_Query failed with %#x!\n", s32Ret);
-                    break;
-                }
-                    
-                /*******************************************************
-                 step 2.2 :suggest to check both u32CurPacks and u32LeftStreamFrames at the same time,for example:
-                 if(0 == stStat.u32CurPacks || 0 == stStat.u32LeftStreamFrames)
-                 {
-                    SAMPLE_PRT("NOTE: Current  frame is NULL!\n");
-                    continue;
-                 }
-                *******************************************************/
-                if(0 == stStat.u32CurPacks) {
-                    LOGE("NOTE: Current  frame is NULL!\n");
-                    continue;
-                }
-                /*******************************************************
-                 step 2.3 : malloc corresponding number of pack nodes.
-                *******************************************************/
-                stStream.pstPack = (VENC_PACK_S*)malloc(sizeof(VENC_PACK_S) * stStat.u32CurPacks);
-                if (NULL == stStream.pstPack) {
-                    LOGE("malloc stream pack failed!\n");
-                    break;
-                }
 
-                /*******************************************************
-                 step 2.4 : call mpi to get one-frame stream
-                *******************************************************/
-                stStream.u32PackCount = stStat.u32CurPacks;
-                s32Ret = HI_MPI_VENC_GetStream(VencChn, &stStream, HI_TRUE);
-                if (HI_SUCCESS != s32Ret) {
-                    free(stStream.pstPack);
-                    stStream.pstPack = NULL;
-                    LOGE("HI_MPI_VENC_GetStream failed with %#x!\n", s32Ret);
-                    break;
-                }
+        u64Bytes += pstFrame->size;
+        u32Frames++;
+        hiliVencDispatch(pstVenc, pstFrame);
+    }
 
-                /*******************************************************
-                 step 2.5 : save frame to file
-                *******************************************************/
-                if (gParamOption.mode == MODE_FILE) {
-                    s32Ret = SAMPLE_COMM_VENC_SaveStream(gParamOption.videoFormat, pFile, &stStream);
-                } 
-                else if (gParamOption.mode == MODE_RTP) {
-                    s32Ret = hiliRTPSendVideo(&stStream);
-                }
-                else {
-                    LOGE("Current Mode is not supported.\n");
-                    break;
-                }
+    u32Ms = (HI_U32)((getMonotonicTime() - u64Start) / 1000);
+    LOGD("replay %u frames %llu KB in %u ms, %.1f fps, %u dropped\n", u32Frames, u64Bytes >> 10, u32Ms,
+         u32Ms ? u32Frames * 1000.0 / u32Ms : 0.0, u32Dropped);
+    s32Ret = (s32Ret < 0) ? HI_FAILURE : HI_SUCCESS;
 
-                if (HI_SUCCESS != s32Ret) {
-                    free(stStream.pstPack);
-                    stStream.pstPack = NULL;
-                    LOGE("save stream failed!\n");
-                    break;
-                }
-                /*******************************************************
-                 step 2.6 : release stream
-                *******************************************************/
-                s32Ret = HI_MPI_VENC_ReleaseStream(0, &stStream);
-                if (HI_SUCCESS != s32Ret) {
-                    free(stStream.pstPack);
-                    stStream.pstPack = NULL;
-                    break;
-                }
-                
-                /*******************************************************
-                 step 2.7 : free pack nodes
-                *******************************************************/
-                free(stStream.pstPack);
-                stStream.pstPack = NULL;
-            }
+END:
+    hiliVencSinkClose(pstVenc);
+    replayClose(&stReplay);
+    framePoolDestroy(&pstVenc->stFramePool);
+    return s32Ret;
+}
+
+/******************************************************************************
+* funciton : the only media thread, all media fds are dispatched by gReactor
+******************************************************************************/
+HI_VOID* hiliReactorProc(HI_VOID* p)
+{
+    reactorRun((ReactorContext *)p);
+    return NULL;
+}
+
+/******************************************************************************
+* funciton : split each frame into slices of equal rows, set before the chn starts
+******************************************************************************/
+HI_S32 hiliVencSliceSplit(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, HI_U32 u32Height, HI_U32 u32Slices)
+{
+    VENC_PARAM_H264_SLICE_SPLIT_S stH264Split;
+    VENC_PARAM_H265_SLICE_SPLIT_S stH265Split;
+    HI_U32 u32Rows;
+    HI_S32 s32Ret;
+
+    if (PT_H264 == enType) {
+        u32Rows = (u32Height + 15) / 16;    // macroblock rows
+        s32Ret = HI_MPI_VENC_GetH264SliceSplit(VencChn, &stH264Split);
+        if (HI_SUCCESS == s32Ret) {
+            stH264Split.bSplitEnable = HI_TRUE;
+            stH264Split.u32SplitMode = 1;
+            stH264Split.u32SliceSize = (u32Rows + u32Slices - 1) / u32Slices;
+            s32Ret = HI_MPI_VENC_SetH264SliceSplit(VencChn, &stH264Split);
+        }
+    } else {
+        u32Rows = (u32Height + HILI_H265_LCU - 1) / HILI_H265_LCU;
+        s32Ret = HI_MPI_VENC_GetH265SliceSplit(VencChn, &stH265Split);
+        if (HI_SUCCESS == s32Ret) {
+            stH265Split.bSplitEnable = HI_TRUE;
+            stH265Split.u32SplitMode = 1;
+            stH265Split.u32SliceSize = (u32Rows + u32Slices - 1) / u32Slices;
+            s32Ret = HI_MPI_VENC_SetH265SliceSplit(VencChn, &stH265Split);
         }
     }
 
-    /*******************************************************
-    * step 3 : close save-file
-    *******************************************************/
-    fclose(pFile);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("venc chn %d slice split failed with %#x!\n", VencChn, s32Ret);
+    } else {
+        LOGD("venc chn %d in %u slices of %u rows\n", VencChn, u32Slices, (u32Rows + u32Slices - 1) / u32Slices);
+    }
+    return s32Ret;
+}
 
-    return NULL;
+/******************************************************************************
+* funciton : vpss hands a picture on after u32LineCnt lines instead of the
+*            whole frame, so the venc starts the first slice early
+******************************************************************************/
+HI_S32 hiliVpssLowDelay(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, HI_U32 u32Height, HI_U32 u32Slices)
+{
+    VPSS_LOW_DELAY_INFO_S stLowDelay;
+    HI_U32 u32LineCnt = (u32Height / u32Slices + 15) & ~15;     // one slice, 16 lines aligned
+    HI_S32 s32Ret;
+
+    stLowDelay.bEnable = HI_TRUE;
+    stLowDelay.u32LineCnt = (u32LineCnt < u32Height) ? u32LineCnt : u32Height;
+    s32Ret = HI_MPI_VPSS_SetLowDelayAttr(VpssGrp, VpssChn, &stLowDelay);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("vpss low delay is not available, %#x\n", s32Ret);
+    } else {
+        LOGD("vpss chn %d low delay after %u lines\n", VpssChn, stLowDelay.u32LineCnt);
+    }
+    return s32Ret;
 }
 
 /******************************************************************************
 * funciton : Start venc stream mode (h265, h264, mjpeg)
 * note      : rate control parameter need adjust, according your case.
 ******************************************************************************/
-HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNorm, PIC_SIZE_E enSize, SAMPLE_RC_E enRcMode, HI_U32  u32Profile)
+HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNorm, PIC_SIZE_E enSize, SAMPLE_RC_E enRcMode, HI_U32  u32Profile,
+                     HI_U32 u32BitRate)
 {
     HI_S32 s32Ret;
     VENC_CHN_ATTR_S stVencChnAttr;
@@ -414,7 +2983,7 @@ HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNor
             stH264Attr.u32PicHeight = stPicSize.u32Height;/*the picture height*/
             stH264Attr.u32BufSize  = stPicSize.u32Width * stPicSize.u32Height * 2;/*stream buffer size*/
             stH264Attr.u32Profile  = u32Profile;/*0: baseline; 1:MP; 2:HP;  3:svc_t */
-            stH264Attr.bByFrame = HI_TRUE;/*get stream mode is slice mode or frame mode?*/
+            stH264Attr.bByFrame = gParamOption.slices ? HI_FALSE : HI_TRUE;/*get stream mode is slice mode or frame mode?*/
             stH264Attr.u32BFrameNum = 0;/* 0: not support B frame; >=1: number of B frames */
             stH264Attr.u32RefNum = 1;/* 0: default; number of refrence frame*/
             memcpy(&stVencChnAttr.stVeAttr.stAttrH264e, &stH264Attr, sizeof(VENC_ATTR_H264_S));
@@ -422,12 +2991,12 @@ HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNor
             if (SAMPLE_RC_CBR == enRcMode)
             {
                 stVencChnAttr.stRcAttr.enRcMode = VENC_RC_MODE_H264CBR;
-                stH264Cbr.u32Gop            = (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
+                stH264Cbr.u32Gop            = gParamOption.refreshFrames ? HILI_REFRESH_GOP : (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
                 stH264Cbr.u32StatTime       = 1; /* stream rate statics time(s) */
                 stH264Cbr.u32SrcFrmRate      = (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30; /* input (vi) frame rate */
                 /* customed framerate & bitrate */
                 stH264Cbr.fr32DstFrmRate = gParamOption.frameRate;
-                stH264Cbr.u32BitRate = gParamOption.bitRate; /* average bit rate */
+                stH264Cbr.u32BitRate = u32BitRate; /* average bit rate */
                 stH264Cbr.u32FluctuateLevel = 0; /* average bit rate */
                 memcpy(&stVencChnAttr.stRcAttr.stAttrH264Cbr, &stH264Cbr, sizeof(VENC_ATTR_H264_CBR_S));
             }
@@ -435,14 +3004,14 @@ HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNor
             else if (SAMPLE_RC_VBR == enRcMode)
             {
                 stVencChnAttr.stRcAttr.enRcMode = VENC_RC_MODE_H264VBR;
-                stH264Vbr.u32Gop = (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
+                stH264Vbr.u32Gop = gParamOption.refreshFrames ? HILI_REFRESH_GOP : (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
                 stH264Vbr.u32StatTime = 1;
                 stH264Vbr.u32SrcFrmRate = (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
                 stH264Vbr.fr32DstFrmRate = (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
                 stH264Vbr.u32MinQp = 10;
                 stH264Vbr.u32MaxQp = 40;
 
-                stH264Vbr.u32MaxBitRate = gParamOption.bitRate; /* average bit rate */
+                stH264Vbr.u32MaxBitRate = u32BitRate; /* average bit rate */
  
                 memcpy(&stVencChnAttr.stRcAttr.stAttrH264Vbr, &stH264Vbr, sizeof(VENC_ATTR_H264_VBR_S));
             }
@@ -464,7 +3033,7 @@ HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNor
             { stH265Attr.u32Profile = 0; }/*0:MP; */
             else
             { stH265Attr.u32Profile  = u32Profile; }/*0:MP*/
-            stH265Attr.bByFrame = HI_TRUE;/*get stream mode is slice mode or frame mode?*/
+            stH265Attr.bByFrame = gParamOption.slices ? HI_FALSE : HI_TRUE;/*get stream mode is slice mode or frame mode?*/
             stH265Attr.u32BFrameNum = 0;/* 0: not support B frame; >=1: number of B frames */
             stH265Attr.u32RefNum = 1;/* 0: default; number of refrence frame*/
             memcpy(&stVencChnAttr.stVeAttr.stAttrH265e, &stH265Attr, sizeof(VENC_ATTR_H265_S));
@@ -472,13 +3041,13 @@ HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNor
             if (SAMPLE_RC_CBR == enRcMode)
             {
                 stVencChnAttr.stRcAttr.enRcMode = VENC_RC_MODE_H265CBR;
-                stH265Cbr.u32Gop            = (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
+                stH265Cbr.u32Gop            = gParamOption.refreshFrames ? HILI_REFRESH_GOP : (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
                 stH265Cbr.u32StatTime       = 1; /* stream rate statics time(s) */
                 stH265Cbr.u32SrcFrmRate      = (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30; /* input (vi) frame rate */
 
                 /* customed framerate & bitrate */
                 stH265Cbr.fr32DstFrmRate = gParamOption.frameRate; /* target frame rate */
-                stH265Cbr.u32BitRate = gParamOption.bitRate; /* average bit rate */
+                stH265Cbr.u32BitRate = u32BitRate; /* average bit rate */
 
                 stH265Cbr.u32FluctuateLevel = 0; /* average bit rate */
                 memcpy(&stVencChnAttr.stRcAttr.stAttrH265Cbr, &stH265Cbr, sizeof(VENC_ATTR_H265_CBR_S));
@@ -486,7 +3055,7 @@ HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNor
             else if (SAMPLE_RC_VBR == enRcMode)
             {
                 stVencChnAttr.stRcAttr.enRcMode = VENC_RC_MODE_H265VBR;
-                stH265Vbr.u32Gop = (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
+                stH265Vbr.u32Gop = gParamOption.refreshFrames ? HILI_REFRESH_GOP : (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
                 stH265Vbr.u32StatTime = 1;
                 stH265Vbr.u32SrcFrmRate = (VIDEO_ENCODING_MODE_PAL == enNorm) ? 25 : 30;
                 stH265Vbr.u32MinQp = 10;
@@ -494,7 +3063,7 @@ HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNor
                 
                 /* customed framerate & bitrate */
                 stH265Vbr.fr32DstFrmRate = gParamOption.frameRate; /* target frame rate */
-                stH265Vbr.u32MaxBitRate = gParamOption.bitRate; /* average bit rate */
+                stH265Vbr.u32MaxBitRate = u32BitRate; /* average bit rate */
                 memcpy(&stVencChnAttr.stRcAttr.stAttrH265Vbr, &stH265Vbr, sizeof(VENC_ATTR_H265_VBR_S));
             }
             else
@@ -515,6 +3084,27 @@ HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNor
         return s32Ret;
     }
 
+    if (gParamOption.slices > 0)
+    {
+        /* one slice per frame still works, only later */
+        hiliVencSliceSplit(VencChn, enType, stPicSize.u32Height, gParamOption.slices);
+    }
+
+    if (gParamOption.refreshFrames > 0)
+    {
+        hiliVencIntraRefresh(VencChn, enType, stPicSize.u32Height, (HI_U32)gParamOption.refreshFrames);
+    }
+
+    if (SUPERFRM_NONE != gParamOption.superFrame.mode)
+    {
+        hiliVencSuperFrame(VencChn, &gParamOption.superFrame);
+    }
+
+    if (gParamOption.layers > 1)
+    {
+        hiliVencTemporalLayers(VencChn, (HI_U32)gParamOption.layers);
+    }
+
     /******************************************
      step 2:  Start Recv Venc Pictures
     ******************************************/
@@ -530,6 +3120,79 @@ HI_S32 hiliVENCStart(VENC_CHN VencChn, PAYLOAD_TYPE_E enType, VIDEO_NORM_E enNor
 }
 
 
+/******************************************************************************
+* funciton : -u, encode the smaller picture of a vpss chn of its own as the
+*            sub stream, each rtp viewer takes the one its network keeps up with
+******************************************************************************/
+HI_S32 hiliSubStreamStart(ReactorContext *pstReactor, VencChnContext *pstMain, VPSS_GRP VpssGrp,
+                          SAMPLE_RC_E enRcMode, HI_U32 u32Profile)
+{
+    VPSS_CHN_ATTR_S stVpssChnAttr;
+    VPSS_CHN_MODE_S stVpssChnMode;
+    SIZE_S stSize;
+    HI_S32 s32Ret;
+
+    s32Ret = SAMPLE_COMM_SYS_GetPicSize(gs_enNorm, gParamOption.subSize, &stSize);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("SAMPLE_COMM_SYS_GetPicSize failed!\n");
+        return s32Ret;
+    }
+
+    stVpssChnMode.enChnMode      = VPSS_CHN_MODE_USER;
+    stVpssChnMode.bDouble        = HI_FALSE;
+    stVpssChnMode.enPixelFormat  = SAMPLE_PIXEL_FORMAT;
+    stVpssChnMode.u32Width       = stSize.u32Width;
+    stVpssChnMode.u32Height      = stSize.u32Height;
+    stVpssChnMode.enCompressMode = COMPRESS_MODE_SEG;
+    memset(&stVpssChnAttr, 0, sizeof(stVpssChnAttr));
+    stVpssChnAttr.s32SrcFrameRate = -1;
+    stVpssChnAttr.s32DstFrameRate = -1;
+    s32Ret = SAMPLE_COMM_VPSS_EnableChn(VpssGrp, HILI_SUB_VPSS_CHN, &stVpssChnAttr, &stVpssChnMode, HI_NULL);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("Enable vpss chn failed!\n");
+        return s32Ret;
+    }
+
+    s32Ret = hiliVENCStart(HILI_SUB_VENC_CHN, gParamOption.videoFormat, gs_enNorm, gParamOption.subSize,
+                           enRcMode, u32Profile, gParamOption.subBitRate);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("Start sub Venc failed!\n");
+        goto ERR_VPSS;
+    }
+
+    s32Ret = SAMPLE_COMM_VENC_BindVpss(HILI_SUB_VENC_CHN, VpssGrp, HILI_SUB_VPSS_CHN);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("Bind sub Venc failed!\n");
+        goto ERR_VENC;
+    }
+
+    s32Ret = hiliVencStreamRegister(pstReactor, &gSubVencCtx, HILI_SUB_VENC_CHN, pstMain);
+    if (HI_SUCCESS != s32Ret) {
+        LOGE("Register sub Venc failed!\n");
+        goto ERR_BIND;
+    }
+    LOGD("sub stream %ux%u at %d kbps\n", stSize.u32Width, stSize.u32Height, gParamOption.subBitRate);
+
+    return HI_SUCCESS;
+
+ERR_BIND:
+    SAMPLE_COMM_VENC_UnBindVpss(HILI_SUB_VENC_CHN, VpssGrp, HILI_SUB_VPSS_CHN);
+ERR_VENC:
+    SAMPLE_COMM_VENC_Stop(HILI_SUB_VENC_CHN);
+ERR_VPSS:
+    SAMPLE_COMM_VPSS_DisableChn(VpssGrp, HILI_SUB_VPSS_CHN);
+    return s32Ret;
+}
+
+/* after the main stream unregistered, its sinks may hold frames of the sub one till they close */
+HI_VOID hiliSubStreamStop(ReactorContext *pstReactor, VPSS_GRP VpssGrp)
+{
+    hiliVencStreamUnRegister(pstReactor, &gSubVencCtx);
+    SAMPLE_COMM_VENC_UnBindVpss(HILI_SUB_VENC_CHN, VpssGrp, HILI_SUB_VPSS_CHN);
+    SAMPLE_COMM_VENC_Stop(HILI_SUB_VENC_CHN);
+    SAMPLE_COMM_VPSS_DisableChn(VpssGrp, HILI_SUB_VPSS_CHN);
+}
+
 /******************************************************************************
 * function :  H.264@1080p@30fps+H.265@1080p@30fps+H.264@D1@30fps
 ******************************************************************************/
@@ -549,14 +3212,18 @@ HI_S32 SAMPLE_VENC_1080P_CLASSIC(HI_VOID)
     VENC_CHN VencChn;
     SAMPLE_RC_E enRcMode = SAMPLE_RC_CBR;   // or SAMPLE_RC_VBR
 
-    HI_S32 s32ChnNum = 1; // use 1 channel video
-
     HI_S32 s32Ret = HI_SUCCESS;
     HI_U32 u32BlkSize;
     SIZE_S stSize;
 
-    SAMPLE_VENC_GETSTREAM_PARA_S stPara;
-    pthread_t vencPid;
+    pthread_t reactorPid;
+    HI_BOOL bMotion = HI_FALSE;
+    HI_BOOL bAudio = HI_FALSE;
+    HI_BOOL bTalk = HI_FALSE;
+    HI_BOOL bSub = HI_FALSE;
+    HI_BOOL bSnap = HI_FALSE;
+    HI_S32 s32SigFd = -1;
+    sigset_t stSigMask;
 
     /******************************************
      step  1: init sys variable
@@ -646,14 +3313,22 @@ HI_S32 SAMPLE_VENC_1080P_CLASSIC(HI_VOID)
         goto END_VENC_1080P_CLASSIC_4;
     }
 
+    if (gParamOption.slices > 0)
+    {
+        hiliVpssLowDelay(VpssGrp, VpssChn, stSize.u32Height, gParamOption.slices);
+    }
+
     /******************************************
      step 5: start stream venc
     ******************************************/
     VpssGrp = 0;
     VpssChn = 0;
     VencChn = 0;
+    if (gParamOption.layers > 1 && PT_H264 == gParamOption.videoFormat) {
+        u32Profile = 3;
+    }
     s32Ret = hiliVENCStart(VencChn, gParamOption.videoFormat, \
-                                    gs_enNorm, gParamOption.videoSize, enRcMode, u32Profile);
+                                    gs_enNorm, gParamOption.videoSize, enRcMode, u32Profile, gParamOption.bitRate);
     if (HI_SUCCESS != s32Ret)
     {
         LOGE("Start Venc failed!\n");
@@ -668,16 +3343,67 @@ HI_S32 SAMPLE_VENC_1080P_CLASSIC(HI_VOID)
     }
 
     /******************************************
-     step 6: stream venc process -- get stream, then save it to file.
+     step 6: stream venc process -- get stream, then dispatch it to sinks.
     ******************************************/
-    stPara.bThreadStart = HI_TRUE;
-    stPara.s32Cnt = s32ChnNum;
+    s32Ret = hiliVencStreamRegister(&gReactor, &gVencCtx, VencChn, NULL);
+    if (HI_SUCCESS != s32Ret)
+    {
+        LOGE("Start Venc failed!\n");
+        goto END_VENC_1080P_CLASSIC_5;
+    }
+
+    if ((gParamOption.mode & MODE_EVENT) || gParamOption.gate.holdSeconds > 0 || gParamOption.roi.qp) {
+        bMotion = (HI_SUCCESS == hiliMotionStart(&gReactor, &gVencCtx, VpssGrp));
+    }
+
+    if (PIC_BUTT != gParamOption.subSize) {
+        bSub = (HI_SUCCESS == hiliSubStreamStart(&gReactor, &gVencCtx, VpssGrp, enRcMode, u32Profile));
+    }
+
+    if (gParamOption.snap.port) {
+        bSnap = (HI_SUCCESS == hiliSnapStart(&gReactor, &gSnapCtx, VpssGrp, VpssChn));
+    }
+
+    if ((gParamOption.mode & MODE_EVENT) || gParamOption.refreshFrames) {
+        /* SIGUSR1 and SIGUSR2 are blocked in main(), taken here from a signalfd */
+        sigemptyset(&stSigMask);
+        sigaddset(&stSigMask, SIGUSR1);
+        sigaddset(&stSigMask, SIGUSR2);
+        s32SigFd = signalfd(-1, &stSigMask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (s32SigFd < 0 || reactorAddFd(&gReactor, s32SigFd, EPOLLIN, hiliTriggerSignalHandler, &gVencCtx) < 0) {
+            LOGE("register trigger signal failed!\n");
+        }
+    }
 
-    s32Ret = pthread_create(&vencPid, 0, hiliGetVencStreamProc, (HI_VOID*)&stPara);
+    if (PT_BUTT != gParamOption.audioFormat) {
+        bAudio = (HI_SUCCESS == hiliAudioStart(&gReactor, &gAudioCtx, gParamOption.audioFormat,
+                                                     (HI_U32)gParamOption.audioPtime));
+    }
+    if (gParamOption.talkPort) {
+        bTalk = (HI_SUCCESS == hiliTalkStart(&gReactor, &gTalkCtx, (PT_BUTT != gParamOption.audioFormat) ?
+                                             gParamOption.audioFormat : PT_G711A, gParamOption.talkPort));
+    }
+    if (gParamOption.mode & MODE_RTP) {
+        hiliWriteSdp(HILI_SDP_FILE, bAudio ? &gAudioCtx : NULL);
+    }
 
+    s32Ret = pthread_create(&reactorPid, 0, hiliReactorProc, (HI_VOID*)&gReactor);
     if (HI_SUCCESS != s32Ret)
     {
         LOGE("Start Venc failed!\n");
+        if (bAudio) {
+            hiliAudioStop(&gReactor, &gAudioCtx);
+        }
+        if (bTalk) {
+            hiliTalkStop(&gReactor, &gTalkCtx);
+        }
+        hiliVencStreamUnRegister(&gReactor, &gVencCtx);
+        if (bSub) {
+            hiliSubStreamStop(&gReactor, VpssGrp);
+        }
+        if (bSnap) {
+            hiliSnapStop(&gReactor, &gSnapCtx, VpssGrp, VpssChn);
+        }
         goto END_VENC_1080P_CLASSIC_5;
     }
 
@@ -688,14 +3414,29 @@ HI_S32 SAMPLE_VENC_1080P_CLASSIC(HI_VOID)
     /******************************************
      step 7: exit process
     ******************************************/
-    // SAMPLE_COMM_VENC_StopGetStream();
-
-    if (HI_TRUE == stPara.bThreadStart)
-    {
-        stPara.bThreadStart = HI_FALSE;
-        pthread_join(vencPid, 0);
+    reactorStop(&gReactor);
+    pthread_join(reactorPid, 0);
+    if (s32SigFd >= 0) {
+        reactorDelFd(&gReactor, s32SigFd);
+        close(s32SigFd);
     }
-    
+    if (bMotion) {
+        hiliMotionStop(&gReactor, &gVencCtx, VpssGrp);
+    }
+    if (bAudio) {
+        hiliAudioStop(&gReactor, &gAudioCtx);
+    }
+    if (bTalk) {
+        hiliTalkStop(&gReactor, &gTalkCtx);
+    }
+    hiliVencStreamUnRegister(&gReactor, &gVencCtx);
+    if (bSub) {
+        hiliSubStreamStop(&gReactor, VpssGrp);
+    }
+    if (bSnap) {
+        hiliSnapStop(&gReactor, &gSnapCtx, VpssGrp, VpssChn);
+    }
+
 END_VENC_1080P_CLASSIC_5:
     VpssGrp = 0;
 
@@ -729,6 +3470,7 @@ END_VENC_1080P_CLASSIC_0:	//system exit
 int main(int argc, char* argv[])
 {
     int res = 0;
+    sigset_t sigMask;
     
     GREEN("+-------------------------+\n");
     GREEN("|         HisiLive        |\n");
@@ -744,26 +3486,34 @@ int main(int argc, char* argv[])
     signal(SIGINT, SAMPLE_VENC_HandleSig);
     signal(SIGTERM, SAMPLE_VENC_HandleSig);
 
-    if (gParamOption.mode == MODE_RTP) {
-        strcpy(gUDPCtx.dstIp, gParamOption.ip);
-        gUDPCtx.dstPort = 1234;
-        res = udpInit(&gUDPCtx);
-        if (res){
-            LOGE("udpInit error.\n");
-            return -1;
-        }
+    /* event trigger and IDR request, blocked before any thread starts so only the signalfd gets them */
+    sigemptyset(&sigMask);
+    sigaddset(&sigMask, SIGUSR1);
+    sigaddset(&sigMask, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &sigMask, NULL);
 
-        initRTPMuxContext(&gRTPCtx);
-        gRTPCtx.aggregation = 1;   // 1 use Aggregation Unit, 0 Single NALU Unit， default 0.
+    if (reactorInit(&gReactor)) {
+        LOGE("reactorInit error.\n");
+        return -1;
     }
 
-    res = SAMPLE_VENC_1080P_CLASSIC();
+    recordSetConfig(&gParamOption.record);
+    loopSetConfig(&gParamOption.loop);
+    eventSetConfig(&gParamOption.event);
+
+    if (gParamOption.replayFile) {
+        res = hiliReplayRun();
+    } else {
+        res = SAMPLE_VENC_1080P_CLASSIC();
+    }
     if (res) { 
         RED("program exit abnormally!\n"); 
     } else {
         GREEN("program exit normally!\n");
     }
 
+    reactorDestroy(&gReactor);
+
     return res;
 }
 
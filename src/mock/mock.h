@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#ifndef HISILIVE_MOCK_H
+#define HISILIVE_MOCK_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Host mock of the MPI subset HisiLive uses, configured by environment:
+ *   HILI_MOCK_VIDEO   .h264/.h265 file encoded by venc chn 0, default stream.h264
+ *   HILI_MOCK_VIDEO1  file of venc chn 1 (sub stream), default HILI_MOCK_VIDEO
+ *   HILI_MOCK_SPEED   pace factor of the rc frame rate, default 1, 0 as fast as possible
+ *   HILI_MOCK_ENCODE_MS  encoding time of a frame, slices come out evenly over it, default 0
+ *   HILI_MOCK_AUDIO   raw G.711 file encoded by aenc, default silence
+ *   HILI_MOCK_MOTION  "on,off" seconds of simulated vda motion, default none
+ *   HILI_MOCK_JPEG    .jpg encoded by jpeg chns, default a flat grey picture of the chn size
+ */
+
+#define MOCK_LOG(fmt, ...)  printf("[mock] " fmt, ##__VA_ARGS__)
+
+const char *mockEnv(const char *name, const char *def);
+double mockEnvDouble(const char *name, double def);
+
+/* eventfd in semaphore mode, one count per pending result */
+int mockEventOpen();
+void mockEventPost(int fd);
+int mockEventTake(int fd);
+
+#endif //HISILIVE_MOCK_H
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include "mock.h"
+#include "mpi_ai.h"
+#include "mpi_ao.h"
+#include "mpi_aenc.h"
+#include "mpi_adec.h"
+#include "Utils.h"
+
+#define MOCK_AENC_CHN_MAX   4
+#define MOCK_AENC_DEPTH     16
+#define MOCK_ADEC_CHN_MAX   4
+#define MOCK_AUDIO_HEAD     4       // hisi frame header ahead of every encoded frame
+
+typedef struct {
+    int created;
+    AENC_CHN_ATTR_S attr;
+    int fd;
+
+    pthread_t thread;
+    volatile int running;
+
+    pthread_mutex_t lock;
+    HI_U8 *buf;                     // depth frames of frameLen bytes
+    HI_U32 frameLen;
+    HI_U32 depth;
+    AUDIO_STREAM_S ring[MOCK_AENC_DEPTH];
+    int head;
+    int count;
+    int got;
+    HI_U32 seq;
+    HI_U32 dropped;
+}MockAencChn;
+
+typedef struct {
+    int created;
+    HI_U32 frames;
+    HI_U64 bytes;
+}MockAdecChn;
+
+static MockAencChn gMockAenc[MOCK_AENC_CHN_MAX];
+static MockAdecChn gMockAdec[MOCK_ADEC_CHN_MAX];
+static HI_U32 gMockSampleRate = AUDIO_SAMPLE_RATE_8000;
+
+/************ AI / AO, the capture is simulated inside aenc ************/
+
+HI_S32 HI_MPI_AI_SetPubAttr(AUDIO_DEV AiDevId, const AIO_ATTR_S *pstAttr) {
+    if (pstAttr && pstAttr->enSamplerate)
+        gMockSampleRate = (HI_U32)pstAttr->enSamplerate;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_AI_Enable(AUDIO_DEV AiDevId) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AI_Disable(AUDIO_DEV AiDevId) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AI_EnableChn(AUDIO_DEV AiDevId, AI_CHN AiChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AI_DisableChn(AUDIO_DEV AiDevId, AI_CHN AiChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AI_SetChnParam(AUDIO_DEV AiDevId, AI_CHN AiChn, AI_CHN_PARAM_S *pstChnParam) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AI_SetVqeAttr(AUDIO_DEV AiDevId, AI_CHN AiChn, AUDIO_DEV AoDevId, AO_CHN AoChn, AI_VQE_CONFIG_S *pstVqeConfig) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AI_SetHiFiVqeAttr(AUDIO_DEV AiDevId, AI_CHN AiChn, AI_HIFIVQE_CONFIG_S *pstVqeConfig) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AI_EnableVqe(AUDIO_DEV AiDevId, AI_CHN AiChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AI_DisableVqe(AUDIO_DEV AiDevId, AI_CHN AiChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AI_EnableReSmp(AUDIO_DEV AiDevId, AI_CHN AiChn, AUDIO_SAMPLE_RATE_E enOutSampleRate) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AI_DisableReSmp(AUDIO_DEV AiDevId, AI_CHN AiChn) { return HI_SUCCESS; }
+
+HI_S32 HI_MPI_AI_GetChnParam(AUDIO_DEV AiDevId, AI_CHN AiChn, AI_CHN_PARAM_S *pstChnParam) {
+    memset(pstChnParam, 0, sizeof(AI_CHN_PARAM_S));
+    return HI_SUCCESS;
+}
+
+/* raw frames are not simulated, ai is expected to be bound to aenc */
+HI_S32 HI_MPI_AI_GetFd(AUDIO_DEV AiDevId, AI_CHN AiChn) { return HI_ERR_AI_NOT_SUPPORT; }
+HI_S32 HI_MPI_AI_GetFrame(AUDIO_DEV AiDevId, AI_CHN AiChn, AUDIO_FRAME_S *pstFrm, AEC_FRAME_S *pstAecFrm, HI_S32 s32MilliSec) { return HI_ERR_AI_BUF_EMPTY; }
+HI_S32 HI_MPI_AI_ReleaseFrame(AUDIO_DEV AiDevId, AI_CHN AiChn, AUDIO_FRAME_S *pstFrm, AEC_FRAME_S *pstAecFrm) { return HI_SUCCESS; }
+
+HI_S32 HI_MPI_AO_SetPubAttr(AUDIO_DEV AoDevId, const AIO_ATTR_S *pstAttr) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_Enable(AUDIO_DEV AoDevId) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_Disable(AUDIO_DEV AoDevId) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_EnableChn(AUDIO_DEV AoDevId, AO_CHN AoChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_DisableChn(AUDIO_DEV AoDevId, AO_CHN AoChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_SendFrame(AUDIO_DEV AoDevId, AO_CHN AoChn, const AUDIO_FRAME_S *pstData, HI_S32 s32MilliSec) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_EnableReSmp(AUDIO_DEV AoDevId, AO_CHN AoChn, AUDIO_SAMPLE_RATE_E enInSampleRate) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_DisableReSmp(AUDIO_DEV AoDevId, AO_CHN AoChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_SetVolume(AUDIO_DEV AoDevId, HI_S32 s32VolumeDb) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_SetMute(AUDIO_DEV AoDevId, HI_BOOL bEnable, AUDIO_FADE_S *pstFade) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_SetVqeAttr(AUDIO_DEV AoDevId, AO_CHN AoChn, AO_VQE_CONFIG_S *pstVqeConfig) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_EnableVqe(AUDIO_DEV AoDevId, AO_CHN AoChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_AO_DisableVqe(AUDIO_DEV AoDevId, AO_CHN AoChn) { return HI_SUCCESS; }
+
+/************ AENC ************/
+
+static MockAencChn *mockAencGet(AENC_CHN AeChn) {
+    if (AeChn < 0 || AeChn >= MOCK_AENC_CHN_MAX || !gMockAenc[AeChn].created)
+        return NULL;
+    return &gMockAenc[AeChn];
+}
+
+/* fill one frame from the input file, silence without one */
+static void mockAencFill(MockAencChn *chn, FILE *fp, HI_U8 *payload, HI_U32 len) {
+    size_t n = 0;
+
+    if (fp) {
+        n = fread(payload, 1, len, fp);
+        if (n < len) {
+            rewind(fp);
+            n += fread(payload + n, 1, len - n, fp);
+        }
+    }
+    if (n < len)
+        memset(payload + n, PT_G711U == chn->attr.enType ? 0xff : PT_G711A == chn->attr.enType ? 0xd5 : 0, len - n);
+}
+
+/* encoded bytes per frame as the real aenc gives them after the hisi header */
+static HI_U32 mockAencPayloadLen(const AENC_CHN_ATTR_S *attr) {
+    HI_U32 n = attr->u32PtNumPerFrm & ~1u;
+
+    switch (attr->enType) {
+        case PT_G726:   return n / 2;       // G726_32K, 4 bits a sample
+        case PT_ADPCMA: return 4 + n / 2;   // DVI4, predictor and step index ahead of the samples
+        case PT_LPCM:   return n * 2;
+        default:        return n;           // G.711, one byte a sample
+    }
+}
+
+static void *mockAencThread(void *arg) {
+    MockAencChn *chn = (MockAencChn *)arg;
+    HI_U32 len = chn->frameLen - MOCK_AUDIO_HEAD;
+    uint64_t period = (uint64_t)chn->attr.u32PtNumPerFrm * 1000000 / gMockSampleRate;
+    uint64_t due = getMonotonicTime();
+    const char *path = mockEnv("HILI_MOCK_AUDIO", NULL);
+    AUDIO_STREAM_S *stream;
+    struct timespec ts;
+    FILE *fp = NULL;
+    HI_U8 *frame;
+
+    if (path && NULL == (fp = fopen(path, "rb")))
+        MOCK_LOG("open %s failed, aenc sends silence\n", path);
+
+    while (chn->running) {
+        due += period;
+        ts.tv_sec = (time_t)(due / 1000000);
+        ts.tv_nsec = (long)(due % 1000000) * 1000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+
+        pthread_mutex_lock(&chn->lock);
+        if ((HI_U32)chn->count == chn->depth) {
+            if (chn->dropped++ % 100 == 0)
+                MOCK_LOG("aenc buffer full, %u frames dropped\n", chn->dropped);
+            pthread_mutex_unlock(&chn->lock);
+            continue;
+        }
+        stream = &chn->ring[(chn->head + chn->count) % chn->depth];
+        frame = stream->pStream;
+        frame[0] = 0x00;
+        frame[1] = 0x01;
+        frame[2] = (HI_U8)(len / 2);        // payload length in 16 bit words, little endian
+        frame[3] = (HI_U8)(len / 2 >> 8);
+        mockAencFill(chn, fp, frame + MOCK_AUDIO_HEAD, len);
+        stream->u32Len = chn->frameLen;
+        stream->u64TimeStamp = due - period;
+        stream->u32Seq = chn->seq++;
+        chn->count++;
+        pthread_mutex_unlock(&chn->lock);
+
+        mockEventPost(chn->fd);
+    }
+
+    if (fp)
+        fclose(fp);
+    return NULL;
+}
+
+HI_S32 HI_MPI_AENC_CreateChn(AENC_CHN AeChn, const AENC_CHN_ATTR_S *pstAttr) {
+    MockAencChn *chn;
+    HI_U32 i;
+
+    if (AeChn < 0 || AeChn >= MOCK_AENC_CHN_MAX)
+        return HI_ERR_AENC_INVALID_CHNID;
+    if (NULL == pstAttr)
+        return HI_ERR_AENC_NULL_PTR;
+    if (pstAttr->u32PtNumPerFrm == 0 || pstAttr->u32PtNumPerFrm > 510)    // header counts words in one byte
+        return HI_ERR_AENC_ILLEGAL_PARAM;
+
+    chn = &gMockAenc[AeChn];
+    if (chn->created)
+        return HI_ERR_AENC_EXIST;
+
+    memset(chn, 0, sizeof(MockAencChn));
+    chn->attr = *pstAttr;
+    chn->depth = pstAttr->u32BufSize;
+    if (chn->depth < 2 || chn->depth > MOCK_AENC_DEPTH)
+        chn->depth = MOCK_AENC_DEPTH;
+
+    chn->frameLen = MOCK_AUDIO_HEAD + mockAencPayloadLen(pstAttr);
+    chn->buf = (HI_U8 *)malloc(chn->frameLen * chn->depth);
+    chn->fd = mockEventOpen();
+    if (NULL == chn->buf || chn->fd < 0) {
+        free(chn->buf);
+        if (chn->fd >= 0)
+            close(chn->fd);
+        return HI_ERR_AENC_NOMEM;
+    }
+    for (i = 0; i < chn->depth; i++)
+        chn->ring[i].pStream = chn->buf + i * chn->frameLen;
+
+    pthread_mutex_init(&chn->lock, NULL);
+    chn->created = 1;
+
+    /* ai is always bound, encoding starts with the channel */
+    chn->running = 1;
+    if (pthread_create(&chn->thread, NULL, mockAencThread, chn) != 0) {
+        chn->running = 0;
+        MOCK_LOG("aenc chn %d thread failed\n", AeChn);
+    }
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_AENC_DestroyChn(AENC_CHN AeChn) {
+    MockAencChn *chn = mockAencGet(AeChn);
+
+    if (NULL == chn)
+        return HI_ERR_AENC_UNEXIST;
+    if (chn->running) {
+        chn->running = 0;
+        pthread_join(chn->thread, NULL);
+    }
+    close(chn->fd);
+    free(chn->buf);
+    pthread_mutex_destroy(&chn->lock);
+    memset(chn, 0, sizeof(MockAencChn));
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_AENC_SendFrame(AENC_CHN AeChn, const AUDIO_FRAME_S *pstFrm, const AEC_FRAME_S *pstAecFrm) {
+    return mockAencGet(AeChn) ? HI_SUCCESS : HI_ERR_AENC_UNEXIST;
+}
+
+HI_S32 HI_MPI_AENC_GetFd(AENC_CHN AeChn) {
+    MockAencChn *chn = mockAencGet(AeChn);
+    return chn ? chn->fd : HI_ERR_AENC_UNEXIST;
+}
+
+HI_S32 HI_MPI_AENC_GetStream(AENC_CHN AeChn, AUDIO_STREAM_S *pstStream, HI_S32 s32MilliSec) {
+    MockAencChn *chn = mockAencGet(AeChn);
+    struct pollfd pfd;
+
+    if (NULL == chn)
+        return HI_ERR_AENC_UNEXIST;
+    if (NULL == pstStream)
+        return HI_ERR_AENC_NULL_PTR;
+
+    if (mockEventTake(chn->fd) < 0) {
+        pfd.fd = chn->fd;
+        pfd.events = POLLIN;
+        if (0 == s32MilliSec || poll(&pfd, 1, s32MilliSec) <= 0 || mockEventTake(chn->fd) < 0)
+            return HI_ERR_AENC_BUF_EMPTY;
+    }
+
+    pthread_mutex_lock(&chn->lock);
+    *pstStream = chn->ring[(chn->head + chn->got) % chn->depth];
+    chn->got++;
+    pthread_mutex_unlock(&chn->lock);
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_AENC_ReleaseStream(AENC_CHN AeChn, const AUDIO_STREAM_S *pstStream) {
+    MockAencChn *chn = mockAencGet(AeChn);
+
+    if (NULL == chn)
+        return HI_ERR_AENC_UNEXIST;
+    if (NULL == pstStream)
+        return HI_ERR_AENC_NULL_PTR;
+
+    pthread_mutex_lock(&chn->lock);
+    if (0 == chn->got || chn->ring[chn->head].u32Seq != pstStream->u32Seq) {
+        pthread_mutex_unlock(&chn->lock);
+        return HI_ERR_AENC_ILLEGAL_PARAM;
+    }
+    chn->head = (chn->head + 1) % chn->depth;
+    chn->count--;
+    chn->got--;
+    pthread_mutex_unlock(&chn->lock);
+    return HI_SUCCESS;
+}
+
+/************ ADEC, frames are counted and dropped ************/
+
+HI_S32 HI_MPI_ADEC_CreateChn(ADEC_CHN AdChn, ADEC_CHN_ATTR_S *pstAttr) {
+    if (AdChn < 0 || AdChn >= MOCK_ADEC_CHN_MAX)
+        return HI_ERR_ADEC_INVALID_CHNID;
+    if (gMockAdec[AdChn].created)
+        return HI_ERR_ADEC_EXIST;
+    memset(&gMockAdec[AdChn], 0, sizeof(MockAdecChn));
+    gMockAdec[AdChn].created = 1;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_ADEC_DestroyChn(ADEC_CHN AdChn) {
+    if (AdChn < 0 || AdChn >= MOCK_ADEC_CHN_MAX || !gMockAdec[AdChn].created)
+        return HI_ERR_ADEC_UNEXIST;
+    MOCK_LOG("adec chn %d decoded %u frames, %llu bytes\n", AdChn,
+             gMockAdec[AdChn].frames, (unsigned long long)gMockAdec[AdChn].bytes);
+    gMockAdec[AdChn].created = 0;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_ADEC_SendStream(ADEC_CHN AdChn, const AUDIO_STREAM_S *pstStream, HI_BOOL bBlock) {
+    if (AdChn < 0 || AdChn >= MOCK_ADEC_CHN_MAX || !gMockAdec[AdChn].created)
+        return HI_ERR_ADEC_UNEXIST;
+    if (NULL == pstStream)
+        return HI_ERR_ADEC_NULL_PTR;
+    gMockAdec[AdChn].frames++;
+    gMockAdec[AdChn].bytes += pstStream->u32Len;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_ADEC_SendEndOfStream(ADEC_CHN AdChn, HI_BOOL bInstant) {
+    return (AdChn >= 0 && AdChn < MOCK_ADEC_CHN_MAX && gMockAdec[AdChn].created) ? HI_SUCCESS : HI_ERR_ADEC_UNEXIST;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include "mock.h"
+#include "mpi_sys.h"
+#include "mpi_vb.h"
+#include "mpi_vpss.h"
+#include "mpi_vi.h"
+#include "mpi_vo.h"
+#include "mpi_vgs.h"
+
+const char *mockEnv(const char *name, const char *def) {
+    const char *val = getenv(name);
+    return (val && val[0]) ? val : def;
+}
+
+double mockEnvDouble(const char *name, double def) {
+    const char *val = getenv(name);
+    return (val && val[0]) ? atof(val) : def;
+}
+
+int mockEventOpen() {
+    return eventfd(0, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+void mockEventPost(int fd) {
+    uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR);
+}
+
+int mockEventTake(int fd) {
+    uint64_t val;
+    return read(fd, &val, sizeof(val)) == sizeof(val) ? 0 : -1;
+}
+
+/************ SYS / VB ************/
+
+HI_S32 HI_MPI_SYS_Init() { return HI_SUCCESS; }
+HI_S32 HI_MPI_SYS_Exit() { return HI_SUCCESS; }
+HI_S32 HI_MPI_SYS_SetConf(const MPP_SYS_CONF_S* pstSysConf) { return HI_SUCCESS; }
+HI_S32 HI_MPI_SYS_SetMemConf(MPP_CHN_S* pstMppChn, const HI_CHAR* pcMmzName) { return HI_SUCCESS; }
+
+/* the venc mock stamps its packs from the same clock */
+HI_S32 HI_MPI_SYS_GetCurPts(HI_U64* pu64CurPts) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    *pu64CurPts = (HI_U64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    return HI_SUCCESS;
+}
+
+/* the mock has no pipeline between modules, binding is only recorded by the caller */
+HI_S32 HI_MPI_SYS_Bind(MPP_CHN_S* pstSrcChn, MPP_CHN_S* pstDestChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_SYS_UnBind(MPP_CHN_S* pstSrcChn, MPP_CHN_S* pstDestChn) { return HI_SUCCESS; }
+
+HI_S32 HI_MPI_SYS_MmzAlloc(HI_U32* pu32PhyAddr, HI_VOID** ppVirtAddr,
+                           const HI_CHAR* strMmb, const HI_CHAR* strZone, HI_U32 u32Len) {
+    *ppVirtAddr = malloc(u32Len);
+    *pu32PhyAddr = 0;
+    return *ppVirtAddr ? HI_SUCCESS : HI_FAILURE;
+}
+
+HI_S32 HI_MPI_SYS_MmzAlloc_Cached(HI_U32* pu32PhyAddr, HI_VOID** ppVitAddr,
+                                  const HI_CHAR* pstrMmb, const HI_CHAR* pstrZone, HI_U32 u32Len) {
+    return HI_MPI_SYS_MmzAlloc(pu32PhyAddr, ppVitAddr, pstrMmb, pstrZone, u32Len);
+}
+
+HI_S32 HI_MPI_VB_Init(HI_VOID) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VB_Exit(HI_VOID) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VB_SetConf(const VB_CONF_S *pstVbConf) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VB_SetSupplementConf(const VB_SUPPLEMENT_CONF_S *pstSupplementConf) { return HI_SUCCESS; }
+
+/************ VPSS ************/
+
+HI_S32 HI_MPI_VPSS_CreateGrp(VPSS_GRP VpssGrp, VPSS_GRP_ATTR_S *pstGrpAttr) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VPSS_DestroyGrp(VPSS_GRP VpssGrp) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VPSS_StartGrp(VPSS_GRP VpssGrp) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VPSS_StopGrp(VPSS_GRP VpssGrp) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VPSS_EnableChn(VPSS_GRP VpssGrp, VPSS_CHN VpssChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VPSS_DisableChn(VPSS_GRP VpssGrp, VPSS_CHN VpssChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VPSS_SetChnAttr(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, VPSS_CHN_ATTR_S *pstChnAttr) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VPSS_SetChnMode(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, VPSS_CHN_MODE_S *pstVpssMode) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VPSS_SetExtChnAttr(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, VPSS_EXT_CHN_ATTR_S *pstExtChnAttr) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VPSS_SetGrpParam(VPSS_GRP VpssGrp, VPSS_GRP_PARAM_S *pstVpssParam) { return HI_SUCCESS; }
+
+HI_S32 HI_MPI_VPSS_GetGrpParam(VPSS_GRP VpssGrp, VPSS_GRP_PARAM_S *pstVpssParam) {
+    memset(pstVpssParam, 0, sizeof(VPSS_GRP_PARAM_S));
+    return HI_SUCCESS;
+}
+
+/* accepted, the encoder mock models its own delay, HILI_MOCK_ENCODE_MS */
+HI_S32 HI_MPI_VPSS_SetLowDelayAttr(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, VPSS_LOW_DELAY_INFO_S *pstLowDelayInfo) {
+    MOCK_LOG("vpss grp %d chn %d low delay %s, %u lines\n", VpssGrp, VpssChn,
+             pstLowDelayInfo->bEnable ? "on" : "off", pstLowDelayInfo->u32LineCnt);
+    return HI_SUCCESS;
+}
+
+/************ VI / VO / VGS, not on the encode path ************/
+
+HI_S32 HI_MPI_VI_EnableChn(VI_CHN ViChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VI_DisableChn(VI_CHN ViChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VI_SetChnAttr(VI_CHN ViChn, const VI_CHN_ATTR_S *pstAttr) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VI_SetExtChnAttr(VI_CHN ViChn, const VI_EXT_CHN_ATTR_S *pstExtChnAttr) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VI_SetFrameDepth(VI_CHN ViChn, HI_U32 u32Depth) { return HI_SUCCESS; }
+
+HI_S32 HI_MPI_VI_GetChnAttr(VI_CHN ViChn, VI_CHN_ATTR_S *pstAttr) {
+    memset(pstAttr, 0, sizeof(VI_CHN_ATTR_S));
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VO_Enable(VO_DEV VoDev) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VO_Disable(VO_DEV VoDev) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VO_EnableChn(VO_LAYER VoLayer, VO_CHN VoChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VO_DisableChn(VO_LAYER VoLayer, VO_CHN VoChn) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VO_EnableVideoLayer(VO_LAYER VoLayer) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VO_DisableVideoLayer(VO_LAYER VoLayer) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VO_SetChnAttr(VO_LAYER VoLayer, VO_CHN VoChn, const VO_CHN_ATTR_S *pstChnAttr) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VO_SetDispBufLen(VO_LAYER VoLayer, HI_U32 u32BufLen) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VO_SetPubAttr(VO_DEV VoDev, const VO_PUB_ATTR_S *pstPubAttr) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VO_SetVideoLayerAttr(VO_LAYER VoLayer, const VO_VIDEO_LAYER_ATTR_S *pstLayerAttr) { return HI_SUCCESS; }
+
+HI_S32 HI_MPI_VO_GetVideoLayerAttr(VO_LAYER VoLayer, VO_VIDEO_LAYER_ATTR_S *pstLayerAttr) {
+    memset(pstLayerAttr, 0, sizeof(VO_VIDEO_LAYER_ATTR_S));
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VGS_BeginJob(VGS_HANDLE *phHandle) { *phHandle = 0; return HI_SUCCESS; }
+HI_S32 HI_MPI_VGS_EndJob(VGS_HANDLE hHandle) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VGS_CancelJob(VGS_HANDLE hHandle) { return HI_SUCCESS; }
+HI_S32 HI_MPI_VGS_AddCoverTask(VGS_HANDLE hHandle, VGS_TASK_ATTR_S *pstTask, VGS_ADD_COVER_S *pstVgsAddCover) { return HI_SUCCESS; }
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include "mock.h"
+#include "mpi_vda.h"
+#include "Utils.h"
+
+#define MOCK_VDA_CHN_MAX    4
+#define MOCK_VDA_PERIOD     133333      // us, md results at 7.5 fps
+
+typedef struct {
+    int created;
+    VDA_CHN_ATTR_S attr;
+    int fd;
+
+    pthread_t thread;
+    volatile int running;
+
+    double on;                  // seconds of motion, then off seconds without, 0 no motion
+    double off;
+    uint64_t start;
+    VDA_OBJ_S obj;
+}MockVdaChn;
+
+static MockVdaChn gMockVda[MOCK_VDA_CHN_MAX];
+
+static MockVdaChn *mockVdaGet(VDA_CHN VdaChn) {
+    if (VdaChn < 0 || VdaChn >= MOCK_VDA_CHN_MAX || !gMockVda[VdaChn].created)
+        return NULL;
+    return &gMockVda[VdaChn];
+}
+
+static int mockVdaMotion(MockVdaChn *chn, uint64_t now) {
+    double t;
+
+    if (chn->on <= 0)
+        return 0;
+    if (chn->off <= 0)
+        return 1;
+    t = (double)(now - chn->start) / 1000000;
+    t -= (double)(uint64_t)(t / (chn->on + chn->off)) * (chn->on + chn->off);
+    return t < chn->on;
+}
+
+static void *mockVdaThread(void *arg) {
+    MockVdaChn *chn = (MockVdaChn *)arg;
+    struct timespec ts;
+    uint64_t due = getMonotonicTime();
+
+    while (chn->running) {
+        due += MOCK_VDA_PERIOD;
+        ts.tv_sec = (time_t)(due / 1000000);
+        ts.tv_nsec = (long)(due % 1000000) * 1000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+        mockEventPost(chn->fd);
+    }
+    return NULL;
+}
+
+HI_S32 HI_MPI_VDA_CreateChn(VDA_CHN VdaChn, const VDA_CHN_ATTR_S *pstAttr) {
+    MockVdaChn *chn;
+    const char *motion;
+
+    if (VdaChn < 0 || VdaChn >= MOCK_VDA_CHN_MAX)
+        return HI_ERR_VDA_INVALID_CHNID;
+    if (NULL == pstAttr)
+        return HI_ERR_VDA_NULL_PTR;
+
+    chn = &gMockVda[VdaChn];
+    if (chn->created)
+        return HI_ERR_VDA_EXIST;
+
+    memset(chn, 0, sizeof(MockVdaChn));
+    chn->fd = mockEventOpen();
+    if (chn->fd < 0)
+        return HI_ERR_VDA_NOMEM;
+    chn->attr = *pstAttr;
+
+    motion = mockEnv("HILI_MOCK_MOTION", NULL);
+    if (motion && sscanf(motion, "%lf,%lf", &chn->on, &chn->off) < 1)
+        chn->on = 0;
+
+    /* the moving object is the center quarter of the picture */
+    chn->obj.u16Left = (HI_U16)(pstAttr->u32Width / 4);
+    chn->obj.u16Top = (HI_U16)(pstAttr->u32Height / 4);
+    chn->obj.u16Right = (HI_U16)(pstAttr->u32Width * 3 / 4);
+    chn->obj.u16Bottom = (HI_U16)(pstAttr->u32Height * 3 / 4);
+    chn->created = 1;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VDA_StopRecvPic(VDA_CHN VdaChn) {
+    MockVdaChn *chn = mockVdaGet(VdaChn);
+
+    if (NULL == chn)
+        return HI_ERR_VDA_UNEXIST;
+    if (chn->running) {
+        chn->running = 0;
+        pthread_join(chn->thread, NULL);
+    }
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VDA_DestroyChn(VDA_CHN VdaChn) {
+    MockVdaChn *chn = mockVdaGet(VdaChn);
+
+    if (NULL == chn)
+        return HI_ERR_VDA_UNEXIST;
+    HI_MPI_VDA_StopRecvPic(VdaChn);
+    close(chn->fd);
+    memset(chn, 0, sizeof(MockVdaChn));
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VDA_StartRecvPic(VDA_CHN VdaChn) {
+    MockVdaChn *chn = mockVdaGet(VdaChn);
+
+    if (NULL == chn)
+        return HI_ERR_VDA_UNEXIST;
+    if (chn->running)
+        return HI_SUCCESS;
+
+    chn->start = getMonotonicTime();
+    chn->running = 1;
+    if (pthread_create(&chn->thread, NULL, mockVdaThread, chn) != 0) {
+        chn->running = 0;
+        return HI_ERR_VDA_NOMEM;
+    }
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VDA_GetFd(VDA_CHN VdaChn) {
+    MockVdaChn *chn = mockVdaGet(VdaChn);
+    return chn ? chn->fd : HI_ERR_VDA_UNEXIST;
+}
+
+HI_S32 HI_MPI_VDA_GetData(VDA_CHN VdaChn, VDA_DATA_S *pstVdaData, HI_S32 s32MilliSec) {
+    MockVdaChn *chn = mockVdaGet(VdaChn);
+    VDA_MD_DATA_S *md;
+    struct pollfd pfd;
+    uint64_t now;
+    int motion;
+
+    if (NULL == chn)
+        return HI_ERR_VDA_UNEXIST;
+    if (NULL == pstVdaData)
+        return HI_ERR_VDA_NULL_PTR;
+
+    if (mockEventTake(chn->fd) < 0) {
+        pfd.fd = chn->fd;
+        pfd.events = POLLIN;
+        if (0 == s32MilliSec || poll(&pfd, 1, s32MilliSec) <= 0 || mockEventTake(chn->fd) < 0)
+            return HI_ERR_VDA_BUF_EMPTY;
+    }
+
+    now = getMonotonicTime();
+    motion = mockVdaMotion(chn, now);
+
+    memset(pstVdaData, 0, sizeof(VDA_DATA_S));
+    pstVdaData->enWorkMode = chn->attr.enWorkMode;
+    pstVdaData->enMbSize = chn->attr.unAttr.stMdAttr.enMbSize;
+    pstVdaData->u32MbWidth = chn->attr.u32Width / 16;
+    pstVdaData->u32MbHeight = chn->attr.u32Height / 16;
+    pstVdaData->u64Pts = now;
+
+    if (VDA_WORK_MODE_MD == chn->attr.enWorkMode) {
+        md = &pstVdaData->unData.stMdData;
+        md->bObjValid = HI_TRUE;
+        md->stObjData.u32ObjNum = motion ? 1 : 0;
+        md->stObjData.pstAddr = &chn->obj;
+        if (motion) {
+            md->stObjData.u32SizeOfMaxObj = (HI_U32)(chn->obj.u16Right - chn->obj.u16Left) *
+                                            (HI_U32)(chn->obj.u16Bottom - chn->obj.u16Top);
+            md->stObjData.u32SizeOfTotalObj = md->stObjData.u32SizeOfMaxObj;
+        }
+        md->bPelsNumValid = HI_TRUE;
+        md->u32AlarmPixCnt = md->stObjData.u32SizeOfTotalObj;
+    }
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VDA_ReleaseData(VDA_CHN VdaChn, const VDA_DATA_S* pstVdaData) {
+    return mockVdaGet(VdaChn) ? HI_SUCCESS : HI_ERR_VDA_UNEXIST;
+}
+
+HI_S32 HI_MPI_VDA_ResetOdRegion(VDA_CHN VdaChn, HI_S32 s32RgnIndex) {
+    return mockVdaGet(VdaChn) ? HI_SUCCESS : HI_ERR_VDA_UNEXIST;
+}
@@ -0,0 +1,1171 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include "mock.h"
+#include "mpi_venc.h"
+#include "Replay.h"
+#include "Utils.h"
+
+#define MOCK_VENC_CHN_MAX   4
+#define MOCK_VENC_DEPTH     128     // frames in the stream buffer at most
+#define MOCK_VENC_POISON    0xee    // released stream bytes, a sink still reading them sends garbage
+#define MOCK_USER_DATA_NUM  4       // pieces of user data pending, like the chip
+#define MOCK_USER_DATA_MAX  1024
+#define MOCK_ROI_NUM        8       // roi index 0-7
+#define MOCK_JPEG_FPS       30      // pictures a jpeg chn receives per second
+#define MOCK_JPEG_COM       48      // comment segment with the picture number
+
+typedef struct {
+    VENC_PACK_S *packs;
+    HI_U32 packCount;
+    HI_U32 packCap;
+    HI_U32 pos;             // in the stream buffer
+    HI_U32 bytes;           // taken from the stream buffer, the frame itself and the skipped tail
+    HI_U32 seq;
+    int refType;
+}MockVencFrame;
+
+typedef struct {
+    int created;
+    VENC_CHN_ATTR_S attr;
+    VENC_PARAM_H264_SLICE_SPLIT_S h264Split;
+    VENC_PARAM_H265_SLICE_SPLIT_S h265Split;
+    int fd;
+
+    pthread_t thread;
+    volatile int running;
+
+    pthread_mutex_t lock;
+    pthread_cond_t space;
+    int block;              // wait for a free slot instead of dropping, when not paced
+    MockVencFrame ring[MOCK_VENC_DEPTH];
+    int head;
+    int count;
+    int got;                // frames handed out by GetStream, not yet released
+    HI_U32 leftBytes;       // encoded, not got yet
+    HI_U32 dropped;
+
+    /* stream buffer, packs point into it like into the mmz buffer of the chip */
+    HI_U8 *buf;
+    HI_U32 bufSize;
+    HI_U32 writePos;
+    HI_U32 usedBytes;       // not released
+
+    /* InsertUserData, an SEI of them goes into the next frame */
+    HI_U8 userData[MOCK_USER_DATA_NUM][MOCK_USER_DATA_MAX];
+    HI_U32 userLen[MOCK_USER_DATA_NUM];
+    int userNum;
+
+    /* intra refresh, see mockVencRefresh() */
+    VENC_PARAM_INTRA_REFRESH_S refresh;
+    volatile int idrWanted;
+    int keySeen;
+    HI_U32 pMean;           // of the P frames, the I frames are cut to it
+    HI_U32 fillLeft;        // bytes cut from the last I frame, not spread yet
+    HI_U32 fillFrames;
+    VENC_PACK_S *refreshPacks;
+    HI_U32 refreshPackCap;
+    HI_U8 *refreshBuf;
+    HI_U32 refreshBufSize;
+
+    VENC_SUPERFRAME_CFG_S superFrame;
+
+    /* svc-t, see mockVencRefType() */
+    VENC_PARAM_REF_S ref;
+    HI_U32 refPos;          // frames since the last I frame
+
+    /* roi, kept and checked like the chip, the frames are not changed */
+    VENC_ROI_CFG_S roi[MOCK_ROI_NUM];
+    VENC_ROIBG_FRAME_RATE_S roiBg;
+
+    /* jpeg, see mockVencJpegThread() */
+    VENC_JPEG_SNAP_MODE_E snapMode;
+    VENC_PARAM_JPEG_S jpegParam;
+    HI_S32 recvNum;         // pictures to encode, -1 until StopRecvPic
+    HI_U32 jpegSeq;
+}MockVencChn;
+
+static MockVencChn gMockVenc[MOCK_VENC_CHN_MAX];
+
+static MockVencChn *mockVencGet(VENC_CHN VeChn) {
+    if (VeChn < 0 || VeChn >= MOCK_VENC_CHN_MAX || !gMockVenc[VeChn].created)
+        return NULL;
+    return &gMockVenc[VeChn];
+}
+
+static int mockVencFrameRate(const VENC_CHN_ATTR_S *attr) {
+    HI_U32 fr;
+
+    switch (attr->stRcAttr.enRcMode) {
+        case VENC_RC_MODE_H264CBR: fr = attr->stRcAttr.stAttrH264Cbr.fr32DstFrmRate; break;
+        case VENC_RC_MODE_H264VBR: fr = attr->stRcAttr.stAttrH264Vbr.fr32DstFrmRate; break;
+        case VENC_RC_MODE_H264FIXQP: fr = attr->stRcAttr.stAttrH264FixQp.fr32DstFrmRate; break;
+        case VENC_RC_MODE_H265CBR: fr = attr->stRcAttr.stAttrH265Cbr.fr32DstFrmRate; break;
+        case VENC_RC_MODE_H265VBR: fr = attr->stRcAttr.stAttrH265Vbr.fr32DstFrmRate; break;
+        case VENC_RC_MODE_H265FIXQP: fr = attr->stRcAttr.stAttrH265FixQp.fr32DstFrmRate; break;
+        default: fr = 30; break;
+    }
+    fr &= 0xffff;       // fractional rates keep the integer part
+    return fr ? (int)fr : 30;
+}
+
+static HI_U32 mockVencStreamBytes(const VENC_STREAM_S *stream, HI_U32 first, HI_U32 count) {
+    HI_U32 i, bytes = 0;
+
+    for (i = first; i < first + count; i++)
+        bytes += stream->pstPack[i].u32Len - stream->pstPack[i].u32Offset;
+    return bytes;
+}
+
+/*
+ * copy count packs of the access unit into the stream buffer. like the chip, a pack crossing
+ * the end of the buffer is split in two, so the packs of a frame are not always contiguous
+ */
+static void mockVencPush(MockVencChn *chn, const VENC_STREAM_S *stream, HI_U32 first, HI_U32 count, int codec) {
+    MockVencFrame *frame;
+    VENC_PACK_S *packs, *pack;
+    HI_U32 i, len, part, bytes = mockVencStreamBytes(stream, first, count);
+
+    pthread_mutex_lock(&chn->lock);
+    while (chn->block && chn->running &&
+           (chn->count == MOCK_VENC_DEPTH || chn->usedBytes + bytes > chn->bufSize) && chn->count)
+        pthread_cond_wait(&chn->space, &chn->lock);
+    if (chn->count == MOCK_VENC_DEPTH || chn->usedBytes + bytes > chn->bufSize) {
+        if (chn->running && chn->dropped++ % 100 == 0)
+            MOCK_LOG("venc stream buffer full, %u frames dropped\n", chn->dropped);
+        pthread_mutex_unlock(&chn->lock);
+        return;
+    }
+
+    frame = &chn->ring[(chn->head + chn->count) % MOCK_VENC_DEPTH];
+    if (frame->packCap < count + 1) {
+        packs = (VENC_PACK_S *)realloc(frame->packs, (count + 1) * sizeof(VENC_PACK_S));
+        if (NULL == packs) {
+            pthread_mutex_unlock(&chn->lock);
+            return;
+        }
+        frame->packs = packs;
+        frame->packCap = count + 1;
+    }
+
+    frame->pos = chn->writePos;
+    frame->packCount = 0;
+    for (i = first; i < first + count; i++) {
+        len = stream->pstPack[i].u32Len - stream->pstPack[i].u32Offset;
+        part = chn->bufSize - chn->writePos;
+        if (part > len)
+            part = len;
+
+        pack = &frame->packs[frame->packCount++];
+        *pack = stream->pstPack[i];
+        memcpy(chn->buf + chn->writePos, stream->pstPack[i].pu8Addr + stream->pstPack[i].u32Offset, part);
+        pack->pu8Addr = chn->buf + chn->writePos;
+        pack->u32Offset = 0;
+        pack->u32Len = part;
+        chn->writePos = (chn->writePos + part) % chn->bufSize;
+
+        if (part < len) {
+            pack->bFrameEnd = HI_FALSE;
+            pack = &frame->packs[frame->packCount++];
+            *pack = stream->pstPack[i];
+            memcpy(chn->buf, stream->pstPack[i].pu8Addr + stream->pstPack[i].u32Offset + part, len - part);
+            pack->pu8Addr = chn->buf;
+            pack->u32Offset = 0;
+            pack->u32Len = len - part;
+            chn->writePos = len - part;
+        }
+    }
+    frame->seq = stream->u32Seq;
+    frame->refType = codec ? stream->stH265Info.enRefType : stream->stH264Info.enRefType;
+    frame->bytes = bytes;
+
+    chn->count++;
+    chn->leftBytes += bytes;
+    chn->usedBytes += bytes;
+    pthread_mutex_unlock(&chn->lock);
+
+    mockEventPost(chn->fd);
+}
+
+static int mockVencIsSlice(const VENC_PACK_S *pack, int codec) {
+    if (codec)
+        return H265E_NALU_ISLICE == pack->DataType.enH265EType || H265E_NALU_PSLICE == pack->DataType.enH265EType;
+    return H264E_NALU_ISLICE == pack->DataType.enH264EType || H264E_NALU_PSLICE == pack->DataType.enH264EType;
+}
+
+static void mockVencSleepUntil(uint64_t due) {
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(due / 1000000);
+    ts.tv_nsec = (long)(due % 1000000) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/*
+ * The picture was captured when replay returns it. In frame mode (bByFrame) the access unit
+ * comes out after encodeUs, in slice mode each slice as soon as its share of encodeUs passed,
+ * a slice takes the NALUs in front of it, the last one also those behind.
+ */
+static void mockVencEncode(MockVencChn *chn, const VENC_STREAM_S *stream, int codec, uint64_t encodeUs) {
+    uint64_t start = getMonotonicTime();
+    HI_BOOL byFrame = codec ? chn->attr.stVeAttr.stAttrH265e.bByFrame : chn->attr.stVeAttr.stAttrH264e.bByFrame;
+    HI_U32 i, first = 0, slices = 0, done = 0;
+
+    for (i = 0; !byFrame && i < stream->u32PackCount; i++)
+        slices += mockVencIsSlice(&stream->pstPack[i], codec);
+
+    if (slices <= 1) {
+        if (encodeUs)
+            mockVencSleepUntil(start + encodeUs);
+        mockVencPush(chn, stream, 0, stream->u32PackCount, codec);
+        return;
+    }
+
+    for (i = 0; i < stream->u32PackCount; i++) {
+        if (!mockVencIsSlice(&stream->pstPack[i], codec))
+            continue;
+        if (++done == slices)
+            i = stream->u32PackCount - 1;
+        if (encodeUs)
+            mockVencSleepUntil(start + encodeUs * done / slices);
+        mockVencPush(chn, stream, first, i + 1 - first, codec);
+        first = i + 1;
+    }
+}
+
+/* the pending user data as user_data_unregistered messages of one SEI NALU, 0 if there is none */
+static HI_U32 mockVencUserSei(MockVencChn *chn, HI_U8 *sei, int codec) {
+    HI_U8 *p = sei;
+    HI_U32 j, len, zeros = 0;
+    int k;
+
+    pthread_mutex_lock(&chn->lock);
+    if (0 == chn->userNum) {
+        pthread_mutex_unlock(&chn->lock);
+        return 0;
+    }
+    memcpy(p, "\0\0\0\1", 4);
+    p += 4;
+    if (codec) {
+        *p++ = H265E_NALU_SEI << 1;
+        *p++ = 1;
+    } else {
+        *p++ = H264E_NALU_SEI;
+    }
+    for (k = 0; k < chn->userNum; k++) {
+        *p++ = 5;
+        for (len = chn->userLen[k]; len >= 255; len -= 255)
+            *p++ = 0xff;
+        *p++ = (HI_U8)len;
+        for (j = 0; j < chn->userLen[k]; j++) {
+            if (zeros >= 2 && chn->userData[k][j] <= 3) {
+                *p++ = 3;       // emulation prevention
+                zeros = 0;
+            }
+            *p++ = chn->userData[k][j];
+            zeros = chn->userData[k][j] ? 0 : zeros + 1;
+        }
+    }
+    *p++ = 0x80;
+    chn->userNum = 0;
+    pthread_mutex_unlock(&chn->lock);
+    return (HI_U32)(p - sei);
+}
+
+/* put the SEI in front of the first slice, packs must hold one more */
+static void mockVencAddSei(VENC_STREAM_S *stream, VENC_PACK_S *packs, HI_U8 *sei, HI_U32 len, int codec) {
+    HI_U32 i, at = 0;
+
+    for (i = 0; i < stream->u32PackCount; i++) {
+        if (mockVencIsSlice(&stream->pstPack[i], codec)) {
+            at = i;
+            break;
+        }
+    }
+    memcpy(packs, stream->pstPack, at * sizeof(VENC_PACK_S));
+    memcpy(packs + at + 1, stream->pstPack + at, (stream->u32PackCount - at) * sizeof(VENC_PACK_S));
+    packs[at] = stream->pstPack[at];
+    packs[at].pu8Addr = sei;
+    packs[at].u32Offset = 0;
+    packs[at].u32Len = len;
+    packs[at].bFrameEnd = HI_FALSE;
+    if (codec)
+        packs[at].DataType.enH265EType = H265E_NALU_SEI;
+    else
+        packs[at].DataType.enH264EType = H264E_NALU_SEI;
+    stream->pstPack = packs;
+    stream->u32PackCount++;
+}
+
+static int mockVencIsParamSet(const VENC_PACK_S *pack, int codec) {
+    if (codec)
+        return pack->DataType.enH265EType >= H265E_NALU_VPS && pack->DataType.enH265EType <= H265E_NALU_PPS;
+    return H264E_NALU_SPS == pack->DataType.enH264EType || H264E_NALU_PPS == pack->DataType.enH264EType;
+}
+
+/* copy a pack into the refresh buffer, at most len bytes, turned into a P slice if it is a slice */
+static HI_U8 *mockVencRefreshCopy(VENC_PACK_S *out, const VENC_PACK_S *in, HI_U8 *p, HI_U32 len, int codec) {
+    HI_U32 h = 0;
+
+    *out = *in;
+    memcpy(p, in->pu8Addr + in->u32Offset, len);
+    out->pu8Addr = p;
+    out->u32Offset = 0;
+    out->u32Len = len;
+    out->bFrameEnd = HI_FALSE;
+    if (mockVencIsSlice(in, codec)) {
+        while (h < len && !p[h])
+            h++;
+        if (++h < len) {
+            if (codec)
+                p[h] = (HI_U8)((p[h] & 0x81) | (1 << 1));      // TRAIL_R
+            else
+                p[h] = (HI_U8)((p[h] & 0xe0) | 1);             // non-IDR slice
+        }
+        if (codec)
+            out->DataType.enH265EType = H265E_NALU_PSLICE;
+        else
+            out->DataType.enH264EType = H264E_NALU_PSLICE;
+    }
+    return p + len;
+}
+
+/*
+ * Intra refresh, modelled on the replayed file. Its I frames after the first come out
+ * as P frames cut to the mean P frame size unless an IDR was requested, the bytes cut
+ * are spread over the next refresh period as filler data NALUs, standing in for the
+ * intra rows each refreshed P frame carries. The stream doesn't decode, its sizes
+ * are what the sinks see. A requested IDR is the next I frame of the file.
+ */
+static void mockVencRefresh(MockVencChn *chn, VENC_STREAM_S *stream, int codec) {
+    HI_U32 height = codec ? chn->attr.stVeAttr.stAttrH265e.u32PicHeight : chn->attr.stVeAttr.stAttrH264e.u32PicHeight;
+    HI_U32 rows = codec ? (height + 63) / 64 : (height + 15) / 16;
+    HI_U32 i, n = 0, key = 0, bytes = 0, slices = 0, budget, len, fill = 0;
+    HI_U8 *p;
+
+    if (!chn->refresh.bRefreshEnable || 0 == chn->refresh.u32RefreshLineNum)
+        return;
+    for (i = 0; i < stream->u32PackCount; i++) {
+        len = stream->pstPack[i].u32Len - stream->pstPack[i].u32Offset;
+        bytes += len;
+        if (mockVencIsSlice(&stream->pstPack[i], codec))
+            slices += len;
+        key |= codec ? H265E_NALU_ISLICE == stream->pstPack[i].DataType.enH265EType :
+                       H264E_NALU_ISLICE == stream->pstPack[i].DataType.enH264EType;
+    }
+
+    if (key && (!chn->keySeen || chn->idrWanted)) {
+        chn->keySeen = 1;
+        chn->idrWanted = 0;
+        return;
+    }
+    if (!key) {
+        chn->pMean = chn->pMean ? (chn->pMean * 7 + bytes) / 8 : bytes;
+        if (0 == chn->fillFrames)
+            return;
+        fill = chn->fillLeft / chn->fillFrames;
+        chn->fillLeft -= fill;
+        chn->fillFrames--;
+    }
+
+    if (chn->refreshPackCap < stream->u32PackCount + 1) {
+        free(chn->refreshPacks);
+        chn->refreshPacks = (VENC_PACK_S *)malloc((stream->u32PackCount + 1) * sizeof(VENC_PACK_S));
+        chn->refreshPackCap = chn->refreshPacks ? stream->u32PackCount + 1 : 0;
+    }
+    if (chn->refreshBufSize < bytes + fill + 8) {
+        free(chn->refreshBuf);
+        chn->refreshBuf = (HI_U8 *)malloc(bytes + fill + 8);
+        chn->refreshBufSize = chn->refreshBuf ? bytes + fill + 8 : 0;
+    }
+    if (NULL == chn->refreshPacks || NULL == chn->refreshBuf)
+        return;
+
+    p = chn->refreshBuf;
+    budget = chn->pMean ? chn->pMean : slices / 8;
+    for (i = 0; i < stream->u32PackCount; i++) {
+        len = stream->pstPack[i].u32Len - stream->pstPack[i].u32Offset;
+        if (key && mockVencIsParamSet(&stream->pstPack[i], codec))
+            continue;
+        if (key && mockVencIsSlice(&stream->pstPack[i], codec) && budget < slices) {
+            len = (HI_U32)((uint64_t)len * budget / slices);
+            if (len < 8)
+                len = 8;
+        }
+        p = mockVencRefreshCopy(&chn->refreshPacks[n++], &stream->pstPack[i], p, len, codec);
+    }
+
+    if (key) {
+        for (i = 0; i < n; i++)
+            bytes -= chn->refreshPacks[i].u32Len;
+        chn->fillLeft += bytes;     // what was cut, and the parameter sets
+        chn->fillFrames = rows / chn->refresh.u32RefreshLineNum + 1;
+    } else if (fill > 6) {
+        VENC_PACK_S *pack = &chn->refreshPacks[n++];
+
+        *pack = stream->pstPack[stream->u32PackCount - 1];
+        pack->pu8Addr = p;
+        pack->u32Offset = 0;
+        pack->u32Len = fill;
+        memcpy(p, "\0\0\0\1", 4);
+        if (codec) {
+            p[4] = 38 << 1;         // FD_NUT
+            p[5] = 1;
+            pack->DataType.enH265EType = (H265E_NALU_TYPE_E)38;
+        } else {
+            p[4] = 12;              // filler data
+            pack->DataType.enH264EType = (H264E_NALU_TYPE_E)12;
+        }
+        memset(p + 4 + (codec ? 2 : 1), 0xff, fill - 5 - (codec ? 2 : 1));
+        p[fill - 1] = 0x80;
+    }
+
+    chn->refreshPacks[n - 1].bFrameEnd = HI_TRUE;
+    stream->pstPack = chn->refreshPacks;
+    stream->u32PackCount = n;
+}
+
+/*
+ * A frame over the super frame threshold is dropped, or encoded again: that takes another
+ * encode time and comes out with its slices cut to the threshold, as if by a higher qp.
+ * -1 drop the frame, else the number of times it was encoded
+ */
+static int mockVencSuperFrame(MockVencChn *chn, VENC_STREAM_S *stream, int codec) {
+    HI_U32 i, key = 0, bytes = 0, slices = 0, thr, budget;
+    VENC_PACK_S *pack;
+
+    if (SUPERFRM_NONE == chn->superFrame.enSuperFrmMode)
+        return 1;
+    for (i = 0; i < stream->u32PackCount; i++) {
+        pack = &stream->pstPack[i];
+        bytes += pack->u32Len - pack->u32Offset;
+        if (mockVencIsSlice(pack, codec))
+            slices += pack->u32Len - pack->u32Offset;
+        key |= codec ? H265E_NALU_ISLICE == pack->DataType.enH265EType : H264E_NALU_ISLICE == pack->DataType.enH264EType;
+    }
+    thr = (key ? chn->superFrame.u32SuperIFrmBitsThr : chn->superFrame.u32SuperPFrmBitsThr) / 8;
+    if (0 == thr || bytes <= thr)
+        return 1;
+    if (SUPERFRM_DISCARD == chn->superFrame.enSuperFrmMode)
+        return -1;
+
+    budget = bytes - slices < thr ? thr - (bytes - slices) : 0;
+    for (i = 0; i < stream->u32PackCount; i++) {
+        pack = &stream->pstPack[i];
+        if (mockVencIsSlice(pack, codec))
+            pack->u32Len = pack->u32Offset + (HI_U32)((uint64_t)(pack->u32Len - pack->u32Offset) * budget / slices);
+    }
+    return 2;
+}
+
+/*
+ * Advanced frame skipping reference: the replayed P frames get the reference type their
+ * position after the I frame has with u32Base and u32Enhance, an enhance frame after each
+ * base frame and with u32Base 2 every other base frame referenced by the enhance frames
+ * only. The bytes stay those of the file, the sinks see which frames they may skip
+ */
+static void mockVencRefType(MockVencChn *chn, VENC_STREAM_S *stream, int codec) {
+    H264E_REF_TYPE_E type;
+    HI_U32 i, key = 0, base;
+
+    if (0 == chn->ref.u32Base)
+        return;
+    for (i = 0; i < stream->u32PackCount; i++)
+        key |= codec ? H265E_NALU_ISLICE == stream->pstPack[i].DataType.enH265EType :
+                       H264E_NALU_ISLICE == stream->pstPack[i].DataType.enH264EType;
+    if (key)
+        chn->refPos = 0;
+
+    if (0 == chn->refPos) {
+        type = BASE_IDRSLICE;
+    } else if (chn->refPos % (chn->ref.u32Enhance + 1)) {
+        type = ENHANCE_PSLICE_NOTFORREF;
+    } else {
+        base = chn->refPos / (chn->ref.u32Enhance + 1);
+        type = (base % chn->ref.u32Base) ? BASE_PSLICE_REFBYENHANCE : BASE_PSLICE_REFBYBASE;
+    }
+    chn->refPos++;
+
+    if (codec)
+        stream->stH265Info.enRefType = type;
+    else
+        stream->stH264Info.enRefType = type;
+}
+
+static void *mockVencThread(void *arg) {
+    MockVencChn *chn = (MockVencChn *)arg;
+    int VeChn = (int)(chn - gMockVenc);
+    int codec = PT_H265 == chn->attr.stVeAttr.enType;
+    char name[24];
+    const char *path;
+    ReplayContext replay;
+    VENC_STREAM_S stream;
+    VENC_PACK_S *packs = NULL, *grown;
+    HI_U32 packCap = 0, seiLen;
+    int encodes;
+    static HI_U8 sei[MOCK_VENC_CHN_MAX][MOCK_USER_DATA_NUM * (MOCK_USER_DATA_MAX * 3 / 2 + 8) + 8];
+    uint64_t encodeUs = (uint64_t)(mockEnvDouble("HILI_MOCK_ENCODE_MS", 0) * 1000);
+
+    snprintf(name, sizeof(name), "HILI_MOCK_VIDEO%d", VeChn);
+    path = mockEnv(name, NULL);
+    if (NULL == path)
+        path = mockEnv("HILI_MOCK_VIDEO", codec ? "stream.h265" : "stream.h264");
+
+    if (replayOpen(&replay, path, codec, mockVencFrameRate(&chn->attr),
+                   mockEnvDouble("HILI_MOCK_SPEED", 1.0), (int)mockEnvDouble("HILI_MOCK_LOOPS", 0)) < 0) {
+        MOCK_LOG("venc chn %d has no input, set HILI_MOCK_VIDEO\n", VeChn);
+        return NULL;
+    }
+    MOCK_LOG("venc chn %d encodes %s by %s\n", VeChn, path,
+             (codec ? chn->attr.stVeAttr.stAttrH265e.bByFrame : chn->attr.stVeAttr.stAttrH264e.bByFrame) ? "frame" : "slice");
+    chn->block = replay.speed <= 0;
+
+    while (chn->running) {
+        replay.frameRate = mockVencFrameRate(&chn->attr);      // follows SetChnAttr
+        if (replayNext(&replay, &stream) <= 0)
+            break;
+        mockVencRefresh(chn, &stream, codec);
+        mockVencRefType(chn, &stream, codec);
+        encodes = mockVencSuperFrame(chn, &stream, codec);
+        if (encodes < 0)
+            continue;
+        seiLen = mockVencUserSei(chn, sei[VeChn], codec);
+        if (seiLen) {
+            if (packCap < stream.u32PackCount + 1) {
+                grown = (VENC_PACK_S *)realloc(packs, (stream.u32PackCount + 1) * sizeof(VENC_PACK_S));
+                if (grown) {
+                    packs = grown;
+                    packCap = stream.u32PackCount + 1;
+                }
+            }
+            if (packCap >= stream.u32PackCount + 1)
+                mockVencAddSei(&stream, packs, sei[VeChn], seiLen, codec);
+        }
+        mockVencEncode(chn, &stream, codec, encodeUs * (uint64_t)encodes);
+    }
+
+    free(packs);
+    replayClose(&replay);
+    MOCK_LOG("venc chn %d input end\n", VeChn);
+    return NULL;
+}
+
+/*
+ * Baseline grayscale JPEG of a flat grey picture. The huffman tables have one code each,
+ * every block is a DC difference of 0 and an EOB, two bits.
+ */
+static HI_U8 *mockJpegFlat(HI_U32 width, HI_U32 height, HI_U32 *len) {
+    HI_U32 bits = (width + 7) / 8 * ((height + 7) / 8) * 2, ecs = (bits + 7) / 8, i;
+    HI_U8 *jpeg = (HI_U8 *)malloc(2 + 69 + 13 + 2 * 22 + 10 + ecs + 2), *p = jpeg;
+
+    if (NULL == jpeg)
+        return NULL;
+    *p++ = 0xff; *p++ = 0xd8;                                   // SOI
+    *p++ = 0xff; *p++ = 0xdb; *p++ = 0; *p++ = 67; *p++ = 0;    // DQT, table 0 all 1
+    memset(p, 1, 64);
+    p += 64;
+    *p++ = 0xff; *p++ = 0xc0; *p++ = 0; *p++ = 11; *p++ = 8;    // SOF0, 8 bit, one component
+    *p++ = (HI_U8)(height >> 8); *p++ = (HI_U8)height;
+    *p++ = (HI_U8)(width >> 8); *p++ = (HI_U8)width;
+    *p++ = 1; *p++ = 1; *p++ = 0x11; *p++ = 0;
+    for (i = 0; i < 2; i++) {                                   // DHT, DC 0 then AC 0: one code '0' for symbol 0
+        *p++ = 0xff; *p++ = 0xc4; *p++ = 0; *p++ = 20; *p++ = (HI_U8)(i << 4);
+        *p++ = 1;
+        memset(p, 0, 16);
+        p += 16;
+    }
+    *p++ = 0xff; *p++ = 0xda; *p++ = 0; *p++ = 8; *p++ = 1;     // SOS
+    *p++ = 1; *p++ = 0; *p++ = 0; *p++ = 63; *p++ = 0;
+    memset(p, 0, ecs);
+    if (bits % 8)
+        p[ecs - 1] = (HI_U8)((1 << (8 - bits % 8)) - 1);        // padded with 1 bits
+    p += ecs;
+    *p++ = 0xff; *p++ = 0xd9;                                   // EOI
+    *len = (HI_U32)(p - jpeg);
+    return jpeg;
+}
+
+/*
+ * A jpeg chn encodes the picture of HILI_MOCK_JPEG, or a flat one of its size, with a comment
+ * segment carrying the picture number so that every snapshot differs. It receives one picture
+ * per frame time, recvNum of them from StartRecvPicEx and then stops like the chip, until
+ * StopRecvPic from StartRecvPic. JPEG_SNAP_FLASH waits for flashed pictures, there are none.
+ */
+static void *mockVencJpegThread(void *arg) {
+    MockVencChn *chn = (MockVencChn *)arg;
+    int VeChn = (int)(chn - gMockVenc);
+    const VENC_ATTR_JPEG_S *attr = &chn->attr.stVeAttr.stAttrJpeg;
+    const char *path = mockEnv("HILI_MOCK_JPEG", NULL);
+    uint64_t encodeUs = (uint64_t)(mockEnvDouble("HILI_MOCK_ENCODE_MS", 0) * 1000), due = getMonotonicTime();
+    HI_U8 *jpeg = NULL, *pic;
+    HI_U32 len = 0, com;
+    VENC_STREAM_S stream;
+    VENC_PACK_S pack;
+    HI_S32 i;
+    int size;
+
+    if (path && (readFile(&jpeg, &size, path) < 0 || size < 4 || jpeg[0] != 0xff || jpeg[1] != 0xd8)) {
+        MOCK_LOG("venc chn %d: %s is no jpeg\n", VeChn, path);
+        free(jpeg);
+        return NULL;
+    }
+    if (path)
+        len = (HI_U32)size;
+    else
+        jpeg = mockJpegFlat(attr->u32PicWidth, attr->u32PicHeight, &len);
+    pic = (HI_U8 *)malloc(len + 4 + MOCK_JPEG_COM);
+    if (NULL == jpeg || NULL == pic || JPEG_SNAP_FLASH == chn->snapMode) {
+        free(jpeg);
+        free(pic);
+        return NULL;
+    }
+
+    for (i = 0; chn->running && (chn->recvNum < 0 || i < chn->recvNum); i++) {
+        due += 1000000 / MOCK_JPEG_FPS;
+        mockVencSleepUntil(due + encodeUs);
+        if (!chn->running)
+            break;
+
+        /* SOI, the comment, the rest of the file */
+        com = (HI_U32)snprintf((char *)pic + 6, MOCK_JPEG_COM - 2, "hisilive mock snapshot %u q%u",
+                               chn->jpegSeq, chn->jpegParam.u32Qfactor);
+        memcpy(pic, "\xff\xd8\xff\xfe", 4);
+        pic[4] = (HI_U8)((com + 2) >> 8);
+        pic[5] = (HI_U8)(com + 2);
+        memcpy(pic + 6 + com, jpeg + 2, len - 2);
+
+        memset(&stream, 0, sizeof(stream));
+        memset(&pack, 0, sizeof(pack));
+        pack.u64PTS = getMonotonicTime();     // the clock of HI_MPI_SYS_GetCurPts
+        pack.pu8Addr = pic;
+        pack.u32Len = len + 4 + com;
+        pack.bFrameEnd = HI_TRUE;
+        pack.DataType.enJPEGEType = JPEGE_PACK_PIC;
+        stream.pstPack = &pack;
+        stream.u32PackCount = 1;
+        stream.u32Seq = chn->jpegSeq++;
+        mockVencPush(chn, &stream, 0, 1, 0);
+    }
+
+    free(jpeg);
+    free(pic);
+    return NULL;
+}
+
+HI_S32 HI_MPI_VENC_CreateChn(VENC_CHN VeChn, const VENC_CHN_ATTR_S *pstAttr) {
+    MockVencChn *chn;
+
+    if (VeChn < 0 || VeChn >= MOCK_VENC_CHN_MAX)
+        return HI_ERR_VENC_INVALID_CHNID;
+    if (NULL == pstAttr)
+        return HI_ERR_VENC_NULL_PTR;
+
+    chn = &gMockVenc[VeChn];
+    if (chn->created)
+        return HI_ERR_VENC_EXIST;
+
+    memset(chn, 0, sizeof(MockVencChn));
+    chn->bufSize = PT_H265 == pstAttr->stVeAttr.enType ? pstAttr->stVeAttr.stAttrH265e.u32BufSize :
+                   PT_JPEG == pstAttr->stVeAttr.enType ? pstAttr->stVeAttr.stAttrJpeg.u32BufSize :
+                   pstAttr->stVeAttr.stAttrH264e.u32BufSize;
+    if (0 == chn->bufSize)
+        chn->bufSize = 1920 * 1080 * 2;
+    chn->buf = (HI_U8 *)malloc(chn->bufSize);
+    chn->fd = mockEventOpen();
+    if (NULL == chn->buf || chn->fd < 0) {
+        free(chn->buf);
+        return HI_ERR_VENC_NOMEM;
+    }
+    chn->attr = *pstAttr;
+    chn->jpegParam.u32Qfactor = 90;
+    pthread_mutex_init(&chn->lock, NULL);
+    pthread_cond_init(&chn->space, NULL);
+    chn->created = 1;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_StopRecvPic(VENC_CHN VeChn) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (chn->running) {
+        pthread_mutex_lock(&chn->lock);
+        chn->running = 0;
+        pthread_cond_signal(&chn->space);
+        pthread_mutex_unlock(&chn->lock);
+        pthread_join(chn->thread, NULL);
+    }
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_DestroyChn(VENC_CHN VeChn) {
+    MockVencChn *chn = mockVencGet(VeChn);
+    int i;
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+
+    HI_MPI_VENC_StopRecvPic(VeChn);
+    for (i = 0; i < MOCK_VENC_DEPTH; i++)
+        free(chn->ring[i].packs);
+    free(chn->refreshPacks);
+    free(chn->refreshBuf);
+    free(chn->buf);
+    close(chn->fd);
+    pthread_mutex_destroy(&chn->lock);
+    pthread_cond_destroy(&chn->space);
+    memset(chn, 0, sizeof(MockVencChn));
+    return HI_SUCCESS;
+}
+
+static HI_S32 mockVencStart(MockVencChn *chn) {
+    chn->running = 1;
+    if (pthread_create(&chn->thread, NULL, PT_JPEG == chn->attr.stVeAttr.enType ? mockVencJpegThread : mockVencThread,
+                       chn) != 0) {
+        chn->running = 0;
+        return HI_ERR_VENC_NOMEM;
+    }
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_StartRecvPic(VENC_CHN VeChn) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (chn->running)
+        return HI_SUCCESS;
+    chn->recvNum = -1;
+    return mockVencStart(chn);
+}
+
+/* the count is kept by jpeg chns only, the replay of the others goes on until StopRecvPic */
+HI_S32 HI_MPI_VENC_StartRecvPicEx(VENC_CHN VeChn, VENC_RECV_PIC_PARAM_S *pstRecvParam) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstRecvParam)
+        return HI_ERR_VENC_NULL_PTR;
+    if (pstRecvParam->s32RecvPicNum <= 0)
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+    if (chn->running)
+        return HI_ERR_VENC_NOT_PERM;     // StopRecvPic first, also after the pictures were received
+    chn->recvNum = pstRecvParam->s32RecvPicNum;
+    return mockVencStart(chn);
+}
+
+HI_S32 HI_MPI_VENC_SetChnAttr(VENC_CHN VeChn, const VENC_CHN_ATTR_S *pstAttr) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstAttr)
+        return HI_ERR_VENC_NULL_PTR;
+    chn->attr = *pstAttr;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetChnAttr(VENC_CHN VeChn, VENC_CHN_ATTR_S *pstAttr) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstAttr)
+        return HI_ERR_VENC_NULL_PTR;
+    *pstAttr = chn->attr;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetFd(VENC_CHN VeChn) {
+    MockVencChn *chn = mockVencGet(VeChn);
+    return chn ? chn->fd : HI_ERR_VENC_UNEXIST;
+}
+
+HI_S32 HI_MPI_VENC_Query(VENC_CHN VeChn, VENC_CHN_STAT_S *pstStat) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstStat)
+        return HI_ERR_VENC_NULL_PTR;
+
+    memset(pstStat, 0, sizeof(VENC_CHN_STAT_S));
+    pthread_mutex_lock(&chn->lock);
+    pstStat->u32LeftStreamFrames = (HI_U32)(chn->count - chn->got);
+    pstStat->u32LeftStreamBytes = chn->leftBytes;
+    if (chn->count > chn->got)
+        pstStat->u32CurPacks = chn->ring[(chn->head + chn->got) % MOCK_VENC_DEPTH].packCount;
+    pthread_mutex_unlock(&chn->lock);
+    return HI_SUCCESS;
+}
+
+/* s32MilliSec, -1 blocks, 0 returns at once */
+HI_S32 HI_MPI_VENC_GetStream(VENC_CHN VeChn, VENC_STREAM_S *pstStream, HI_S32 s32MilliSec) {
+    MockVencChn *chn = mockVencGet(VeChn);
+    MockVencFrame *frame;
+    struct pollfd pfd;
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstStream || NULL == pstStream->pstPack)
+        return HI_ERR_VENC_NULL_PTR;
+
+    if (mockEventTake(chn->fd) < 0) {
+        pfd.fd = chn->fd;
+        pfd.events = POLLIN;
+        if (0 == s32MilliSec || poll(&pfd, 1, s32MilliSec) <= 0 || mockEventTake(chn->fd) < 0)
+            return HI_ERR_VENC_BUF_EMPTY;
+    }
+
+    pthread_mutex_lock(&chn->lock);
+    frame = &chn->ring[(chn->head + chn->got) % MOCK_VENC_DEPTH];
+    if (pstStream->u32PackCount < frame->packCount) {
+        pthread_mutex_unlock(&chn->lock);
+        mockEventPost(chn->fd);     // the frame stays pending
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+    }
+    memcpy(pstStream->pstPack, frame->packs, frame->packCount * sizeof(VENC_PACK_S));
+    pstStream->u32PackCount = frame->packCount;
+    pstStream->u32Seq = frame->seq;
+    chn->leftBytes -= frame->bytes;
+    if (PT_H265 == chn->attr.stVeAttr.enType)
+        pstStream->stH265Info.enRefType = (H265E_REF_TYPE_E)frame->refType;
+    else
+        pstStream->stH264Info.enRefType = (H264E_REF_TYPE_E)frame->refType;
+    chn->got++;
+    pthread_mutex_unlock(&chn->lock);
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_ReleaseStream(VENC_CHN VeChn, VENC_STREAM_S *pstStream) {
+    MockVencChn *chn = mockVencGet(VeChn);
+    MockVencFrame *frame;
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstStream)
+        return HI_ERR_VENC_NULL_PTR;
+
+    pthread_mutex_lock(&chn->lock);
+    frame = &chn->ring[chn->head];
+    if (0 == chn->got || frame->seq != pstStream->u32Seq) {
+        pthread_mutex_unlock(&chn->lock);
+        return HI_ERR_VENC_ILLEGAL_PARAM;       // streams are released in the order they were got
+    }
+    if (frame->pos + frame->bytes <= chn->bufSize) {
+        memset(chn->buf + frame->pos, MOCK_VENC_POISON, frame->bytes);
+    } else {
+        memset(chn->buf + frame->pos, MOCK_VENC_POISON, chn->bufSize - frame->pos);
+        memset(chn->buf, MOCK_VENC_POISON, frame->pos + frame->bytes - chn->bufSize);
+    }
+    chn->usedBytes -= frame->bytes;
+    chn->head = (chn->head + 1) % MOCK_VENC_DEPTH;
+    chn->count--;
+    chn->got--;
+    pthread_cond_signal(&chn->space);
+    pthread_mutex_unlock(&chn->lock);
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_SetH264SliceSplit(VENC_CHN VeChn, const VENC_PARAM_H264_SLICE_SPLIT_S *pstSliceSplit) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstSliceSplit)
+        return HI_ERR_VENC_NULL_PTR;
+    if (chn->running)
+        return HI_ERR_VENC_NOT_PERM;     // static, before StartRecvPic
+    chn->h264Split = *pstSliceSplit;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetH264SliceSplit(VENC_CHN VeChn, VENC_PARAM_H264_SLICE_SPLIT_S *pstSliceSplit) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstSliceSplit)
+        return HI_ERR_VENC_NULL_PTR;
+    *pstSliceSplit = chn->h264Split;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_SetH265SliceSplit(VENC_CHN VeChn, const VENC_PARAM_H265_SLICE_SPLIT_S *pstSliceSplit) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstSliceSplit)
+        return HI_ERR_VENC_NULL_PTR;
+    if (chn->running)
+        return HI_ERR_VENC_NOT_PERM;
+    chn->h265Split = *pstSliceSplit;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetH265SliceSplit(VENC_CHN VeChn, VENC_PARAM_H265_SLICE_SPLIT_S *pstSliceSplit) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstSliceSplit)
+        return HI_ERR_VENC_NULL_PTR;
+    *pstSliceSplit = chn->h265Split;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetStreamBufInfo(VENC_CHN VeChn, VENC_STREAM_BUF_INFO_S *pstStreamBufInfo) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstStreamBufInfo)
+        return HI_ERR_VENC_NULL_PTR;
+    pstStreamBufInfo->u32PhyAddr = 0;
+    pstStreamBufInfo->pUserAddr = chn->buf;
+    pstStreamBufInfo->u32BufSize = chn->bufSize;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_InsertUserData(VENC_CHN VeChn, HI_U8 *pu8Data, HI_U32 u32Len) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pu8Data)
+        return HI_ERR_VENC_NULL_PTR;
+    if (0 == u32Len || u32Len > MOCK_USER_DATA_MAX)
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+
+    pthread_mutex_lock(&chn->lock);
+    if (MOCK_USER_DATA_NUM == chn->userNum) {
+        pthread_mutex_unlock(&chn->lock);
+        return HI_ERR_VENC_BUF_FULL;
+    }
+    memcpy(chn->userData[chn->userNum], pu8Data, u32Len);
+    chn->userLen[chn->userNum++] = u32Len;
+    pthread_mutex_unlock(&chn->lock);
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_SetIntraRefresh(VENC_CHN VeChn, VENC_PARAM_INTRA_REFRESH_S *pstIntraRefresh) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstIntraRefresh)
+        return HI_ERR_VENC_NULL_PTR;
+    if (chn->running)
+        return HI_ERR_VENC_NOT_PERM;
+    if (pstIntraRefresh->bRefreshEnable && 0 == pstIntraRefresh->u32RefreshLineNum)
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+    chn->refresh = *pstIntraRefresh;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetIntraRefresh(VENC_CHN VeChn, VENC_PARAM_INTRA_REFRESH_S *pstIntraRefresh) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstIntraRefresh)
+        return HI_ERR_VENC_NULL_PTR;
+    *pstIntraRefresh = chn->refresh;
+    return HI_SUCCESS;
+}
+
+/* the next I frame of the replayed file comes out as one, see mockVencRefresh() */
+HI_S32 HI_MPI_VENC_RequestIDR(VENC_CHN VeChn, HI_BOOL bInstant) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    chn->idrWanted = 1;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_SetSuperFrameCfg(VENC_CHN VeChn, const VENC_SUPERFRAME_CFG_S *pstSuperFrmParam) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstSuperFrmParam)
+        return HI_ERR_VENC_NULL_PTR;
+    if (pstSuperFrmParam->enSuperFrmMode >= SUPERFRM_BUTT)
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+    chn->superFrame = *pstSuperFrmParam;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetSuperFrameCfg(VENC_CHN VeChn, VENC_SUPERFRAME_CFG_S *pstSuperFrmParam) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstSuperFrmParam)
+        return HI_ERR_VENC_NULL_PTR;
+    *pstSuperFrmParam = chn->superFrame;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_SetRefParam(VENC_CHN VeChn, const VENC_PARAM_REF_S *pstRefParam) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstRefParam)
+        return HI_ERR_VENC_NULL_PTR;
+    if (chn->running)
+        return HI_ERR_VENC_NOT_PERM;
+    if (0 == pstRefParam->u32Base || pstRefParam->u32Enhance > 255)
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+    chn->ref = *pstRefParam;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetRefParam(VENC_CHN VeChn, VENC_PARAM_REF_S *pstRefParam) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstRefParam)
+        return HI_ERR_VENC_NULL_PTR;
+    *pstRefParam = chn->ref;
+    if (0 == pstRefParam->u32Base) {
+        pstRefParam->u32Base = 1;       // the chip default, no skipping
+        pstRefParam->bEnablePred = HI_TRUE;
+    }
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_SetRoiCfg(VENC_CHN VeChn, VENC_ROI_CFG_S *pstVencRoiCfg) {
+    MockVencChn *chn = mockVencGet(VeChn);
+    int codec;
+    HI_U32 width, height;
+    const RECT_S *rect;
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstVencRoiCfg)
+        return HI_ERR_VENC_NULL_PTR;
+    if (pstVencRoiCfg->u32Index >= MOCK_ROI_NUM)
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+
+    /* regions on the 16 pixel grid within the picture, qp -51..51 relative or 0..51 absolute */
+    codec = (PT_H265 == chn->attr.stVeAttr.enType);
+    width = codec ? chn->attr.stVeAttr.stAttrH265e.u32PicWidth : chn->attr.stVeAttr.stAttrH264e.u32PicWidth;
+    height = codec ? chn->attr.stVeAttr.stAttrH265e.u32PicHeight : chn->attr.stVeAttr.stAttrH264e.u32PicHeight;
+    rect = &pstVencRoiCfg->stRect;
+    if (pstVencRoiCfg->bEnable &&
+        (rect->s32X < 0 || rect->s32Y < 0 || (rect->s32X | rect->s32Y | rect->u32Width | rect->u32Height) & 15 ||
+         0 == rect->u32Width || 0 == rect->u32Height ||
+         (HI_U32)rect->s32X + rect->u32Width > width || (HI_U32)rect->s32Y + rect->u32Height > height ||
+         pstVencRoiCfg->s32Qp > 51 || pstVencRoiCfg->s32Qp < (pstVencRoiCfg->bAbsQp ? 0 : -51)))
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+    chn->roi[pstVencRoiCfg->u32Index] = *pstVencRoiCfg;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetRoiCfg(VENC_CHN VeChn, HI_U32 u32Index, VENC_ROI_CFG_S *pstVencRoiCfg) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstVencRoiCfg)
+        return HI_ERR_VENC_NULL_PTR;
+    if (u32Index >= MOCK_ROI_NUM)
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+    *pstVencRoiCfg = chn->roi[u32Index];
+    pstVencRoiCfg->u32Index = u32Index;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_SetRoiBgFrameRate(VENC_CHN VeChn, const VENC_ROIBG_FRAME_RATE_S *pstRoiBgFrmRate) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstRoiBgFrmRate)
+        return HI_ERR_VENC_NULL_PTR;
+    if (pstRoiBgFrmRate->s32SrcFrmRate <= 0 || pstRoiBgFrmRate->s32DstFrmRate <= 0 ||
+        pstRoiBgFrmRate->s32DstFrmRate > pstRoiBgFrmRate->s32SrcFrmRate)
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+    chn->roiBg = *pstRoiBgFrmRate;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetRoiBgFrameRate(VENC_CHN VeChn, VENC_ROIBG_FRAME_RATE_S *pstRoiBgFrmRate) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstRoiBgFrmRate)
+        return HI_ERR_VENC_NULL_PTR;
+    *pstRoiBgFrmRate = chn->roiBg;
+    if (0 == pstRoiBgFrmRate->s32SrcFrmRate) {
+        pstRoiBgFrmRate->s32SrcFrmRate = mockVencFrameRate(&chn->attr);    // no skipping
+        pstRoiBgFrmRate->s32DstFrmRate = pstRoiBgFrmRate->s32SrcFrmRate;
+    }
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_SetJpegSnapMode(VENC_CHN VeChn, VENC_JPEG_SNAP_MODE_E enJpegSnapMode) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (PT_JPEG != chn->attr.stVeAttr.enType || chn->running)
+        return HI_ERR_VENC_NOT_PERM;
+    if (enJpegSnapMode >= JPEG_SNAP_BUTT)
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+    chn->snapMode = enJpegSnapMode;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetJpegSnapMode(VENC_CHN VeChn, VENC_JPEG_SNAP_MODE_E *penJpegSnapMode) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == penJpegSnapMode)
+        return HI_ERR_VENC_NULL_PTR;
+    *penJpegSnapMode = chn->snapMode;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_SetJpegParam(VENC_CHN VeChn, const VENC_PARAM_JPEG_S *pstJpegParam) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstJpegParam)
+        return HI_ERR_VENC_NULL_PTR;
+    if (PT_JPEG != chn->attr.stVeAttr.enType)
+        return HI_ERR_VENC_NOT_PERM;
+    if (pstJpegParam->u32Qfactor < 1 || pstJpegParam->u32Qfactor > 99)
+        return HI_ERR_VENC_ILLEGAL_PARAM;
+    chn->jpegParam = *pstJpegParam;
+    return HI_SUCCESS;
+}
+
+HI_S32 HI_MPI_VENC_GetJpegParam(VENC_CHN VeChn, VENC_PARAM_JPEG_S *pstJpegParam) {
+    MockVencChn *chn = mockVencGet(VeChn);
+
+    if (NULL == chn)
+        return HI_ERR_VENC_UNEXIST;
+    if (NULL == pstJpegParam)
+        return HI_ERR_VENC_NULL_PTR;
+    *pstJpegParam = chn->jpegParam;
+    return HI_SUCCESS;
+}
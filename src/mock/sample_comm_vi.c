@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+/*
+ * Replaces common/sample_comm_vi.c and sample_comm_isp.c on the host, they drive the
+ * sensor, mipi and isp devices directly. The encoder mock makes its own pictures.
+ */
+
+#include <pthread.h>
+#include "mock.h"
+#include "sample_comm.h"
+
+HI_S32 SAMPLE_COMM_VI_StartVi(SAMPLE_VI_CONFIG_S* pstViConfig) {
+    MOCK_LOG("vi started without sensor\n");
+    return HI_SUCCESS;
+}
+
+HI_S32 SAMPLE_COMM_VI_StopVi(SAMPLE_VI_CONFIG_S* pstViConfig) {
+    return HI_SUCCESS;
+}
+
+HI_S32 SAMPLE_COMM_VI_BindVpss(SAMPLE_VI_MODE_E enViMode) {
+    return HI_SUCCESS;
+}
+
+HI_S32 SAMPLE_COMM_VI_UnBindVpss(SAMPLE_VI_MODE_E enViMode) {
+    return HI_SUCCESS;
+}
+
+HI_VOID SAMPLE_COMM_ISP_Stop(void) {
+}
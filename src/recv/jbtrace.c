@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+/*
+ * Replays packet arrival traces through the audio jitter buffer, built on the host with `make recv`.
+ *
+ * A trace has one packet per line, "arrival_us seq ts marker pt size", as recv/rtprecv -w
+ * writes them, or is one of the built-in ones, 60 s of 20 ms PCMU packets over 10 ms transit:
+ *   clean      nothing but the transit
+ *   jitter30   0..30 ms more transit per packet, reordered
+ *   loss5      5 % of the packets lost
+ *   spike      every 10 s the network stalls 300 ms and delivers the packets at once
+ *   talk       2 s talkspurts, 1 s silence between, 0..10 ms jitter
+ * Without a trace the built-in ones are run. The player is simulated like the talkback one on the device: every frame
+ * time it takes as many samples from the buffer as were played meanwhile.
+ * Reports what was played, concealed and dropped and the playout delay, the time from
+ * the arrival a packet would have had with the smallest transit of the trace to its play.
+ *
+ *   recv/rtprecv -p 1238 -w talk.trace -t 60
+ *   recv/jbtrace -m 20 -M 400 talk.trace
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "JitterBuffer.h"
+
+#define TRACE_RATE      8000
+#define TRACE_FRAME     160     // samples, 20 ms
+#define TRACE_BINS      2000    // ms
+#define TRACE_SECONDS   60      // of a built-in scenario
+#define TRACE_TRANSIT   10000   // us
+
+typedef struct {
+    uint64_t arrivalUs;
+    uint32_t ts;
+    int marker;
+    int size;
+    uint32_t samples;
+}TracePacket;
+
+typedef struct {
+    uint32_t bins[TRACE_BINS];
+    uint64_t count;
+    double sum;
+    double max;
+}DelayHisto;
+
+static uint32_t gRand = 0x1234567;
+
+static uint32_t traceRand() {
+    gRand ^= gRand << 13;
+    gRand ^= gRand >> 17;
+    gRand ^= gRand << 5;
+    return gRand;
+}
+
+static int traceBuiltIn(const char *name) {
+    return !strcmp(name, "clean") || !strcmp(name, "jitter30") || !strcmp(name, "loss5") ||
+           !strcmp(name, "spike") || !strcmp(name, "talk");
+}
+
+static int traceCompare(const void *a, const void *b) {
+    uint64_t x = ((const TracePacket *)a)->arrivalUs, y = ((const TracePacket *)b)->arrivalUs;
+    return (x > y) - (x < y);
+}
+
+/* the packets of a built-in scenario, by arrival */
+static int traceScenario(const char *name, TracePacket **out) {
+    int num = TRACE_SECONDS * TRACE_RATE / TRACE_FRAME, i, n = 0;
+    TracePacket *pkts = (TracePacket *)calloc((size_t)num, sizeof(TracePacket)), *p;
+    uint64_t sent, stall;
+
+    if (NULL == pkts)
+        return -1;
+    gRand = 0x1234567;      // the same packets every run
+
+    for (i = 0; i < num; i++) {
+        sent = (uint64_t)i * TRACE_FRAME * 1000000 / TRACE_RATE;
+        p = &pkts[n];
+        p->ts = (uint32_t)i * TRACE_FRAME;
+        p->size = TRACE_FRAME;
+        p->samples = TRACE_FRAME;
+        p->arrivalUs = sent + TRACE_TRANSIT;
+
+        if (!strcmp(name, "jitter30")) {
+            p->arrivalUs += traceRand() % 30000;
+        } else if (!strcmp(name, "loss5")) {
+            if (traceRand() % 100 < 5)
+                continue;
+        } else if (!strcmp(name, "spike")) {
+            stall = sent % 10000000;
+            if (sent >= 10000000 && stall < 300000)
+                p->arrivalUs += 300000 - stall;
+        } else if (!strcmp(name, "talk")) {
+            if (sent % 3000000 >= 2000000)
+                continue;
+            p->marker = sent % 3000000 < 20000;
+            p->arrivalUs += traceRand() % 10000;
+        }
+        n++;
+    }
+
+    qsort(pkts, (size_t)n, sizeof(TracePacket), traceCompare);
+    *out = pkts;
+    return n;
+}
+
+/* samples in a packet of the static or hisilive payload types */
+static uint32_t traceSamples(int pt, int size) {
+    switch (pt) {
+        case 5:  return size > 4 ? (uint32_t)(size - 4) * 2 : 0;  // DVI4
+        case 97: return (uint32_t)size * 2;                        // G726-32
+        default: return (uint32_t)size;                            // PCMU, PCMA
+    }
+}
+
+static int traceLoad(const char *path, TracePacket **out) {
+    FILE *fp = fopen(path, "r");
+    TracePacket *pkts = NULL, *p;
+    unsigned long long arrival;
+    unsigned seq, ts;
+    int num = 0, cap = 0, marker, pt, size;
+
+    if (NULL == fp) {
+        printf("open %s failed.\n", path);
+        return -1;
+    }
+    while (fscanf(fp, "%llu %u %u %d %d %d", &arrival, &seq, &ts, &marker, &pt, &size) == 6) {
+        if (num == cap) {
+            cap = cap ? cap * 2 : 1024;
+            p = (TracePacket *)realloc(pkts, sizeof(TracePacket) * (size_t)cap);
+            if (NULL == p) {
+                free(pkts);
+                fclose(fp);
+                return -1;
+            }
+            pkts = p;
+        }
+        p = &pkts[num++];
+        p->arrivalUs = arrival;
+        p->ts = ts;
+        p->marker = marker;
+        p->size = size;
+        p->samples = traceSamples(pt, size);
+    }
+    fclose(fp);
+    *out = pkts;
+    return num;
+}
+
+static void delayAdd(DelayHisto *h, double ms) {
+    int bin = ms < 0 ? 0 : (int)ms;
+    h->bins[bin < TRACE_BINS ? bin : TRACE_BINS - 1]++;
+    h->count++;
+    h->sum += ms;
+    if (ms > h->max)
+        h->max = ms;
+}
+
+static double delayPercentile(const DelayHisto *h, double p) {
+    uint64_t want = (uint64_t)(h->count * p), n = 0;
+    int i;
+
+    for (i = 0; i < TRACE_BINS; i++) {
+        n += h->bins[i];
+        if (n > want)
+            return (double)(i + 1) < h->max ? (double)(i + 1) : h->max;
+    }
+    return h->max;
+}
+
+static void traceRun(const char *path, const TracePacket *pkts, int num, uint32_t minMs, uint32_t maxMs, int json) {
+    static uint8_t payload[JB_PAYLOAD_MAX];
+    static JitterBuffer jb;
+    static DelayHisto delay;
+    uint64_t now, tick = (uint64_t)TRACE_FRAME * 1000000 / TRACE_RATE, base = pkts[0].arrivalUs;
+    uint32_t baseTs = pkts[0].ts;
+    int64_t minTransit = INT64_MAX, transit;
+    int64_t credit = 0;
+    uint64_t playedUs = 0, concealedUs = 0, idleUs = 0, targetSum = 0, ticks = 0;
+    JBFrame frame;
+    int i, next = 0;
+
+    /* the smallest transit of the trace, the delay is measured from it */
+    for (i = 0; i < num; i++) {
+        transit = (int64_t)(pkts[i].arrivalUs - base) - (int64_t)(int32_t)(pkts[i].ts - baseTs) * 1000000 / TRACE_RATE;
+        if (transit < minTransit)
+            minTransit = transit;
+    }
+
+    memset(&delay, 0, sizeof(delay));
+    memset(payload, 0xd5, sizeof(payload));
+    jbInit(&jb, TRACE_RATE, TRACE_FRAME, minMs, maxMs);
+
+    for (now = base; next < num || jb.count > 0; now += tick) {
+        for (; next < num && pkts[next].arrivalUs <= now; next++)
+            jbPut(&jb, pkts[next].ts, pkts[next].marker, payload,
+                  pkts[next].size > JB_PAYLOAD_MAX ? JB_PAYLOAD_MAX : pkts[next].size,
+                  pkts[next].samples, pkts[next].arrivalUs);
+
+        credit += TRACE_FRAME;
+        while (credit > 0) {
+            if (JB_IDLE == jbGet(&jb, now, &frame)) {
+                credit = 0;
+                idleUs += tick;
+                break;
+            }
+            credit -= frame.samples;
+            if (JB_PLAY == frame.kind) {
+                playedUs += (uint64_t)frame.samples * 1000000 / TRACE_RATE;
+                delayAdd(&delay, ((double)(now - base) - minTransit -
+                                  (double)(int32_t)(frame.ts - baseTs) * 1000000 / TRACE_RATE) / 1000);
+            } else {
+                concealedUs += (uint64_t)frame.samples * 1000000 / TRACE_RATE;
+            }
+        }
+        targetSum += jbTargetMs(&jb);
+        ticks++;
+    }
+
+    if (json) {
+        printf("{\"trace\":\"%s\",\"packets\":%d,\"min_ms\":%u,\"max_ms\":%u,\"played\":%u,\"late\":%u,"
+               "\"duplicates\":%u,\"overflows\":%u,\"lost\":%u,\"underruns\":%u,\"dropped\":%u,\"resyncs\":%u,"
+               "\"played_ms\":%llu,\"concealed_ms\":%llu,\"idle_ms\":%llu,\"target_mean_ms\":%.1f,"
+               "\"delay_mean_ms\":%.1f,\"delay_p95_ms\":%.1f,\"delay_max_ms\":%.1f}\n",
+               path, num, minMs, maxMs, jb.stats.played, jb.stats.late, jb.stats.duplicates, jb.stats.overflows,
+               jb.stats.lost, jb.stats.underruns, jb.stats.dropped, jb.stats.resyncs,
+               (unsigned long long)playedUs / 1000, (unsigned long long)concealedUs / 1000,
+               (unsigned long long)idleUs / 1000, ticks ? (double)targetSum / ticks : 0.0,
+               delay.count ? delay.sum / delay.count : 0.0, delayPercentile(&delay, 0.95), delay.max);
+    } else {
+        printf("%s: %d packets, played %u, late %u, dup %u, overflow %u\n", path, num, jb.stats.played,
+               jb.stats.late, jb.stats.duplicates, jb.stats.overflows);
+        printf("  concealed: lost %u, underrun %u, %llu ms of %llu ms; dropped to shrink %u, resyncs %u\n",
+               jb.stats.lost, jb.stats.underruns, (unsigned long long)concealedUs / 1000,
+               (unsigned long long)(playedUs + concealedUs) / 1000, jb.stats.dropped, jb.stats.resyncs);
+        printf("  target mean %.1f ms, playout delay mean %.1f p95 %.1f max %.1f ms\n",
+               ticks ? (double)targetSum / ticks : 0.0, delay.count ? delay.sum / delay.count : 0.0,
+               delayPercentile(&delay, 0.95), delay.max);
+    }
+}
+
+static void traceUsage(const char *prg) {
+    printf("Usage : %s [-m min_ms] [-M max_ms] [-j] [trace|clean|jitter30|loss5|spike|talk]...\n", prg);
+    printf("\t -m: smallest delay, default 20 ms.\n");
+    printf("\t -M: largest delay, default 400 ms.\n");
+    printf("\t -j: one JSON object per trace.\n");
+    printf("\t without a trace the built-in scenarios are run.\n");
+    printf("\t 8 kHz audio in 20 ms frames, the talkback of HisiLive -t.\n");
+}
+
+int main(int argc, char **argv) {
+    static const char *scenarios[] = {"clean", "jitter30", "loss5", "spike", "talk"};
+    TracePacket *pkts;
+    int minMs = 20, maxMs = 400, json = 0, opt, num, i;
+
+    while ((opt = getopt(argc, argv, "m:M:jh")) != -1) {
+        switch (opt) {
+            case 'm': minMs = atoi(optarg); break;
+            case 'M': maxMs = atoi(optarg); break;
+            case 'j': json = 1; break;
+            default:
+                traceUsage(argv[0]);
+                return -1;
+        }
+    }
+    if (minMs < 0 || maxMs < minMs) {
+        traceUsage(argv[0]);
+        return -1;
+    }
+
+    if (optind >= argc) {
+        argv = (char **)scenarios;
+        argc = sizeof(scenarios) / sizeof(scenarios[0]);
+        optind = 0;
+    }
+
+    for (i = optind; i < argc; i++) {
+        num = traceBuiltIn(argv[i]) ? traceScenario(argv[i], &pkts) : traceLoad(argv[i], &pkts);
+        if (num <= 0) {
+            printf("%s: no packets.\n", argv[i]);
+            continue;
+        }
+        traceRun(argv[i], pkts, num, (uint32_t)minMs, (uint32_t)maxMs, json);
+        free(pkts);
+    }
+    return 0;
+}
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+/*
+ * Lists and exports the loop recording of HisiLive -m loop, built on the host with `make recv`.
+ *
+ * The segments of the directory are taken in recording order, by the wall clock of their
+ * first GOP. Without -o they are listed. With -o the GOPs covering [from, from + length]
+ * are seeked in the sidecar indexes and copied to one elementary stream, across segments,
+ * starting at the key frame before from.
+ * With -c every indexed GOP has to lie in its segment and start with a key frame, and the
+ * clip read back has to be the exported GOPs, each starting with one. The exit status is 1
+ * if anything fails, so it checks a loop recorded with the mock (make host, make loopcheck).
+ *
+ *   recv/loopexport /mnt/loop
+ *   recv/loopexport -f 60 -d 30 -o clip.h264 /mnt/loop
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "Loop.h"
+
+#define EXPORT_PROBE    256     // bytes of a GOP looked at for its key frame
+
+typedef struct {
+    char path[256];
+    LoopIndex index;
+    uint64_t size;          // of the segment file
+}ExportSegment;
+
+static ExportSegment gSegments[LOOP_SEGMENT_MAX];
+static int gSegmentNum;
+
+static int64_t exportWall(const ExportSegment *seg, int gop) {
+    return seg->index.header.wallBase + (int64_t)seg->index.entries[gop].pts;
+}
+
+static int exportCompare(const void *a, const void *b) {
+    int64_t x = exportWall((const ExportSegment *)a, 0), y = exportWall((const ExportSegment *)b, 0);
+    return (x > y) - (x < y);
+}
+
+static void exportTime(char *buf, int size, int64_t us) {
+    time_t sec = (time_t)(us / 1000000);
+    struct tm tm;
+    int len;
+
+    localtime_r(&sec, &tm);
+    len = (int)strftime(buf, (size_t)size, "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(buf + len, (size_t)(size - len), ".%03d", (int)(us % 1000000 / 1000));
+}
+
+/* the indexed segments of dir, oldest first */
+static int exportLoad(const char *dir) {
+    char path[256];
+    struct stat st;
+    ExportSegment *seg;
+    int i;
+
+    for (i = 0; i < LOOP_SEGMENT_MAX; i++) {
+        loopIndexPath(path, sizeof(path), dir, i);
+        if (stat(path, &st) < 0)
+            continue;
+
+        seg = &gSegments[gSegmentNum];
+        if (loopIndexLoad(path, &seg->index) < 0)
+            return -1;
+        if (0 == seg->index.count) {
+            loopIndexFree(&seg->index);
+            continue;
+        }
+        loopSegmentPath(seg->path, sizeof(seg->path), dir, i, seg->index.header.codec);
+        if (stat(seg->path, &st) < 0) {
+            printf("%s has an index and no segment.\n", seg->path);
+            loopIndexFree(&seg->index);
+            return -1;
+        }
+        seg->size = (uint64_t)st.st_size;
+        gSegmentNum++;
+    }
+
+    qsort(gSegments, (size_t)gSegmentNum, sizeof(ExportSegment), exportCompare);
+    return gSegmentNum;
+}
+
+static void exportList() {
+    const ExportSegment *seg;
+    char start[32];
+    uint64_t bytes;
+    uint32_t frames;
+    int i, j;
+
+    for (i = 0; i < gSegmentNum; i++) {
+        seg = &gSegments[i];
+        for (j = 0, bytes = 0, frames = 0; j < seg->index.count; j++) {
+            bytes += seg->index.entries[j].size;
+            frames += seg->index.entries[j].frames;
+        }
+        exportTime(start, sizeof(start), exportWall(seg, 0));
+        printf("%s: %s, +%.1f s, %d GOPs, %u frames, %.1f MB\n", seg->path, start,
+               (double)(exportWall(seg, 0) - exportWall(&gSegments[0], 0)) / 1000000,
+               seg->index.count, frames, (double)bytes / (1 << 20));
+    }
+}
+
+/* starts with a start code, and the first NAL other than an AUD or SEI is a parameter set or an IDR */
+static int exportKeyStart(const uint8_t *buf, int len, int codec) {
+    int i, type;
+
+    if (len < 4 || buf[0] || buf[1] || (1 != buf[2] && (buf[2] || 1 != buf[3])))
+        return 0;
+    for (i = 0; i + 3 < len; i++) {
+        if (buf[i] || buf[i + 1] || 1 != buf[i + 2])
+            continue;
+        type = codec ? (buf[i + 3] >> 1) & 0x3f : buf[i + 3] & 0x1f;
+        if (codec ? (35 == type || 39 == type || 40 == type) : (9 == type || 6 == type))
+            continue;
+        return codec ? (type >= 32 && type <= 34) || 19 == type || 20 == type : 7 == type || 8 == type || 5 == type;
+    }
+    return 0;
+}
+
+static int exportCheckSegment(const ExportSegment *seg) {
+    const LoopIndexEntry *e;
+    uint8_t buf[EXPORT_PROBE];
+    int fd, i, bad = 0;
+    ssize_t n;
+
+    fd = open(seg->path, O_RDONLY);
+    if (fd < 0) {
+        printf("open %s error %d.\n", seg->path, errno);
+        return -1;
+    }
+    for (i = 0; i < seg->index.count; i++) {
+        e = &seg->index.entries[i];
+        if (e->offset + e->size > seg->size || (i > 0 && e->offset != e[-1].offset + e[-1].size) ||
+            (i > 0 && e->pts <= e[-1].pts)) {
+            printf("%s: GOP %d at %llu, %u bytes, is out of order or beyond the segment.\n", seg->path, i,
+                   (unsigned long long)e->offset, e->size);
+            bad++;
+            continue;
+        }
+        n = pread(fd, buf, sizeof(buf), (off_t)e->offset);
+        if (n <= 0 || !exportKeyStart(buf, (int)n, seg->index.header.codec)) {
+            printf("%s: GOP %d at %llu doesn't start with a key frame.\n", seg->path, i, (unsigned long long)e->offset);
+            bad++;
+        }
+    }
+    close(fd);
+    return bad ? -1 : 0;
+}
+
+/* the GOPs of segment i covering the wall clock [from, to], as loopIndexExport copies them.
+   a GOP lasts until the next one, the last of a segment until the next segment starts */
+static int exportRange(int i, int64_t from, int64_t to, int *first, int *last) {
+    const ExportSegment *seg = &gSegments[i];
+    int64_t wallBase = seg->index.header.wallBase;
+
+    if ((i + 1 < gSegmentNum && from >= exportWall(&gSegments[i + 1], 0)) || to < wallBase)
+        return 0;
+    *first = loopIndexSeek(&seg->index, from > wallBase ? (uint64_t)(from - wallBase) : 0);
+    *last = loopIndexSeek(&seg->index, (uint64_t)(to - wallBase));
+    if (*last < 0)
+        return 0;
+    if (*first < 0)
+        *first = 0;
+    return *last - *first + 1;
+}
+
+static int exportClip(const char *path, int64_t from, int64_t to) {
+    const ExportSegment *seg;
+    int64_t copied, total = 0, wallBase;
+    int fd, i, first, last, gops = 0;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("open %s error %d.\n", path, errno);
+        return -1;
+    }
+
+    for (i = 0; i < gSegmentNum; i++) {
+        if (exportRange(i, from, to, &first, &last) <= 0)
+            continue;
+        seg = &gSegments[i];
+        wallBase = seg->index.header.wallBase;
+        copied = loopIndexExport(&seg->index, seg->path, from > wallBase ? (uint64_t)(from - wallBase) : 0,
+                                 (uint64_t)(to - wallBase), fd);
+        if (copied < 0) {
+            close(fd);
+            return -1;
+        }
+        printf("%s: GOPs %d..%d, %lld bytes\n", seg->path, first, last, (long long)copied);
+        total += copied;
+        gops += last - first + 1;
+    }
+
+    close(fd);
+    printf("%s: %d GOPs, %lld bytes\n", path, gops, (long long)total);
+    return gops;
+}
+
+/* the clip is the GOPs of the range, back to back, each starting with a key frame */
+static int exportCheckClip(const char *path, int64_t from, int64_t to) {
+    const ExportSegment *seg;
+    uint8_t buf[EXPORT_PROBE];
+    uint64_t offset = 0;
+    struct stat st;
+    int fd, i, j, first, last, bad = 0;
+    ssize_t n;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        printf("open %s error %d.\n", path, errno);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    for (i = 0; i < gSegmentNum; i++) {
+        if (exportRange(i, from, to, &first, &last) <= 0)
+            continue;
+        seg = &gSegments[i];
+        for (j = first; j <= last; j++) {
+            n = pread(fd, buf, sizeof(buf), (off_t)offset);
+            if (n <= 0 || !exportKeyStart(buf, (int)n, seg->index.header.codec)) {
+                printf("%s: the GOP at %llu doesn't start with a key frame.\n", path, (unsigned long long)offset);
+                bad++;
+            }
+            offset += seg->index.entries[j].size;
+        }
+    }
+    if (offset != (uint64_t)st.st_size) {
+        printf("%s: %llu bytes, the index has %llu.\n", path, (unsigned long long)st.st_size,
+               (unsigned long long)offset);
+        bad++;
+    }
+    close(fd);
+    return bad ? -1 : 0;
+}
+
+static void exportUsage(const char *prg) {
+    printf("Usage : %s [-f from] [-d length] [-o clip] [-c] dir\n", prg);
+    printf("\t -f: start of the clip, seconds after the oldest GOP, default 0.\n");
+    printf("\t -d: length of the clip in seconds, default 10.\n");
+    printf("\t -o: export the clip, without it the segments are listed.\n");
+    printf("\t -c: check the indexes and the clip, exit status 1 if they are wrong.\n");
+}
+
+int main(int argc, char **argv) {
+    const char *out = NULL;
+    double from = 0, length = 10;
+    int64_t start, end;
+    int check = 0, opt, ret = 0, i;
+
+    while ((opt = getopt(argc, argv, "f:d:o:ch")) != -1) {
+        switch (opt) {
+            case 'f': from = atof(optarg); break;
+            case 'd': length = atof(optarg); break;
+            case 'o': out = optarg; break;
+            case 'c': check = 1; break;
+            default:
+                exportUsage(argv[0]);
+                return -1;
+        }
+    }
+    if (optind != argc - 1 || from < 0 || length <= 0) {
+        exportUsage(argv[0]);
+        return -1;
+    }
+
+    if (exportLoad(argv[optind]) <= 0) {
+        printf("%s: no loop recording.\n", argv[optind]);
+        return 1;
+    }
+    exportList();
+
+    if (check) {
+        for (i = 0; i < gSegmentNum; i++)
+            if (exportCheckSegment(&gSegments[i]) < 0)
+                ret = 1;
+    }
+
+    if (out) {
+        start = exportWall(&gSegments[0], 0) + (int64_t)(from * 1000000);
+        end = start + (int64_t)(length * 1000000);
+        if (exportClip(out, start, end) <= 0 || (check && exportCheckClip(out, start, end) < 0))
+            ret = 1;
+    }
+
+    if (check)
+        printf("check %s.\n", ret ? "failed" : "ok");
+    for (i = 0; i < gSegmentNum; i++)
+        loopIndexFree(&gSegments[i].index);
+    return ret;
+}
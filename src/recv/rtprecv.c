@@ -0,0 +1,733 @@
+/*
+ * Copyright (c) 2018 Liming Shao <lmshao@163.com>
+ */
+
+/*
+ * RTP receiver for end to end measurement, built on the host with `make recv`.
+ *
+ * Depacketizes H.264 (single NALU, STAP-A, FU-A, RFC 6184) or H.265 (single, AP, FU,
+ * RFC 7798), reassembles access units at the marker bit and reports loss, reordering,
+ * duplicates, jitter, inter-frame arrival and packet-to-frame latency. With -c the access
+ * units are checked against the file the sender replays, in any order or loop.
+ * With -n it opens N receivers on consecutive ports as a load generator.
+ * With -w the arrivals are written as a trace recv/jbtrace replays, e.g. of the audio.
+ * Frames with a capture time, of the abs-capture-time extension (HisiLive -c 1) or the
+ * capture time SEI (-c 2), give the glass to glass latency, from the capture to the frame
+ * complete here. Across hosts it is only as good as their NTP sync.
+ * With -r it answers the sender reports on port + 1 with a receiver report every second,
+ * which HisiLive -n steers the temporal layer of this viewer by. -L drops packets on
+ * arrival like a lossy link, for the first seconds only to watch the layer come back.
+ *
+ *   recv/rtprecv -p 1234 -c clip.h264
+ *   recv/rtprecv -p 5000 -n 32 -t 60 -j
+ *   recv/rtprecv -p 1236 -w audio.trace -t 60
+ *   recv/rtprecv -p 1234 -x 1 -t 60
+ *   recv/rtprecv -p 1234 -r -L 10,20 -t 90
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "RTPRecv.h"
+#include "Replay.h"
+#include "Media.h"
+#include "Utils.h"
+
+#define RECV_BATCH          32
+#define RECV_PKT_MAX        2048
+#define HISTO_STEP          100     // us per bin
+#define HISTO_BINS          20000   // up to 2 s
+#define RR_INTERVAL_US      1000000
+
+typedef struct {
+    uint32_t bins[HISTO_BINS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+}Histo;
+
+typedef struct {
+    int fd;
+    int port;
+    int codec;                  // 0, H.264/AVC; 1, HEVC/H.265
+    RTPRecvStats stats;
+    uint64_t bytes;
+    uint32_t invalid;
+
+    /* access unit being reassembled */
+    uint8_t *au;
+    size_t auSize;
+    size_t auCap;
+    uint32_t auTs;
+    uint32_t auNextSeq;         // extended
+    int auBroken;
+    int fuActive;
+    uint64_t auFirstUs;
+    uint64_t auCaptureNtp;      // of the extension, 0 none
+
+    uint32_t frames;
+    uint32_t incomplete;        // lost or broken packets inside the frame
+    uint32_t noMarker;          // timestamp changed before the marker
+    uint32_t matched;
+    uint32_t mismatched;
+    uint64_t lastFrameUs;
+    Histo interFrame;
+    Histo latency;
+    Histo glass;                // capture of the extension to the frame complete
+    Histo glassSei;             // capture of the SEI to the frame complete
+    uint32_t skewed;            // captured after it was received, the clocks are off
+    int seiValid;               // the last SEI, the capture time of any frame follows from it
+    uint64_t seiPts;
+    uint64_t seiWallUs;
+    FILE *trace;                // -w, arrival_us seq ts marker pt size per packet
+
+    int rtcpFd;                 // -r, port + 1, -1 none
+    struct sockaddr_in rtcpPeer;// the sender reports come from there
+    int rtcpPeerValid;
+    uint64_t lastRRUs;
+    uint32_t dropped;           // -L
+}Receiver;
+
+typedef struct {
+    uint64_t hash;
+    int index;
+}SourceAu;
+
+static SourceAu *gSource;
+static int gSourceNum;
+static volatile int gRunning = 1;
+static int gCaptureExtId = 1;
+static int64_t gWallOffset;     // wallclock - monotonic us
+static int gReportRR;
+static double gLossPct;
+static double gLossSeconds;     // 0 the whole run
+static uint64_t gStartUs;
+
+static void histoAdd(Histo *h, uint64_t us) {
+    uint64_t bin = us / HISTO_STEP;
+    h->bins[bin < HISTO_BINS ? bin : HISTO_BINS - 1]++;
+    h->count++;
+    h->sum += us;
+    if (us > h->max)
+        h->max = us;
+}
+
+static void histoMerge(Histo *dst, const Histo *src) {
+    int i;
+    for (i = 0; i < HISTO_BINS; i++)
+        dst->bins[i] += src->bins[i];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+static double histoPercentile(const Histo *h, double p) {
+    uint64_t want = (uint64_t)(h->count * p), n = 0;
+    int i;
+
+    for (i = 0; i < HISTO_BINS; i++) {
+        n += h->bins[i];
+        if (n > want)
+            return (double)((uint64_t)(i + 1) * HISTO_STEP < h->max ? (uint64_t)(i + 1) * HISTO_STEP : h->max);
+    }
+    return (double)h->max;
+}
+
+/************ source check ************/
+
+/* hash of the NALUs of an access unit, start codes and trailing zeros excluded */
+static uint64_t auHash(const uint8_t *buf, size_t size) {
+    const uint8_t *end = buf + size, *r, *r1, *e;
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    r = ff_avc_find_startcode(buf, end);
+    while (r < end) {
+        while (r < end && !*r)
+            r++;
+        if (++r >= end)
+            break;
+        r1 = ff_avc_find_startcode(r, end);
+        for (e = r1; e > r && !e[-1]; e--);
+        h ^= (uint64_t)(e - r);
+        h *= 0x100000001b3ull;
+        for (; r < e; r++) {
+            h ^= *r;
+            h *= 0x100000001b3ull;
+        }
+        r = r1;
+    }
+    return h;
+}
+
+static int sourceCmp(const void *a, const void *b) {
+    uint64_t x = ((const SourceAu *)a)->hash, y = ((const SourceAu *)b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+static int sourceLoad(const char *path, int codec) {
+    ReplayContext replay;
+    VENC_STREAM_S stream;
+    const uint8_t *start;
+    size_t size;
+    int n, cap = 1024;
+    SourceAu *au;
+
+    if (replayOpen(&replay, path, codec, 30, 0, 1) < 0)
+        return -1;
+
+    gSource = (SourceAu *)malloc(cap * sizeof(SourceAu));
+    while (gSource && (n = replayNext(&replay, &stream)) > 0) {
+        if (gSourceNum == cap) {
+            au = (SourceAu *)realloc(gSource, cap * 2 * sizeof(SourceAu));
+            if (NULL == au)
+                break;
+            gSource = au;
+            cap *= 2;
+        }
+        start = stream.pstPack[0].pu8Addr;
+        size = (size_t)(stream.pstPack[n - 1].pu8Addr + stream.pstPack[n - 1].u32Len - start);
+        gSource[gSourceNum].hash = auHash(start, size);
+        gSource[gSourceNum].index = gSourceNum;
+        gSourceNum++;
+    }
+    replayClose(&replay);
+
+    if (NULL == gSource || 0 == gSourceNum)
+        return -1;
+    qsort(gSource, (size_t)gSourceNum, sizeof(SourceAu), sourceCmp);
+    printf("source %s: %d access units\n", path, gSourceNum);
+    return 0;
+}
+
+/************ glass to glass ************/
+
+static void glassAdd(Receiver *rx, Histo *h, uint64_t now, uint64_t captureWallUs) {
+    int64_t us = (int64_t)(now + gWallOffset) - (int64_t)captureWallUs;
+
+    if (us < 0)
+        rx->skewed++;
+    else
+        histoAdd(h, (uint64_t)us);
+}
+
+static void glassFrame(Receiver *rx, uint64_t now) {
+    uint64_t pts, ntp;
+    int32_t delta;
+
+    if (rx->auCaptureNtp)
+        glassAdd(rx, &rx->glass, now, ntpToWall(rx->auCaptureNtp));
+
+    if (0 == seiCaptureFind(rx->au, (int)rx->auSize, rx->codec, &pts, &ntp)) {
+        rx->seiValid = 1;
+        rx->seiPts = pts;
+        rx->seiWallUs = ntpToWall(ntp);
+    }
+    if (rx->seiValid) {
+        /* the rtp timestamp is the pts in 90 kHz */
+        delta = (int32_t)(rx->auTs - (uint32_t)(rx->seiPts * 9 / 100));
+        glassAdd(rx, &rx->glassSei, now, rx->seiWallUs + (int64_t)delta * 100 / 9);
+    }
+}
+
+/************ depacketizer ************/
+
+static int auAppend(Receiver *rx, const uint8_t *data, size_t size, int startCode) {
+    uint8_t *au;
+    size_t need = rx->auSize + size + 4;
+
+    if (need > rx->auCap) {
+        au = (uint8_t *)realloc(rx->au, need * 2);
+        if (NULL == au)
+            return -1;
+        rx->au = au;
+        rx->auCap = need * 2;
+    }
+    if (startCode) {
+        memcpy(rx->au + rx->auSize, "\0\0\0\1", 4);
+        rx->auSize += 4;
+    }
+    memcpy(rx->au + rx->auSize, data, size);
+    rx->auSize += size;
+    return 0;
+}
+
+static void auFinish(Receiver *rx, uint64_t now, int marker) {
+    SourceAu key, *hit;
+
+    if (0 == rx->auSize && !rx->auBroken)
+        return;
+
+    rx->frames++;
+    if (!marker)
+        rx->noMarker++;
+    if (rx->auBroken || !marker || rx->fuActive) {
+        rx->incomplete++;
+    } else {
+        if (rx->lastFrameUs)
+            histoAdd(&rx->interFrame, now - rx->lastFrameUs);
+        rx->lastFrameUs = now;
+        histoAdd(&rx->latency, now - rx->auFirstUs);
+        glassFrame(rx, now);
+
+        if (gSourceNum) {
+            key.hash = auHash(rx->au, rx->auSize);
+            hit = (SourceAu *)bsearch(&key, gSource, (size_t)gSourceNum, sizeof(SourceAu), sourceCmp);
+            if (hit)
+                rx->matched++;
+            else
+                rx->mismatched++;
+        }
+    }
+
+    rx->auSize = 0;
+    rx->auBroken = 0;
+    rx->fuActive = 0;
+    rx->auCaptureNtp = 0;
+}
+
+/* aggregation packet: 16 bit size before every NALU, the header has hdr bytes */
+static void depayAggregate(Receiver *rx, const uint8_t *p, int size, int hdr) {
+    int len;
+
+    p += hdr;
+    size -= hdr;
+    while (size >= 2) {
+        len = p[0] << 8 | p[1];
+        if (len == 0 || len > size - 2) {
+            rx->auBroken = 1;
+            return;
+        }
+        auAppend(rx, p + 2, (size_t)len, 1);
+        p += 2 + len;
+        size -= 2 + len;
+    }
+}
+
+static void depayH264(Receiver *rx, const uint8_t *p, int size) {
+    uint8_t type = p[0] & 0x1f, header;
+
+    if (type >= 1 && type <= 23) {
+        auAppend(rx, p, (size_t)size, 1);
+    } else if (type == 24) {                    // STAP-A
+        depayAggregate(rx, p, size, 1);
+    } else if (type == 28 && size > 2) {        // FU-A
+        if (p[1] & 0x80) {
+            header = (uint8_t)((p[0] & 0xe0) | (p[1] & 0x1f));
+            auAppend(rx, &header, 1, 1);
+            rx->fuActive = 1;
+        } else if (!rx->fuActive) {
+            rx->auBroken = 1;                   // the start fragment is missing
+            return;
+        }
+        auAppend(rx, p + 2, (size_t)(size - 2), 0);
+        if (p[1] & 0x40)
+            rx->fuActive = 0;
+    } else {
+        rx->auBroken = 1;
+    }
+}
+
+static void depayHEVC(Receiver *rx, const uint8_t *p, int size) {
+    uint8_t type = (p[0] >> 1) & 0x3f, header[2];
+
+    if (size < 3) {
+        rx->auBroken = 1;
+    } else if (type < 48) {
+        auAppend(rx, p, (size_t)size, 1);
+    } else if (type == 48) {                    // AP
+        depayAggregate(rx, p, size, 2);
+    } else if (type == 49) {                    // FU
+        if (p[2] & 0x80) {
+            header[0] = (uint8_t)((p[0] & 0x81) | ((p[2] & 0x3f) << 1));
+            header[1] = p[1];
+            auAppend(rx, header, 2, 1);
+            rx->fuActive = 1;
+        } else if (!rx->fuActive) {
+            rx->auBroken = 1;
+            return;
+        }
+        auAppend(rx, p + 3, (size_t)(size - 3), 0);
+        if (p[2] & 0x40)
+            rx->fuActive = 0;
+    } else {
+        rx->auBroken = 1;
+    }
+}
+
+static void receiverPacket(Receiver *rx, const uint8_t *buf, int len, uint64_t now) {
+    RTPPacket pkt;
+    const uint8_t *capture;
+    uint32_t ext;
+    int dup, i;
+
+    if (rtpParse(&pkt, buf, len) < 0 || pkt.size <= 0) {
+        rx->invalid++;
+        return;
+    }
+    if (rx->trace)
+        fprintf(rx->trace, "%llu %u %u %d %d %d\n", (unsigned long long)now, pkt.seq, pkt.timestamp,
+                pkt.marker, pkt.payloadType, pkt.size);
+
+    ext = rtpStatsUpdate(&rx->stats, &pkt, now, &dup);
+    if (dup)
+        return;
+    rx->bytes += (uint64_t)len;
+
+    /* too late for its frame, already counted as reordered */
+    if (rx->stats.received > 1 && (int32_t)(ext - rx->auNextSeq) < 0)
+        return;
+
+    /* a new timestamp closes the previous access unit, its marker was lost */
+    if ((rx->auSize || rx->auBroken) && pkt.timestamp != rx->auTs)
+        auFinish(rx, now, 0);
+
+    if (0 == rx->auSize && !rx->auBroken) {
+        rx->auTs = pkt.timestamp;
+        rx->auFirstUs = now;
+    }
+    if (gCaptureExtId && rtpFindExt(&pkt, gCaptureExtId, &capture) >= 8) {
+        for (rx->auCaptureNtp = 0, i = 0; i < 8; i++)
+            rx->auCaptureNtp = rx->auCaptureNtp << 8 | capture[i];
+    }
+    if (rx->stats.received > 1 && ext != rx->auNextSeq)
+        rx->auBroken = 1;                       // packets of this frame lost
+    rx->auNextSeq = ext + 1;
+
+    if (rx->codec)
+        depayHEVC(rx, pkt.payload, pkt.size);
+    else
+        depayH264(rx, pkt.payload, pkt.size);
+
+    if (pkt.marker)
+        auFinish(rx, now, 1);
+}
+
+/************ receiver reports ************/
+
+static void receiverRtcp(Receiver *rx, uint64_t now) {
+    uint8_t buf[RECV_PKT_MAX], rr[RTCP_RR_SIZE];
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    ssize_t len;
+    int size;
+
+    while ((len = recvfrom(rx->rtcpFd, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &fromLen)) > 0) {
+        rtpStatsSR(&rx->stats, buf, (int)len, now);
+        rx->rtcpPeer = from;
+        rx->rtcpPeerValid = 1;
+        fromLen = sizeof(from);
+    }
+
+    if (!rx->rtcpPeerValid || 0 == rx->stats.received || now - rx->lastRRUs < RR_INTERVAL_US)
+        return;
+    rx->lastRRUs = now;
+    size = rtcpBuildRR(&rx->stats, 0x52520000u | (uint32_t)rx->port, now, rr);
+    sendto(rx->rtcpFd, rr, (size_t)size, 0, (struct sockaddr *)&rx->rtcpPeer, sizeof(rx->rtcpPeer));
+}
+
+/* -L, a lossy link in front of the receiver */
+static int receiverDrop(Receiver *rx, uint64_t now) {
+    if (gLossPct <= 0 || (gLossSeconds > 0 && now - gStartUs >= (uint64_t)(gLossSeconds * 1e6)))
+        return 0;
+    if (rand() % 10000 >= (int)(gLossPct * 100))
+        return 0;
+    rx->dropped++;
+    return 1;
+}
+
+/************ main ************/
+
+static int receiverBind(int port, int size) {
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+
+    if (fd < 0)
+        return -1;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        printf("bind port %d error %d.\n", port, errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int receiverOpen(Receiver *rx, int port, int codec) {
+    memset(rx, 0, sizeof(Receiver));
+    rx->port = port;
+    rx->codec = codec;
+    rx->rtcpFd = -1;
+    rtpStatsInit(&rx->stats, 90000);
+
+    rx->fd = receiverBind(port, 4 * 1024 * 1024);
+    if (rx->fd < 0)
+        return -1;
+    if (gReportRR && (rx->rtcpFd = receiverBind(port + 1, 64 * 1024)) < 0) {
+        close(rx->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static void receiverRead(Receiver *rx, uint8_t (*bufs)[RECV_PKT_MAX], struct mmsghdr *msgs, struct iovec *iovs) {
+    uint64_t now;
+    int i, n;
+
+    for (;;) {
+        for (i = 0; i < RECV_BATCH; i++) {
+            iovs[i].iov_base = bufs[i];
+            iovs[i].iov_len = RECV_PKT_MAX;
+            memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        n = recvmmsg(rx->fd, msgs, RECV_BATCH, MSG_DONTWAIT, NULL);
+        if (n <= 0)
+            return;
+        now = getMonotonicTime();
+        gWallOffset = (int64_t)getWallClockTime() - (int64_t)now;
+        for (i = 0; i < n; i++) {
+            if (!receiverDrop(rx, now))
+                receiverPacket(rx, bufs[i], (int)msgs[i].msg_len, now);
+        }
+        if (n < RECV_BATCH)
+            return;
+    }
+}
+
+typedef struct {
+    uint64_t received, lost, reordered, duplicates, bytes, invalid;
+    uint64_t frames, incomplete, noMarker, matched, mismatched, skewed, dropped;
+    double jitterUs, maxJitterUs;
+    int worstPort;
+    Histo interFrame;
+    Histo latency;
+    Histo glass;
+    Histo glassSei;
+}Summary;
+
+static void summarize(Summary *s, Receiver *rx, int n) {
+    double jitter;
+    int i;
+
+    memset(s, 0, sizeof(Summary));
+    for (i = 0; i < n; i++) {
+        s->received += rx[i].stats.received;
+        s->lost += rtpStatsLost(&rx[i].stats);
+        s->reordered += rx[i].stats.reordered;
+        s->duplicates += rx[i].stats.duplicates;
+        s->bytes += rx[i].bytes;
+        s->invalid += rx[i].invalid;
+        s->frames += rx[i].frames;
+        s->incomplete += rx[i].incomplete;
+        s->noMarker += rx[i].noMarker;
+        s->matched += rx[i].matched;
+        s->mismatched += rx[i].mismatched;
+        s->skewed += rx[i].skewed;
+        s->dropped += rx[i].dropped;
+        jitter = rtpStatsJitterUs(&rx[i].stats);
+        s->jitterUs += jitter / n;
+        if (jitter >= s->maxJitterUs) {
+            s->maxJitterUs = jitter;
+            s->worstPort = rx[i].port;
+        }
+        histoMerge(&s->interFrame, &rx[i].interFrame);
+        histoMerge(&s->latency, &rx[i].latency);
+        histoMerge(&s->glass, &rx[i].glass);
+        histoMerge(&s->glassSei, &rx[i].glassSei);
+    }
+}
+
+static void reportJson(Receiver *rx, int n, double seconds) {
+    Summary s;
+
+    summarize(&s, rx, n);
+    printf("{\"receivers\":%d,\"seconds\":%.1f,\"packets\":%llu,\"lost\":%llu,\"loss_pct\":%.3f,"
+           "\"reordered\":%llu,\"duplicates\":%llu,\"invalid\":%llu,\"mbps\":%.2f,"
+           "\"jitter_us\":%.0f,\"jitter_max_us\":%.0f,\"jitter_worst_port\":%d,"
+           "\"frames\":%llu,\"incomplete\":%llu,\"no_marker\":%llu,\"matched\":%llu,\"mismatched\":%llu,"
+           "\"interframe_mean_us\":%.0f,\"interframe_p99_us\":%.0f,\"interframe_max_us\":%llu,"
+           "\"latency_mean_us\":%.0f,\"latency_p99_us\":%.0f,\"latency_max_us\":%llu,"
+           "\"glass_frames\":%llu,\"glass_mean_us\":%.0f,\"glass_p99_us\":%.0f,\"glass_max_us\":%llu,"
+           "\"glass_sei_frames\":%llu,\"glass_sei_mean_us\":%.0f,\"glass_sei_p99_us\":%.0f,"
+           "\"glass_sei_max_us\":%llu,\"skewed\":%llu}\n",
+           n, seconds, (unsigned long long)s.received, (unsigned long long)s.lost,
+           s.received + s.lost ? 100.0 * s.lost / (s.received + s.lost) : 0.0,
+           (unsigned long long)s.reordered, (unsigned long long)s.duplicates, (unsigned long long)s.invalid,
+           seconds > 0 ? s.bytes * 8 / seconds / 1e6 : 0.0,
+           s.jitterUs, s.maxJitterUs, s.worstPort,
+           (unsigned long long)s.frames, (unsigned long long)s.incomplete, (unsigned long long)s.noMarker,
+           (unsigned long long)s.matched, (unsigned long long)s.mismatched,
+           s.interFrame.count ? (double)s.interFrame.sum / s.interFrame.count : 0.0,
+           histoPercentile(&s.interFrame, 0.99), (unsigned long long)s.interFrame.max,
+           s.latency.count ? (double)s.latency.sum / s.latency.count : 0.0,
+           histoPercentile(&s.latency, 0.99), (unsigned long long)s.latency.max,
+           (unsigned long long)s.glass.count, s.glass.count ? (double)s.glass.sum / s.glass.count : 0.0,
+           histoPercentile(&s.glass, 0.99), (unsigned long long)s.glass.max,
+           (unsigned long long)s.glassSei.count, s.glassSei.count ? (double)s.glassSei.sum / s.glassSei.count : 0.0,
+           histoPercentile(&s.glassSei, 0.99), (unsigned long long)s.glassSei.max, (unsigned long long)s.skewed);
+}
+
+static void reportLine(Receiver *rx, int n, Summary *last, double interval) {
+    Summary s;
+
+    summarize(&s, rx, n);
+    printf("rx %6.0f pkt/s %6.2f Mbps  lost %llu  reorder %llu  dup %llu  jitter %.0f/%.0f us  "
+           "frames %.1f/s incomplete %llu",
+           (s.received - last->received) / interval, (s.bytes - last->bytes) * 8 / interval / 1e6,
+           (unsigned long long)s.lost, (unsigned long long)s.reordered, (unsigned long long)s.duplicates,
+           s.jitterUs, s.maxJitterUs, (s.frames - last->frames) / interval, (unsigned long long)s.incomplete);
+    if (gSourceNum)
+        printf("  match %llu/%llu", (unsigned long long)s.matched, (unsigned long long)(s.matched + s.mismatched));
+    if (s.glass.count)
+        printf("  glass %.1f/%.1f ms", (double)s.glass.sum / s.glass.count / 1000, histoPercentile(&s.glass, 0.99) / 1000);
+    if (s.glassSei.count)
+        printf("  sei %.1f/%.1f ms", (double)s.glassSei.sum / s.glassSei.count / 1000,
+               histoPercentile(&s.glassSei, 0.99) / 1000);
+    if (s.skewed)
+        printf("  skewed %llu", (unsigned long long)s.skewed);
+    if (s.dropped)
+        printf("  dropped %llu", (unsigned long long)s.dropped);
+    printf("\n");
+    fflush(stdout);
+    *last = s;
+}
+
+static void recvHandleSig(int signo) {
+    gRunning = 0;
+}
+
+static void recvUsage(const char *prg) {
+    printf("Usage : %s [-p port] [-n receivers] [-e 264|265] [-c source] [-t seconds] [-i interval] [-j] [-w trace] [-x id] [-r] [-L pct[,seconds]]\n", prg);
+    printf("\t -p: first udp port, default 1234.\n");
+    printf("\t -n: receivers on consecutive ports, default 1.\n");
+    printf("\t -e: codec, default 264.\n");
+    printf("\t -c: check access units against the .h264/.h265 file the sender replays.\n");
+    printf("\t -t: stop after seconds, default 0, until Ctrl-C.\n");
+    printf("\t -i: report interval seconds, default 1, 0 only the summary.\n");
+    printf("\t -j: summary as one JSON object.\n");
+    printf("\t -w: write the packet arrivals of the first port to a trace file for recv/jbtrace.\n");
+    printf("\t -x: abs-capture-time extension id, the a=extmap of the sdp, 0 ignores it, default 1.\n");
+    printf("\t -r: receiver reports on port + 1 to the sender reports, one receiver only.\n");
+    printf("\t -L: drop pct of the packets on arrival, only in the first seconds if given.\n");
+}
+
+int main(int argc, char **argv) {
+    static uint8_t bufs[RECV_BATCH][RECV_PKT_MAX];
+    struct mmsghdr msgs[RECV_BATCH];
+    struct iovec iovs[RECV_BATCH];
+    struct epoll_event ev, events[64];
+    Receiver *rx;
+    Summary last;
+    const char *source = NULL, *trace = NULL;
+    uint64_t start, lastReport, now;
+    double seconds = 0, interval = 1;
+    int port = 1234, num = 1, codec = 0, json = 0, epfd, opt, i, n;
+
+    while ((opt = getopt(argc, argv, "p:n:e:c:t:i:w:x:L:rjh")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 'n': num = atoi(optarg); break;
+            case 'e': codec = strstr(optarg, "265") != NULL; break;
+            case 'c': source = optarg; break;
+            case 't': seconds = atof(optarg); break;
+            case 'i': interval = atof(optarg); break;
+            case 'j': json = 1; break;
+            case 'w': trace = optarg; break;
+            case 'x': gCaptureExtId = atoi(optarg); break;
+            case 'r': gReportRR = 1; break;
+            case 'L':
+                gLossPct = atof(optarg);
+                if (strchr(optarg, ','))
+                    gLossSeconds = atof(strchr(optarg, ',') + 1);
+                break;
+            default:
+                recvUsage(argv[0]);
+                return -1;
+        }
+    }
+    if (port <= 0 || num <= 0 || port + num > 65536 || (gReportRR && (num > 1 || port + 1 > 65535)) ||
+        gLossPct < 0 || gLossPct > 100) {
+        recvUsage(argv[0]);
+        return -1;
+    }
+    if (source && sourceLoad(source, codec) < 0) {
+        printf("load source %s failed.\n", source);
+        return -1;
+    }
+
+    rx = (Receiver *)calloc((size_t)num, sizeof(Receiver));
+    epfd = epoll_create1(0);
+    if (NULL == rx || epfd < 0)
+        return -1;
+    for (i = 0; i < num; i++) {
+        if (receiverOpen(&rx[i], port + i, codec) < 0)
+            return -1;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &rx[i];
+        epoll_ctl(epfd, EPOLL_CTL_ADD, rx[i].fd, &ev);
+    }
+    if (trace && NULL == (rx[0].trace = fopen(trace, "w"))) {
+        printf("open %s error %d.\n", trace, errno);
+        return -1;
+    }
+    printf("%d receiver(s) on udp %d-%d, %s\n", num, port, port + num - 1, codec ? "H.265" : "H.264");
+
+    signal(SIGINT, recvHandleSig);
+    signal(SIGTERM, recvHandleSig);
+
+    memset(&last, 0, sizeof(last));
+    start = lastReport = gStartUs = getMonotonicTime();
+    srand((unsigned)start);
+    while (gRunning) {
+        n = epoll_wait(epfd, events, 64, 100);
+        for (i = 0; i < n; i++)
+            receiverRead((Receiver *)events[i].data.ptr, bufs, msgs, iovs);
+
+        now = getMonotonicTime();
+        for (i = 0; gReportRR && i < num; i++)
+            receiverRtcp(&rx[i], now);
+        if (interval > 0 && now - lastReport >= (uint64_t)(interval * 1e6)) {
+            reportLine(rx, num, &last, (double)(now - lastReport) / 1e6);
+            lastReport = now;
+        }
+        if (seconds > 0 && now - start >= (uint64_t)(seconds * 1e6))
+            break;
+    }
+
+    now = getMonotonicTime();
+    if (json) {
+        reportJson(rx, num, (double)(now - start) / 1e6);
+    } else {
+        memset(&last, 0, sizeof(last));
+        printf("total: ");
+        reportLine(rx, num, &last, (double)(now - start) / 1e6);
+    }
+
+    for (i = 0; i < num; i++) {
+        close(rx[i].fd);
+        if (rx[i].rtcpFd >= 0)
+            close(rx[i].rtcpFd);
+        free(rx[i].au);
+    }
+    if (rx[0].trace)
+        fclose(rx[0].trace);
+    free(rx);
+    free(gSource);
+    close(epfd);
+    return 0;
+}